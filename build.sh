@@ -2,6 +2,7 @@
 
 SOURCEFILES=../src/build.c
 OUTPUTFILE=muda
+TESTS="arena_test compile_db_test build_db_test jobserver_test remote_test"
 GCCFLAGS="-g"
 CLANGFLAGS="-gcodeview -Od"
 
@@ -9,6 +10,10 @@ if [ ! -d "./release" ]; then
     mkdir release
 fi
 
+if [ ! -d "./tests/bin" ]; then
+    mkdir tests/bin
+fi
+
 if [ "$1" == "optimize" ]; then
     GCCFLAGS="-O2"
     CLANGFLAGS="-O2 -gcodeview"
@@ -20,9 +25,16 @@ echo ------------------------------
 if command -v gcc &> /dev/null
 then
     pushd release
-    gcc -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-pointer-to-int-cast $GCCFLAGS $SOURCEFILES -o $OUTPUTFILE -ldl
+    gcc -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-pointer-to-int-cast $GCCFLAGS $SOURCEFILES -o $OUTPUTFILE -ldl -lpthread
+    STATUS=$?
+    for TEST in $TESTS; do
+        [ $STATUS -eq 0 ] || break
+        gcc -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-pointer-to-int-cast $GCCFLAGS ../tests/$TEST.c -o ../tests/bin/$TEST -ldl -lpthread &&
+        ../tests/bin/$TEST
+        STATUS=$?
+    done
     popd
-    exit
+    exit $STATUS
 else
     echo GCC Not Found
     echo ------------------------------
@@ -34,9 +46,16 @@ echo ------------------------------
 if command -v clang &> /dev/null
 then
     pushd release
-    clang -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-void-pointer-to-int-cast $SOURCEFILES $COMPILERFLAGS -o $OUTPUTFILE -ldl
+    clang -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-void-pointer-to-int-cast $SOURCEFILES $COMPILERFLAGS -o $OUTPUTFILE -ldl -lpthread
+    STATUS=$?
+    for TEST in $TESTS; do
+        [ $STATUS -eq 0 ] || break
+        clang -D_GNU_SOURCE -DASSERTION_HANDLED -DDEPRECATION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -Wno-void-pointer-to-int-cast ../tests/$TEST.c $COMPILERFLAGS -o ../tests/bin/$TEST -ldl -lpthread &&
+        ../tests/bin/$TEST
+        STATUS=$?
+    done
     popd
-    exit
+    exit $STATUS
 else
     echo Clang Not Found
     echo ------------------------------
@@ -48,7 +48,7 @@ IF %ERRORLEVEL% NEQ 0 goto SkipCLANG
 where llvm-rc >nul 2>nul
 IF %ERRORLEVEL% NEQ 0 goto SkipCLANG
 echo Building with CLANG
-call clang -DASSERTION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -D_CRT_SECURE_NO_WARNINGS %SourceFiles% %CompilerFlags% -o %OutputBinary% -lShlwapi.lib -lUserenv.lib -lAdvapi32.lib
+call clang -DASSERTION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion -D_CRT_SECURE_NO_WARNINGS %SourceFiles% %CompilerFlags% -o %OutputBinary% -lShlwapi.lib -lUserenv.lib -lAdvapi32.lib -lPsapi.lib -lWs2_32.lib
 echo -------------------------------------
 goto Finished
 :SkipCLANG
@@ -61,7 +61,7 @@ IF %ERRORLEVEL% NEQ 0 goto SkipGCC
 where windres >nul 2>nul
 IF %ERRORLEVEL% NEQ 0 goto SkipGCC
 echo Building with GCC
-call gcc -DASSERTION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion %SourceFiles% %CompilerFlags% -o %OutputBinary%  -lShlwapi -lUserenv -lAdvapi32
+call gcc -DASSERTION_HANDLED -Wno-switch -Wno-pointer-sign -Wno-enum-conversion %SourceFiles% %CompilerFlags% -o %OutputBinary%  -lShlwapi -lUserenv -lAdvapi32 -lPsapi -lWs2_32
 echo -------------------------------------
 goto Finished
 :SkipGCC
@@ -0,0 +1,149 @@
+//
+// Reference cache provider, blobs are stored in a directory shared between machines (NFS, SMB...)
+// The directory is given by the MUDA_CACHE_DIRECTORY environment variable, blobs are laid out as "<dir>/ab/abcd...".
+// Files are written under a temporary name and renamed once complete, so that readers never see partial blobs.
+//
+// Linux:   cc -shared -fPIC cache_directory.c -o .muda/plugins/cache_directory.so
+// Windows: cl -LD cache_directory.c -Fe.muda/plugins/cache_directory.dll
+//
+
+#include "../src/plugin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PLATFORM_OS_WINDOWS == 1
+#include <windows.h>
+#define ProcessId() ((unsigned long)GetCurrentProcessId())
+#define ThreadId() ((unsigned long)GetCurrentThreadId())
+#else
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ProcessId() ((unsigned long)getpid())
+#define ThreadId() ((unsigned long)pthread_self())
+#endif
+
+static char CacheDirectory[1024];
+
+static int ReplaceFile(const char *from, const char *to)
+{
+#if PLATFORM_OS_WINDOWS == 1
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+static int MakeDirectory(const char *path)
+{
+#if PLATFORM_OS_WINDOWS == 1
+    return (CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS) ? 0 : -1;
+#else
+    struct stat info;
+    if (mkdir(path, 0777) == 0 || stat(path, &info) == 0)
+        return 0;
+    return -1;
+#endif
+}
+
+static int CopyFileContent(const char *from, const char *to)
+{
+    char temp[1200];
+    snprintf(temp, sizeof(temp), "%s.%lx.%lx.tmp", to, ProcessId(), ThreadId());
+
+    FILE *in = fopen(from, "rb");
+    if (!in)
+        return -1;
+    FILE *out = fopen(temp, "wb");
+    if (!out)
+    {
+        fclose(in);
+        return -1;
+    }
+
+    char   buffer[64 * 1024];
+    size_t size;
+    int    result = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        if (fwrite(buffer, 1, size, out) != size)
+        {
+            result = -1;
+            break;
+        }
+    }
+    if (ferror(in))
+        result = -1;
+
+    fclose(in);
+    if (fclose(out) != 0)
+        result = -1;
+
+    if (result == 0)
+        result = ReplaceFile(temp, to);
+    if (result != 0)
+        remove(temp);
+    return result;
+}
+
+static void BlobPath(char *path, size_t size, const char *key)
+{
+    snprintf(path, size, "%s/%.2s/%s", CacheDirectory, key, key);
+}
+
+static int32_t DirectoryContains(void *context, const char *key)
+{
+    char path[1200];
+    BlobPath(path, sizeof(path), key);
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return -1;
+    fclose(fp);
+    return 0;
+}
+
+static int32_t DirectoryGet(void *context, const char *key, const char *path)
+{
+    char blob[1200];
+    BlobPath(blob, sizeof(blob), key);
+    return CopyFileContent(blob, path);
+}
+
+static int32_t DirectoryPut(void *context, const char *key, const char *path)
+{
+    char blob[1200];
+    snprintf(blob, sizeof(blob), "%s/%.2s", CacheDirectory, key);
+    if (MakeDirectory(blob) != 0)
+        return -1;
+    BlobPath(blob, sizeof(blob), key);
+    return CopyFileContent(path, blob);
+}
+
+static const Muda_Cache_Provider DirectoryProvider = {DirectoryContains, DirectoryGet, DirectoryPut, NULL, 0};
+
+MudaHandleEvent()
+{
+    if (MudaGetEventKind() == Muda_Plugin_Event_Kind_Detection)
+    {
+        MudaPluginName("CacheDirectory");
+
+        const char *directory = getenv("MUDA_CACHE_DIRECTORY");
+        if (!directory || !directory[0])
+        {
+            MudaWarn("CacheDirectory: MUDA_CACHE_DIRECTORY is not set, the plugin is disabled\n");
+            return -1;
+        }
+
+        snprintf(CacheDirectory, sizeof(CacheDirectory), "%s", directory);
+        if (MakeDirectory(CacheDirectory) != 0)
+        {
+            MudaWarn("CacheDirectory: could not create %s\n", CacheDirectory);
+            return -1;
+        }
+
+        MudaSubscribe(0);
+        MudaSetCacheProvider(&DirectoryProvider);
+    }
+    return 0;
+}
@@ -0,0 +1,283 @@
+//
+// Reference cache provider talking to an HTTP server, for example a local stand-in of a remote cache
+// The server is given by the MUDA_CACHE_URL environment variable ("http://127.0.0.1:8080/muda"), blobs are read with
+// "GET <prefix>/<key>", stored with "PUT <prefix>/<key>" and looked up with "HEAD <prefix>/<key>". Any server
+// accepting these requests works, nginx with "dav_methods PUT" for example. Plain HTTP/1.0 only, without TLS. Blobs
+// must be sent with their Content-Length, a response that is chunked or shorter than its length is a miss.
+//
+// Linux:   cc -shared -fPIC cache_http.c -o .muda/plugins/cache_http.so
+// Windows: cl -LD cache_http.c ws2_32.lib -Fe.muda/plugins/cache_http.dll
+//
+
+#include "../src/plugin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if PLATFORM_OS_WINDOWS == 1
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+typedef SOCKET Socket;
+#define INVALID_SOCKET_HANDLE INVALID_SOCKET
+#define CloseSocket closesocket
+#define ProcessId() ((unsigned long)GetCurrentProcessId())
+#define ThreadId() ((unsigned long)GetCurrentThreadId())
+#define StrCompareCaseInsensitive _strnicmp
+#else
+#include <netdb.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int Socket;
+#define INVALID_SOCKET_HANDLE -1
+#define CloseSocket close
+#define ProcessId() ((unsigned long)getpid())
+#define ThreadId() ((unsigned long)pthread_self())
+#define StrCompareCaseInsensitive strncasecmp
+#endif
+
+static char Host[256];
+static char Port[16];
+static char Prefix[512];
+
+static int ParseUrl(const char *url)
+{
+    if (strncmp(url, "http://", 7) != 0)
+        return -1;
+    url += 7;
+
+    size_t host_length = strcspn(url, ":/");
+    if (host_length == 0 || host_length >= sizeof(Host))
+        return -1;
+    memcpy(Host, url, host_length);
+    Host[host_length] = 0;
+    url += host_length;
+
+    snprintf(Port, sizeof(Port), "80");
+    if (*url == ':')
+    {
+        url += 1;
+        size_t port_length = strcspn(url, "/");
+        if (port_length == 0 || port_length >= sizeof(Port))
+            return -1;
+        memcpy(Port, url, port_length);
+        Port[port_length] = 0;
+        url += port_length;
+    }
+
+    // Without the trailing '/', the key is appended as "<prefix>/<key>"
+    snprintf(Prefix, sizeof(Prefix), "%s", url);
+    size_t prefix_length = strlen(Prefix);
+    if (prefix_length && Prefix[prefix_length - 1] == '/')
+        Prefix[prefix_length - 1] = 0;
+    return 0;
+}
+
+static Socket Connect(void)
+{
+    struct addrinfo hints, *addresses = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(Host, Port, &hints, &addresses) != 0)
+        return INVALID_SOCKET_HANDLE;
+
+    Socket sock = INVALID_SOCKET_HANDLE;
+    for (struct addrinfo *address = addresses; address; address = address->ai_next)
+    {
+        sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (sock == INVALID_SOCKET_HANDLE)
+            continue;
+        if (connect(sock, address->ai_addr, (int)address->ai_addrlen) == 0)
+            break;
+        CloseSocket(sock);
+        sock = INVALID_SOCKET_HANDLE;
+    }
+    freeaddrinfo(addresses);
+    return sock;
+}
+
+static int SendAll(Socket sock, const char *data, size_t size)
+{
+    while (size)
+    {
+        int sent = send(sock, data, (int)(size > 65536 ? 65536 : size), 0);
+        if (sent <= 0)
+            return -1;
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+
+// Returns the value of the header "name" of the headers ending at "end", NULL if it is not present
+static const char *FindHeader(const char *headers, const char *end, const char *name)
+{
+    size_t length = strlen(name);
+    for (const char *line = strstr(headers, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n"))
+    {
+        if (StrCompareCaseInsensitive(line + 2, name, length) == 0 && line[2 + length] == ':')
+            return line + 3 + length;
+    }
+    return NULL;
+}
+
+// Sends the request with the content of the file "body" if not NULL, returns the HTTP status or -1
+// The body of the response is written to "response" if not NULL. It must be sent with its Content-Length, a body
+// that is chunked, without a length or shorter than its length gives -1.
+static int Request(const char *method, const char *key, FILE *body, FILE *response)
+{
+    Socket sock = Connect();
+    if (sock == INVALID_SOCKET_HANDLE)
+        return -1;
+
+    long body_size = 0;
+    if (body)
+    {
+        fseek(body, 0, SEEK_END);
+        body_size = ftell(body);
+        fseek(body, 0, SEEK_SET);
+    }
+
+    char header[1024];
+    int  length = snprintf(header, sizeof(header),
+                           "%s %s/%s HTTP/1.0\r\nHost: %s:%s\r\nContent-Length: %ld\r\nConnection: close\r\n\r\n",
+                           method, Prefix, key, Host, Port, body_size);
+    int  status = -1;
+    if (SendAll(sock, header, (size_t)length) != 0)
+        goto done;
+
+    char   buffer[64 * 1024];
+    size_t size;
+    while (body && (size = fread(buffer, 1, sizeof(buffer), body)) > 0)
+    {
+        if (SendAll(sock, buffer, size) != 0)
+            goto done;
+    }
+
+    // Status line and headers, then the body
+    size_t used        = 0;
+    char  *body_start  = NULL;
+    while (!body_start && used < sizeof(buffer) - 1)
+    {
+        int received = recv(sock, buffer + used, (int)(sizeof(buffer) - 1 - used), 0);
+        if (received <= 0)
+            goto done;
+        used += (size_t)received;
+        buffer[used] = 0;
+        body_start   = strstr(buffer, "\r\n\r\n");
+    }
+    if (!body_start || sscanf(buffer, "HTTP/%*s %d", &status) != 1)
+    {
+        status = -1;
+        goto done;
+    }
+
+    if (response && status == 200)
+    {
+        const char *value          = FindHeader(buffer, body_start, "Content-Length");
+        long long   content_length = value ? strtoll(value, NULL, 10) : -1;
+        if (content_length < 0 || FindHeader(buffer, body_start, "Transfer-Encoding"))
+        {
+            status = -1;
+            goto done;
+        }
+
+        body_start += 4;
+        size_t received_body = used - (size_t)(body_start - buffer);
+        if ((long long)received_body > content_length)
+            received_body = (size_t)content_length;
+        if (fwrite(body_start, 1, received_body, response) != received_body)
+            status = -1;
+
+        long long remaining = content_length - (long long)received_body;
+        while (status == 200 && remaining > 0)
+        {
+            size_t wanted   = remaining < (long long)sizeof(buffer) ? (size_t)remaining : sizeof(buffer);
+            int    received = recv(sock, buffer, (int)wanted, 0);
+            if (received <= 0 || fwrite(buffer, 1, (size_t)received, response) != (size_t)received)
+                status = -1;
+            else
+                remaining -= received;
+        }
+    }
+
+done:
+    CloseSocket(sock);
+    return status;
+}
+
+static int32_t HttpContains(void *context, const char *key)
+{
+    return Request("HEAD", key, NULL, NULL) == 200 ? 0 : -1;
+}
+
+static int32_t HttpGet(void *context, const char *key, const char *path)
+{
+    char temp[1200];
+    snprintf(temp, sizeof(temp), "%s.%lx.%lx.tmp", path, ProcessId(), ThreadId());
+
+    FILE *out = fopen(temp, "wb");
+    if (!out)
+        return -1;
+    int status = Request("GET", key, NULL, out);
+    if (fclose(out) != 0)
+        status = -1;
+
+    int result = -1;
+    if (status == 200)
+    {
+#if PLATFORM_OS_WINDOWS == 1
+        result = MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+        result = rename(temp, path);
+#endif
+    }
+    if (result != 0)
+        remove(temp);
+    return result;
+}
+
+static int32_t HttpPut(void *context, const char *key, const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return -1;
+    int status = Request("PUT", key, in, NULL);
+    fclose(in);
+    return (status >= 200 && status < 300) ? 0 : -1;
+}
+
+static const Muda_Cache_Provider HttpProvider = {HttpContains, HttpGet, HttpPut, NULL, 0};
+
+MudaHandleEvent()
+{
+    if (MudaGetEventKind() == Muda_Plugin_Event_Kind_Detection)
+    {
+        MudaPluginName("CacheHttp");
+
+        const char *url = getenv("MUDA_CACHE_URL");
+        if (!url || !url[0])
+        {
+            MudaWarn("CacheHttp: MUDA_CACHE_URL is not set, the plugin is disabled\n");
+            return -1;
+        }
+        if (ParseUrl(url) != 0)
+        {
+            MudaWarn("CacheHttp: %s is not an http:// URL\n", url);
+            return -1;
+        }
+
+#if PLATFORM_OS_WINDOWS == 1
+        WSADATA wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+            return -1;
+#endif
+
+        MudaSubscribe(0);
+        MudaSetCacheProvider(&HttpProvider);
+    }
+    return 0;
+}
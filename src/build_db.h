@@ -0,0 +1,235 @@
+#pragma once
+
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+
+#include <stdlib.h>
+
+//
+// Build database
+// Remembers how every output of a target was last produced, so that unchanged actions can be skipped.
+// Stored as text in the build directory, one record per line separated by tabs:
+// <command hash> <tool hash> <environment hash> <compiler> <duration> <peak memory> <output>
+// New columns must be added before the output, records with a different number of columns are dropped.
+//
+
+#define BUILD_DB_COLUMN_COUNT 7
+
+typedef struct Build_Fingerprint
+{
+    Uint64 Command;     // Normalized argv of the action
+    Uint64 Tool;        // Path and modification time of the executable, changes when the compiler is updated
+    Uint64 Environment; // Environment variables read by the compiler
+} Build_Fingerprint;
+
+typedef struct Build_Db_Record
+{
+    String                  Output;
+    Build_Fingerprint       Fingerprint;
+    Compiler_Kind           Compiler;
+    Uint64                  Duration; // Microseconds taken by the action, averaged with the previous runs
+    Uint64                  Memory;   // Peak resident bytes of the action, follows an increase at once
+    struct Build_Db_Record *Next;
+} Build_Db_Record;
+
+typedef struct Build_Db
+{
+    String            Path;
+    Build_Db_Record  *First;
+    Build_Db_Record **Table;
+    Uint32            TableSize;
+    Uint32            Count;
+    bool              Changed;
+    Memory_Arena     *Arena;
+} Build_Db;
+
+INLINE_PROCEDURE Build_Db_Record **BuildDbSlot(Build_Db *db, String output)
+{
+    Uint32 slot = (Uint32)StrHash(output);
+    for (;; ++slot)
+    {
+        Build_Db_Record **entry = &db->Table[slot & (db->TableSize - 1)];
+        if (*entry == NULL || StrMatch((*entry)->Output, output))
+            return entry;
+    }
+}
+
+INLINE_PROCEDURE Build_Db_Record *BuildDbFind(Build_Db *db, String output)
+{
+    return *BuildDbSlot(db, output);
+}
+
+static void BuildDbRehash(Build_Db *db, Uint32 table_size)
+{
+    db->TableSize = table_size;
+    db->Table     = PushArrayZero(db->Arena, Build_Db_Record *, table_size);
+    for (Build_Db_Record *record = db->First; record; record = record->Next)
+        *BuildDbSlot(db, record->Output) = record;
+}
+
+INLINE_PROCEDURE bool BuildFingerprintMatch(const Build_Fingerprint *a, const Build_Fingerprint *b)
+{
+    return a->Command == b->Command && a->Tool == b->Tool && a->Environment == b->Environment;
+}
+
+// A duration or memory of 0 keeps the recorded one
+static void BuildDbUpdate(Build_Db *db, String output, const Build_Fingerprint *fingerprint, Compiler_Kind compiler,
+                          Uint64 duration, Uint64 memory)
+{
+    Build_Db_Record *record = BuildDbFind(db, output);
+    if (record)
+    {
+        // Half of the new measure, so that a single slow run does not throw the estimates off
+        if (!duration)
+            duration = record->Duration;
+        else if (record->Duration)
+            duration = (record->Duration + duration) / 2;
+
+        // The memory is used to keep the actions under a budget, an increase is taken as is
+        if (!memory)
+            memory = record->Memory;
+        else if (memory < record->Memory)
+            memory = (record->Memory + memory) / 2;
+
+        if (BuildFingerprintMatch(&record->Fingerprint, fingerprint) && record->Compiler == compiler &&
+            record->Duration == duration && record->Memory == memory)
+            return;
+    }
+    else
+    {
+        if ((db->Count + 1) * 2 > db->TableSize)
+            BuildDbRehash(db, db->TableSize * 2);
+
+        record         = PushType(db->Arena, Build_Db_Record);
+        record->Output = StrDuplicateArena(output, db->Arena);
+        record->Next   = db->First;
+        db->First      = record;
+        db->Count += 1;
+        *BuildDbSlot(db, output) = record;
+    }
+
+    record->Fingerprint = *fingerprint;
+    record->Compiler    = compiler;
+    record->Duration    = duration;
+    record->Memory      = memory;
+    db->Changed         = true;
+}
+
+// A missing or unreadable database is treated as empty, every action is then considered dirty
+static void BuildDbLoad(Build_Db *db, String path, Memory_Arena *arena)
+{
+    db->Path    = StrDuplicateArena(path, arena);
+    db->First   = NULL;
+    db->Count   = 0;
+    db->Changed = false;
+    db->Arena   = arena;
+
+    File_Handle handle = OsFileOpen(path, File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize size = OsFileGetSize(handle);
+        Uint8  *data = PushSize(arena, size + 1);
+        if (size && OsFileRead(handle, data, size))
+        {
+            String content = StringMake(data, size);
+            while (content.Length)
+            {
+                Int64  line_end = StrFindCharacter(content, '\n', 0);
+                String line     = StrTrim(StringMake(content.Data, line_end < 0 ? content.Length : line_end));
+                content         = StrRemovePrefix(content, line_end < 0 ? content.Length : line_end + 1);
+
+                Int64 columns[BUILD_DB_COLUMN_COUNT] = {0};
+                Int64 column_count                   = 1;
+                Int64 pos                            = 0;
+                while (column_count < BUILD_DB_COLUMN_COUNT && (pos = StrFindCharacter(line, '\t', pos)) >= 0)
+                    columns[column_count++] = ++pos;
+                if (column_count != BUILD_DB_COLUMN_COUNT)
+                    continue;
+
+                Compiler_Kind compiler = (Compiler_Kind)strtoul((char *)line.Data + columns[3], NULL, 10);
+                if (compiler != Compiler_Bit_CL && compiler != Compiler_Bit_CLANG && compiler != Compiler_Bit_GCC)
+                    continue;
+
+                Build_Db_Record *record         = PushType(arena, Build_Db_Record);
+                record->Fingerprint.Command     = strtoull((char *)line.Data + columns[0], NULL, 16);
+                record->Fingerprint.Tool        = strtoull((char *)line.Data + columns[1], NULL, 16);
+                record->Fingerprint.Environment = strtoull((char *)line.Data + columns[2], NULL, 16);
+                record->Compiler                = compiler;
+                record->Duration                = strtoull((char *)line.Data + columns[4], NULL, 10);
+                record->Memory                  = strtoull((char *)line.Data + columns[5], NULL, 10);
+                record->Output                  = StrRemovePrefix(line, columns[6]);
+                record->Output.Data[record->Output.Length] = 0;
+                record->Next                    = db->First;
+                db->First                       = record;
+                db->Count += 1;
+            }
+        }
+        OsFileClose(handle);
+    }
+
+    Uint32 table_size = 64;
+    while (table_size < db->Count * 2)
+        table_size <<= 1;
+    db->TableSize = table_size;
+    db->Table     = PushArrayZero(arena, Build_Db_Record *, table_size);
+
+    // Records are listed from the last line, an output written twice keeps its last record
+    for (Build_Db_Record **record = &db->First; *record;)
+    {
+        Build_Db_Record **slot = BuildDbSlot(db, (*record)->Output);
+        if (*slot)
+        {
+            *record = (*record)->Next;
+            db->Count -= 1;
+            db->Changed = true;
+        }
+        else
+        {
+            *slot  = *record;
+            record = &(*record)->Next;
+        }
+    }
+}
+
+static bool BuildDbSave(Build_Db *db)
+{
+    if (!db->Changed)
+        return true;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Out_Stream       out;
+    OutCreate(&out, MemoryArenaAllocator(scratch));
+
+    for (Build_Db_Record *record = db->First; record; record = record->Next)
+    {
+        char line[136];
+        int  length = snprintf(line, sizeof(line), "%016llx\t%016llx\t%016llx\t%u\t%llu\t%llu\t",
+                               (unsigned long long)record->Fingerprint.Command,
+                               (unsigned long long)record->Fingerprint.Tool,
+                               (unsigned long long)record->Fingerprint.Environment, (unsigned)record->Compiler,
+                               (unsigned long long)record->Duration, (unsigned long long)record->Memory);
+        OutBuffer(&out, line, length);
+        OutString(&out, record->Output);
+        OutBuffer(&out, "\n", 1);
+    }
+
+    bool        result = false;
+    File_Handle handle = OsFileOpen(db->Path, File_Mode_Write);
+    if (handle.PlatformFileHandle)
+    {
+        result = OutWriteFile(&out, handle);
+        OsFileClose(handle);
+    }
+
+    if (result)
+        db->Changed = false;
+    else
+        LogWarn("Could not write build database %s\n", db->Path.Data);
+
+    EndTemporaryMemory(&temp);
+
+    return result;
+}
@@ -0,0 +1,1916 @@
+#pragma once
+
+#include "build_db.h"
+#include "config.h"
+#include "lenstring.h"
+#include "logger.h"
+#include "object_cache.h"
+#include "os.h"
+#include "plugin_host.h"
+#include "remote.h"
+#include "stream.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+//
+// Build graph
+// Compiler backends lower a Compiler_Config into nodes, every node is a single process invocation
+// described by its argv along with the files it reads and writes. The executor only works with nodes
+// and never looks at the Compiler_Config.
+//
+
+typedef enum Build_Node_Kind
+{
+    Build_Node_Compile,
+    Build_Node_Archive,
+    Build_Node_Link,
+    Build_Node_Resource,
+    Build_Node_Custom,
+} Build_Node_Kind;
+
+static const String BuildNodeKindId[] = {StringExpand("Compile"), StringExpand("Archive"), StringExpand("Link"),
+                                         StringExpand("Resource"), StringExpand("Custom")};
+static const String BuildNodeKindVerb[] = {StringExpand("compiling"), StringExpand("archiving"),
+                                           StringExpand("linking"), StringExpand("compiling resources"),
+                                           StringExpand("running")};
+
+typedef enum Build_Node_State
+{
+    Build_Node_State_Pending,
+    Build_Node_State_Succeeded,
+    Build_Node_State_Failed,
+    Build_Node_State_Skipped,
+} Build_Node_State;
+
+struct Build_Node;
+
+typedef struct Build_Node_Ref
+{
+    struct Build_Node     *Node;
+    struct Build_Node_Ref *Next;
+} Build_Node_Ref;
+
+typedef struct Build_Node
+{
+    Build_Node_Kind    Kind;
+    Uint32             Id;
+    Build_Node_State   State;
+
+    String_List        Argv;
+    String_List        Inputs;
+    String_List        Outputs;
+    Build_Node_Ref    *Deps;
+    Build_Node_Ref    *Dependents;
+    String             DepFile; // Make style dependency file written by the compiler, empty if not available
+
+    bool               HeadersScanned; // Every header included by the source was found by the include scanner
+    Uint64             HeaderTime;     // Modification time of the newest header found by the include scanner
+    String             Header;
+
+    bool               Dirty;
+    String             Reason;  // Why the node is dirty
+
+    Uint32             PendingDeps; // Dependencies not yet completed while executing
+
+    struct Build_Node *Next;
+} Build_Node;
+
+typedef struct Build_Graph
+{
+    Build_Node    *First;
+    Build_Node    *Last;
+    Uint32         NodeCount;
+
+    Compiler_Kind  Compiler;
+    Uint64         EnvironmentHash;
+    String         Name;
+    String         BuildDirectory;
+
+    Memory_Arena  *Arena;
+} Build_Graph;
+
+INLINE_PROCEDURE void BuildGraphInit(Build_Graph *graph, String name, String build_dir, Compiler_Kind compiler,
+                                     Memory_Arena *arena)
+{
+    graph->First           = NULL;
+    graph->Last            = NULL;
+    graph->NodeCount       = 0;
+    graph->Compiler        = compiler;
+    graph->EnvironmentHash = 0;
+    graph->Name            = name;
+    graph->BuildDirectory  = build_dir;
+    graph->Arena           = arena;
+}
+
+INLINE_PROCEDURE Build_Node *BuildGraphAddNode(Build_Graph *graph, Build_Node_Kind kind)
+{
+    Build_Node *node     = PushType(graph->Arena, Build_Node);
+    node->Kind           = kind;
+    node->Id             = graph->NodeCount++;
+    node->State          = Build_Node_State_Pending;
+    node->Deps           = NULL;
+    node->Dependents     = NULL;
+    node->DepFile        = StringLiteral("");
+    node->HeadersScanned = false;
+    node->HeaderTime     = 0;
+    node->Header         = StringLiteral("");
+    node->Dirty          = true;
+    node->Reason         = StringLiteral("");
+    node->PendingDeps    = 0;
+    node->Next           = NULL;
+    StringListInit(&node->Argv);
+    StringListInit(&node->Inputs);
+    StringListInit(&node->Outputs);
+
+    if (graph->Last)
+        graph->Last->Next = node;
+    else
+        graph->First = node;
+    graph->Last = node;
+
+    return node;
+}
+
+INLINE_PROCEDURE void BuildNodeAddDependency(Build_Graph *graph, Build_Node *node, Build_Node *dependency)
+{
+    Build_Node_Ref *ref    = PushType(graph->Arena, Build_Node_Ref);
+    ref->Node              = dependency;
+    ref->Next              = node->Deps;
+    node->Deps             = ref;
+
+    Build_Node_Ref *rev    = PushType(graph->Arena, Build_Node_Ref);
+    rev->Node              = node;
+    rev->Next              = dependency->Dependents;
+    dependency->Dependents = rev;
+}
+
+INLINE_PROCEDURE void BuildNodeArg(Build_Graph *graph, Build_Node *node, String arg)
+{
+    StringListAdd(&node->Argv, arg, graph->Arena);
+}
+
+INLINE_PROCEDURE void BuildNodeArgFmt(Build_Graph *graph, Build_Node *node, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    StringListAdd(&node->Argv, FmtStrV(graph->Arena, fmt, args), graph->Arena);
+    va_end(args);
+}
+
+INLINE_PROCEDURE void BuildNodeArgPrefixed(Build_Graph *graph, Build_Node *node, const char *prefix, String value)
+{
+    StringListAdd(&node->Argv, StrConcatArena(StringMake(prefix, strlen(prefix)), value, graph->Arena), graph->Arena);
+}
+
+// Adds every value of the list as an argument, prefixed with "prefix" if present (eg: "-I")
+INLINE_PROCEDURE void BuildNodeArgList(Build_Graph *graph, Build_Node *node, String_Array_List *list, const char *prefix)
+{
+    ForList(String_Array_List_Node, list)
+    {
+        ForListNode(list, MAX_STRING_NODE_DATA_COUNT)
+        {
+            Int64 str_count = it->Data[index].Count;
+            for (Int64 str_index = 0; str_index < str_count; ++str_index)
+            {
+                String value = it->Data[index].Values[str_index];
+                if (prefix)
+                    BuildNodeArgPrefixed(graph, node, prefix, value);
+                else
+                    BuildNodeArg(graph, node, value);
+            }
+        }
+    }
+}
+
+// Arguments are shared, not copied
+INLINE_PROCEDURE void BuildNodeArgStrings(Build_Graph *graph, Build_Node *node, String_List *args)
+{
+    ForList(String_List_Node, args)
+    {
+        ForListNode(args, MAX_STRING_NODE_DATA_COUNT)
+        {
+            StringListAdd(&node->Argv, it->Data[index], graph->Arena);
+        }
+    }
+}
+
+INLINE_PROCEDURE void BuildNodeInput(Build_Graph *graph, Build_Node *node, String path)
+{
+    StringListAdd(&node->Inputs, path, graph->Arena);
+}
+
+INLINE_PROCEDURE void BuildNodeOutput(Build_Graph *graph, Build_Node *node, String path)
+{
+    StringListAdd(&node->Outputs, path, graph->Arena);
+}
+
+INLINE_PROCEDURE String BuildNodeFirstInput(Build_Node *node)
+{
+    return node->Inputs.Used ? node->Inputs.Head.Data[0] : StringLiteral("");
+}
+
+INLINE_PROCEDURE String BuildNodeFirstOutput(Build_Node *node)
+{
+    return node->Outputs.Used ? node->Outputs.Head.Data[0] : StringLiteral("");
+}
+
+//
+// Command line rendering
+//
+
+INLINE_PROCEDURE bool ArgumentNeedsQuotes(String arg)
+{
+    if (arg.Length == 0)
+        return true;
+    for (Int64 index = 0; index < arg.Length; ++index)
+    {
+        if (isspace(arg.Data[index]) || arg.Data[index] == '"')
+            return true;
+    }
+    return false;
+}
+
+// Arguments without white spaces or quotes are written as is, so flags from muda files keep working the way they are
+// written (eg: environment variables in Linux)
+INLINE_PROCEDURE void OutCommandLineArgument(Out_Stream *out, String arg)
+{
+    if (!ArgumentNeedsQuotes(arg))
+    {
+        OutString(out, arg);
+        return;
+    }
+
+    OutChar(out, '"');
+#if PLATFORM_OS_WINDOWS == 1
+    // CommandLineToArgvW rules: backslashes are only special when followed by a quote
+    Int64 backslashes = 0;
+    for (Int64 index = 0; index < arg.Length; ++index)
+    {
+        Uint8 ch = arg.Data[index];
+        if (ch == '\\')
+        {
+            backslashes += 1;
+            continue;
+        }
+        Int64 count = (ch == '"') ? backslashes * 2 + 1 : backslashes;
+        for (Int64 i = 0; i < count; ++i)
+            OutChar(out, '\\');
+        backslashes = 0;
+        OutChar(out, ch);
+    }
+    for (Int64 i = 0; i < backslashes * 2; ++i)
+        OutChar(out, '\\');
+#else
+    // Inside double quotes the shell only treats $ ` " \ specially, runs without them are copied at once
+    Int64 begin = 0;
+    for (Int64 index = 0; index < arg.Length; ++index)
+    {
+        Uint8 ch = arg.Data[index];
+        if (ch == '"' || ch == '\\' || ch == '$' || ch == '`')
+        {
+            OutBuffer(out, arg.Data + begin, index - begin);
+            OutChar(out, '\\');
+            begin = index;
+        }
+    }
+    OutBuffer(out, arg.Data + begin, arg.Length - begin);
+#endif
+    OutChar(out, '"');
+}
+
+// GCC, CLANG and ar (libiberty) response files: backslash escapes any character, quotes group white spaces
+INLINE_PROCEDURE void OutResponseFileArgument(Out_Stream *out, String arg, Compiler_Kind compiler)
+{
+    if (compiler == Compiler_Bit_CL)
+    {
+        OutCommandLineArgument(out, arg);
+        return;
+    }
+
+    bool  quote = ArgumentNeedsQuotes(arg);
+    Int64 begin = 0;
+    if (quote)
+        OutChar(out, '"');
+    for (Int64 index = 0; index < arg.Length; ++index)
+    {
+        Uint8 ch = arg.Data[index];
+        if (ch == '"' || ch == '\\')
+        {
+            OutBuffer(out, arg.Data + begin, index - begin);
+            OutChar(out, '\\');
+            begin = index;
+        }
+    }
+    OutBuffer(out, arg.Data + begin, arg.Length - begin);
+    if (quote)
+        OutChar(out, '"');
+}
+
+INLINE_PROCEDURE String BuildNodeCommandLine(Build_Node *node, Memory_Arena *arena)
+{
+    Out_Stream out;
+    OutCreate(&out, MemoryArenaAllocator(arena));
+
+    bool first = true;
+    ForList(String_List_Node, &node->Argv)
+    {
+        ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+        {
+            if (!first)
+                OutChar(&out, ' ');
+            OutCommandLineArgument(&out, it->Data[index]);
+            first = false;
+        }
+    }
+
+    return OutBuildStringSerial(&out, arena);
+}
+
+// Command lines longer than this are passed to the compiler through a response file
+// Windows: cmd.exe limits a command line to 8191 characters
+// Linux: system() passes the whole command as a single argument to /bin/sh, limited by MAX_ARG_STRLEN (128 KB)
+#if PLATFORM_OS_WINDOWS == 1
+#define MUDA_RESPONSE_FILE_THRESHOLD 8000
+#else
+#define MUDA_RESPONSE_FILE_THRESHOLD KiloBytes(96)
+#endif
+
+// Moves the arguments of a long command line into "<build_dir>/<hash>.rsp" and returns "program @<file>"
+// The file is named after its content, so nodes using identical arguments share the same response file
+static String BuildNodeResponseFileCommandLine(Build_Graph *graph, Build_Node *node, String cmd_line,
+                                               Memory_Arena *arena)
+{
+    if (cmd_line.Length < MUDA_RESPONSE_FILE_THRESHOLD || node->Kind == Build_Node_Resource ||
+        node->Kind == Build_Node_Custom)
+        return cmd_line;
+
+    Out_Stream out;
+    OutCreate(&out, MemoryArenaAllocator(arena));
+
+    String program = node->Argv.Head.Data[0];
+    bool   first   = true;
+    ForList(String_List_Node, &node->Argv)
+    {
+        ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+        {
+            if (first)
+            {
+                first = false;
+                continue;
+            }
+            OutResponseFileArgument(&out, it->Data[index], graph->Compiler);
+            OutChar(&out, '\n');
+        }
+    }
+
+    // The arguments are hashed and written straight from the stream buckets
+    Uint64 args_hash = OutHash(&out);
+
+    String build_dir = graph->BuildDirectory;
+    String rsp_path;
+    if (build_dir.Data[build_dir.Length - 1] == '/')
+        rsp_path = FmtStr(arena, "%s%016llx.rsp", build_dir.Data, (unsigned long long)args_hash);
+    else
+        rsp_path = FmtStr(arena, "%s/%016llx.rsp", build_dir.Data, (unsigned long long)args_hash);
+
+    bool write_rsp = true;
+    if (OsCheckIfPathExists(rsp_path) == Path_Exist_File)
+    {
+        File_Handle handle = OsFileOpen(rsp_path, File_Mode_Read);
+        if (handle.PlatformFileHandle)
+        {
+            write_rsp = (OsFileGetSize(handle) != (Ptrsize)OutGetSize(&out));
+            OsFileClose(handle);
+        }
+    }
+
+    if (write_rsp)
+    {
+        File_Handle handle = OsFileOpen(rsp_path, File_Mode_Write);
+        if (!handle.PlatformFileHandle)
+        {
+            LogWarn("Could not create response file %s. Using the command line directly.\n", rsp_path.Data);
+            return cmd_line;
+        }
+        bool written = OutWriteFile(&out, handle);
+        OsFileClose(handle);
+        if (!written)
+        {
+            LogWarn("Could not write response file %s. Using the command line directly.\n", rsp_path.Data);
+            return cmd_line;
+        }
+    }
+
+    Out_Stream cmd;
+    OutCreate(&cmd, MemoryArenaAllocator(arena));
+    OutCommandLineArgument(&cmd, program);
+    OutBuffer(&cmd, " @", 2);
+    OutCommandLineArgument(&cmd, rsp_path);
+    return OutBuildStringSerial(&cmd, arena);
+}
+
+//
+// Dirty checking
+//
+
+// Arguments are hashed without "./" path components, and with '\' folded to '/' on Windows
+INLINE_PROCEDURE Uint64 HashNormalizedArgument(Uint64 hash, String arg)
+{
+    for (Int64 index = 0; index < arg.Length; ++index)
+    {
+        Uint8 ch = arg.Data[index];
+#if PLATFORM_OS_WINDOWS == 1
+        if (ch == '\\')
+            ch = '/';
+#endif
+        bool component = (index == 0 || arg.Data[index - 1] == '/' || arg.Data[index - 1] == '\\');
+        if (component && ch == '.' && index + 1 < arg.Length &&
+            (arg.Data[index + 1] == '/' || (PLATFORM_OS_WINDOWS && arg.Data[index + 1] == '\\')))
+        {
+            index += 1;
+            continue;
+        }
+        hash = HashBytes(hash, &ch, 1);
+    }
+    return HashBytes(hash, "", 1);
+}
+
+// Environment variables that change the output of the compilers without appearing in the command line
+static const char *const GccClangEnvironmentVariables[] = {
+    "CPATH",         "C_INCLUDE_PATH", "CPLUS_INCLUDE_PATH", "LIBRARY_PATH",
+    "COMPILER_PATH", "GCC_EXEC_PREFIX", "SOURCE_DATE_EPOCH",
+};
+static const char *const ClEnvironmentVariables[] = {"INCLUDE", "LIB", "LIBPATH", "CL", "_CL_", "LINK", "_LINK_"};
+
+static Uint64 CompilerEnvironmentHash(Compiler_Kind compiler)
+{
+    const char *const *names = GccClangEnvironmentVariables;
+    Uint32              count = ArrayCount(GccClangEnvironmentVariables);
+    if (compiler == Compiler_Bit_CL)
+    {
+        names = ClEnvironmentVariables;
+        count = ArrayCount(ClEnvironmentVariables);
+    }
+
+    Uint64 hash = HASH_SEED;
+    for (Uint32 index = 0; index < count; ++index)
+    {
+        const char *value = getenv(names[index]);
+        hash              = HashBytes(hash, names[index], strlen(names[index]) + 1);
+        if (value)
+            hash = HashBytes(hash, value, strlen(value));
+        hash = HashBytes(hash, "", 1);
+    }
+    return hash;
+}
+
+typedef struct Tool_Identity
+{
+    Uint64 NameHash;
+    Uint64 Identity;
+    Uint64 Content; // Hash of the executable, 0 until it is needed by the object cache
+} Tool_Identity;
+
+// Tools are only looked up once per process, there are just a handful of them (compiler, linker, archiver)
+// Only used by the thread executing the graph
+static Tool_Identity ToolIdentityCache[32];
+static Uint32        ToolIdentityCacheCount;
+
+static Tool_Identity ToolIdentityLookup(String program, bool content)
+{
+    Uint64         name_hash = StrHash(program);
+    Tool_Identity *found     = NULL;
+    for (Uint32 index = 0; index < ToolIdentityCacheCount; ++index)
+    {
+        if (ToolIdentityCache[index].NameHash == name_hash)
+            found = &ToolIdentityCache[index];
+    }
+
+    if (found && (!content || found->Content))
+        return *found;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Tool_Identity    tool;
+    tool.NameHash = name_hash;
+    tool.Identity = name_hash;
+    tool.Content  = 0;
+
+    String path   = OsFindExecutable(program, scratch);
+    if (path.Length)
+    {
+        Uint64 time   = OsGetFileLastWriteTime(path);
+        tool.Identity = HashBytes(StrHash(path), &time, sizeof(time));
+    }
+
+    if (content)
+    {
+        tool.Content = HASH_SEED;
+        if (!path.Length || !ObjectCacheHashFile(&tool.Content, path))
+            tool.Content = name_hash;
+    }
+
+    EndTemporaryMemory(&temp);
+
+    if (found)
+    {
+        *found = tool;
+    }
+    else if (ToolIdentityCacheCount < ArrayCount(ToolIdentityCache))
+    {
+        ToolIdentityCache[ToolIdentityCacheCount] = tool;
+        ToolIdentityCacheCount += 1;
+    }
+
+    return tool;
+}
+
+// Identifies the installed tool by its resolved path and modification time, so updating the compiler changes it
+static Uint64 ToolIdentityHash(String program)
+{
+    return ToolIdentityLookup(program, false).Identity;
+}
+
+// Identifies the tool by the content of its executable, the same wherever and whenever it was installed
+static Uint64 ToolContentHash(String program)
+{
+    return ToolIdentityLookup(program, true).Content;
+}
+
+static Build_Fingerprint BuildNodeFingerprint(Build_Graph *graph, Build_Node *node)
+{
+    Build_Fingerprint fingerprint;
+    fingerprint.Command = HASH_SEED;
+    ForList(String_List_Node, &node->Argv)
+    {
+        ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+        {
+            fingerprint.Command = HashNormalizedArgument(fingerprint.Command, it->Data[index]);
+        }
+    }
+    fingerprint.Tool        = ToolIdentityHash(node->Argv.Head.Data[0]);
+    fingerprint.Environment = graph->EnvironmentHash;
+    return fingerprint;
+}
+
+typedef void (*Dep_File_Procedure)(void *context, String prerequisite);
+
+// Passes every prerequisite of a make style dependency file ("out.o: a.c a.h \") to "procedure", in order
+// Only the first rule is read, the rules that follow (-MP, C++ modules of GCC) do not list prerequisites
+// Returns false if the file could not be read
+static bool DepFileReadPrerequisites(String depfile, Dep_File_Procedure procedure, void *context, Memory_Arena *arena)
+{
+    File_Handle handle = OsFileOpen(depfile, File_Mode_Read);
+    if (!handle.PlatformFileHandle)
+        return false;
+
+    Ptrsize size = OsFileGetSize(handle);
+    Uint8  *data = PushSize(arena, size + 1);
+    bool    read = (size == 0) || OsFileRead(handle, data, size);
+    OsFileClose(handle);
+    if (!read)
+        return false;
+
+    // Skip the target, colons of paths like "C:\dir" are not followed by a white space
+    Ptrsize pos = 0;
+    while (pos < size && !(data[pos] == ':' && (pos + 1 == size || isspace(data[pos + 1]))))
+        pos += 1;
+    pos += 1;
+
+    Uint8 *path = PushSize(arena, size + 1);
+    bool   last = false;
+    while (pos < size && !last)
+    {
+        Int64 length = 0;
+        for (; pos < size; ++pos)
+        {
+            Uint8 ch   = data[pos];
+            Uint8 next = (pos + 1 < size) ? data[pos + 1] : 0;
+            if (ch == '\\' && (next == ' ' || next == '#'))
+            {
+                path[length++] = next;
+                pos += 1;
+            }
+            else if (ch == '$' && next == '$')
+            {
+                path[length++] = '$';
+                pos += 1;
+            }
+            else if ((ch == '\\' && (next == '\n' || next == '\r')) || isspace(ch))
+            {
+                // A new line ends the rule unless it is escaped, "\\\r\n" is read as '\\', '\r' then '\n'
+                Ptrsize escape = (pos && data[pos - 1] == '\r') ? pos - 1 : pos;
+                last           = (ch == '\n' && !(escape && data[escape - 1] == '\\'));
+                break;
+            }
+            else
+            {
+                path[length++] = ch;
+            }
+        }
+        pos += 1;
+
+        if (length == 0)
+            continue;
+
+        path[length] = 0;
+        procedure(context, StringMake(path, length));
+    }
+
+    return true;
+}
+
+typedef struct Dep_File_Newest
+{
+    Uint64        Time;
+    String        Path;
+    Memory_Arena *Arena;
+} Dep_File_Newest;
+
+static void DepFileNewestProcedure(void *context, String prerequisite)
+{
+    Dep_File_Newest *newest = (Dep_File_Newest *)context;
+    Uint64           time   = OsGetFileLastWriteTime(prerequisite);
+    if (time == 0)
+        time = UINT64_MAX;
+    if (time > newest->Time)
+    {
+        newest->Time = time;
+        newest->Path = StrDuplicateArena(prerequisite, newest->Arena);
+    }
+}
+
+// Finds the most recently modified prerequisite of a dependency file, missing prerequisites are reported as the newest
+// Returns false if the file could not be read
+static bool DepFileNewestPrerequisite(String depfile, Uint64 *newest_time, String *newest_path, Memory_Arena *arena)
+{
+    Dep_File_Newest newest;
+    newest.Time  = *newest_time;
+    newest.Path  = *newest_path;
+    newest.Arena = arena;
+    if (!DepFileReadPrerequisites(depfile, DepFileNewestProcedure, &newest, arena))
+        return false;
+    *newest_time = newest.Time;
+    *newest_path = newest.Path;
+    return true;
+}
+
+// Returns why the node has to be executed, or an empty string if its outputs are up to date
+static String BuildNodeCheckDirty(Build_Graph *graph, Build_Node *node, Build_Db *db, bool force_rebuild)
+{
+    Memory_Arena *arena = graph->Arena;
+
+    if (force_rebuild)
+        return StringLiteral("rebuild requested with -rebuild");
+
+    Uint64 oldest_output = UINT64_MAX;
+    ForList(String_List_Node, &node->Outputs)
+    {
+        ForListNode(&node->Outputs, MAX_STRING_NODE_DATA_COUNT)
+        {
+            Uint64 time = OsGetFileLastWriteTime(it->Data[index]);
+            if (time == 0)
+                return FmtStr(arena, "output %s is missing", it->Data[index].Data);
+            oldest_output = Minimum(oldest_output, time);
+        }
+    }
+
+    String           output = BuildNodeFirstOutput(node);
+    Build_Db_Record *record = BuildDbFind(db, output);
+    if (!record)
+        return FmtStr(arena, "no record of a previous build of %s", output.Data);
+    if (record->Compiler != graph->Compiler)
+        return FmtStr(arena, "compiler changed from %s to %s", GetCompilerName(record->Compiler),
+                      GetCompilerName(graph->Compiler));
+
+    Build_Fingerprint fingerprint = BuildNodeFingerprint(graph, node);
+    if (record->Fingerprint.Command != fingerprint.Command)
+        return StringLiteral("command line changed");
+    if (record->Fingerprint.Tool != fingerprint.Tool)
+        return FmtStr(arena, "%s changed since the last build", node->Argv.Head.Data[0].Data);
+    if (record->Fingerprint.Environment != fingerprint.Environment)
+        return StringLiteral("environment variables read by the compiler changed");
+
+    for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+    {
+        if (dep->Node->Dirty)
+            return FmtStr(arena, "%s will be rebuilt", BuildNodeFirstOutput(dep->Node).Data);
+    }
+
+    ForList(String_List_Node, &node->Inputs)
+    {
+        ForListNode(&node->Inputs, MAX_STRING_NODE_DATA_COUNT)
+        {
+            Uint64 time = OsGetFileLastWriteTime(it->Data[index]);
+            if (time == 0)
+                return FmtStr(arena, "input %s is missing", it->Data[index].Data);
+            if (time > oldest_output)
+                return FmtStr(arena, "%s is newer than %s", it->Data[index].Data, output.Data);
+        }
+    }
+
+    // The headers listed by the compiler are used when there are any, the ones found by the include scanner otherwise
+    if (node->Kind == Build_Node_Compile)
+    {
+        Memory_Arena    *scratch = ThreadScratchpad();
+        Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+        String           reason  = StringLiteral("");
+        Uint64           newest  = 0;
+        String           header  = StringLiteral("");
+        bool             listed  = node->DepFile.Length != 0;
+        listed = listed && DepFileNewestPrerequisite(node->DepFile, &newest, &header, scratch);
+        if (!listed && node->HeadersScanned)
+        {
+            newest = node->HeaderTime;
+            header = node->Header;
+        }
+
+        if (!listed && !node->HeadersScanned)
+        {
+            if (node->DepFile.Length)
+                reason = FmtStr(arena, "dependency file %s is missing", node->DepFile.Data);
+            else
+                reason = StringLiteral("header dependencies are not tracked for this compiler");
+        }
+        else if (newest > oldest_output)
+        {
+            reason = FmtStr(arena, "%s is newer than %s", header.Data, output.Data);
+        }
+
+        EndTemporaryMemory(&temp);
+        return reason;
+    }
+
+    return StringLiteral("");
+}
+
+// Marks the nodes that have to be executed, nodes that depend on a dirty node are dirty as well
+static Uint32 BuildGraphEvaluate(Build_Graph *graph, Build_Db *db, bool force_rebuild)
+{
+    graph->EnvironmentHash = CompilerEnvironmentHash(graph->Compiler);
+
+    Uint32 dirty_count     = 0;
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        node->Reason = BuildNodeCheckDirty(graph, node, db, force_rebuild);
+        node->Dirty  = (node->Reason.Length != 0);
+        dirty_count += node->Dirty;
+    }
+    return dirty_count;
+}
+
+// Prints the actions in execution order, grouped into lanes of actions that don't depend on each other
+static void BuildGraphPrint(Build_Graph *graph, bool explain)
+{
+    Memory_Arena    *scratch     = ThreadScratchpad();
+    Temporary_Memory temp        = BeginTemporaryMemory(scratch);
+
+    LogFlush();
+
+    Uint32          *lanes       = PushArray(scratch, Uint32, graph->NodeCount + 1);
+    Uint32           lane_count  = 0;
+    Uint32           dirty_count = 0;
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        Uint32 lane = 0;
+        for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+            lane = Maximum(lane, lanes[dep->Node->Id] + 1);
+        lanes[node->Id] = lane;
+        lane_count      = Maximum(lane_count, lane + 1);
+        dirty_count += node->Dirty;
+    }
+
+    OsConsoleWrite("Target %s (%s): %u actions, %u dirty, %u lanes\n", graph->Name.Data,
+                   GetCompilerName(graph->Compiler), graph->NodeCount, dirty_count, lane_count);
+
+    for (Uint32 lane = 0; lane < lane_count; ++lane)
+    {
+        OsConsoleWrite("  Lane %u\n", lane);
+        for (Build_Node *node = graph->First; node; node = node->Next)
+        {
+            if (lanes[node->Id] != lane)
+                continue;
+
+            OsConsoleWrite("    [%s] %-8s %s\n", node->Dirty ? "dirty" : "clean", BuildNodeKindId[node->Kind].Data,
+                           BuildNodeFirstOutput(node).Data);
+            if (explain && node->Dirty)
+                OsConsoleWrite("        because %s\n", node->Reason.Data);
+            OsConsoleWrite("        %s\n", BuildNodeCommandLine(node, scratch).Data);
+        }
+    }
+    OsConsoleWrite("\n");
+
+    EndTemporaryMemory(&temp);
+}
+
+//
+// Executor
+//
+
+// "index" is the position of the action among the "count" actions of the build
+INLINE_PROCEDURE void BuildNodeLogBegin(Build_Node *node, Uint32 index, Uint32 count)
+{
+    switch (node->Kind)
+    {
+    case Build_Node_Compile:
+        LogInfo("[%u/%u] Compiling %s\n", index, count, BuildNodeFirstInput(node).Data);
+        break;
+    case Build_Node_Archive:
+        LogInfo("[%u/%u] Creating static library %s\n", index, count, BuildNodeFirstOutput(node).Data);
+        break;
+    case Build_Node_Link:
+        LogInfo("[%u/%u] Linking %s\n", index, count, BuildNodeFirstOutput(node).Data);
+        break;
+    case Build_Node_Resource:
+        LogInfo("[%u/%u] Executing Resource compilation\n", index, count);
+        break;
+    case Build_Node_Custom:
+        LogInfo("[%u/%u] Executing %s\n", index, count, node->Argv.Head.Data[0].Data);
+        break;
+    }
+}
+
+//
+// Progress
+// Durations of the actions are recorded in the build database, the remaining time of the build is the sum of the
+// recorded durations of the actions left, minus the time the running actions have already taken, spread over the
+// jobs. Actions that were never recorded take the average duration of the recorded actions of the same kind.
+//
+
+#define BUILD_DEFAULT_ESTIMATE 1000000 // Microseconds, used when no action of the kind was ever recorded
+#define BUILD_STATUS_INTERVAL 100000   // Microseconds between two draws of the status line
+
+typedef struct Build_Progress
+{
+    Uint32      Total;    // Dirty nodes
+    Uint32      Started;
+    Uint32      Finished;
+    Uint32      Running;
+    Uint32      Jobs;
+    Uint64      Remaining;       // Estimated microseconds of the actions that are not finished
+    Uint64      RunningStartSum; // Sum of the start times of the running actions
+    Uint64     *Estimates;       // Indexed by node id
+    Uint64     *StartTimes;      // Indexed by node id
+    Build_Node *Last;            // Last started action
+    Uint64      StatusTime;      // When the status line was last drawn
+} Build_Progress;
+
+static void BuildProgressInit(Build_Progress *progress, Build_Graph *graph, Build_Db *db, Uint32 jobs,
+                              Memory_Arena *arena)
+{
+    memset(progress, 0, sizeof(*progress));
+    progress->Jobs       = jobs;
+    progress->Estimates  = PushArrayZero(arena, Uint64, graph->NodeCount);
+    progress->StartTimes = PushArrayZero(arena, Uint64, graph->NodeCount);
+
+    Uint64 kind_total[ArrayCount(BuildNodeKindId)] = {0};
+    Uint32 kind_count[ArrayCount(BuildNodeKindId)] = {0};
+
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        Build_Db_Record *record = BuildDbFind(db, BuildNodeFirstOutput(node));
+        if (record && record->Duration)
+        {
+            progress->Estimates[node->Id] = record->Duration;
+            kind_total[node->Kind] += record->Duration;
+            kind_count[node->Kind] += 1;
+        }
+    }
+
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        if (!node->Dirty)
+            continue;
+        if (!progress->Estimates[node->Id])
+        {
+            progress->Estimates[node->Id] =
+                kind_count[node->Kind] ? kind_total[node->Kind] / kind_count[node->Kind] : BUILD_DEFAULT_ESTIMATE;
+        }
+        progress->Remaining += progress->Estimates[node->Id];
+        progress->Total += 1;
+    }
+}
+
+INLINE_PROCEDURE void BuildProgressStart(Build_Progress *progress, Build_Node *node, Uint64 now)
+{
+    progress->Started += 1;
+    progress->Running += 1;
+    progress->RunningStartSum += now;
+    progress->StartTimes[node->Id] = now;
+    progress->Last                 = node;
+}
+
+INLINE_PROCEDURE void BuildProgressFinish(Build_Progress *progress, Build_Node *node)
+{
+    progress->Finished += 1;
+    progress->Running -= 1;
+    progress->RunningStartSum -= progress->StartTimes[node->Id];
+    progress->Remaining -= Minimum(progress->Remaining, progress->Estimates[node->Id]);
+}
+
+// Nodes that are skipped because a dependency failed are never executed
+INLINE_PROCEDURE void BuildProgressSkip(Build_Progress *progress, Build_Node *node)
+{
+    if (!node->Dirty)
+        return;
+    progress->Total -= 1;
+    progress->Remaining -= Minimum(progress->Remaining, progress->Estimates[node->Id]);
+}
+
+INLINE_PROCEDURE Uint64 BuildProgressEta(Build_Progress *progress, Uint64 now)
+{
+    Uint64 elapsed   = (Uint64)progress->Running * now - progress->RunningStartSum;
+    Uint64 remaining = progress->Remaining - Minimum(progress->Remaining, elapsed);
+    Uint32 left      = progress->Total - progress->Finished;
+    Uint32 parallel  = Maximum(Minimum(progress->Jobs, left), 1);
+    return remaining / parallel;
+}
+
+// [12/90] compiling foo.c, 8 running, ETA 42s
+static void BuildProgressStatus(Build_Progress *progress)
+{
+    if (!LogStatusEnabled() || !progress->Last)
+        return;
+
+    Uint64 now = OsGetMonotonicTime();
+    if (now - progress->StatusTime < BUILD_STATUS_INTERVAL)
+        return;
+    progress->StatusTime = now;
+
+    Build_Node *node = progress->Last;
+    String      name = (node->Kind == Build_Node_Compile) ? BuildNodeFirstInput(node) : BuildNodeFirstOutput(node);
+    Int64       slash = Maximum(StrReverseFindCharacter(name, '/', name.Length - 1),
+                                StrReverseFindCharacter(name, '\\', name.Length - 1));
+    name              = StrRemovePrefix(name, slash + 1);
+
+    Uint64 eta        = BuildProgressEta(progress, now) / 1000000;
+    if (eta >= 60)
+    {
+        LogStatus("[%u/%u] %s %.*s, %u running, ETA %llum%02llus", progress->Finished, progress->Total,
+                  BuildNodeKindVerb[node->Kind].Data, (int)name.Length, name.Data, progress->Running,
+                  (unsigned long long)(eta / 60), (unsigned long long)(eta % 60));
+    }
+    else
+    {
+        LogStatus("[%u/%u] %s %.*s, %u running, ETA %llus", progress->Finished, progress->Total,
+                  BuildNodeKindVerb[node->Kind].Data, (int)name.Length, name.Data, progress->Running,
+                  (unsigned long long)eta);
+    }
+}
+
+//
+// Scheduling
+// Ready nodes are started longest critical path first: the recorded durations of the node and of the longest chain
+// of its dependents, so that the chains that bound the build start as early as possible.
+// With a memory budget, a node is started only while the recorded peak memory of the running actions and its own
+// fit in the budget. Nodes are held back while the load average is above the limit or while tasks stall on memory.
+// A node is always started when nothing is running, so that the build goes on with a budget that is too small.
+// With a jobserver, every node started while another one is running takes a token from it.
+//
+
+#define BUILD_DEFAULT_MEMORY_ESTIMATE MegaBytes(256ull) // Used when no action of the kind was ever recorded
+#define BUILD_MEMORY_PRESSURE_LIMIT 10.0f               // Percentage of time tasks stalled on memory
+#define BUILD_LOAD_SAMPLE_INTERVAL 1000000              // Microseconds between two reads of the system load
+#define BUILD_LOAD_RETRY_INTERVAL 1000                  // Milliseconds before a node held back by the load is retried
+#define BUILD_JOBSERVER_RETRY_INTERVAL 10               // Milliseconds before a node waiting for a token is retried
+
+typedef struct Build_Scheduler
+{
+    Build_Node **Ready; // Binary heap ordered by critical path
+    Uint32       ReadyCount;
+    Uint64      *CriticalPath; // Indexed by node id
+    Uint64      *Memory;       // Indexed by node id
+    Uint64       MemoryBudget;
+    Uint64       MemoryRunning;
+    Real32       MaxLoad;
+    Uint64       LoadSampleTime;
+    bool         Overloaded; // Set by the last sample of the system load
+    Os_Jobserver Jobserver;
+    Uint32       Tokens;     // Taken from the jobserver, one for every running action but the first one
+    Uint32       RetryAfter; // Milliseconds, set when a node is held back until the load goes down or a token is free
+} Build_Scheduler;
+
+static void BuildSchedulerInit(Build_Scheduler *scheduler, Build_Graph *graph, Build_Db *db,
+                               Build_Progress *progress, Build_Config *build_config, Memory_Arena *arena)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->Ready        = PushArray(arena, Build_Node *, graph->NodeCount);
+    scheduler->CriticalPath = PushArrayZero(arena, Uint64, graph->NodeCount);
+    scheduler->Memory       = PushArrayZero(arena, Uint64, graph->NodeCount);
+    scheduler->MemoryBudget = build_config->MemoryBudget;
+    scheduler->MaxLoad      = build_config->MaxLoad;
+    scheduler->Jobserver    = build_config->Jobserver;
+
+    if (scheduler->MemoryBudget)
+    {
+        Uint64 kind_total[ArrayCount(BuildNodeKindId)] = {0};
+        Uint32 kind_count[ArrayCount(BuildNodeKindId)] = {0};
+
+        for (Build_Node *node = graph->First; node; node = node->Next)
+        {
+            Build_Db_Record *record = BuildDbFind(db, BuildNodeFirstOutput(node));
+            if (record && record->Memory)
+            {
+                scheduler->Memory[node->Id] = record->Memory;
+                kind_total[node->Kind] += record->Memory;
+                kind_count[node->Kind] += 1;
+            }
+        }
+
+        for (Build_Node *node = graph->First; node; node = node->Next)
+        {
+            if (node->Dirty && !scheduler->Memory[node->Id])
+            {
+                scheduler->Memory[node->Id] = kind_count[node->Kind] ? kind_total[node->Kind] / kind_count[node->Kind]
+                                                                     : BUILD_DEFAULT_MEMORY_ESTIMATE;
+            }
+        }
+    }
+
+    // Critical paths are computed from the last nodes of the build back to the first ones: a node is visited once
+    // all of its dependents are
+    Memory_Arena    *scratch   = ThreadScratchpad();
+    Temporary_Memory temp      = BeginTemporaryMemory(scratch);
+
+    Uint32          *remaining = PushArrayZero(scratch, Uint32, graph->NodeCount);
+    Build_Node     **stack     = PushArray(scratch, Build_Node *, graph->NodeCount);
+    Uint32           top       = 0;
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        for (Build_Node_Ref *dependent = node->Dependents; dependent; dependent = dependent->Next)
+            remaining[node->Id] += 1;
+        if (remaining[node->Id] == 0)
+            stack[top++] = node;
+    }
+
+    while (top)
+    {
+        Build_Node *node    = stack[--top];
+        Uint64      longest = 0;
+        for (Build_Node_Ref *dependent = node->Dependents; dependent; dependent = dependent->Next)
+            longest = Maximum(longest, scheduler->CriticalPath[dependent->Node->Id]);
+        scheduler->CriticalPath[node->Id] = longest + (node->Dirty ? progress->Estimates[node->Id] : 0);
+
+        for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+        {
+            remaining[dep->Node->Id] -= 1;
+            if (remaining[dep->Node->Id] == 0)
+                stack[top++] = dep->Node;
+        }
+    }
+
+    EndTemporaryMemory(&temp);
+}
+
+// Longest critical path first, then the order of the nodes in the graph
+INLINE_PROCEDURE bool BuildSchedulerBefore(Build_Scheduler *scheduler, Build_Node *a, Build_Node *b)
+{
+    Uint64 a_path = scheduler->CriticalPath[a->Id];
+    Uint64 b_path = scheduler->CriticalPath[b->Id];
+    return a_path > b_path || (a_path == b_path && a->Id < b->Id);
+}
+
+INLINE_PROCEDURE void BuildSchedulerPush(Build_Scheduler *scheduler, Build_Node *node)
+{
+    Build_Node **heap  = scheduler->Ready;
+    Uint32       index = scheduler->ReadyCount++;
+    for (; index && BuildSchedulerBefore(scheduler, node, heap[(index - 1) / 2]); index = (index - 1) / 2)
+        heap[index] = heap[(index - 1) / 2];
+    heap[index] = node;
+}
+
+INLINE_PROCEDURE Build_Node *BuildSchedulerPop(Build_Scheduler *scheduler)
+{
+    Build_Node **heap  = scheduler->Ready;
+    Build_Node  *first = heap[0];
+    Build_Node  *last  = heap[--scheduler->ReadyCount];
+    Uint32       count = scheduler->ReadyCount;
+    Uint32       index = 0;
+    for (;;)
+    {
+        Uint32 child = index * 2 + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && BuildSchedulerBefore(scheduler, heap[child + 1], heap[child]))
+            child += 1;
+        if (!BuildSchedulerBefore(scheduler, heap[child], last))
+            break;
+        heap[index] = heap[child];
+        index       = child;
+    }
+    if (count)
+        heap[index] = last;
+    return first;
+}
+
+static bool BuildSchedulerOverloaded(Build_Scheduler *scheduler)
+{
+    Uint64 now = OsGetMonotonicTime();
+    if (scheduler->LoadSampleTime && now - scheduler->LoadSampleTime < BUILD_LOAD_SAMPLE_INTERVAL)
+        return scheduler->Overloaded;
+
+    Os_System_Load load       = OsGetSystemLoad();
+    scheduler->LoadSampleTime = now;
+    scheduler->Overloaded     = (scheduler->MaxLoad > 0 && load.LoadAverage >= scheduler->MaxLoad) ||
+                            load.MemoryPressure >= BUILD_MEMORY_PRESSURE_LIMIT;
+    return scheduler->Overloaded;
+}
+
+// Returns false if the node has to wait for running actions to complete
+static bool BuildSchedulerAdmit(Build_Scheduler *scheduler, Build_Node *node, Uint32 running)
+{
+    scheduler->RetryAfter = 0;
+    if (running == 0)
+        return true;
+    if (scheduler->MemoryBudget && scheduler->MemoryRunning + scheduler->Memory[node->Id] > scheduler->MemoryBudget)
+        return false;
+    if (BuildSchedulerOverloaded(scheduler))
+    {
+        scheduler->RetryAfter = BUILD_LOAD_RETRY_INTERVAL;
+        return false;
+    }
+
+    // The token is taken last, it belongs to the node once taken
+    if (scheduler->Jobserver.PlatformHandle)
+    {
+        if (!OsJobserverAcquire(scheduler->Jobserver))
+        {
+            scheduler->RetryAfter = BUILD_JOBSERVER_RETRY_INTERVAL;
+            return false;
+        }
+        scheduler->Tokens += 1;
+    }
+    return true;
+}
+
+INLINE_PROCEDURE void BuildSchedulerStart(Build_Scheduler *scheduler, Build_Node *node)
+{
+    scheduler->MemoryRunning += scheduler->Memory[node->Id];
+}
+
+// Every running action but the last one holds a token, whichever action completes gives one back
+INLINE_PROCEDURE void BuildSchedulerFinish(Build_Scheduler *scheduler, Build_Node *node)
+{
+    scheduler->MemoryRunning -= scheduler->Memory[node->Id];
+    if (scheduler->Tokens)
+    {
+        OsJobserverRelease(scheduler->Jobserver);
+        scheduler->Tokens -= 1;
+    }
+}
+
+INLINE_PROCEDURE bool BuildNodeDependenciesSucceeded(Build_Node *node)
+{
+    for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+    {
+        if (dep->Node->State != Build_Node_State_Succeeded)
+            return false;
+    }
+    return true;
+}
+
+//
+// Object cache keys
+// Two blobs are cached per compilation, the same way as the manifests of ccache:
+//   manifest key: fingerprint of the action and content of the source -> dependency file
+//   result key: manifest key and content of every prerequisite listed in the dependency file -> object file
+// So the headers included by the source are known before it is compiled again.
+//
+
+// Compilations tracking their header dependencies are cached, the object file must be their only output and the
+// source their only input (importers of C++ modules also read the BMIs, which are not in the dependency file)
+INLINE_PROCEDURE bool BuildNodeCacheable(Build_Node *node)
+{
+    return node->Kind == Build_Node_Compile && node->DepFile.Length && node->Outputs.Used == 1 &&
+           node->Outputs.Head.Next == NULL && node->Inputs.Used == 1 && node->Inputs.Head.Next == NULL;
+}
+
+// Returns 0 if the source could not be read
+// The compiler is identified by its content rather than by its path and time, the keys are the same on the machines
+// sharing the cache
+static Uint64 BuildNodeManifestKey(Build_Node *node, const Build_Fingerprint *fingerprint, Uint64 tool_content,
+                                   Compiler_Kind compiler)
+{
+    Uint64 key = StrHash(StringLiteral("muda object cache 2"));
+    key        = HashBytes(key, &fingerprint->Command, sizeof(fingerprint->Command));
+    key        = HashBytes(key, &fingerprint->Environment, sizeof(fingerprint->Environment));
+    key        = HashBytes(key, &tool_content, sizeof(tool_content));
+    key        = HashBytes(key, &compiler, sizeof(compiler));
+    if (!ObjectCacheHashFile(&key, BuildNodeFirstInput(node)))
+        return 0;
+    return key;
+}
+
+typedef struct Build_Result_Key
+{
+    Uint64 Key;
+    bool   Valid;
+} Build_Result_Key;
+
+static void BuildResultKeyProcedure(void *context, String prerequisite)
+{
+    Build_Result_Key *result = (Build_Result_Key *)context;
+    result->Key              = HashNormalizedArgument(result->Key, prerequisite);
+    result->Valid &= ObjectCacheHashFile(&result->Key, prerequisite);
+}
+
+// Returns 0 if the dependency file or one of the prerequisites could not be read
+static Uint64 BuildNodeResultKey(Build_Node *node, Uint64 manifest_key)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Build_Result_Key result;
+    result.Key   = manifest_key;
+    result.Valid = DepFileReadPrerequisites(node->DepFile, BuildResultKeyProcedure, &result, scratch);
+
+    EndTemporaryMemory(&temp);
+    return result.Valid ? result.Key : 0;
+}
+
+//
+// Distributed compilation
+// The worker thread preprocesses the source, which also writes the dependency file, and sends the preprocessed source
+// to a host of the pool along with the options that are not read by the preprocessor.
+//
+
+// Options only read by the preprocessor, their value is either joined ("-DNAME") or the next argument ("-I dir")
+static const String PreprocessorValueOptions[] = {
+    StringExpand("-D"),       StringExpand("-U"),       StringExpand("-I"),        StringExpand("-include"),
+    StringExpand("-imacros"), StringExpand("-isystem"), StringExpand("-iquote"),   StringExpand("-idirafter"),
+    StringExpand("-MF"),      StringExpand("-MT"),      StringExpand("-MQ"),
+};
+static const String PreprocessorFlags[] = {StringExpand("-MMD"), StringExpand("-MD"), StringExpand("-MP")};
+
+typedef enum Preprocessor_Argument
+{
+    Preprocessor_Argument_None,  // Also read by the compiler
+    Preprocessor_Argument_Flag,  // Only read by the preprocessor, including its joined value
+    Preprocessor_Argument_Value, // Only read by the preprocessor, its value is the next argument
+} Preprocessor_Argument;
+
+static Preprocessor_Argument PreprocessorArgumentKind(String arg)
+{
+    for (Uint32 index = 0; index < ArrayCount(PreprocessorFlags); ++index)
+    {
+        if (StrMatch(arg, PreprocessorFlags[index]))
+            return Preprocessor_Argument_Flag;
+    }
+    for (Uint32 index = 0; index < ArrayCount(PreprocessorValueOptions); ++index)
+    {
+        if (StrMatch(arg, PreprocessorValueOptions[index]))
+            return Preprocessor_Argument_Value;
+        if (StrStartsWith(arg, PreprocessorValueOptions[index]))
+            return Preprocessor_Argument_Flag;
+    }
+    return Preprocessor_Argument_None;
+}
+
+typedef struct Build_Remote_Command
+{
+    Build_Node  Preprocess; // Writes the preprocessed source and the dependency file
+    String_List Args;       // Compiler and options sent to the worker, without the input and output files
+    String      Source;     // Preprocessed source, next to the object file
+    String      Name;       // Name of the source on the worker, its extension gives the language
+} Build_Remote_Command;
+
+// Splits the command of the node: "-c" becomes "-E" and the output is the preprocessed source for the local part,
+// the preprocessor options, the input and the output are removed for the worker
+static void BuildRemoteCommandInit(Build_Remote_Command *command, Build_Node *node, Memory_Arena *arena)
+{
+    String source   = BuildNodeFirstInput(node);
+    String object   = BuildNodeFirstOutput(node);
+    bool   c_source = StrEndsWith(source, StringLiteral(".c"));
+
+    command->Name   = c_source ? StringLiteral("source.i") : StringLiteral("source.ii");
+    command->Source = StrConcatArena(object, c_source ? StringLiteral(".i") : StringLiteral(".ii"), arena);
+
+    memset(&command->Preprocess, 0, sizeof(command->Preprocess));
+    StringListInit(&command->Preprocess.Argv);
+    StringListInit(&command->Args);
+
+    String_List *preprocess = &command->Preprocess.Argv;
+    bool         compiler   = true;
+    String      *value      = NULL; // Replaces the next argument of the preprocessor command if set
+    bool         skip       = false;
+    ForList(String_List_Node, &node->Argv)
+    {
+        ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+        {
+            String arg = it->Data[index];
+            if (compiler)
+            {
+                StringListAdd(preprocess, arg, arena);
+                StringListAdd(&command->Args, arg, arena);
+                compiler = false;
+            }
+            else if (value || skip)
+            {
+                StringListAdd(preprocess, value ? *value : arg, arena);
+                value = NULL;
+                skip  = false;
+            }
+            else if (StrMatch(arg, StringLiteral("-c")))
+            {
+                StringListAdd(preprocess, StringLiteral("-E"), arena);
+            }
+            else if (StrMatch(arg, StringLiteral("-o")))
+            {
+                StringListAdd(preprocess, arg, arena);
+                value = &command->Source;
+            }
+            else if (StrMatch(arg, source))
+            {
+                StringListAdd(preprocess, arg, arena);
+            }
+            else
+            {
+                Preprocessor_Argument kind = PreprocessorArgumentKind(arg);
+                StringListAdd(preprocess, arg, arena);
+                if (kind == Preprocessor_Argument_None)
+                    StringListAdd(&command->Args, arg, arena);
+                skip = (kind == Preprocessor_Argument_Value);
+            }
+        }
+    }
+
+    // Without it, the target of the dependency file would be the preprocessed source
+    StringListAdd(preprocess, StringLiteral("-MT"), arena);
+    StringListAdd(preprocess, object, arena);
+}
+
+// Distributed compilations are GCC and Clang ones tracking their header dependencies, the same ones that are cached.
+// Commands the workers refuse, such as the profile guided ones, are not preprocessed only to be executed locally.
+static bool BuildNodeDistributable(Build_Graph *graph, Build_Node *node)
+{
+    if (graph->Compiler == Compiler_Bit_CL || !BuildNodeCacheable(node))
+        return false;
+
+    Memory_Arena        *scratch = ThreadScratchpad();
+    Temporary_Memory     temp    = BeginTemporaryMemory(scratch);
+    Build_Remote_Command command;
+    BuildRemoteCommandInit(&command, node, scratch);
+    String rejected;
+    bool   allowed = RemoteArgumentsAllowed(&command.Args, &rejected);
+    EndTemporaryMemory(&temp);
+    return allowed;
+}
+
+typedef enum Build_Cache_Result
+{
+    Build_Cache_None, // The action is not cached
+    Build_Cache_Hit,
+    Build_Cache_Miss,
+} Build_Cache_Result;
+
+// A dirty node handed to a worker thread, the worker only runs the command line
+// Node states and the build database are only touched by the thread executing the graph
+typedef struct Build_Job
+{
+    Build_Graph           *Graph;
+    Build_Node            *Node;
+    struct Build_Executor *Executor;
+    bool                   Succeeded;
+    Build_Fingerprint      Fingerprint; // Computed by the thread executing the graph
+    Uint64                 ToolContent; // Content hash of the compiler, only computed for cached compilations
+    Build_Cache_Result     CacheResult;
+    String                 CommandLine; // Set if the command failed, allocated from the shared arena
+    String                 Output;      // Captured stdout and stderr of the command, allocated from the shared arena
+    Os_Process_Usage       Usage;
+    Remote_Host           *Host;        // NULL when the action is executed locally
+    Uint64                 StartTime;
+    Uint64                 EndTime;
+    Uint32                 Thread;
+    struct Build_Job      *Next;
+} Build_Job;
+
+typedef struct Build_Executor
+{
+    Build_Job *volatile Completed; // Lock free stack of finished jobs, pushed by the workers
+    Os_Semaphore        Done;      // Signalled once for every finished job
+    Shared_Arena       *Arena;
+    Object_Cache       *Cache; // NULL when the object cache is disabled
+} Build_Executor;
+
+INLINE_PROCEDURE void BuildJobCaptureOutput(void *context, const Uint8 *data, Int64 size)
+{
+    OutBuffer((Out_Stream *)context, data, size);
+}
+
+INLINE_PROCEDURE String BuildJobCopyString(Shared_Arena *arena, String str)
+{
+    Uint8 *copy = arena ? (Uint8 *)SharedArenaPush(arena, str.Length + 1) : NULL;
+    if (!copy)
+        return StringLiteral("");
+    memcpy(copy, str.Data, str.Length);
+    copy[str.Length] = 0;
+    return StringMake(copy, str.Length);
+}
+
+// Returns false if the host could not compile the source, the action is then executed locally
+// Unless it refused the command, the host is not used again for the build, it is most likely down or running another
+// version of the protocol
+static bool BuildJobExecuteRemote(Build_Job *job, Out_Stream *output, Memory_Arena *arena)
+{
+    Build_Node          *node = job->Node;
+    Build_Remote_Command command;
+    BuildRemoteCommandInit(&command, node, arena);
+
+    String preprocess = BuildNodeCommandLine(&command.Preprocess, arena);
+    preprocess        = BuildNodeResponseFileCommandLine(job->Graph, &command.Preprocess, preprocess, arena);
+    job->Succeeded    = OsExecuteCommandLineCapture(preprocess, BuildJobCaptureOutput, output, &job->Usage);
+
+    Remote_Result result = Remote_Result_Failed;
+    if (job->Succeeded)
+        result = RemoteCompile(job->Host, &command.Args, command.Source, command.Name, BuildNodeFirstOutput(node),
+                               output, &job->Usage.ExitCode);
+    OsFileDelete(command.Source);
+
+    if (result == Remote_Result_Unavailable)
+    {
+        if (AtomicCompareExchange32(&job->Host->Down, 0, 1))
+            LogWarn("Could not compile on %s, its compilations are executed locally\n", job->Host->Address.Data);
+        return false;
+    }
+    if (result == Remote_Result_Rejected)
+        return false;
+
+    // The memory used by the compiler is not known, the one recorded by a local compilation is kept
+    job->Succeeded        = (result == Remote_Result_Succeeded);
+    job->Usage.PeakMemory = 0;
+    return true;
+}
+
+static void BuildJobExecute(void *data)
+{
+    Build_Job       *job      = (Build_Job *)data;
+    Build_Executor  *executor = job->Executor;
+
+    Memory_Arena    *scratch  = ThreadScratchpad();
+    Temporary_Memory temp     = BeginTemporaryMemory(scratch);
+
+    job->Thread               = ThreadContext.ThreadIndex;
+    job->StartTime            = OsGetMonotonicTime();
+    LogSetTarget(job->Graph->Name);
+
+    Build_Node      *node         = job->Node;
+    Object_Cache    *cache        = executor->Cache;
+    Uint64           manifest_key = 0;
+    if (cache && BuildNodeCacheable(node))
+        manifest_key = BuildNodeManifestKey(node, &job->Fingerprint, job->ToolContent, job->Graph->Compiler);
+
+    if (manifest_key)
+    {
+        // The dependency file is restored first, it lists the headers that make the key of the object file
+        Uint64 result_key = 0;
+        if (ObjectCacheGet(cache, manifest_key, node->DepFile))
+            result_key = BuildNodeResultKey(node, manifest_key);
+        if (result_key && ObjectCacheGet(cache, result_key, BuildNodeFirstOutput(node)))
+            job->CacheResult = Build_Cache_Hit;
+        else
+            job->CacheResult = Build_Cache_Miss;
+    }
+
+    if (job->CacheResult == Build_Cache_Hit)
+    {
+        memset(&job->Usage, 0, sizeof(job->Usage));
+        job->Succeeded = true;
+        job->EndTime   = OsGetMonotonicTime();
+    }
+    else
+    {
+        String cmd_line = BuildNodeCommandLine(node, scratch);
+
+        // The output is printed by the main thread once the job is complete, so that jobs never interleave
+        Out_Stream *output = PushType(scratch, Out_Stream);
+        OutCreate(output, MemoryArenaAllocator(scratch));
+
+        if (!job->Host || !BuildJobExecuteRemote(job, output, scratch))
+        {
+            // Warnings printed while preprocessing are printed again by the compiler
+            if (job->Host)
+                OutReset(output);
+            cmd_line       = BuildNodeResponseFileCommandLine(job->Graph, node, cmd_line, scratch);
+            job->Succeeded = OsExecuteCommandLineCapture(cmd_line, BuildJobCaptureOutput, output, &job->Usage);
+        }
+
+        job->EndTime   = OsGetMonotonicTime();
+
+        if (OutGetSize(output))
+            job->Output = BuildJobCopyString(executor->Arena, OutBuildStringSerial(output, scratch));
+        if (!job->Succeeded)
+            job->CommandLine = BuildJobCopyString(executor->Arena, cmd_line);
+
+        // The object file is stored before the dependency file, so that a manifest never refers to a missing object
+        if (job->Succeeded && job->CacheResult == Build_Cache_Miss)
+        {
+            Uint64 result_key = BuildNodeResultKey(node, manifest_key);
+            if (result_key)
+            {
+                ObjectCachePut(cache, result_key, BuildNodeFirstOutput(node));
+                ObjectCachePut(cache, manifest_key, node->DepFile);
+            }
+        }
+    }
+
+    LogSetTarget(StringLiteral(""));
+    EndTemporaryMemory(&temp);
+
+    Build_Job *head;
+    do
+    {
+        head      = executor->Completed;
+        job->Next = head;
+    } while (!AtomicCompareExchangePointer((void *volatile *)&executor->Completed, head, job));
+
+    OsSemaphoreSignal(executor->Done, 1);
+}
+
+// Dependents that became ready are handed to the scheduler
+INLINE_PROCEDURE void BuildNodeComplete(Build_Node *node, Build_Scheduler *scheduler)
+{
+    for (Build_Node_Ref *dependent = node->Dependents; dependent; dependent = dependent->Next)
+    {
+        dependent->Node->PendingDeps -= 1;
+        if (dependent->Node->PendingDeps == 0)
+            BuildSchedulerPush(scheduler, dependent->Node);
+    }
+}
+
+// Keeps the first "max_lines" lines of the output (all of them if 0), "omitted" receives the count of lines left out
+INLINE_PROCEDURE String BuildJobTruncateOutput(String output, Uint32 max_lines, Uint32 *omitted)
+{
+    *omitted = 0;
+    if (!max_lines)
+        return output;
+
+    Uint32 lines = 0;
+    Int64  end   = output.Length;
+    for (Int64 index = 0; index < output.Length; ++index)
+    {
+        if (output.Data[index] == '\n')
+        {
+            lines += 1;
+            if (lines == max_lines)
+                end = index + 1;
+        }
+    }
+    if (output.Length && output.Data[output.Length - 1] != '\n')
+        lines += 1;
+
+    if (lines > max_lines)
+    {
+        *omitted      = lines - max_lines;
+        output.Length = end;
+    }
+    return output;
+}
+
+// Prints the result of a job as a single message and appends its whole output to the log of the target
+static void BuildJobReport(Build_Job *job, Build_Config *build_config, Out_Stream *target_log, String log_path)
+{
+    Build_Node      *node    = job->Node;
+    const char      *kind    = BuildNodeKindId[node->Kind].Data;
+    String           name    = BuildNodeFirstOutput(node);
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Uint32           omitted = 0;
+    String           output  = BuildJobTruncateOutput(job->Output, build_config->OutputLines, &omitted);
+    const char      *newline = (output.Length && output.Data[output.Length - 1] != '\n') ? "\n" : "";
+    String           note    = StringLiteral("");
+    if (omitted)
+        note = FmtStr(scratch, "... %u more lines in %s\n", omitted, log_path.Data);
+
+    if (!job->Succeeded)
+    {
+        LogError("%s failed: %s\n%.*s%s%s", kind, name.Data, (int)output.Length, output.Data, newline, note.Data);
+        if (job->CommandLine.Length && !build_config->DisplayCommandLine)
+            LogError("Command Line: %s\n", job->CommandLine.Data);
+    }
+    else if (output.Length)
+    {
+        LogInfo("%s %s:\n%.*s%s%s", kind, name.Data, (int)output.Length, output.Data, newline, note.Data);
+    }
+
+    EndTemporaryMemory(&temp);
+
+    OutFormatted(target_log, "==> %s %s %s%s\n", kind, name.Data, job->Succeeded ? "succeeded" : "failed",
+                 job->CacheResult == Build_Cache_Hit ? " (restored from the object cache)" : "");
+    if (job->CommandLine.Length)
+    {
+        OutPrefixed(target_log, StringLiteral("Command Line: "), job->CommandLine);
+        OutChar(target_log, '\n');
+    }
+    OutString(target_log, job->Output);
+    if (job->Output.Length && job->Output.Data[job->Output.Length - 1] != '\n')
+        OutChar(target_log, '\n');
+}
+
+//
+// Action events
+// Sent to the plugins in batches from the thread executing the graph, only to the plugins that accept version 1.11
+//
+
+#define BUILD_ACTION_EVENT_BATCH 256
+
+typedef struct Build_Action_Events
+{
+    Build_Config             *Config;
+    const char               *Target;
+    Muda_Plugin_Action_Event *Events; // NULL when no plugin receives action events
+    Uint32                    Count;
+} Build_Action_Events;
+
+static void BuildActionEventsInit(Build_Action_Events *events, Build_Graph *graph, Build_Config *build_config,
+                                  Memory_Arena *arena)
+{
+    events->Config = build_config;
+    events->Target = (const char *)graph->Name.Data;
+    events->Events = NULL;
+    events->Count  = 0;
+    if (PluginSubscribed(build_config, Muda_Plugin_Event_Kind_Actions))
+        events->Events = PushArray(arena, Muda_Plugin_Action_Event, BUILD_ACTION_EVENT_BATCH);
+}
+
+static void BuildActionEventsFlush(Build_Action_Events *events)
+{
+    if (!events->Count)
+        return;
+
+    Muda_Plugin_Event pevent;
+    memset(&pevent, 0, sizeof(pevent));
+    pevent.Kind                = Muda_Plugin_Event_Kind_Actions;
+    pevent.Data.Actions.Target = events->Target;
+    pevent.Data.Actions.Events = events->Events;
+    pevent.Data.Actions.Count  = events->Count;
+    PluginDispatch(events->Config, &pevent);
+    events->Count = 0;
+}
+
+// Returns NULL if no plugin receives action events, the fields that depend on the kind are left to zero
+static Muda_Plugin_Action_Event *BuildActionEventPush(Build_Action_Events *events, Muda_Plugin_Action_Event_Kind kind,
+                                                      Build_Node *node, Uint64 time)
+{
+    if (!events->Events)
+        return NULL;
+    if (events->Count == BUILD_ACTION_EVENT_BATCH)
+        BuildActionEventsFlush(events);
+
+    Muda_Plugin_Action_Event *event = &events->Events[events->Count++];
+    memset(event, 0, sizeof(*event));
+    event->Kind   = kind;
+    event->Action = (Muda_Plugin_Action_Kind)node->Kind;
+    event->Input  = (const char *)BuildNodeFirstInput(node).Data;
+    event->Output = (const char *)BuildNodeFirstOutput(node).Data;
+    event->Time   = time;
+    return event;
+}
+
+// BuildGraphEvaluate must be called before, only the dirty nodes are executed
+// Up to build_config->Jobs nodes whose dependencies have succeeded are run at once on the thread pool, without a
+// pool the nodes are executed one after another on the calling thread
+static bool BuildGraphExecute(Build_Graph *graph, Build_Db *db, Build_Config *build_config)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Thread_Pool     *pool    = build_config->ThreadPool;
+    Uint32           jobs    = pool ? Maximum(build_config->Jobs, 1) : 1;
+    Remote_Pool     *remote  = pool ? build_config->Remote : NULL;
+
+    Build_Executor   executor;
+    executor.Completed       = NULL;
+    executor.Done            = OsSemaphoreCreate(0);
+    executor.Arena           = build_config->SharedArena;
+    executor.Cache           = build_config->Cache;
+
+    // Output of every executed action is written to "<build_dir>/<target>.log"
+    Out_Stream *target_log = PushType(scratch, Out_Stream);
+    OutCreate(target_log, MemoryArenaAllocator(scratch));
+    String log_path;
+    if (graph->BuildDirectory.Data[graph->BuildDirectory.Length - 1] == '/')
+        log_path = FmtStr(scratch, "%s%s.log", graph->BuildDirectory.Data, graph->Name.Data);
+    else
+        log_path = FmtStr(scratch, "%s/%s.log", graph->BuildDirectory.Data, graph->Name.Data);
+
+    bool   result       = true;
+    Uint32 running      = 0;
+    Uint32 local        = 0; // Running actions not sent to a host of the remote pool
+    Uint32 executed     = 0;
+    Uint32 cache_hits   = 0;
+    Uint32 cache_misses = 0;
+
+    Build_Progress progress;
+    BuildProgressInit(&progress, graph, db, jobs + (remote ? remote->SlotCount : 0), scratch);
+
+    // Every node is handed to the scheduler exactly once, when its dependencies are completed
+    Build_Scheduler scheduler;
+    BuildSchedulerInit(&scheduler, graph, db, &progress, build_config, scratch);
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        node->PendingDeps = 0;
+        for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+            node->PendingDeps += 1;
+        if (node->PendingDeps == 0)
+            BuildSchedulerPush(&scheduler, node);
+    }
+
+    Build_Action_Events events;
+    BuildActionEventsInit(&events, graph, build_config, scratch);
+
+    LogSetTarget(graph->Name);
+
+    for (;;)
+    {
+        while (scheduler.ReadyCount)
+        {
+            // Compilations sent to a host only take one of its slots, the local limits do not apply to them
+            Build_Node  *node  = scheduler.Ready[0];
+            bool         ready = node->Dirty && BuildNodeDependenciesSucceeded(node);
+            Remote_Host *host  = NULL;
+            if (ready && remote && BuildNodeDistributable(graph, node))
+                host = RemotePoolAcquire(remote);
+            if (!host && (local == jobs || (ready && !BuildSchedulerAdmit(&scheduler, node, local))))
+                break;
+            BuildSchedulerPop(&scheduler);
+
+            if (!BuildNodeDependenciesSucceeded(node))
+            {
+                node->State = Build_Node_State_Skipped;
+                BuildProgressSkip(&progress, node);
+                BuildNodeComplete(node, &scheduler);
+                continue;
+            }
+
+            if (!node->Dirty)
+            {
+                node->State = Build_Node_State_Succeeded;
+                BuildNodeComplete(node, &scheduler);
+                continue;
+            }
+
+            BuildNodeLogBegin(node, progress.Started + 1, progress.Total);
+            if (build_config->ExplainDirty)
+                LogInfo("Reason: %s\n", node->Reason.Data);
+            if (build_config->DisplayCommandLine)
+            {
+                Temporary_Memory cmd_temp = BeginTemporaryMemory(scratch);
+                LogInfo("%s Command Line: %s\n", BuildNodeKindId[node->Kind].Data,
+                        BuildNodeCommandLine(node, scratch).Data);
+                EndTemporaryMemory(&cmd_temp);
+            }
+
+            Build_Job *job   = PushType(scratch, Build_Job);
+            job->Graph       = graph;
+            job->Node        = node;
+            job->Executor    = &executor;
+            job->Succeeded   = false;
+            job->Fingerprint = BuildNodeFingerprint(graph, node);
+            job->ToolContent = 0;
+            if (executor.Cache && BuildNodeCacheable(node))
+                job->ToolContent = ToolContentHash(node->Argv.Head.Data[0]);
+            job->CacheResult = Build_Cache_None;
+            job->CommandLine = StringLiteral("");
+            job->Output      = StringLiteral("");
+            job->Host        = host;
+            job->Next        = NULL;
+
+            running += 1;
+            executed += 1;
+            Uint64 now = OsGetMonotonicTime();
+            BuildProgressStart(&progress, node, now);
+            if (!host)
+            {
+                local += 1;
+                BuildSchedulerStart(&scheduler, node);
+            }
+            BuildActionEventPush(&events, Muda_Plugin_Action_Event_Start, node, now);
+            if (pool)
+                ThreadPoolSubmit(pool, BuildJobExecute, job);
+            else
+                BuildJobExecute(job);
+        }
+
+        if (running == 0)
+            break;
+
+        BuildProgressStatus(&progress);
+
+        // The status line is redrawn every second so that the estimate keeps counting down during long actions
+        // Nodes held back by the system load or waiting for a token of the jobserver are tried again meanwhile
+        if (LogStatusEnabled() || scheduler.RetryAfter)
+        {
+            Uint32 timeout = scheduler.RetryAfter ? scheduler.RetryAfter : 1000;
+            bool   signalled;
+            while (!(signalled = OsSemaphoreWaitTimeout(executor.Done, timeout)) && !scheduler.RetryAfter)
+                BuildProgressStatus(&progress);
+            if (!signalled)
+                continue;
+        }
+        else
+        {
+            OsSemaphoreWait(executor.Done);
+        }
+
+        Build_Job *completed = AtomicExchangePointer((void *volatile *)&executor.Completed, NULL);
+        for (Build_Job *job = completed; job; job = job->Next)
+        {
+            Build_Node *node = job->Node;
+            running -= 1;
+            BuildProgressFinish(&progress, node);
+            if (job->Host)
+            {
+                RemotePoolRelease(job->Host);
+            }
+            else
+            {
+                local -= 1;
+                BuildSchedulerFinish(&scheduler, node);
+            }
+
+            if (job->CacheResult == Build_Cache_Hit)
+            {
+                cache_hits += 1;
+                BuildActionEventPush(&events, Muda_Plugin_Action_Event_Cache_Hit, node, job->EndTime);
+            }
+            else if (job->CacheResult == Build_Cache_Miss)
+            {
+                cache_misses += 1;
+                BuildActionEventPush(&events, Muda_Plugin_Action_Event_Cache_Miss, node, job->EndTime);
+            }
+
+            Muda_Plugin_Action_Event *event =
+                BuildActionEventPush(&events, Muda_Plugin_Action_Event_Finish, node, job->EndTime);
+            if (event)
+            {
+                event->Thread     = job->Thread;
+                event->ExitCode   = job->Usage.ExitCode;
+                event->Duration   = job->EndTime - job->StartTime;
+                event->UserTime   = job->Usage.UserTime;
+                event->SystemTime = job->Usage.SystemTime;
+                event->PeakMemory = job->Usage.PeakMemory;
+            }
+
+            TraceAddEvent(build_config->Trace, BuildNodeKindId[node->Kind].Data, BuildNodeFirstOutput(node),
+                          job->StartTime, job->EndTime, job->Thread);
+
+            if (job->Succeeded)
+            {
+                // Restoring from the cache says nothing about the resources the action takes
+                bool   hit      = (job->CacheResult == Build_Cache_Hit);
+                Uint64 duration = hit ? 0 : job->EndTime - job->StartTime;
+                Uint64 memory   = hit ? 0 : job->Usage.PeakMemory;
+                node->State     = Build_Node_State_Succeeded;
+                BuildDbUpdate(db, BuildNodeFirstOutput(node), &job->Fingerprint, graph->Compiler, duration, memory);
+            }
+            else
+            {
+                node->State = Build_Node_State_Failed;
+                result      = false;
+            }
+
+            BuildNodeComplete(node, &scheduler);
+        }
+
+        // Failed jobs of the batch are reported first
+        for (Build_Job *job = completed; job; job = job->Next)
+        {
+            if (!job->Succeeded)
+                BuildJobReport(job, build_config, target_log, log_path);
+        }
+        for (Build_Job *job = completed; job; job = job->Next)
+        {
+            if (job->Succeeded)
+                BuildJobReport(job, build_config, target_log, log_path);
+        }
+    }
+
+    BuildActionEventsFlush(&events);
+
+    if (executed)
+    {
+        LogStatus("");
+
+        if (cache_hits + cache_misses)
+            LogInfo("Object cache: %u hits, %u misses\n", cache_hits, cache_misses);
+
+        File_Handle handle = OsFileOpen(log_path, File_Mode_Write);
+        if (handle.PlatformFileHandle)
+        {
+            OutWriteFile(target_log, handle);
+            OsFileClose(handle);
+        }
+    }
+
+    OsSemaphoreDestroy(executor.Done);
+    EndTemporaryMemory(&temp);
+    LogSetTarget(StringLiteral(""));
+
+    BuildDbSave(db);
+
+    return result;
+}
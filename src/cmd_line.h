@@ -23,7 +23,27 @@ static bool OptCmdline(const char *program, const char *arg[], int count, Build_
 static bool OptNoLog(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
 static bool OptConfig(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
 static bool OptLog(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptLogJson(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
 static bool OptNoPlug(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptCompileDb(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptDryRun(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptExplain(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptRebuild(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptPgo(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptJobs(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptOutputLines(const char *program, const char *arg[], int count, Build_Config *config,
+                           Muda_Option *option);
+static bool OptMemoryBudget(const char *program, const char *arg[], int count, Build_Config *config,
+                            Muda_Option *option);
+static bool OptMaxLoad(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptCache(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptDistribute(const char *program, const char *arg[], int count, Build_Config *config,
+                          Muda_Option *option);
+static bool OptServe(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptDaemon(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptBenchmark(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptStats(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
+static bool OptTrace(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
 static bool OptHelp(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option);
 
 static const Muda_Option Options[] = {
@@ -38,7 +58,34 @@ static const Muda_Option Options[] = {
     {StringExpand("config"), "Specify default or configurations to use from the muda file.", "[configuration/s]",
      OptConfig, -255},
     {StringExpand("log"), "Log to the given file", "<file>", OptLog, 1},
+    {StringExpand("logjson"), "Log to the given file as JSON lines", "<file>", OptLogJson, 1},
     {StringExpand("noplug"), "Plugin are not loaded", "", OptNoPlug, 0},
+    {StringExpand("compdb"), "Writes compile_commands.json without building", "", OptCompileDb, 0},
+    {StringExpand("n"), "Prints the planned actions without executing them", "", OptDryRun, 0},
+    {StringExpand("explain"), "Explains why each action has to be executed", "", OptExplain, 0},
+    {StringExpand("rebuild"), "Executes every action even if it is up to date", "", OptRebuild, 0},
+    {StringExpand("pgo"), "Builds with instrumentation, runs Training and builds again using the profile", "", OptPgo,
+     0},
+    {StringExpand("jobs"), "Number of actions executed in parallel, defaults to the number of processors", "<count>",
+     OptJobs, 1},
+    {StringExpand("outputlines"), "Maximum number of lines of compiler output printed per action", "<count>",
+     OptOutputLines, 1},
+    {StringExpand("membudget"), "Starts actions only while their recorded memory fits in the budget (512M, 4G...)",
+     "<size>", OptMemoryBudget, 1},
+    {StringExpand("maxload"), "Starts no action while the load average is above the given value", "<load>",
+     OptMaxLoad, 1},
+    {StringExpand("cache"), "Restores the compiled objects from the cache in the given directory", "<dir>", OptCache,
+     1},
+    {StringExpand("distribute"), "Sends the compilations to the workers listed in the given file", "<file>",
+     OptDistribute, 1},
+    {StringExpand("serve"), "Runs as a worker compiling for other machines, on trusted networks only", "<[host:]port>",
+     OptServe, 1},
+    {StringExpand("daemon"), "Keeps a process running that executes the builds started in this directory", "",
+     OptDaemon, 0},
+    {StringExpand("benchmark"), "Measures parsing and lowering of the muda file with each memory commit strategy",
+     "<iterations>", OptBenchmark, 1},
+    {StringExpand("stats"), "Reports the memory used by Muda when it exits", "", OptStats, 0},
+    {StringExpand("trace"), "Writes a timeline of the build in Chrome trace format", "<file>", OptTrace, 1},
     {StringExpand("help"), "Muda description and list all the command", "[command/s]", OptHelp, -255},
 };
 
@@ -340,12 +387,166 @@ static bool OptLog(const char *program, const char *arg[], int count, Build_Conf
     return false;
 }
 
+static bool OptLogJson(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->LogJsonPath = arg[0];
+    return false;
+}
+
 static bool OptNoPlug(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
 {
     config->EnablePlugins = false;
     return false;
 }
 
+static bool OptCompileDb(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->GenerateCompileDb = true;
+    return false;
+}
+
+static bool OptDryRun(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->DryRun = true;
+    return false;
+}
+
+static bool OptExplain(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->ExplainDirty = true;
+    return false;
+}
+
+static bool OptRebuild(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->ForceRebuild = true;
+    return false;
+}
+
+static bool OptPgo(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->ProfileGuided = true;
+    return false;
+}
+
+static bool OptJobs(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    char         *end  = NULL;
+    unsigned long jobs = strtoul(arg[0], &end, 10);
+    if (end == arg[0] || *end || jobs == 0 || jobs > MUDA_MAX_JOBS)
+    {
+        LogError("Invalid job count \"%s\", expected a number between 1 and %u\n\n", arg[0], MUDA_MAX_JOBS);
+        return true;
+    }
+    config->Jobs = (Uint32)jobs;
+    return false;
+}
+
+static bool OptOutputLines(const char *program, const char *arg[], int count, Build_Config *config,
+                           Muda_Option *option)
+{
+    char         *end   = NULL;
+    unsigned long lines = strtoul(arg[0], &end, 10);
+    if (end == arg[0] || *end || lines == 0)
+    {
+        LogError("Invalid line count \"%s\"\n\n", arg[0]);
+        return true;
+    }
+    config->OutputLines = (Uint32)lines;
+    return false;
+}
+
+static bool OptMemoryBudget(const char *program, const char *arg[], int count, Build_Config *config,
+                            Muda_Option *option)
+{
+    char              *end    = NULL;
+    unsigned long long budget = strtoull(arg[0], &end, 10);
+    unsigned long long unit   = 1;
+    if (end != arg[0])
+    {
+        if (*end == 'k' || *end == 'K')
+            unit = KiloBytes(1ull);
+        else if (*end == 'm' || *end == 'M')
+            unit = MegaBytes(1ull);
+        else if (*end == 'g' || *end == 'G')
+            unit = GigaBytes(1ull);
+        if (unit != 1)
+            end += 1;
+    }
+    budget *= unit;
+
+    if (end == arg[0] || *end || budget == 0)
+    {
+        LogError("Invalid memory budget \"%s\", expected a size in bytes or with a K, M or G suffix\n\n", arg[0]);
+        return true;
+    }
+    config->MemoryBudget = budget;
+    return false;
+}
+
+static bool OptMaxLoad(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    char *end  = NULL;
+    float load = strtof(arg[0], &end);
+    if (end == arg[0] || *end || load <= 0)
+    {
+        LogError("Invalid load average \"%s\"\n\n", arg[0]);
+        return true;
+    }
+    config->MaxLoad = load;
+    return false;
+}
+
+static bool OptCache(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->CachePath = arg[0];
+    return false;
+}
+
+static bool OptDistribute(const char *program, const char *arg[], int count, Build_Config *config,
+                          Muda_Option *option)
+{
+    config->DistributePath = arg[0];
+    return false;
+}
+
+static bool OptServe(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->ServeAddress = arg[0];
+    return false;
+}
+
+static bool OptDaemon(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->Daemon = true;
+    return false;
+}
+
+static bool OptBenchmark(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    char         *end        = NULL;
+    unsigned long iterations = strtoul(arg[0], &end, 10);
+    if (end == arg[0] || *end || iterations == 0)
+    {
+        LogError("Invalid iteration count \"%s\"\n\n", arg[0]);
+        return true;
+    }
+    config->BenchmarkIterations = (Uint32)iterations;
+    return false;
+}
+
+static bool OptStats(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->PrintStats = true;
+    return false;
+}
+
+static bool OptTrace(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
+{
+    config->TracePath = arg[0];
+    return false;
+}
+
 static bool OptHelp(const char *program, const char *arg[], int count, Build_Config *config, Muda_Option *option)
 {
     if (count)
@@ -0,0 +1,442 @@
+#pragma once
+
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+
+//
+// compile_commands.json (JSON Compilation Database) generation
+// https://clang.llvm.org/docs/JSONCompilationDatabase.html
+//
+
+typedef struct Compile_Db_Entry
+{
+    String                   Directory;
+    String                   File;
+    String                   Command;
+    bool                     Current; // Written by this run, set while merging
+    struct Compile_Db_Entry *Next;
+} Compile_Db_Entry;
+
+typedef struct Compile_Db
+{
+    Compile_Db_Entry *First;
+    Compile_Db_Entry *Last;
+    Memory_Arena     *Arena;
+} Compile_Db;
+
+INLINE_PROCEDURE void CompileDbInit(Compile_Db *db, Memory_Arena *arena)
+{
+    db->First = NULL;
+    db->Last  = NULL;
+    db->Arena = arena;
+}
+
+INLINE_PROCEDURE void CompileDbAdd(Compile_Db *db, String directory, String file, String command)
+{
+    Compile_Db_Entry *entry = PushType(db->Arena, Compile_Db_Entry);
+    entry->Directory        = directory;
+    entry->File             = StrDuplicateArena(file, db->Arena);
+    entry->Command          = StrDuplicateArena(command, db->Arena);
+    entry->Current          = false;
+    entry->Next             = NULL;
+
+    if (db->Last)
+        db->Last->Next = entry;
+    else
+        db->First = entry;
+    db->Last = entry;
+}
+
+INLINE_PROCEDURE void OutJsonString(Out_Stream *out, String str)
+{
+    OutBuffer(out, "\"", 1);
+    Int64 begin = 0;
+    for (Int64 index = 0; index < str.Length; ++index)
+    {
+        Uint8 ch = str.Data[index];
+        if (ch == '"' || ch == '\\' || ch < 0x20)
+        {
+            OutBuffer(out, str.Data + begin, index - begin);
+            if (ch == '"')
+                OutBuffer(out, "\\\"", 2);
+            else if (ch == '\\')
+                OutBuffer(out, "\\\\", 2);
+            else if (ch == '\n')
+                OutBuffer(out, "\\n", 2);
+            else if (ch == '\t')
+                OutBuffer(out, "\\t", 2);
+            else
+            {
+                const char *hex       = "0123456789abcdef";
+                char        escape[6] = {'\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF]};
+                OutBuffer(out, escape, sizeof(escape));
+            }
+            begin = index + 1;
+        }
+    }
+    OutBuffer(out, str.Data + begin, str.Length - begin);
+    OutBuffer(out, "\"", 1);
+}
+
+typedef struct Json_Reader
+{
+    Uint8 *Pos;
+    Uint8 *End;
+} Json_Reader;
+
+INLINE_PROCEDURE void JsonSkipSpaces(Json_Reader *reader)
+{
+    while (reader->Pos < reader->End && isspace(*reader->Pos))
+        reader->Pos += 1;
+}
+
+INLINE_PROCEDURE bool JsonExpect(Json_Reader *reader, Uint8 ch)
+{
+    JsonSkipSpaces(reader);
+    if (reader->Pos < reader->End && *reader->Pos == ch)
+    {
+        reader->Pos += 1;
+        return true;
+    }
+    return false;
+}
+
+// Strings are decoded in place, escape sequences never grow the string
+static bool JsonReadString(Json_Reader *reader, String *out)
+{
+    if (!JsonExpect(reader, '"'))
+        return false;
+
+    Uint8 *write = reader->Pos;
+    out->Data    = write;
+
+    while (reader->Pos < reader->End && *reader->Pos != '"')
+    {
+        Uint8 ch = *reader->Pos++;
+        if (ch == '\\' && reader->Pos < reader->End)
+        {
+            ch = *reader->Pos++;
+            switch (ch)
+            {
+            case 'n':
+                ch = '\n';
+                break;
+            case 't':
+                ch = '\t';
+                break;
+            case 'r':
+                ch = '\r';
+                break;
+            case 'b':
+                ch = '\b';
+                break;
+            case 'f':
+                ch = '\f';
+                break;
+            case 'u': {
+                if (reader->End - reader->Pos < 4)
+                    return false;
+                unsigned int code = 0;
+                sscanf((char *)reader->Pos, "%4x", &code);
+                reader->Pos += 4;
+                if (code < 0x80)
+                {
+                    ch = (Uint8)code;
+                }
+                else if (code < 0x800)
+                {
+                    *write++ = (Uint8)(0xC0 | (code >> 6));
+                    ch       = (Uint8)(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    *write++ = (Uint8)(0xE0 | (code >> 12));
+                    *write++ = (Uint8)(0x80 | ((code >> 6) & 0x3F));
+                    ch       = (Uint8)(0x80 | (code & 0x3F));
+                }
+            }
+            break;
+            }
+        }
+        *write++ = ch;
+    }
+
+    if (reader->Pos >= reader->End)
+        return false;
+
+    out->Length = write - out->Data;
+    reader->Pos += 1;
+    return true;
+}
+
+// Arrays and objects nested deeper are not read, the stack would not hold the recursion
+#define JSON_MAX_DEPTH 256
+
+// Skips a value of any kind, strings are decoded in place as they are skipped
+static bool JsonSkipValue(Json_Reader *reader, Uint32 depth)
+{
+    JsonSkipSpaces(reader);
+    if (reader->Pos >= reader->End || depth > JSON_MAX_DEPTH)
+        return false;
+
+    String value;
+    switch (*reader->Pos)
+    {
+    case '"':
+        return JsonReadString(reader, &value);
+
+    case '[':
+    case '{': {
+        Uint8 close = *reader->Pos == '[' ? ']' : '}';
+        reader->Pos += 1;
+        if (JsonExpect(reader, close))
+            return true;
+        do
+        {
+            if (close == '}' && (!JsonReadString(reader, &value) || !JsonExpect(reader, ':')))
+                return false;
+            if (!JsonSkipValue(reader, depth + 1))
+                return false;
+        } while (JsonExpect(reader, ','));
+        return JsonExpect(reader, close);
+    }
+
+    default: {
+        // Numbers, true, false and null
+        Uint8 *start = reader->Pos;
+        while (reader->Pos < reader->End && !isspace(*reader->Pos) && *reader->Pos != ',' && *reader->Pos != ']' &&
+               *reader->Pos != '}')
+            reader->Pos += 1;
+        return reader->Pos != start;
+    }
+    }
+}
+
+// Reads the entries of an existing compile_commands.json, entries that are not written by Muda are dropped
+static Compile_Db_Entry *CompileDbParse(Uint8 *data, Int64 length, Memory_Arena *arena)
+{
+    Compile_Db_Entry *first  = NULL;
+    Compile_Db_Entry *last   = NULL;
+
+    Json_Reader       reader = {data, data + length};
+
+    if (!JsonExpect(&reader, '['))
+        return NULL;
+
+    while (JsonExpect(&reader, '{'))
+    {
+        Compile_Db_Entry entry;
+        memset(&entry, 0, sizeof(entry));
+
+        do
+        {
+            String key, value;
+            if (!JsonReadString(&reader, &key) || !JsonExpect(&reader, ':'))
+                return first;
+
+            // "arguments", "output" and the other keys Muda does not write are skipped
+            JsonSkipSpaces(&reader);
+            if (reader.Pos < reader.End && *reader.Pos != '"')
+            {
+                if (!JsonSkipValue(&reader, 0))
+                    return first;
+                continue;
+            }
+
+            if (!JsonReadString(&reader, &value))
+                return first;
+
+            if (StrMatch(key, StringLiteral("directory")))
+                entry.Directory = value;
+            else if (StrMatch(key, StringLiteral("file")))
+                entry.File = value;
+            else if (StrMatch(key, StringLiteral("command")))
+                entry.Command = value;
+        } while (JsonExpect(&reader, ','));
+
+        if (!JsonExpect(&reader, '}'))
+            return first;
+
+        if (entry.Directory.Data && entry.File.Data && entry.Command.Data)
+        {
+            Compile_Db_Entry *node = PushType(arena, Compile_Db_Entry);
+            *node                  = entry;
+            node->Next             = NULL;
+            if (last)
+                last->Next = node;
+            else
+                first = node;
+            last = node;
+        }
+
+        if (!JsonExpect(&reader, ','))
+            break;
+    }
+
+    return first;
+}
+
+// Existing entries are dropped when their source was deleted or renamed, or when they belong to a directory whose
+// entries are all regenerated by this run
+static bool CompileDbEntryObsolete(Compile_Db_Entry *entry, Compile_Db_Entry *first, Memory_Arena *arena)
+{
+    if (entry->Current)
+        return false;
+
+    for (Compile_Db_Entry *current = first; current; current = current->Next)
+    {
+        if (StrMatch(current->Directory, entry->Directory))
+            return true;
+    }
+
+    bool   absolute = entry->File.Length && (entry->File.Data[0] == '/' || entry->File.Data[0] == '\\' ||
+                                           (entry->File.Length > 1 && entry->File.Data[1] == ':'));
+    String path     = absolute ? FmtStr(arena, "%.*s", (int)entry->File.Length, entry->File.Data)
+                               : FmtStr(arena, "%.*s/%.*s", (int)entry->Directory.Length, entry->Directory.Data,
+                                        (int)entry->File.Length, entry->File.Data);
+    return OsCheckIfPathExists(path) != Path_Exist_File;
+}
+
+// Merges the entries starting from "first" into the database present at "path"
+// Entries of other targets are preserved and the file is only rewritten when an entry changed. A source built by
+// several configurations keeps the command of the first one.
+static bool CompileDbWrite(Compile_Db_Entry *first, String path)
+{
+    Memory_Arena    *scratch  = ThreadScratchpad();
+    Temporary_Memory temp     = BeginTemporaryMemory(scratch);
+
+    Compile_Db_Entry *existing = NULL;
+
+    File_Handle       handle   = OsFileOpen(path, File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize size = OsFileGetSize(handle);
+        Uint8  *data = PushSize(scratch, size + 1);
+        if (size && OsFileRead(handle, data, size))
+            existing = CompileDbParse(data, (Int64)size, scratch);
+        OsFileClose(handle);
+    }
+
+    Uint32 entry_count = 0;
+    for (Compile_Db_Entry *entry = existing; entry; entry = entry->Next)
+        entry_count += 1;
+    for (Compile_Db_Entry *entry = first; entry; entry = entry->Next)
+        entry_count += 1;
+
+    // Open addressing table over the existing entries and the ones added by this run, keyed by directory + file
+    Uint32             table_size = 16;
+    while (table_size < entry_count * 2)
+        table_size <<= 1;
+    Compile_Db_Entry **table = PushArrayZero(scratch, Compile_Db_Entry *, table_size);
+
+    for (Compile_Db_Entry *entry = existing; entry; entry = entry->Next)
+    {
+        Uint32 slot = (Uint32)HashBytes(StrHash(entry->Directory), entry->File.Data, entry->File.Length);
+        while (table[slot & (table_size - 1)])
+            slot += 1;
+        table[slot & (table_size - 1)] = entry;
+    }
+
+    bool              changed = (handle.PlatformFileHandle == NULL);
+    Compile_Db_Entry *added   = NULL;
+    Compile_Db_Entry *tail    = NULL;
+
+    for (Compile_Db_Entry *entry = first; entry; entry = entry->Next)
+    {
+        Compile_Db_Entry *found = NULL;
+        Uint32            slot  = (Uint32)HashBytes(StrHash(entry->Directory), entry->File.Data, entry->File.Length);
+        for (; table[slot & (table_size - 1)]; ++slot)
+        {
+            Compile_Db_Entry *candidate = table[slot & (table_size - 1)];
+            if (StrMatch(candidate->Directory, entry->Directory) && StrMatch(candidate->File, entry->File))
+            {
+                found = candidate;
+                break;
+            }
+        }
+
+        if (found && found->Current)
+            continue;
+
+        if (found)
+        {
+            found->Current = true;
+            if (!StrMatch(found->Command, entry->Command))
+            {
+                found->Command = entry->Command;
+                changed        = true;
+            }
+        }
+        else
+        {
+            Compile_Db_Entry *node = PushType(scratch, Compile_Db_Entry);
+            *node                  = *entry;
+            node->Current          = true;
+            node->Next             = NULL;
+            if (tail)
+                tail->Next = node;
+            else
+                added = node;
+            tail                           = node;
+            table[slot & (table_size - 1)] = node;
+            changed                        = true;
+        }
+    }
+
+    for (Compile_Db_Entry **entry = &existing; *entry;)
+    {
+        if (CompileDbEntryObsolete(*entry, first, scratch))
+        {
+            *entry  = (*entry)->Next;
+            changed = true;
+        }
+        else
+        {
+            entry = &(*entry)->Next;
+        }
+    }
+
+    bool result = true;
+
+    if (changed)
+    {
+        Out_Stream out;
+        OutCreate(&out, MemoryArenaAllocator(scratch));
+
+        OutBuffer(&out, "[", 1);
+        bool               first_entry = true;
+        Compile_Db_Entry *lists[]     = {existing, added};
+        for (Uint32 list_index = 0; list_index < ArrayCount(lists); ++list_index)
+        {
+            for (Compile_Db_Entry *entry = lists[list_index]; entry; entry = entry->Next)
+            {
+                OutString(&out, first_entry ? StringLiteral("\n  {\n") : StringLiteral(",\n  {\n"));
+                OutString(&out, StringLiteral("    \"directory\": "));
+                OutJsonString(&out, entry->Directory);
+                OutString(&out, StringLiteral(",\n    \"file\": "));
+                OutJsonString(&out, entry->File);
+                OutString(&out, StringLiteral(",\n    \"command\": "));
+                OutJsonString(&out, entry->Command);
+                OutString(&out, StringLiteral("\n  }"));
+                first_entry = false;
+            }
+        }
+        OutBuffer(&out, "\n]\n", 3);
+
+        handle = OsFileOpen(path, File_Mode_Write);
+        if (handle.PlatformFileHandle)
+        {
+            result = OutWriteFile(&out, handle);
+            OsFileClose(handle);
+        }
+        else
+        {
+            result = false;
+        }
+    }
+
+    EndTemporaryMemory(&temp);
+
+    return result;
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include "compile_db.h"
 #include "lenstring.h"
+#include "logger.h"
 #include "os.h"
 #include "stream.h"
 #include "version.h"
@@ -9,12 +11,15 @@
 
 const char *MudaPluginProcedureName = "External_MudaEventHook";
 #if PLATFORM_OS_WINDOWS == 1
-const char *MudaPluginPath = "./.muda/muda.dll";
+const char *MudaPluginPath      = "./.muda/muda.dll";
+const char *MudaPluginExtension = ".dll";
 #elif PLATFORM_OS_LINUX
-const char *MudaPluginPath = "./.muda/muda.so";
+const char *MudaPluginPath      = "./.muda/muda.so";
+const char *MudaPluginExtension = ".so";
 #else
 #error "Unimplemented"
 #endif
+const char *MudaPluginDirectory = "./.muda/plugins";
 
 #include <time.h>
 
@@ -55,6 +60,52 @@ typedef enum Subsystem_Kind
 
 static const String SubsystemKindId[] = {StringExpand("Console"), StringExpand("Windows")};
 
+typedef enum Optimization_Profile_Kind
+{
+    Optimization_Profile_Default, // Optimization and DebugSymbol are used
+    Optimization_Profile_Debug,
+    Optimization_Profile_Release,
+    Optimization_Profile_Release_With_Debug_Info,
+    Optimization_Profile_Size,
+    Optimization_Profile_Aggressive,
+} Optimization_Profile_Kind;
+
+static const String OptimizationProfileKindId[] = {StringExpand("Default"), StringExpand("Debug"),
+                                                   StringExpand("Release"), StringExpand("ReleaseWithDebugInfo"),
+                                                   StringExpand("Size"),    StringExpand("Aggressive")};
+
+// The ids are the values of -march
+typedef enum Target_Cpu_Kind
+{
+    Target_Cpu_Default,
+    Target_Cpu_Native,
+    Target_Cpu_X86_64_V2,
+    Target_Cpu_X86_64_V3,
+    Target_Cpu_X86_64_V4,
+} Target_Cpu_Kind;
+
+static const String TargetCpuKindId[] = {StringExpand("Default"), StringExpand("native"), StringExpand("x86-64-v2"),
+                                         StringExpand("x86-64-v3"), StringExpand("x86-64-v4")};
+
+typedef enum Lto_Kind
+{
+    Lto_None,
+    Lto_Full,
+    Lto_Thin,
+} Lto_Kind;
+
+static const String LtoKindId[] = {StringExpand("None"), StringExpand("Full"), StringExpand("Thin")};
+
+typedef enum Profile_Phase
+{
+    Profile_Phase_None,
+    Profile_Phase_Instrument, // Writes the profile when the binary is run
+    Profile_Phase_Use,        // Optimized with the collected profile
+} Profile_Phase;
+
+// Upper limit of -jobs, one worker thread is created for every job
+#define MUDA_MAX_JOBS 256
+
 typedef struct Build_Config
 {
     Compiler_Kind             ForceCompiler;
@@ -65,10 +116,45 @@ typedef struct Build_Config
     Uint32                    ConfigurationCount;
 
     const char               *LogFilePath;
+    const char               *LogJsonPath; // JSON lines, one object per message
+
+    bool                      GenerateCompileDb;
+    Compile_Db                CompileDb;
+
+    bool                      DryRun;
+    bool                      ExplainDirty;
+    bool                      ForceRebuild;
+    bool                      ProfileGuided; // Instrumented build, Training command and build using the profile
+
+    Uint32                    Jobs;
+    Uint32                    OutputLines;  // Lines of the output of an action printed to the console, 0 for all
+    Uint64                    MemoryBudget; // Bytes the running actions may use together, 0 for no limit
+    Real32                    MaxLoad;      // No action is started above this load average, 0 for no limit
+    struct Thread_Pool       *ThreadPool;   // NULL when the actions are executed serially
+    Os_Jobserver              Jobserver;    // Job slots shared with the other processes of the build
+    Shared_Arena             *SharedArena;  // Memory shared between the worker threads
+
+    Uint32                    BenchmarkIterations; // Runs the memory strategy benchmark instead of building if not 0
+
+    bool                      PrintStats;
+    const char               *TracePath;
+    struct Trace             *Trace; // NULL unless tracing
 
     bool                      EnablePlugins;
-    Muda_Plugin_Interface     Interface;
-    Muda_Event_Hook_Procedure PluginHook;
+    Muda_Plugin_Interface     Interface; // Copied to every plugin when it is loaded
+    struct Plugin_Host       *Plugins;   // NULL without plugins
+
+    const char               *CachePath; // Local store of the object cache
+    struct Object_Cache      *Cache;     // NULL when the object cache is disabled
+
+    const char               *DistributePath; // Hosts compiling for this build, one "host:port [slots]" per line
+    struct Remote_Pool       *Remote;         // NULL unless compilations are distributed
+    const char               *ServeAddress;   // Runs as a compilation worker listening on "[host:]port" if set
+
+    bool                      Daemon;      // Runs as the build daemon of the working directory
+    struct Daemon_Cache      *DaemonCache; // Configurations and graphs kept between the builds of the daemon
+
+    bool                      Failed; // Set when an action, a Prebuild or a Postbuild command failed
 } Build_Config;
 
 typedef struct String_Array_List_Node
@@ -127,7 +213,11 @@ typedef struct Compiler_Config
     Uint32            Application; // Application_Kind
 
     bool              Optimization;
+    Uint32            OptimizationProfile; // Optimization_Profile_Kind
     bool              DebugSymbol;
+    Uint32            Lto;       // Lto_Kind
+    Uint32            TargetCpu; // Target_Cpu_Kind
+    String_Array_List TargetVariants;
 
     String            Build;
     String            BuildDirectory;
@@ -148,6 +238,9 @@ typedef struct Compiler_Config
 
     String            Prebuild;
     String            Postbuild;
+    String            Training;
+
+    Uint32            ProfilePhase; // Profile_Phase, forced by -pgo, otherwise resolved when lowering
 
     Memory_Arena     *Arena;
 } Compiler_Config;
@@ -194,6 +287,10 @@ static const Enum_Info              CompilerKindInfo               = {CompilerKi
 static const Enum_Info              LanguageKindInfo               = {LanguageKindId, ArrayCount(LanguageKindId)};
 static const Enum_Info              ApplicationKindInfo            = {ApplicationKindId, ArrayCount(ApplicationKindId)};
 static const Enum_Info              SubsystemKindInfo              = {SubsystemKindId, ArrayCount(SubsystemKindId)};
+static const Enum_Info              LtoKindInfo                    = {LtoKindId, ArrayCount(LtoKindId)};
+static const Enum_Info              OptimizationProfileKindInfo    = {OptimizationProfileKindId,
+                                                                      ArrayCount(OptimizationProfileKindId)};
+static const Enum_Info              TargetCpuKindInfo              = {TargetCpuKindId, ArrayCount(TargetCpuKindId)};
 
 static const Compiler_Config_Member CompilerConfigMemberTypeInfo[] = {
     {StringExpand("Kind"), Compiler_Config_Member_Enum, offsetof(Compiler_Config, Kind),
@@ -210,9 +307,23 @@ static const Compiler_Config_Member CompilerConfigMemberTypeInfo[] = {
     {StringExpand("Optimization"), Compiler_Config_Member_Bool, offsetof(Compiler_Config, Optimization),
      "Use optimization while compiling or not (true/false)"},
 
+    {StringExpand("OptimizationProfile"), Compiler_Config_Member_Enum, offsetof(Compiler_Config, OptimizationProfile),
+     "Optimization options of the compiler. Unless Default, replaces Optimization and DebugSymbol.",
+     &OptimizationProfileKindInfo},
+
     {StringExpand("DebugSymbol"), Compiler_Config_Member_Bool, offsetof(Compiler_Config, DebugSymbol),
      "Generate debug symbols while compiling or not (true/false)"},
 
+    {StringExpand("LTO"), Compiler_Config_Member_Enum, offsetof(Compiler_Config, Lto),
+     "Link time optimization. Thin is only different from Full with CLANG, its cache is kept in BuildDirectory.",
+     &LtoKindInfo},
+
+    {StringExpand("TargetCPU"), Compiler_Config_Member_Enum, offsetof(Compiler_Config, TargetCpu),
+     "Instruction set the code is generated for. Default is the baseline of the compiler.", &TargetCpuKindInfo},
+
+    {StringExpand("TargetVariants"), Compiler_Config_Member_String_Array, offsetof(Compiler_Config, TargetVariants),
+     "TargetCPU values of the additional builds of the binary, each one is built in BuildDirectory/<value>."},
+
     {StringExpand("Build"), Compiler_Config_Member_String, offsetof(Compiler_Config, Build),
      "Name of the output binary."},
 
@@ -261,7 +372,10 @@ static const Compiler_Config_Member CompilerConfigMemberTypeInfo[] = {
      "Executes the command before executing muda file."},
 
     {StringExpand("Postbuild"), Compiler_Config_Member_String, offsetof(Compiler_Config, Postbuild),
-     "Executes the command if the compilation executed sucessfully."}};
+     "Executes the command if the compilation executed sucessfully."},
+
+    {StringExpand("Training"), Compiler_Config_Member_String, offsetof(Compiler_Config, Training),
+     "Command run on the instrumented build by muda -pgo, the profile it collects is used by the following builds."}};
 
 static const bool CompilerConfigMemberTakeInput[ArrayCount(CompilerConfigMemberTypeInfo)] = {
     /*Kind*/ false,
@@ -269,7 +383,11 @@ static const bool CompilerConfigMemberTakeInput[ArrayCount(CompilerConfigMemberT
     /*Application*/ false,
 
     /*Optimization*/ false,
+    /*OptimizationProfile*/ false,
     /*DebugSymbol*/ false,
+    /*LTO*/ false,
+    /*TargetCPU*/ false,
+    /*TargetVariants*/ false,
 
     /*Build*/ true,
     /*BuildDirectory*/ true,
@@ -289,7 +407,8 @@ static const bool CompilerConfigMemberTakeInput[ArrayCount(CompilerConfigMemberT
     /*ProjectDirectories*/ false,
 
     /*Prebuild*/ false,
-    /*Postbuild*/ false};
+    /*Postbuild*/ false,
+    /*Training*/ false};
 
 //
 // Base setup
@@ -351,6 +470,8 @@ INLINE_PROCEDURE void LogProcedureDisabled(void *agent, Log_Kind kind, const cha
 
 INLINE_PROCEDURE void FatalErrorProcedure(const char *message)
 {
+    // The messages queued before, usually the error causing this one, would be lost when exiting
+    LogFlush();
     OsConsoleWrite("%-10s", "[Fatal Error] ");
     OsConsoleWrite("%s", message);
     OsProcessExit(0);
@@ -404,11 +525,6 @@ static void MudaPluginInterface_FatalError(Thread_Context *thread_context, const
     thread_context->FatalError(msg);
 }
 
-static Muda_Event_Hook_Defn(NullMudaEventHook)
-{
-    return 0;
-}
-
 INLINE_PROCEDURE void BuildConfigInit(Build_Config *build_config)
 {
     build_config->ForceCompiler                  = 0;
@@ -418,6 +534,29 @@ INLINE_PROCEDURE void BuildConfigInit(Build_Config *build_config)
     build_config->ConfigurationCount             = 0;
 
     build_config->LogFilePath                    = NULL;
+    build_config->LogJsonPath                    = NULL;
+    build_config->OutputLines                    = 0;
+
+    build_config->GenerateCompileDb              = false;
+    CompileDbInit(&build_config->CompileDb, NULL);
+
+    build_config->DryRun                         = false;
+    build_config->ExplainDirty                   = false;
+    build_config->ForceRebuild                   = false;
+    build_config->ProfileGuided                  = false;
+
+    build_config->Jobs                           = Minimum(OsGetProcessorCount(), MUDA_MAX_JOBS);
+    build_config->MemoryBudget                   = 0;
+    build_config->MaxLoad                        = 0;
+    build_config->ThreadPool                     = NULL;
+    build_config->Jobserver.PlatformHandle       = NULL;
+    build_config->SharedArena                    = NULL;
+
+    build_config->BenchmarkIterations            = 0;
+
+    build_config->PrintStats                     = false;
+    build_config->TracePath                      = NULL;
+    build_config->Trace                          = NULL;
 
     build_config->Interface.GetThreadScratchpad  = MudaPluginInterface_GetThreadScratchpad;
     build_config->Interface.PushSize             = MudaPluginInterface_PushSize;
@@ -438,20 +577,38 @@ INLINE_PROCEDURE void BuildConfigInit(Build_Config *build_config)
     build_config->Interface.Version.Minor        = MUDA_VERSION_MINOR;
     build_config->Interface.Version.Patch        = MUDA_VERSION_PATCH;
 
-    build_config->PluginHook                     = NullMudaEventHook;
+    build_config->Interface.Subscriptions        = ~0u;
+    build_config->Interface.CacheProvider        = NULL;
+    build_config->Plugins                        = NULL;
+
+    build_config->CachePath                      = NULL;
+    build_config->Cache                          = NULL;
+
+    build_config->DistributePath                 = NULL;
+    build_config->Remote                         = NULL;
+    build_config->ServeAddress                   = NULL;
+
+    build_config->Daemon                         = false;
+    build_config->DaemonCache                    = NULL;
+
+    build_config->Failed                         = false;
 
     memset(&build_config->Interface.CommandLineConfig, 0, sizeof(build_config->Interface.CommandLineConfig));
 }
 
 INLINE_PROCEDURE void CompilerConfigInit(Compiler_Config *config, Memory_Arena *arena)
 {
-    config->Name             = StringMake(NULL, 0);
-    config->Kind             = Compile_Project;
-    config->Language         = Language_C;
-    config->Application      = Application_Executable;
+    config->Name                = StringMake(NULL, 0);
+    config->Kind                = Compile_Project;
+    config->Language            = Language_C;
+    config->Application         = Application_Executable;
 
-    config->Optimization     = false;
-    config->DebugSymbol      = true;
+    config->Optimization        = false;
+    config->OptimizationProfile = Optimization_Profile_Default;
+    config->DebugSymbol         = true;
+    config->Lto                 = Lto_None;
+    config->TargetCpu           = Target_Cpu_Default;
+    StringArrayListInit(&config->TargetVariants);
 
     const String EmptyString = {.Data = NULL, .Length = 0};
 
@@ -473,10 +630,29 @@ INLINE_PROCEDURE void CompilerConfigInit(Compiler_Config *config, Memory_Arena *
     StringArrayListInit(&config->IgnoredDirectories);
     StringArrayListInit(&config->ProjectDirectories);
 
-    config->Prebuild  = EmptyString;
-    config->Postbuild = EmptyString;
+    config->Prebuild     = EmptyString;
+    config->Postbuild    = EmptyString;
+    config->Training     = EmptyString;
+
+    config->ProfilePhase = Profile_Phase_None;
 
-    config->Arena     = arena;
+    config->Arena        = arena;
+}
+
+// -optimize
+INLINE_PROCEDURE void CompilerConfigForceOptimization(Compiler_Config *config)
+{
+    config->Optimization = true;
+    if (config->OptimizationProfile == Optimization_Profile_Debug)
+        config->OptimizationProfile = Optimization_Profile_Release;
+}
+
+INLINE_PROCEDURE bool CompilerConfigDebugSymbol(Compiler_Config *config)
+{
+    if (config->OptimizationProfile == Optimization_Profile_Default)
+        return config->DebugSymbol;
+    return config->OptimizationProfile == Optimization_Profile_Debug ||
+           config->OptimizationProfile == Optimization_Profile_Release_With_Debug_Info;
 }
 
 INLINE_PROCEDURE void CompilerConfigListInit(Compiler_Config_List *list, Memory_Arena *arena)
@@ -590,8 +766,8 @@ typedef void (*Stream_Writer_Proc)(void *context, const char *fmt, ...);
 INLINE_PROCEDURE void WriteCompilerConfig(Compiler_Config *conf, bool comments, Stream_Writer_Proc writer,
                                           void *context)
 {
-    const char *fmt        = "%-18s : %s;\n";
-    const char *fmt_no_val = "%-18s : ";
+    const char *fmt        = "%-19s : %s;\n";
+    const char *fmt_no_val = "%-19s : ";
 
     if (comments)
     {
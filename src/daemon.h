@@ -0,0 +1,197 @@
+#pragma once
+
+#include "build_graph.h"
+#include "lenstring.h"
+#include "os.h"
+#include "remote.h"
+
+//
+// Build daemon
+// "muda -daemon" keeps a process running in the workspace, with the compiler detected, the plugins loaded and the
+// worker threads started. A muda started in the same directory sends its options to the daemon over the local socket
+// .muda/daemon.sock along with its console, the daemon builds and writes to that console. When no daemon answers,
+// the build runs in the process as usual. Linux only.
+// The daemon builds with the environment it was started with, requests made with another PATH or other compiler
+// variables are refused and run in their own process.
+// The configurations parsed from the muda files and the graphs lowered from them are kept between the builds. They
+// are dropped when a muda file that was parsed is modified, when a build is requested with other options than the
+// previous one or once DAEMON_CACHE_LIMIT bytes are kept. A graph is lowered again when a directory its sources are
+// expanded from ("src/*.c") is modified. The actions are checked against the files at every build.
+//
+// Messages use the encoding of the distributed compilation:
+//   request:  magic, version, environment hash, argument count, arguments, then the console
+//   response: magic, accepted, exit code once the build is over (1 if it failed)
+//
+
+#define DAEMON_PROTOCOL_MAGIC 0x4455444du // "MUDD"
+#define DAEMON_PROTOCOL_VERSION 1
+#define DAEMON_SOCKET_PATH ".muda/daemon.sock"
+#define DAEMON_MAX_ARGUMENTS 256
+#define DAEMON_CACHE_LIMIT MegaBytes(256)
+
+// Options applied when the process starts, they can not change for a single build of the daemon
+static const String DaemonProcessOptions[] = {
+    StringExpand("compiler"),  StringExpand("log"),       StringExpand("logjson"),    StringExpand("nolog"),
+    StringExpand("noplug"),    StringExpand("jobs"),      StringExpand("membudget"),  StringExpand("maxload"),
+    StringExpand("cache"),     StringExpand("serve"),     StringExpand("distribute"), StringExpand("daemon"),
+    StringExpand("benchmark"), StringExpand("stats"),     StringExpand("trace"),
+};
+
+static Uint64 DaemonEnvironmentHash(void)
+{
+    const char *path      = getenv("PATH");
+    Uint64      gcc_clang = CompilerEnvironmentHash(Compiler_Bit_GCC);
+    Uint64      cl        = CompilerEnvironmentHash(Compiler_Bit_CL);
+    Uint64      hash      = StrHash(path ? StringMake(path, strlen(path)) : StringLiteral(""));
+    hash                  = HashBytes(hash, &gcc_clang, sizeof(gcc_clang));
+    return HashBytes(hash, &cl, sizeof(cl));
+}
+
+typedef struct Daemon_File
+{
+    Uint64                Key;  // Working directory and path of the muda file
+    String                Path; // Absolute
+    Uint64                Time; // Modification time of the file when it was parsed
+    Compiler_Config_List *Configs;
+    struct Daemon_File   *Next;
+} Daemon_File;
+
+typedef struct Daemon_Graph
+{
+    Uint64               Key;         // Working directory, name and build directory of the configuration
+    Uint64               SourcesTime; // Modification times of the directories the sources are expanded from
+    bool                 Lowered;     // False until a build completed the graph, or if it can not be kept
+    Build_Graph          Graph;
+    struct Daemon_Graph *Next;
+} Daemon_Graph;
+
+typedef struct Daemon_Cache
+{
+    Memory_Arena  Arena;   // Configurations and graphs, reset when they are dropped
+    Memory_Arena  Build;   // Include scanners and build databases, released after every build of a graph
+    Uint64        Options; // Options of the build they were made for
+    Daemon_File  *Files;
+    Daemon_Graph *Graphs;
+} Daemon_Cache;
+
+static void DaemonCacheCreate(Daemon_Cache *cache)
+{
+    cache->Arena   = MemoryArenaCreate(GigaBytes(1));
+    cache->Build   = MemoryArenaCreate(GigaBytes(1));
+    cache->Options = 0;
+    cache->Files   = NULL;
+    cache->Graphs  = NULL;
+}
+
+static void DaemonCacheDrop(Daemon_Cache *cache)
+{
+    MemoryArenaReset(&cache->Arena);
+    cache->Files  = NULL;
+    cache->Graphs = NULL;
+}
+
+// Called before every build, the previous one may have used other options or the muda files may have been modified
+static void DaemonCacheValidate(Daemon_Cache *cache, int argc, char *argv[])
+{
+    Uint64 options = HASH_SEED;
+    for (int argi = 0; argi < argc; ++argi)
+        options = HashBytes(options, argv[argi], strlen(argv[argi]) + 1);
+
+    bool valid = (options == cache->Options) && cache->Arena.CurrentPos <= DAEMON_CACHE_LIMIT;
+    for (Daemon_File *file = cache->Files; valid && file; file = file->Next)
+        valid = (OsGetFileLastWriteTime(file->Path) == file->Time);
+
+    if (!valid)
+        DaemonCacheDrop(cache);
+    cache->Options = options;
+}
+
+static Uint64 DaemonFileKey(String path)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    Uint64           key     = HashBytes(StrHash(OsGetWorkingDirectory(scratch)), path.Data, path.Length);
+    EndTemporaryMemory(&temp);
+    return key;
+}
+
+// Returns NULL if the file was not parsed by a previous build
+static Compiler_Config_List *DaemonCacheFindConfigs(Daemon_Cache *cache, String path)
+{
+    Uint64 key = DaemonFileKey(path);
+    for (Daemon_File *file = cache->Files; file; file = file->Next)
+    {
+        if (file->Key == key)
+            return file->Configs;
+    }
+    return NULL;
+}
+
+// "configs" must be allocated from the cache
+static void DaemonCacheAddConfigs(Daemon_Cache *cache, String path, Compiler_Config_List *configs)
+{
+    Memory_Arena *arena = &cache->Arena;
+    Daemon_File  *file  = PushType(arena, Daemon_File);
+    file->Key           = DaemonFileKey(path);
+    if (path.Length && path.Data[0] == '/')
+        file->Path = StrDuplicateArena(path, arena);
+    else
+        file->Path = FmtStr(arena, "%s/%s", OsGetWorkingDirectory(arena).Data, path.Data);
+    file->Time    = OsGetFileLastWriteTime(file->Path);
+    file->Configs = configs;
+    file->Next    = cache->Files;
+    cache->Files  = file;
+}
+
+static Daemon_Graph *DaemonCacheFindGraph(Daemon_Cache *cache, Uint64 key)
+{
+    for (Daemon_Graph *graph = cache->Graphs; graph; graph = graph->Next)
+    {
+        if (graph->Key == key)
+            return graph;
+    }
+
+    Daemon_Graph *graph = PushTypeEx(&cache->Arena, Daemon_Graph, Push_Flag_Zero);
+    graph->Key          = key;
+    graph->Next         = cache->Graphs;
+    cache->Graphs       = graph;
+    return graph;
+}
+
+// Returns false if the build has to run in this process: no daemon answered, it refused the request or an option
+// can only be applied by a new process
+static bool DaemonRequestBuild(int argc, char *argv[], int *exit_code)
+{
+    if (argc - 1 > DAEMON_MAX_ARGUMENTS)
+        return false;
+
+    for (int argi = 1; argi < argc; ++argi)
+    {
+        String option = StringMake(argv[argi] + 1, strlen(argv[argi] + 1));
+        for (Uint32 index = 0; argv[argi][0] == '-' && index < ArrayCount(DaemonProcessOptions); ++index)
+        {
+            if (StrMatchCaseInsensitive(option, DaemonProcessOptions[index]))
+                return false;
+        }
+    }
+
+    Os_Socket socket = OsSocketConnectLocal(StringLiteral(DAEMON_SOCKET_PATH));
+    if (socket.PlatformHandle < 0)
+        return false;
+
+    bool sent = RemoteSendUint32(socket, DAEMON_PROTOCOL_MAGIC) && RemoteSendUint32(socket, DAEMON_PROTOCOL_VERSION) &&
+                RemoteSendUint64(socket, DaemonEnvironmentHash()) && RemoteSendUint32(socket, (Uint32)(argc - 1));
+    for (int argi = 1; sent && argi < argc; ++argi)
+        sent = RemoteSendString(socket, StringMake(argv[argi], strlen(argv[argi])));
+    sent = sent && OsConsoleSend(socket);
+
+    Uint32 magic = 0, accepted = 0, code = 0;
+    bool   built = sent && RemoteReceiveUint32(socket, &magic) && magic == DAEMON_PROTOCOL_MAGIC &&
+                 RemoteReceiveUint32(socket, &accepted) && accepted;
+    if (built && !RemoteReceiveUint32(socket, &code))
+        code = 1; // The daemon exited during the build
+
+    OsSocketClose(socket);
+    *exit_code = (int)code;
+    return built;
+}
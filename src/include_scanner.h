@@ -0,0 +1,962 @@
+#pragma once
+
+#include "build_graph.h"
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+
+//
+// Include scanner
+// Finds the headers included by the sources without running the compiler, so that the dirty check knows them when
+// the compiler wrote no dependency file (CL, or an object that was never compiled by Muda) and so that compilations
+// wait for the actions generating the headers they include. The #include directives of every file are tokenized
+// without evaluating the conditionals, the headers of every branch are listed. Names are looked up the way the
+// compilers do: the directory of the including file for quoted names, then the -iquote and -I directories. Headers
+// not found there are system headers, they are only tracked through the dependency file (-MD).
+// A source including a macro ("#include HEADER") can not be followed, its dirty check uses the dependency file only.
+// The C++20 module declarations and imports ("export module m;", "import m;", "import :part;") are listed as well,
+// they order the compilations of the modules (modules.h).
+// The directives are kept in "BuildDirectory/<Build>.muda.inc" with the modification time of the file, only the
+// files modified since the previous build are read again, on the worker threads.
+//
+// Stored as text, a line per file followed by a line per directive that starts with a tab:
+// <modification time> <complete> <path>
+// <tab><kind><name>
+//
+
+// The value is the character written before the name in the cache
+typedef enum Include_Directive_Kind
+{
+    Include_Directive_Quoted    = '"', // #include "name"
+    Include_Directive_Angled    = '<', // #include <name>
+    Include_Directive_Module    = 'm', // Module or partition whose interface is compiled from the unit
+    Include_Directive_Partition = 'p', // Internal partition compiled from the unit, "module m:part;"
+    Include_Directive_Import    = 'i', // Module or partition imported by the unit, partitions are qualified by the module
+} Include_Directive_Kind;
+
+typedef struct Include_Directive
+{
+    String                 Name;
+    Include_Directive_Kind Kind;
+} Include_Directive;
+
+typedef enum Include_File_State
+{
+    Include_File_Unchecked, // Loaded from the previous build or just added, the file was not looked at yet
+    Include_File_Missing,
+    Include_File_Queued,    // Modified since its directives were read, they are read again
+    Include_File_Ready,     // Directives are up to date
+} Include_File_State;
+
+typedef struct Include_File
+{
+    String                Path;
+    Uint64                Time; // Modification time of the file when its directives were read
+    Include_File_State    State;
+    bool                  Complete; // False if a directive names a macro, or the file could not be read
+    Include_Directive    *Directives;
+    Uint32                DirectiveCount;
+
+    struct Include_File **Includes; // Headers found for the directives, only set for the current build
+    Uint32                IncludeCount;
+    bool                  Resolved;
+    Build_Node           *Producer; // Action writing the header, NULL for files of the source tree
+    Uint32                Visit;
+
+    struct Include_File  *Next;
+    struct Include_File  *NextPending; // Files to resolve or to read, only used by the thread running the scan
+} Include_File;
+
+typedef struct Include_Resolution
+{
+    Uint64        Key;  // Name of the header, and directory of the including file for quoted names, never 0
+    Include_File *File; // NULL if the header was not found
+} Include_Resolution;
+
+typedef struct Include_Scanner
+{
+    String              Path;
+    Include_File       *First;
+    Include_File      **Table;
+    Uint32              TableSize;
+    Uint32              Count;
+    bool                Changed;
+
+    Include_Resolution *Resolutions;
+    Uint32              ResolutionTableSize;
+    Uint32              ResolutionCount;
+
+    // Directories searched for the headers, the first QuoteDirectoryCount ones only for quoted names (-iquote)
+    String             *Directories;
+    Uint32              DirectoryCount;
+    Uint32              QuoteDirectoryCount;
+
+    Memory_Arena       *Arena;
+    Shared_Arena       *Shared; // Directives read by the worker threads are allocated from it, NULL to read serially
+} Include_Scanner;
+
+// Joins "dir" and "name" removing the "." components and folding "dir/..", so that every file has a single path
+static String IncludePathJoin(String dir, String name, Memory_Arena *arena)
+{
+    bool absolute = (name.Length && (name.Data[0] == '/' || name.Data[0] == '\\')) ||
+                    (name.Length > 1 && name.Data[1] == ':');
+    if (absolute)
+        dir = StringLiteral("");
+
+    Uint8 *path   = PushSize(arena, dir.Length + name.Length + 2);
+    Int64  length = 0;
+    Int64  root   = 0; // Components before it can not be folded
+    for (Uint32 part = 0; part < 2; ++part)
+    {
+        String str = part ? name : dir;
+        Int64  pos = 0;
+        while (pos < str.Length)
+        {
+            Int64 end = pos;
+            while (end < str.Length && str.Data[end] != '/' && str.Data[end] != '\\')
+                end += 1;
+            String component = StringMake(str.Data + pos, end - pos);
+            pos              = end + 1;
+
+            if (component.Length == 0 && end == 0 && length == 0)
+            {
+                path[length++] = '/';
+                root           = length;
+                continue;
+            }
+            if (component.Length == 0 || StrMatch(component, StringLiteral(".")))
+                continue;
+
+            if (StrMatch(component, StringLiteral("..")))
+            {
+                Int64  last     = length;
+                while (last > root && path[last - 1] != '/')
+                    last -= 1;
+                String previous = StringMake(path + last, length - last);
+                if (length > root && !StrMatch(previous, StringLiteral("..")))
+                {
+                    length = (last > root) ? last - 1 : root;
+                    continue;
+                }
+                if (root)
+                    continue;
+            }
+
+            if (length && path[length - 1] != '/')
+                path[length++] = '/';
+            memcpy(path + length, component.Data, component.Length);
+            length += component.Length;
+            if (length == component.Length && component.Data[component.Length - 1] == ':')
+                root = length;
+        }
+    }
+
+    path[length] = 0;
+    return StringMake(path, length);
+}
+
+// Directory of the file without the trailing separator, empty for files of the working directory
+INLINE_PROCEDURE String IncludeDirectoryOf(String path)
+{
+    Int64 pos = StrReverseFindCharacter(path, '/', path.Length - 1);
+    return StringMake(path.Data, pos < 0 ? 0 : pos);
+}
+
+INLINE_PROCEDURE Include_File **IncludeScannerSlot(Include_Scanner *scanner, String path)
+{
+    Uint32 slot = (Uint32)StrHash(path);
+    for (;; ++slot)
+    {
+        Include_File **entry = &scanner->Table[slot & (scanner->TableSize - 1)];
+        if (*entry == NULL || StrMatch((*entry)->Path, path))
+            return entry;
+    }
+}
+
+static void IncludeScannerRehash(Include_Scanner *scanner, Uint32 table_size)
+{
+    scanner->TableSize = table_size;
+    scanner->Table     = PushArrayZero(scanner->Arena, Include_File *, table_size);
+    for (Include_File *file = scanner->First; file; file = file->Next)
+        *IncludeScannerSlot(scanner, file->Path) = file;
+}
+
+// "path" must be normalized, it is copied if the file is not known yet
+static Include_File *IncludeScannerAdd(Include_Scanner *scanner, String path)
+{
+    Include_File **slot = IncludeScannerSlot(scanner, path);
+    if (*slot)
+        return *slot;
+
+    if ((scanner->Count + 1) * 2 > scanner->TableSize)
+    {
+        IncludeScannerRehash(scanner, scanner->TableSize * 2);
+        slot = IncludeScannerSlot(scanner, path);
+    }
+
+    Include_File *file   = PushTypeZero(scanner->Arena, Include_File);
+    file->Path           = StrDuplicateArena(path, scanner->Arena);
+    file->State          = Include_File_Unchecked;
+    file->Next           = scanner->First;
+    scanner->First       = file;
+    scanner->Count += 1;
+    *slot = file;
+    return file;
+}
+
+INLINE_PROCEDURE void *IncludeScannerPush(Include_Scanner *scanner, Ptrsize size)
+{
+    if (scanner->Shared)
+        return SharedArenaPush(scanner->Shared, size);
+    return PushSize(scanner->Arena, size);
+}
+
+// A missing or unreadable file is treated as empty, every file is then read again
+static void IncludeScannerLoad(Include_Scanner *scanner, String path, Memory_Arena *arena, Shared_Arena *shared)
+{
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->Path   = StrDuplicateArena(path, arena);
+    scanner->Arena  = arena;
+    scanner->Shared = shared;
+    IncludeScannerRehash(scanner, 256);
+
+    scanner->ResolutionTableSize = 256;
+    scanner->Resolutions         = PushArrayZero(arena, Include_Resolution, scanner->ResolutionTableSize);
+
+    File_Handle handle           = OsFileOpen(path, File_Mode_Read);
+    if (!handle.PlatformFileHandle)
+        return;
+
+    Ptrsize size = OsFileGetSize(handle);
+    Uint8  *data = PushSize(arena, size + 1);
+    bool    read = size && OsFileRead(handle, data, size);
+    OsFileClose(handle);
+    if (!read)
+        return;
+
+    Include_File *file     = NULL;
+    Uint32        expected = 0;
+    String        content  = StringMake(data, size);
+    while (content.Length)
+    {
+        Int64  line_end = StrFindCharacter(content, '\n', 0);
+        String line     = StringMake(content.Data, line_end < 0 ? content.Length : line_end);
+        content         = StrRemovePrefix(content, line_end < 0 ? content.Length : line_end + 1);
+        if (line.Length && line.Data[line.Length - 1] == '\r')
+            line.Length -= 1;
+        line.Data[line.Length] = 0;
+
+        if (StrStartsWithCharacter(line, '\t'))
+        {
+            Uint8 kind = (line.Length < 3) ? 0 : line.Data[1];
+            if (!file || file->DirectiveCount == expected ||
+                (kind != Include_Directive_Quoted && kind != Include_Directive_Angled &&
+                 kind != Include_Directive_Module && kind != Include_Directive_Partition &&
+                 kind != Include_Directive_Import))
+                continue;
+            Include_Directive *directive = &file->Directives[file->DirectiveCount++];
+            directive->Kind              = (Include_Directive_Kind)kind;
+            directive->Name              = StrRemovePrefix(line, 2);
+            continue;
+        }
+
+        file         = NULL;
+        Int64 second = StrFindCharacter(line, '\t', 0);
+        Int64 third  = (second < 0) ? -1 : StrFindCharacter(line, '\t', second + 1);
+        if (third < 0)
+            continue;
+
+        String file_path = StrRemovePrefix(line, third + 1);
+        if (!file_path.Length || *IncludeScannerSlot(scanner, file_path))
+            continue;
+
+        // The directives of the file are on the lines that follow
+        expected         = 0;
+        String following = content;
+        while (StrStartsWithCharacter(following, '\t'))
+        {
+            Int64 next = StrFindCharacter(following, '\n', 0);
+            following  = StrRemovePrefix(following, next < 0 ? following.Length : next + 1);
+            expected += 1;
+        }
+
+        file                 = IncludeScannerAdd(scanner, file_path);
+        file->Time           = strtoull((char *)line.Data, NULL, 16);
+        file->Complete       = (line.Data[second + 1] == '1');
+        file->Directives     = PushArray(arena, Include_Directive, expected);
+        file->DirectiveCount = 0;
+    }
+}
+
+static bool IncludeScannerSave(Include_Scanner *scanner)
+{
+    // Files that were not reached by this build are dropped
+    for (Include_File *file = scanner->First; file && !scanner->Changed; file = file->Next)
+        scanner->Changed = (file->State == Include_File_Unchecked);
+    if (!scanner->Changed)
+        return true;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Out_Stream       out;
+    OutCreate(&out, MemoryArenaAllocator(scratch));
+
+    for (Include_File *file = scanner->First; file; file = file->Next)
+    {
+        if (file->State != Include_File_Ready)
+            continue;
+
+        char line[32];
+        int  length = snprintf(line, sizeof(line), "%016llx\t%u\t", (unsigned long long)file->Time,
+                               (unsigned)file->Complete);
+        OutBuffer(&out, line, length);
+        OutString(&out, file->Path);
+        OutBuffer(&out, "\n", 1);
+
+        for (Uint32 index = 0; index < file->DirectiveCount; ++index)
+        {
+            char prefix[2] = {'\t', (char)file->Directives[index].Kind};
+            OutBuffer(&out, prefix, 2);
+            OutString(&out, file->Directives[index].Name);
+            OutBuffer(&out, "\n", 1);
+        }
+    }
+
+    bool        result = false;
+    File_Handle handle = OsFileOpen(scanner->Path, File_Mode_Write);
+    if (handle.PlatformFileHandle)
+    {
+        result = OutWriteFile(&out, handle);
+        OsFileClose(handle);
+    }
+
+    if (result)
+        scanner->Changed = false;
+    else
+        LogWarn("Could not write include scanner cache %s\n", scanner->Path.Data);
+
+    EndTemporaryMemory(&temp);
+
+    return result;
+}
+
+//
+// Tokenizer
+//
+
+INLINE_PROCEDURE bool IncludeIsIdentifier(Uint8 ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+// Skips the white spaces, comments and escaped new lines, stops at the end of the line
+static Ptrsize IncludeSkipSpaces(const Uint8 *data, Ptrsize size, Ptrsize pos)
+{
+    while (pos < size)
+    {
+        Uint8 ch   = data[pos];
+        Uint8 next = (pos + 1 < size) ? data[pos + 1] : 0;
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v')
+        {
+            pos += 1;
+        }
+        else if (ch == '\\' && (next == '\n' || next == '\r'))
+        {
+            pos += (next == '\r' && pos + 2 < size && data[pos + 2] == '\n') ? 3 : 2;
+        }
+        else if (ch == '/' && next == '*')
+        {
+            pos += 2;
+            while (pos + 1 < size && !(data[pos] == '*' && data[pos + 1] == '/'))
+                pos += 1;
+            pos = Minimum(pos + 2, size);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return pos;
+}
+
+typedef struct Include_Directive_List
+{
+    Include_Directive *Directives;
+    Uint32             Count;
+    Uint32             Capacity;
+} Include_Directive_List;
+
+static void IncludeDirectiveAdd(Include_Directive_List *list, String name, Include_Directive_Kind kind,
+                                Memory_Arena *arena)
+{
+    if (list->Count == list->Capacity)
+    {
+        list->Capacity           = list->Capacity ? list->Capacity * 2 : 64;
+        Include_Directive *grown = PushArray(arena, Include_Directive, list->Capacity);
+        if (list->Count)
+            memcpy(grown, list->Directives, list->Count * sizeof(*grown));
+        list->Directives = grown;
+    }
+    list->Directives[list->Count].Name = name;
+    list->Directives[list->Count].Kind = kind;
+    list->Count += 1;
+}
+
+// Reads a header name, "name" or <name>, returns the position after it or "pos" if there is none
+static Ptrsize IncludeReadHeaderName(const Uint8 *data, Ptrsize size, Ptrsize pos, Include_Directive_List *list,
+                                     Memory_Arena *arena)
+{
+    if (pos == size || (data[pos] != '"' && data[pos] != '<'))
+        return pos;
+
+    Uint8   close = (data[pos] == '"') ? '"' : '>';
+    Ptrsize start = pos + 1;
+    Ptrsize end   = start;
+    while (end < size && data[end] != close && data[end] != '\n')
+        end += 1;
+    if (end == size || data[end] != close || end == start)
+        return pos;
+
+    IncludeDirectiveAdd(list, StringMake(data + start, end - start),
+                        close == '"' ? Include_Directive_Quoted : Include_Directive_Angled, arena);
+    return end + 1;
+}
+
+INLINE_PROCEDURE Ptrsize IncludeReadIdentifier(const Uint8 *data, Ptrsize size, Ptrsize pos, String *identifier)
+{
+    Ptrsize start = pos;
+    while (pos < size && IncludeIsIdentifier(data[pos]))
+        pos += 1;
+    *identifier = StringMake(data + start, pos - start);
+    return pos;
+}
+
+// Returns the #include directives and the module declarations of the file, allocated from "arena" with their names
+static Uint32 IncludeScanDirectives(const Uint8 *data, Ptrsize size, Include_Directive **directives, bool *complete,
+                                    Memory_Arena *arena)
+{
+    Include_Directive_List list;
+    list.Directives    = NULL;
+    list.Count         = 0;
+    list.Capacity      = 0;
+
+    String  module     = StringLiteral(""); // Module of the unit, qualifies the imported partitions
+    bool    line_start = true;
+    Ptrsize pos        = 0;
+
+    *complete          = true;
+
+    while (pos < size)
+    {
+        Ptrsize skipped = IncludeSkipSpaces(data, size, pos);
+        if (skipped != pos)
+        {
+            pos = skipped;
+            continue;
+        }
+
+        Uint8 ch   = data[pos];
+        Uint8 next = (pos + 1 < size) ? data[pos + 1] : 0;
+        if (ch == '\n')
+        {
+            line_start = true;
+            pos += 1;
+        }
+        else if (ch == '/' && next == '/')
+        {
+            while (pos < size && data[pos] != '\n')
+                pos += (data[pos] == '\\' && pos + 1 < size) ? 2 : 1;
+        }
+        else if (ch == '"' || ch == '\'')
+        {
+            // Comments are not started in string and character literals
+            pos += 1;
+            while (pos < size && data[pos] != ch && data[pos] != '\n')
+                pos += (data[pos] == '\\' && pos + 1 < size) ? 2 : 1;
+            if (pos < size && data[pos] == ch)
+                pos += 1;
+            line_start = false;
+        }
+        else if (ch == '#' && line_start)
+        {
+            line_start = false;
+
+            String keyword;
+            pos = IncludeReadIdentifier(data, size, IncludeSkipSpaces(data, size, pos + 1), &keyword);
+            if (!StrMatch(keyword, StringLiteral("include")) && !StrMatch(keyword, StringLiteral("include_next")) &&
+                !StrMatch(keyword, StringLiteral("import")))
+                continue;
+
+            pos          = IncludeSkipSpaces(data, size, pos);
+            Ptrsize name = IncludeReadHeaderName(data, size, pos, &list, arena);
+            if (name == pos && pos < size && IncludeIsIdentifier(data[pos]))
+                *complete = false;
+            pos = name;
+        }
+        else if (IncludeIsIdentifier(ch) && line_start)
+        {
+            // Module declarations and imports start a line and end with a semicolon:
+            // [export] module name[:partition]; and [export] import name; import :partition; import <header>;
+            line_start = false;
+
+            String keyword;
+            pos           = IncludeReadIdentifier(data, size, pos, &keyword);
+            bool exported = StrMatch(keyword, StringLiteral("export"));
+            if (exported)
+                pos = IncludeReadIdentifier(data, size, IncludeSkipSpaces(data, size, pos), &keyword);
+
+            bool declaration = StrMatch(keyword, StringLiteral("module"));
+            if (!declaration && !StrMatch(keyword, StringLiteral("import")))
+                continue;
+
+            pos = IncludeSkipSpaces(data, size, pos);
+            if (!declaration)
+            {
+                Ptrsize name = IncludeReadHeaderName(data, size, pos, &list, arena);
+                if (name != pos)
+                {
+                    pos = name;
+                    continue;
+                }
+            }
+
+            Ptrsize start = pos;
+            while (pos < size && (IncludeIsIdentifier(data[pos]) || data[pos] == '.' || data[pos] == ':'))
+                pos += 1;
+            String  name = StringMake(data + start, pos - start);
+            Ptrsize end  = IncludeSkipSpaces(data, size, pos);
+            if (!name.Length || end == size || data[end] != ';')
+                continue; // "module;" starts the global module fragment
+            pos = end + 1;
+
+            Int64 partition = StrFindCharacter(name, ':', 0);
+            if (declaration)
+            {
+                // Implementation units import the interface of their module, partitions have their own interface
+                Include_Directive_Kind kind = Include_Directive_Import;
+                if (exported)
+                    kind = Include_Directive_Module;
+                else if (partition >= 0)
+                    kind = Include_Directive_Partition;
+                module = StringMake(name.Data, partition < 0 ? name.Length : partition);
+                IncludeDirectiveAdd(&list, name, kind, arena);
+            }
+            else
+            {
+                if (partition == 0)
+                    name = StrConcatArena(module, name, arena);
+                IncludeDirectiveAdd(&list, name, Include_Directive_Import, arena);
+            }
+        }
+        else
+        {
+            line_start = false;
+            pos += 1;
+        }
+    }
+
+    *directives = list.Directives;
+    return list.Count;
+}
+
+// Reads the directives of the file, called by the worker threads
+static void IncludeScanFile(Include_Scanner *scanner, Include_File *file)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    file->Complete           = false;
+    file->Directives         = NULL;
+    file->DirectiveCount     = 0;
+
+    File_Handle handle       = OsFileOpen(file->Path, File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize size = OsFileGetSize(handle);
+        Uint8  *data = PushSize(scratch, size + 1);
+        bool    read = (size == 0) || OsFileRead(handle, data, size);
+        OsFileClose(handle);
+
+        if (read)
+        {
+            Include_Directive *directives;
+            bool               complete;
+            Uint32             count = IncludeScanDirectives(data, size, &directives, &complete, scratch);
+
+            Ptrsize            bytes = count * sizeof(Include_Directive);
+            for (Uint32 index = 0; index < count; ++index)
+                bytes += directives[index].Name.Length + 1;
+
+            Uint8 *memory = bytes ? (Uint8 *)IncludeScannerPush(scanner, bytes) : NULL;
+            if (memory || !count)
+            {
+                file->Directives = (Include_Directive *)memory;
+                Uint8 *names     = memory + count * sizeof(Include_Directive);
+                for (Uint32 index = 0; index < count; ++index)
+                {
+                    String name = directives[index].Name;
+                    memcpy(names, name.Data, name.Length);
+                    names[name.Length]                  = 0;
+                    file->Directives[index].Name        = StringMake(names, name.Length);
+                    file->Directives[index].Kind        = directives[index].Kind;
+                    names += name.Length + 1;
+                }
+                file->DirectiveCount = count;
+                file->Complete       = complete;
+            }
+        }
+    }
+
+    file->State = Include_File_Ready;
+
+    EndTemporaryMemory(&temp);
+}
+
+typedef struct Include_Scan_Job
+{
+    Include_Scanner *Scanner;
+    Include_File    *File;
+    Os_Semaphore     Done;
+} Include_Scan_Job;
+
+static void IncludeScanJob(void *data)
+{
+    Include_Scan_Job *job = (Include_Scan_Job *)data;
+    IncludeScanFile(job->Scanner, job->File);
+    OsSemaphoreSignal(job->Done, 1);
+}
+
+//
+// Resolution
+//
+
+// Returns the file if it exists or is written by an action, the files modified since their directives were read are
+// added to "queue"
+static Include_File *IncludeScannerCheck(Include_Scanner *scanner, String path, Include_File **pending,
+                                         Include_File **queue)
+{
+    Include_File *file = *IncludeScannerSlot(scanner, path);
+    if (!file)
+        file = IncludeScannerAdd(scanner, path);
+
+    if (file->State == Include_File_Unchecked)
+    {
+        Uint64 time = OsGetFileLastWriteTime(file->Path);
+        if (time == 0)
+        {
+            scanner->Changed |= (file->Time != 0);
+            file->State       = Include_File_Missing;
+            file->Time        = 0;
+        }
+        else if (time == file->Time)
+        {
+            file->State       = Include_File_Ready;
+            file->NextPending = *pending;
+            *pending          = file;
+        }
+        else
+        {
+            file->Time        = time;
+            file->State       = Include_File_Queued;
+            file->NextPending = *queue;
+            *queue            = file;
+        }
+    }
+
+    if (file->State == Include_File_Missing && !file->Producer)
+        return NULL;
+    return file;
+}
+
+static Include_File *IncludeScannerLookup(Include_Scanner *scanner, Include_File *includer,
+                                          Include_Directive *directive, Include_File **pending, Include_File **queue)
+{
+    String dir = IncludeDirectoryOf(includer->Path);
+    bool   angled = (directive->Kind == Include_Directive_Angled);
+    Uint64 key    = HashBytes(StrHash(directive->Name), angled ? "<" : "\"", 1);
+    if (!angled)
+        key = HashBytes(key, dir.Data, dir.Length);
+    key |= 1;
+
+    Uint32 mask = scanner->ResolutionTableSize - 1;
+    Uint32 slot = (Uint32)key & mask;
+    while (scanner->Resolutions[slot].Key && scanner->Resolutions[slot].Key != key)
+        slot = (slot + 1) & mask;
+    if (scanner->Resolutions[slot].Key)
+        return scanner->Resolutions[slot].File;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Include_File    *found   = NULL;
+    if (!angled)
+        found = IncludeScannerCheck(scanner, IncludePathJoin(dir, directive->Name, scratch), pending, queue);
+
+    Uint32 first = angled ? scanner->QuoteDirectoryCount : 0;
+    for (Uint32 index = first; !found && index < scanner->DirectoryCount; ++index)
+    {
+        String path = IncludePathJoin(scanner->Directories[index], directive->Name, scratch);
+        found       = IncludeScannerCheck(scanner, path, pending, queue);
+    }
+
+    EndTemporaryMemory(&temp);
+
+    if ((scanner->ResolutionCount + 1) * 2 > scanner->ResolutionTableSize)
+    {
+        Include_Resolution *previous = scanner->Resolutions;
+        Uint32              size     = scanner->ResolutionTableSize;
+        scanner->ResolutionTableSize = size * 2;
+        scanner->Resolutions         = PushArrayZero(scanner->Arena, Include_Resolution, size * 2);
+        mask                         = size * 2 - 1;
+        for (Uint32 index = 0; index < size; ++index)
+        {
+            if (!previous[index].Key)
+                continue;
+            Uint32 rehashed = (Uint32)previous[index].Key & mask;
+            while (scanner->Resolutions[rehashed].Key)
+                rehashed = (rehashed + 1) & mask;
+            scanner->Resolutions[rehashed] = previous[index];
+        }
+        slot = (Uint32)key & mask;
+        while (scanner->Resolutions[slot].Key)
+            slot = (slot + 1) & mask;
+    }
+
+    scanner->Resolutions[slot].Key  = key;
+    scanner->Resolutions[slot].File = found;
+    scanner->ResolutionCount += 1;
+    return found;
+}
+
+static void IncludeFileResolve(Include_Scanner *scanner, Include_File *file, Include_File **pending,
+                               Include_File **queue)
+{
+    file->Resolved     = true;
+    file->IncludeCount = 0;
+    file->Includes     = PushArray(scanner->Arena, Include_File *, file->DirectiveCount);
+    for (Uint32 index = 0; index < file->DirectiveCount; ++index)
+    {
+        Include_Directive_Kind kind = file->Directives[index].Kind;
+        if (kind != Include_Directive_Quoted && kind != Include_Directive_Angled)
+            continue;
+        Include_File *header = IncludeScannerLookup(scanner, file, &file->Directives[index], pending, queue);
+        if (header)
+            file->Includes[file->IncludeCount++] = header;
+    }
+}
+
+// Reads the directives of the queued files, on the worker threads when there are several
+static void IncludeScannerRead(Include_Scanner *scanner, Include_File *queue, Thread_Pool *pool)
+{
+    Uint32 count = 0;
+    for (Include_File *file = queue; file; file = file->NextPending)
+        count += 1;
+
+    if (!pool || !scanner->Shared || count == 1)
+    {
+        for (Include_File *file = queue; file; file = file->NextPending)
+            IncludeScanFile(scanner, file);
+        return;
+    }
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Os_Semaphore     done    = OsSemaphoreCreate(0);
+    Include_Scan_Job *jobs   = PushArray(scratch, Include_Scan_Job, count);
+    Uint32           index   = 0;
+    for (Include_File *file = queue; file; file = file->NextPending, ++index)
+    {
+        jobs[index].Scanner = scanner;
+        jobs[index].File    = file;
+        jobs[index].Done    = done;
+        ThreadPoolSubmit(pool, IncludeScanJob, &jobs[index]);
+    }
+
+    // The calling thread reads files as well until the queue is empty
+    while (ThreadPoolRunNext(pool))
+        ;
+    for (index = 0; index < count; ++index)
+        OsSemaphoreWait(done);
+    OsSemaphoreDestroy(done);
+
+    EndTemporaryMemory(&temp);
+}
+
+// The compile nodes of a graph share their options, the directories are taken from the first one
+static void IncludeScannerSetDirectories(Include_Scanner *scanner, Build_Node *node)
+{
+    Uint32 arg_count = 0;
+    ForList(String_List_Node, &node->Argv)
+    {
+        ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+        {
+            arg_count += 1;
+        }
+    }
+
+    scanner->Directories         = PushArray(scanner->Arena, String, arg_count);
+    scanner->DirectoryCount      = 0;
+    scanner->QuoteDirectoryCount = 0;
+
+    // Quoted names are looked up in the -iquote directories first, the value of the options may be the next argument
+    for (Uint32 pass = 0; pass < 2; ++pass)
+    {
+        String prefix     = pass ? StringLiteral("-I") : StringLiteral("-iquote");
+        bool   value_next = false;
+        ForList(String_List_Node, &node->Argv)
+        {
+            ForListNode(&node->Argv, MAX_STRING_NODE_DATA_COUNT)
+            {
+                String arg   = it->Data[index];
+                String value = StringLiteral("");
+                if (value_next)
+                    value = arg;
+                else if (StrStartsWith(arg, prefix))
+                    value = StrRemovePrefix(arg, prefix.Length);
+                else if (pass && StrStartsWith(arg, StringLiteral("/I")))
+                    value = StrRemovePrefix(arg, 2);
+                value_next = !value_next && arg.Length && !value.Length &&
+                             (StrMatch(arg, prefix) || (pass && StrMatch(arg, StringLiteral("/I"))));
+                if (value.Length)
+                    scanner->Directories[scanner->DirectoryCount++] =
+                        IncludePathJoin(value, StringLiteral(""), scanner->Arena);
+            }
+        }
+        if (!pass)
+            scanner->QuoteDirectoryCount = scanner->DirectoryCount;
+    }
+}
+
+// Finds the headers included by every compile node, makes the compilations depend on the actions writing the headers
+// they include, and sets the header fields of the compile nodes read by BuildGraphEvaluate
+static void IncludeScannerRun(Include_Scanner *scanner, Build_Graph *graph, Thread_Pool *pool)
+{
+    Build_Node *first = graph->First;
+    while (first && first->Kind != Build_Node_Compile)
+        first = first->Next;
+    if (!first)
+        return;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    IncludeScannerSetDirectories(scanner, first);
+
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        if (node->Kind == Build_Node_Compile)
+            continue;
+        ForList(String_List_Node, &node->Outputs)
+        {
+            ForListNode(&node->Outputs, MAX_STRING_NODE_DATA_COUNT)
+            {
+                String path = IncludePathJoin(StringLiteral(""), it->Data[index], scratch);
+                IncludeScannerAdd(scanner, path)->Producer = node;
+            }
+        }
+    }
+
+    // Files are resolved once their directives are known, the included files that changed are read in waves
+    Include_File *pending = NULL;
+    Include_File *queue   = NULL;
+    for (Build_Node *node = first; node; node = node->Next)
+    {
+        if (node->Kind == Build_Node_Compile)
+        {
+            String path = IncludePathJoin(StringLiteral(""), BuildNodeFirstInput(node), scratch);
+            IncludeScannerCheck(scanner, path, &pending, &queue);
+        }
+    }
+
+    for (;;)
+    {
+        while (pending)
+        {
+            Include_File *file = pending;
+            pending            = file->NextPending;
+            if (!file->Resolved)
+                IncludeFileResolve(scanner, file, &pending, &queue);
+        }
+
+        if (!queue)
+            break;
+
+        scanner->Changed = true;
+        IncludeScannerRead(scanner, queue, pool);
+        pending = queue;
+        queue   = NULL;
+    }
+
+    Include_File **stack = PushArray(scratch, Include_File *, scanner->Count);
+    for (Include_File *file = scanner->First; file; file = file->Next)
+        file->Visit = 0;
+
+    for (Build_Node *node = first; node; node = node->Next)
+    {
+        if (node->Kind != Build_Node_Compile)
+            continue;
+
+        // Graphs kept by the daemon were scanned by the previous builds
+        node->HeadersScanned = false;
+        node->HeaderTime     = 0;
+        node->Header         = StringLiteral("");
+
+        String        path   = IncludePathJoin(StringLiteral(""), BuildNodeFirstInput(node), scratch);
+        Include_File *root   = *IncludeScannerSlot(scanner, path);
+        if (!root || root->State != Include_File_Ready)
+            continue;
+
+        Uint32        visit    = node->Id + 1;
+        bool          complete = true;
+        Uint64        newest   = 0;
+        Include_File *header   = NULL;
+        Uint32        top      = 0;
+        stack[top++]           = root;
+        root->Visit            = visit;
+        while (top)
+        {
+            Include_File *file = stack[--top];
+            if (file->State == Include_File_Ready)
+                complete &= file->Complete;
+
+            if (file != root)
+            {
+                // Headers not written yet by their action are reported as the newest
+                Uint64 time = file->Time ? file->Time : UINT64_MAX;
+                if (time > newest)
+                {
+                    newest = time;
+                    header = file;
+                }
+
+                // Nodes only depend on the nodes added before them, so no cycle is made
+                Build_Node     *producer = file->Producer;
+                Build_Node_Ref *dep      = node->Deps;
+                while (producer && dep && dep->Node != producer)
+                    dep = dep->Next;
+                if (producer && !dep && producer->Id < node->Id)
+                    BuildNodeAddDependency(graph, node, producer);
+            }
+
+            for (Uint32 index = 0; index < file->IncludeCount; ++index)
+            {
+                if (file->Includes[index]->Visit != visit)
+                {
+                    file->Includes[index]->Visit = visit;
+                    stack[top++]                 = file->Includes[index];
+                }
+            }
+        }
+
+        node->HeadersScanned = complete;
+        node->HeaderTime     = newest;
+        node->Header         = header ? header->Path : StringLiteral("");
+    }
+
+    EndTemporaryMemory(&temp);
+}
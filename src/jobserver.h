@@ -0,0 +1,91 @@
+#pragma once
+
+#include "config.h"
+#include "lenstring.h"
+#include "os.h"
+
+#include <stdlib.h>
+
+//
+// Jobserver
+// Started by make with a jobserver (MAKEFLAGS contains --jobserver-auth), every action run beyond the first one takes
+// a token from it, so that the whole process tree stays under the job count given to the top level make.
+// Otherwise muda is the top level: it creates a jobserver with a token for every job beyond the first one and exports
+// it in MAKEFLAGS, where make, muda or gcc -flto=jobserver run by the actions, Prebuild and Postbuild find it.
+//
+
+// Value of the last --jobserver-auth of MAKEFLAGS (--jobserver-fds before make 4.2), empty if there is none
+// Only the options are read, the variables set on the make command line follow a lone "--"
+static String JobserverFindAuth(String makeflags)
+{
+    static const String prefixes[] = {StringExpand("--jobserver-auth="), StringExpand("--jobserver-fds=")};
+
+    String auth  = StringLiteral("");
+    Uint32 found = ArrayCount(prefixes);
+    for (Int64 pos = 0; pos < makeflags.Length;)
+    {
+        while (pos < makeflags.Length && (makeflags.Data[pos] == ' ' || makeflags.Data[pos] == '\t'))
+            pos += 1;
+        Int64 start = pos;
+        while (pos < makeflags.Length && makeflags.Data[pos] != ' ' && makeflags.Data[pos] != '\t')
+            pos += 1;
+
+        String word = StringMake(makeflags.Data + start, pos - start);
+        if (StrMatch(word, StringLiteral("--")))
+            break;
+
+        for (Uint32 index = 0; index < ArrayCount(prefixes) && index <= found; ++index)
+        {
+            if (StrStartsWith(word, prefixes[index]))
+            {
+                auth  = StrRemovePrefix(word, prefixes[index].Length);
+                found = index;
+                break;
+            }
+        }
+    }
+    return auth;
+}
+
+// Sets build_config->Jobserver, used when the actions are run by several worker threads
+static void JobserverCreate(Build_Config *build_config)
+{
+    const char *makeflags = getenv("MAKEFLAGS");
+    String      flags     = makeflags ? StringMake(makeflags, strlen(makeflags)) : StringLiteral("");
+    String      auth      = JobserverFindAuth(flags);
+
+    if (auth.Length)
+    {
+        char value[256];
+        snprintf(value, sizeof(value), "%.*s", (int)auth.Length, auth.Data);
+        build_config->Jobserver = OsJobserverConnect(StringMake(value, strlen(value)));
+        if (build_config->Jobserver.PlatformHandle)
+            LogInfo("Sharing the job slots of the jobserver %s\n", value);
+        else
+            LogWarn("Jobserver %s of MAKEFLAGS is not available, is the muda command prefixed with '+'?\n", value);
+        return;
+    }
+
+    char value[64];
+    build_config->Jobserver = OsJobserverCreate(build_config->Jobs - 1, value, sizeof(value));
+    if (!build_config->Jobserver.PlatformHandle)
+    {
+        LogWarn("Could not create a jobserver, the child processes do not share the job slots\n");
+        return;
+    }
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    String exported = FmtStr(scratch, "%s%s-j%u --jobserver-auth=%s", makeflags ? makeflags : "",
+                             flags.Length ? " " : "", build_config->Jobs, value);
+    OsSetEnvironmentVariable("MAKEFLAGS", (const char *)exported.Data);
+    EndTemporaryMemory(&temp);
+}
+
+static void JobserverDestroy(Build_Config *build_config)
+{
+    if (!build_config->Jobserver.PlatformHandle)
+        return;
+    OsJobserverDestroy(build_config->Jobserver);
+    build_config->Jobserver.PlatformHandle = NULL;
+}
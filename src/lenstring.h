@@ -26,13 +26,18 @@ typedef struct String_List
     Uint32            Used;
 } String_List;
 
+// Short results (paths, flags) are formatted once on the stack and copied, longer ones are formatted twice
 INLINE_PROCEDURE String FmtStrV(Memory_Arena *arena, const char *fmt, va_list list)
 {
+    char    local[512];
     va_list args;
     va_copy(args, list);
-    int   len = 1 + vsnprintf(NULL, 0, fmt, args);
+    int   len = 1 + vsnprintf(local, sizeof(local), fmt, args);
     char *buf = (char *)PushSize(arena, len);
-    vsnprintf(buf, len, fmt, list);
+    if (len <= (int)sizeof(local))
+        memcpy(buf, local, len);
+    else
+        vsnprintf(buf, len, fmt, list);
     va_end(args);
     return StringMake((Uint8 *)buf, len - 1);
 }
@@ -116,6 +121,17 @@ INLINE_PROCEDURE String StrDuplicateArena(String src, Memory_Arena *arena)
     return dst;
 }
 
+INLINE_PROCEDURE String StrConcatArena(String a, String b, Memory_Arena *arena)
+{
+    String dst;
+    dst.Data = PushSize(arena, a.Length + b.Length + 1);
+    memcpy(dst.Data, a.Data, a.Length);
+    memcpy(dst.Data + a.Length, b.Data, b.Length);
+    dst.Length           = a.Length + b.Length;
+    dst.Data[dst.Length] = 0;
+    return dst;
+}
+
 INLINE_PROCEDURE String SubStr(String str, Int64 index, Int64 count)
 {
     Assert(index < str.Length);
@@ -255,6 +271,55 @@ INLINE_PROCEDURE Int64 StrReverseFindCharacter(String str, Uint8 key, Int64 pos)
     return -1;
 }
 
+// Supports '*' (any sequence) and '?' (any single character)
+INLINE_PROCEDURE bool StrMatchWildcard(String pattern, String str)
+{
+    Int64 p = 0, s = 0;
+    Int64 star = -1, resume = 0;
+    while (s < str.Length)
+    {
+        if (p < pattern.Length && (pattern.Data[p] == '?' || pattern.Data[p] == str.Data[s]))
+        {
+            p += 1;
+            s += 1;
+        }
+        else if (p < pattern.Length && pattern.Data[p] == '*')
+        {
+            star   = p++;
+            resume = s;
+        }
+        else if (star >= 0)
+        {
+            p = star + 1;
+            s = ++resume;
+        }
+        else
+            return false;
+    }
+    while (p < pattern.Length && pattern.Data[p] == '*')
+        p += 1;
+    return p == pattern.Length;
+}
+
+// FNV-1a, used for naming generated files after their contents
+#define HASH_SEED 0xcbf29ce484222325ull
+
+INLINE_PROCEDURE Uint64 HashBytes(Uint64 hash, const void *ptr, Int64 length)
+{
+    const Uint8 *data = (const Uint8 *)ptr;
+    for (Int64 index = 0; index < length; ++index)
+    {
+        hash ^= data[index];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+INLINE_PROCEDURE Uint64 StrHash(String str)
+{
+    return HashBytes(HASH_SEED, str.Data, str.Length);
+}
+
 INLINE_PROCEDURE bool StringListIsEmpty(String_List *list)
 {
     return list->Head.Next == NULL && list->Used == 0;
@@ -0,0 +1,404 @@
+#pragma once
+
+#include "compile_db.h"
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+#include <stdlib.h>
+
+//
+// Asynchronous logger
+// Any thread formats its message into a heap block and pushes it on a lock-free stack, a dedicated writer thread
+// takes the whole stack at once and writes the batch to the console, the log file and the JSON lines file.
+// Messages are tagged with the worker that logged them and the target being built by that thread (see LogSetTarget).
+// When the standard output is a terminal, a status line (see LogStatus) is kept below the messages.
+//
+
+#define LOG_STATUS_LENGTH 80
+
+typedef struct Log_Message
+{
+    struct Log_Message *Next;
+    Log_Kind            Kind;
+    bool                Status; // Replaces the status line instead of being logged
+    Uint32              Thread;
+    Uint64              Time;
+    String              Target;
+    String              Text;
+} Log_Message;
+
+typedef struct Logger
+{
+    Log_Message *volatile Pending;
+    volatile Int32        Submitted;
+    volatile Int32        Written;
+    volatile Int32        Waiting;
+    volatile Int32        Quit;
+    Os_Semaphore          Available;
+    Os_Semaphore          Drained;
+    Os_Thread             Writer;
+
+    bool                  Quiet;    // Info messages are not written to the console
+    bool                  Terminal; // Standard output is a terminal, the status line is only drawn there
+    Uint64                Origin;
+    File_Handle           File;
+    File_Handle           Json;
+
+    Log_Agent             Fallback; // Logging agent of the thread that created the logger, used by the writer itself
+    Fatal_Error_Procedure FatalError;
+
+    // Only used by the writer thread
+    char                  StatusLine[LOG_STATUS_LENGTH];
+    Int64                 StatusLength;
+    Int64                 StatusShown; // Characters of the status line currently on the console
+} Logger;
+
+// Target built by the current thread, copied into every message it logs
+static thread_local String LogTarget;
+
+INLINE_PROCEDURE void LogSetTarget(String target)
+{
+    LogTarget = target;
+}
+
+static const String LogKindLabel[] = {StringExpand("[Log]     "), StringExpand("[Warning] "),
+                                      StringExpand("[Error]   ")};
+static const String LogKindId[]    = {StringExpand("info"), StringExpand("warning"), StringExpand("error")};
+
+static void LoggerPush(Logger *logger, Log_Kind kind, bool status, const char *fmt, va_list list)
+{
+    char    local[1024];
+    va_list args;
+    va_copy(args, list);
+    int len = vsnprintf(local, sizeof(local), fmt, args);
+    va_end(args);
+    if (len < 0)
+        return;
+
+    String       target  = LogTarget;
+    Log_Message *message = (Log_Message *)malloc(sizeof(Log_Message) + len + target.Length + 2);
+    if (!message)
+        return;
+
+    Uint8 *text = (Uint8 *)(message + 1);
+    if (len < (int)sizeof(local))
+        memcpy(text, local, len + 1);
+    else
+        vsnprintf((char *)text, len + 1, fmt, list);
+
+    memcpy(text + len + 1, target.Data, target.Length);
+    text[len + 1 + target.Length] = 0;
+
+    message->Kind                 = kind;
+    message->Status               = status;
+    message->Thread               = ThreadContext.ThreadIndex;
+    message->Time                 = OsGetMonotonicTime() - logger->Origin;
+    message->Target               = StringMake(text + len + 1, target.Length);
+    message->Text                 = StringMake(text, len);
+
+    AtomicAdd32(&logger->Submitted, 1);
+
+    // Only the message pushed on an empty stack wakes the writer, the following ones are taken in the same batch
+    Log_Message *head;
+    do
+    {
+        head          = logger->Pending;
+        message->Next = head;
+    } while (!AtomicCompareExchangePointer((void *volatile *)&logger->Pending, head, message));
+
+    if (!head)
+        OsSemaphoreSignal(logger->Available, 1);
+}
+
+static void LoggerLogProcedure(void *agent, Log_Kind kind, const char *fmt, va_list list)
+{
+    LoggerPush((Logger *)agent, kind, false, fmt, list);
+}
+
+// Overwrites the status line with spaces, the cursor is left at the beginning of the line
+INLINE_PROCEDURE void LoggerEraseStatus(Logger *logger)
+{
+    if (!logger->StatusShown)
+        return;
+
+    char line[LOG_STATUS_LENGTH + 2];
+    line[0] = '\r';
+    memset(line + 1, ' ', logger->StatusShown);
+    line[logger->StatusShown + 1] = '\r';
+    OsConsoleOutBuffer(OsGetStdOutputHandle(), StringMake(line, logger->StatusShown + 2));
+    logger->StatusShown = 0;
+}
+
+INLINE_PROCEDURE void LoggerDrawStatus(Logger *logger)
+{
+    if (!logger->StatusLength)
+    {
+        LoggerEraseStatus(logger);
+        return;
+    }
+
+    // Characters left over from a longer status line are overwritten with spaces
+    char  line[LOG_STATUS_LENGTH + 1];
+    Int64 length = Maximum(logger->StatusLength, logger->StatusShown);
+    line[0]      = '\r';
+    memcpy(line + 1, logger->StatusLine, logger->StatusLength);
+    memset(line + 1 + logger->StatusLength, ' ', length - logger->StatusLength);
+    OsConsoleOutBuffer(OsGetStdOutputHandle(), StringMake(line, length + 1));
+    logger->StatusShown = logger->StatusLength;
+}
+
+INLINE_PROCEDURE void LoggerWriteConsole(Logger *logger, Out_Stream *out, Log_Kind kind)
+{
+    if (OutGetSize(out) == 0)
+        return;
+
+    LoggerEraseStatus(logger);
+
+    void *fp = (kind == Log_Kind_Info) ? OsGetStdOutputHandle() : OsGetErrorOutputHandle();
+    if (!logger->Quiet)
+    {
+        if (kind == Log_Kind_Error)
+            OsConsoleSetColorRed(fp);
+        else if (kind == Log_Kind_Warn)
+            OsConsoleSetColorYellow(fp);
+    }
+    OsConsoleOutBuffer(fp, OutBuildStringSerial(out, ThreadScratchpad()));
+    if (!logger->Quiet)
+        OsConsoleResetColor(fp);
+}
+
+// Messages are in the order they were pushed, runs of the same kind are written to the console at once
+static void LoggerWriteBatch(Logger *logger, Log_Message *first)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Out_Stream      *console = PushType(scratch, Out_Stream);
+    Out_Stream      *file    = PushType(scratch, Out_Stream);
+    Out_Stream      *json    = PushType(scratch, Out_Stream);
+    OutCreate(console, MemoryArenaAllocator(scratch));
+    OutCreate(file, MemoryArenaAllocator(scratch));
+    OutCreate(json, MemoryArenaAllocator(scratch));
+
+    Log_Kind run_kind = first->Kind;
+    Int32    count    = 0;
+
+    for (Log_Message *message = first; message; message = message->Next)
+    {
+        count += 1;
+
+        if (message->Status)
+        {
+            logger->StatusLength = Minimum(message->Text.Length, LOG_STATUS_LENGTH - 1);
+            memcpy(logger->StatusLine, message->Text.Data, logger->StatusLength);
+            continue;
+        }
+
+        if (message->Kind != run_kind)
+        {
+            LoggerWriteConsole(logger, console, run_kind);
+            OutCreate(console, MemoryArenaAllocator(scratch));
+            run_kind = message->Kind;
+        }
+
+        if (!logger->Quiet)
+        {
+            OutString(console, LogKindLabel[message->Kind]);
+            OutString(console, message->Text);
+        }
+        else if (message->Kind != Log_Kind_Info)
+        {
+            OutString(console, message->Text);
+        }
+
+        if (logger->File.PlatformFileHandle)
+        {
+            OutString(file, LogKindLabel[message->Kind]);
+            if (message->Thread)
+            {
+                OutString(file, StringLiteral("(worker "));
+                OutUnsigned(file, message->Thread);
+                OutString(file, StringLiteral(") "));
+            }
+            if (message->Target.Length)
+                OutPrefixed(file, message->Target, StringLiteral(": "));
+            OutString(file, message->Text);
+        }
+
+        if (logger->Json.PlatformFileHandle)
+        {
+            String text = message->Text;
+            while (text.Length && (text.Data[text.Length - 1] == '\n' || text.Data[text.Length - 1] == '\r'))
+                text.Length -= 1;
+
+            OutString(json, StringLiteral("{\"time_us\": "));
+            OutUnsigned(json, message->Time);
+            OutString(json, StringLiteral(", \"level\": \""));
+            OutString(json, LogKindId[message->Kind]);
+            OutString(json, StringLiteral("\", \"thread\": "));
+            OutUnsigned(json, message->Thread);
+            OutString(json, StringLiteral(", \"target\": "));
+            OutJsonString(json, message->Target);
+            OutString(json, StringLiteral(", \"message\": "));
+            OutJsonString(json, text);
+            OutString(json, StringLiteral("}\n"));
+        }
+    }
+
+    LoggerWriteConsole(logger, console, run_kind);
+    if (logger->Terminal)
+        LoggerDrawStatus(logger);
+    if (logger->File.PlatformFileHandle)
+        OutWriteFile(file, logger->File);
+    if (logger->Json.PlatformFileHandle)
+        OutWriteFile(json, logger->Json);
+
+    EndTemporaryMemory(&temp);
+
+    while (first)
+    {
+        Log_Message *next = first->Next;
+        free(first);
+        first = next;
+    }
+
+    AtomicAdd32(&logger->Written, count);
+    if (AtomicLoad32(&logger->Waiting))
+        OsSemaphoreSignal(logger->Drained, 1);
+}
+
+static void LoggerWriter(void *arg)
+{
+    Logger *logger = (Logger *)arg;
+
+    InitThreadContext(NullMemoryAllocator(), MegaBytes(64), logger->Fallback, logger->FatalError);
+
+    for (;;)
+    {
+        OsSemaphoreWait(logger->Available);
+
+        // Messages are pushed in front of the stack, reversed to get them in the order they were logged
+        Log_Message *taken = (Log_Message *)AtomicExchangePointer((void *volatile *)&logger->Pending, NULL);
+        Log_Message *batch = NULL;
+        while (taken)
+        {
+            Log_Message *next = taken->Next;
+            taken->Next       = batch;
+            batch             = taken;
+            taken             = next;
+        }
+
+        if (batch)
+            LoggerWriteBatch(logger, batch);
+
+        if (AtomicLoad32(&logger->Quit) && logger->Pending == NULL)
+            break;
+    }
+
+    FreeThreadContext();
+}
+
+// Files that can not be opened are reported and skipped, returns false if the writer thread could not be started
+static bool LoggerCreate(Logger *logger, const char *file_path, const char *json_path, bool quiet)
+{
+    memset(logger, 0, sizeof(*logger));
+    logger->Quiet      = quiet;
+    logger->Terminal   = !quiet && OsConsoleIsTerminal(OsGetStdOutputHandle());
+    logger->Origin     = OsGetMonotonicTime();
+    logger->Fallback   = ThreadContext.LogAgent;
+    logger->FatalError = ThreadContext.FatalError;
+
+    if (file_path)
+    {
+        logger->File = OsFileOpen(StringMake(file_path, strlen(file_path)), File_Mode_Write);
+        if (!logger->File.PlatformFileHandle)
+            LogError("Could not open file: \"%s\" for logging. Logging to file disabled.\n", file_path);
+    }
+
+    if (json_path)
+    {
+        logger->Json = OsFileOpen(StringMake(json_path, strlen(json_path)), File_Mode_Write);
+        if (!logger->Json.PlatformFileHandle)
+            LogError("Could not open file: \"%s\" for JSON logging. JSON logging disabled.\n", json_path);
+    }
+
+    logger->Available = OsSemaphoreCreate(0);
+    logger->Drained   = OsSemaphoreCreate(0);
+    if (logger->Available.PlatformHandle && logger->Drained.PlatformHandle)
+        logger->Writer = OsThreadCreate(LoggerWriter, logger);
+
+    if (!logger->Writer.PlatformHandle)
+    {
+        if (logger->Available.PlatformHandle)
+            OsSemaphoreDestroy(logger->Available);
+        if (logger->Drained.PlatformHandle)
+            OsSemaphoreDestroy(logger->Drained);
+        if (logger->File.PlatformFileHandle)
+            OsFileClose(logger->File);
+        if (logger->Json.PlatformFileHandle)
+            OsFileClose(logger->Json);
+        return false;
+    }
+
+    return true;
+}
+
+INLINE_PROCEDURE Log_Agent LoggerAgent(Logger *logger)
+{
+    Log_Agent agent;
+    agent.Data      = logger;
+    agent.Procedure = LoggerLogProcedure;
+    return agent;
+}
+
+// Waits until every message logged so far has been written
+static void LoggerFlush(Logger *logger)
+{
+    Int32 target = AtomicLoad32(&logger->Submitted);
+
+    AtomicStore32(&logger->Waiting, 1);
+    while (AtomicLoad32(&logger->Written) < target)
+        OsSemaphoreWait(logger->Drained);
+    AtomicStore32(&logger->Waiting, 0);
+}
+
+// Flushes the logger of the calling thread, used before writing to the console directly
+INLINE_PROCEDURE void LogFlush()
+{
+    if (ThreadContext.LogAgent.Procedure == LoggerLogProcedure)
+        LoggerFlush((Logger *)ThreadContext.LogAgent.Data);
+}
+
+// The status line is only drawn by the asynchronous logger, when the standard output is a terminal
+INLINE_PROCEDURE bool LogStatusEnabled()
+{
+    return ThreadContext.LogAgent.Procedure == LoggerLogProcedure &&
+           ((Logger *)ThreadContext.LogAgent.Data)->Terminal;
+}
+
+// Sets the status line, an empty status removes it
+static void LogStatus(const char *fmt, ...)
+{
+    if (!LogStatusEnabled())
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    LoggerPush((Logger *)ThreadContext.LogAgent.Data, Log_Kind_Info, true, fmt, args);
+    va_end(args);
+}
+
+// Remaining messages are written before the writer thread exits
+static void LoggerDestroy(Logger *logger)
+{
+    AtomicStore32(&logger->Quit, 1);
+    OsSemaphoreSignal(logger->Available, 1);
+    OsThreadJoin(logger->Writer);
+
+    OsSemaphoreDestroy(logger->Available);
+    OsSemaphoreDestroy(logger->Drained);
+    if (logger->File.PlatformFileHandle)
+        OsFileClose(logger->File);
+    if (logger->Json.PlatformFileHandle)
+        OsFileClose(logger->Json);
+}
@@ -1,9 +1,19 @@
 ﻿
+#include "build_graph.h"
 #include "cmd_line.h"
+#include "daemon.h"
+#include "include_scanner.h"
+#include "jobserver.h"
 #include "lenstring.h"
+#include "logger.h"
+#include "modules.h"
 #include "muda_parser.h"
+#include "object_cache.h"
 #include "os.h"
+#include "plugin_host.h"
+#include "remote.h"
 #include "stream.h"
+#include "trace.h"
 #include "zBase.h"
 
 #if PLATFORM_OS_WINDOWS == 1
@@ -329,7 +339,7 @@ void DeserializeMuda(Build_Config *build_config, Compiler_Config_List *config_li
                 pevent.Data.Parse.Values      = (Muda_String *)token->Data.Property.Value;
                 pevent.Data.Parse.ValueCount  = (uint32_t)token->Data.Property.Count;
 
-                if (build_config->PluginHook(&ThreadContext, &build_config->Interface, &pevent) != 0)
+                if (PluginDispatch(build_config, &pevent) != 0)
                 {
                     LogWarn("Line: %u, Column: %u :: Invalid Property \"%s\". Ignored.\n", prsr.line, prsr.column,
                             token->Data.Property.Key.Data);
@@ -359,18 +369,6 @@ void DeserializeMuda(Build_Config *build_config, Compiler_Config_List *config_li
     }
 }
 
-const char *GetCompilerName(Compiler_Kind kind)
-{
-    if (kind == Compiler_Bit_CL)
-        return "CL";
-    else if (kind == Compiler_Bit_CLANG)
-        return "CLANG";
-    else if (kind == Compiler_Bit_GCC)
-        return "GCC";
-    Unreachable();
-    return "";
-}
-
 typedef struct Directory_Iteration_Context
 {
     Memory_Arena      *Arena;
@@ -415,564 +413,1015 @@ static Directory_Iteration DirectoryIteratorAddToList(const File_Info *info, voi
     return Directory_Iteration_Continue;
 }
 
-void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_config,
-                      const Compiler_Kind available_compilers, const Compiler_Kind compiler, const char *parent,
-                      bool is_root);
-void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, const Compiler_Kind available_compilers,
-                            const Compiler_Kind compiler, Compiler_Config *alternative_config, const char *parent,
-                            bool is_root);
+typedef struct Source_Expansion_Context
+{
+    String        Pattern;
+    String_List  *List;
+    Memory_Arena *Arena;
+} Source_Expansion_Context;
 
-void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_config,
-                      const Compiler_Kind available_compilers, const Compiler_Kind compiler, const char *parent,
-                      bool is_root)
+static Directory_Iteration SourceExpansionIterator(const File_Info *info, void *user_context)
 {
-    Memory_Arena    *scratch       = ThreadScratchpad();
+    Source_Expansion_Context *context = (Source_Expansion_Context *)user_context;
+    if (!(info->Atribute & File_Attribute_Directory) && StrMatchWildcard(context->Pattern, info->Name))
+        StringListAdd(context->List, StrDuplicateArena(info->Path, context->Arena), context->Arena);
+    return Directory_Iteration_Continue;
+}
 
-    Temporary_Memory temp          = BeginTemporaryMemory(scratch);
+// Returns false if the file name of the source has no wildcard, "dir" is then not set
+static bool SourcePatternDirectory(String source, String *dir, String *name, Memory_Arena *arena)
+{
+    Int64 name_pos = Maximum(StrReverseFindCharacter(source, '/', source.Length - 1),
+                             StrReverseFindCharacter(source, '\\', source.Length - 1)) + 1;
+    *name          = StrRemovePrefix(source, name_pos);
 
-    bool             prebuild_pass = true;
-    if (compiler_config->Prebuild.Length)
+    if (StrFindCharacter(*name, '*', 0) < 0 && StrFindCharacter(*name, '?', 0) < 0)
+        return false;
+
+    *dir = name_pos ? StrDuplicateArena(StringMake(source.Data, name_pos), arena) : StringLiteral(".");
+    return true;
+}
+
+// Sources may contain wildcards in the file name (eg: "src/*.c"), which are left to the shell or to the compiler
+// when compiling. This expands them for the places where individual files are required.
+static void ExpandSourcePattern(String_List *list, String source, Memory_Arena *arena)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    String           dir, name;
+    if (!SourcePatternDirectory(source, &dir, &name, scratch))
     {
-        LogInfo("==> Executing Prebuild command\n");
-        if (!OsExecuteCommandLine(compiler_config->Prebuild))
-        {
-            prebuild_pass = false;
-            LogError("Prebuild execution failed. Aborted.\n\n");
-            if (compiler_config->Kind != Compile_Project)
-                return;
-        }
-        else
+        StringListAdd(list, source, arena);
+        EndTemporaryMemory(&temp);
+        return;
+    }
+
+    Source_Expansion_Context context;
+    context.Pattern = name;
+    context.List    = list;
+    context.Arena   = arena;
+    OsIterateDirectory((char *)dir.Data, SourceExpansionIterator, &context);
+
+    EndTemporaryMemory(&temp);
+}
+
+// Adding or removing a file changes the modification time of the directory, the sources expanded from it change
+static Uint64 SourcePatternsTime(Compiler_Config *compiler_config)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Uint64           hash    = HASH_SEED;
+    ForList(String_Array_List_Node, &compiler_config->Sources)
+    {
+        ForListNode(&compiler_config->Sources, MAX_STRING_NODE_DATA_COUNT)
         {
-            LogInfo("Finished executing Prebuild command\n");
+            Int64 str_count = it->Data[index].Count;
+            for (Int64 str_index = 0; str_index < str_count; ++str_index)
+            {
+                String dir, name;
+                if (SourcePatternDirectory(it->Data[index].Values[str_index], &dir, &name, scratch))
+                {
+                    Uint64 time = OsGetFileLastWriteTime(dir);
+                    hash        = HashBytes(hash, &time, sizeof(time));
+                }
+            }
         }
     }
 
-    bool              execute_postbuild = true;
+    EndTemporaryMemory(&temp);
+    return hash;
+}
 
-    Muda_Plugin_Event pevent;
-    memset(&pevent, 0, sizeof(pevent));
+static String BuildIntermediateDirectory(String build_dir, Memory_Arena *arena)
+{
+    if (build_dir.Data[build_dir.Length - 1] == '/')
+        return FmtStr(arena, "%sint", build_dir.Data);
+    return FmtStr(arena, "%s/int", build_dir.Data);
+}
 
-    if (compiler_config->Kind == Compile_Project)
+// Objects are named after the source and the hash of its path, so sources with the same name don't collide
+static String ObjectPathFromSource(String intermediate, String source, const char *extension, Memory_Arena *arena)
+{
+    Int64 name_pos = Maximum(StrReverseFindCharacter(source, '/', source.Length - 1),
+                             StrReverseFindCharacter(source, '\\', source.Length - 1)) + 1;
+    String name    = StrRemovePrefix(source, name_pos);
+    Int64  ext_pos = StrReverseFindCharacter(name, '.', name.Length - 1);
+    if (ext_pos > 0)
+        name.Length = ext_pos;
+    return FmtStr(arena, "%s/%.*s.%08x.%s", intermediate.Data, (int)name.Length, name.Data, (Uint32)StrHash(source),
+                  extension);
+}
+
+// Raw profiles written by the instrumented binary
+static String ProfileDirectory(Build_Graph *graph)
+{
+    return FmtStr(graph->Arena, "%s/pgo", graph->BuildDirectory.Data);
+}
+
+// Profile read by the optimized build. GCC reads the .gcda where they are written, the raw profiles of CLANG are
+// merged into a single file and the CL linker merges the .pgc into the .pgd it wrote
+static String ProfileDataPath(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    if (graph->Compiler == Compiler_Bit_CL)
+        return FmtStr(graph->Arena, "%s/%s.pgd", graph->BuildDirectory.Data, compiler_config->Build.Data);
+    if (graph->Compiler == Compiler_Bit_CLANG)
+        return FmtStr(graph->Arena, "%s/%s.profdata", graph->BuildDirectory.Data, compiler_config->Build.Data);
+    return ProfileDirectory(graph);
+}
+
+// Objects of the thin LTO backend reused by the next links
+static String LtoCacheDirectory(Build_Graph *graph)
+{
+    return FmtStr(graph->Arena, "%s/lto-cache", graph->BuildDirectory.Data);
+}
+
+// Profile options of GCC and CLANG, given both when compiling and when linking
+static void BuildNodeProfileOptions(Build_Graph *graph, Build_Node *node, Compiler_Config *compiler_config)
+{
+    if (compiler_config->ProfilePhase == Profile_Phase_Instrument)
     {
-        String build_dir                 = compiler_config->BuildDirectory;
-        String build                     = compiler_config->Build;
+        BuildNodeArgPrefixed(graph, node, "-fprofile-generate=", ProfileDirectory(graph));
+    }
+    else if (compiler_config->ProfilePhase == Profile_Phase_Use)
+    {
+        BuildNodeArgPrefixed(graph, node, "-fprofile-use=", ProfileDataPath(graph, compiler_config));
+        if (graph->Compiler == Compiler_Bit_GCC)
+            BuildNodeArg(graph, node, StringLiteral("-Wno-missing-profile"));
+    }
+}
 
-        pevent.Data.Prebuild.MudaDirName = parent;
-        pevent.Data.Prebuild.Name        = compiler_config->Name.Data;
-        pevent.Data.Prebuild.Build       = build.Data;
-        pevent.Data.Prebuild.BuildDir    = build_dir.Data;
-        pevent.Data.Prebuild.Succeeded   = prebuild_pass;
-        pevent.Data.Prebuild.RootBuild   = is_root;
+// Optimization level of the profile, Default is lowered from the Optimization property by each compiler
+static String OptimizationProfileLevel(Compiler_Kind compiler, Uint32 profile)
+{
+    switch (profile)
+    {
+    case Optimization_Profile_Debug:
+        return compiler == Compiler_Bit_CL ? StringLiteral("-Od") : StringLiteral("-O0");
+    case Optimization_Profile_Size:
+        return compiler == Compiler_Bit_CL ? StringLiteral("-O1") : StringLiteral("-Os");
+    case Optimization_Profile_Aggressive:
+        return compiler == Compiler_Bit_CL ? StringLiteral("-O2") : StringLiteral("-O3");
+    }
+    return StringLiteral("-O2");
+}
 
-        if (compiler_config->Application == Application_Executable)
-            pevent.Data.Prebuild.BuildExtension = ExecutableExtension;
-        else if (compiler_config->Application == Application_Dynamic_Library)
-            pevent.Data.Prebuild.BuildExtension = DynamicLibraryExtension;
-        else
-            pevent.Data.Prebuild.BuildExtension = StaticLibraryExtension;
+// Options of the profile shared by the compilers, assertions are only compiled in the Debug profile
+static void BuildNodeOptimizationProfile(Build_Graph *graph, Build_Node *node, Compiler_Config *compiler_config)
+{
+    Uint32 profile = compiler_config->OptimizationProfile;
+    BuildNodeArg(graph, node, OptimizationProfileLevel(graph->Compiler, profile));
+    if (profile == Optimization_Profile_Aggressive && graph->Compiler == Compiler_Bit_CL)
+        BuildNodeArg(graph, node, StringLiteral("-Ob3"));
+    if (profile != Optimization_Profile_Debug)
+        BuildNodeArg(graph, node, StringLiteral("-DNDEBUG"));
+}
 
-        pevent.Kind = Muda_Plugin_Event_Kind_Prebuild;
-        build_config->PluginHook(&ThreadContext, &build_config->Interface, &pevent);
+// Compiler invocation along with the options that are common to every source of the configuration
+static void BuildNodeCompilerOptions(Build_Graph *graph, Build_Node *node, Compiler_Config *compiler_config)
+{
+    switch (graph->Compiler)
+    {
+    case Compiler_Bit_CL: {
+        BuildNodeArg(graph, node, StringLiteral("cl"));
+        BuildNodeArg(graph, node, StringLiteral("-nologo"));
+        BuildNodeArg(graph, node, StringLiteral("-EHsc"));
+        BuildNodeArg(graph, node, StringLiteral("-W3"));
+        if (compiler_config->OptimizationProfile == Optimization_Profile_Default)
+            BuildNodeArg(graph, node, compiler_config->Optimization ? StringLiteral("-O2") : StringLiteral("-Od"));
+        else
+            BuildNodeOptimizationProfile(graph, node, compiler_config);
+
+        if (CompilerConfigDebugSymbol(compiler_config))
+            BuildNodeArg(graph, node, StringLiteral("-Zi"));
+
+        // CL has no option for the native processor, nor between SSE2 and AVX2
+        if (compiler_config->TargetCpu == Target_Cpu_X86_64_V3)
+            BuildNodeArg(graph, node, StringLiteral("-arch:AVX2"));
+        else if (compiler_config->TargetCpu == Target_Cpu_X86_64_V4)
+            BuildNodeArg(graph, node, StringLiteral("-arch:AVX512"));
+        else if (compiler_config->TargetCpu != Target_Cpu_Default)
+            LogWarn("TargetCPU %.*s is not supported by CL, built for the default processor\n",
+                    (int)TargetCpuKindId[compiler_config->TargetCpu].Length,
+                    TargetCpuKindId[compiler_config->TargetCpu].Data);
+
+        // Profile guided optimization is done by the linker on the code generated when linking
+        if (compiler_config->Lto != Lto_None || compiler_config->ProfilePhase != Profile_Phase_None)
+            BuildNodeArg(graph, node, StringLiteral("-GL"));
+    }
+    break;
 
-        if (!prebuild_pass)
-            return;
+    case Compiler_Bit_CLANG: {
+        BuildNodeArg(graph, node, compiler_config->Language ? StringLiteral("clang++") : StringLiteral("clang"));
+        BuildNodeArg(graph, node, StringLiteral("-Wall"));
 
-        LogInfo("Beginning compilation\n");
+        if (CompilerConfigDebugSymbol(compiler_config))
+        {
+            BuildNodeArg(graph, node, StringLiteral("-g"));
+            BuildNodeArg(graph, node, StringLiteral("-gcodeview"));
+        }
 
-        Out_Stream out;
-        OutCreate(&out, MemoryArenaAllocator(compiler_config->Arena));
+        if (compiler_config->OptimizationProfile == Optimization_Profile_Default)
+            BuildNodeArg(graph, node,
+                         compiler_config->Optimization ? StringLiteral("--optimize") : StringLiteral("--debug"));
+        else
+            BuildNodeOptimizationProfile(graph, node, compiler_config);
 
-        Out_Stream lib;
-        OutCreate(&lib, MemoryArenaAllocator(compiler_config->Arena));
+        if (compiler_config->TargetCpu != Target_Cpu_Default)
+            BuildNodeArgPrefixed(graph, node, "-march=", TargetCpuKindId[compiler_config->TargetCpu]);
 
-        Out_Stream res;
-        OutCreate(&res, MemoryArenaAllocator(compiler_config->Arena));
+        if (compiler_config->Lto != Lto_None)
+            BuildNodeArg(graph, node,
+                         compiler_config->Lto == Lto_Thin ? StringLiteral("-flto=thin") : StringLiteral("-flto"));
+        BuildNodeProfileOptions(graph, node, compiler_config);
+    }
+    break;
 
-        Uint32 result = OsCheckIfPathExists(build_dir);
-        if (result == Path_Does_Not_Exist)
+    case Compiler_Bit_GCC: {
+        BuildNodeArg(graph, node, compiler_config->Language ? StringLiteral("g++") : StringLiteral("gcc"));
+        BuildNodeArg(graph, node, StringLiteral("-Wall"));
+        // DebugSymbol has never been used with GCC, only the profiles give debug symbols
+        if (compiler_config->OptimizationProfile == Optimization_Profile_Default)
         {
-            if (!OsCreateDirectoryRecursively(build_dir))
-            {
-                LogError("Failed to create directory %s! Aborted.\n", build_dir.Data);
-                return;
-            }
+            BuildNodeArg(graph, node, compiler_config->Optimization ? StringLiteral("-O2") : StringLiteral("-O"));
         }
-        else if (result == Path_Exist_File)
+        else
         {
-            LogError("%s: Path exist but is a file! Aborted.\n", build_dir.Data);
-            return;
+            BuildNodeOptimizationProfile(graph, node, compiler_config);
+            if (CompilerConfigDebugSymbol(compiler_config))
+                BuildNodeArg(graph, node, StringLiteral("-g"));
+        }
+
+        if (compiler_config->TargetCpu != Target_Cpu_Default)
+            BuildNodeArgPrefixed(graph, node, "-march=", TargetCpuKindId[compiler_config->TargetCpu]);
+
+        // GCC has no thin LTO, its link time optimization is partitioned and parallel already
+        if (compiler_config->Lto != Lto_None)
+            BuildNodeArg(graph, node, StringLiteral("-flto"));
+        BuildNodeProfileOptions(graph, node, compiler_config);
+    }
+    break;
+    }
+
+    BuildNodeArgList(graph, node, &compiler_config->Defines, "-D");
+    BuildNodeArgList(graph, node, &compiler_config->IncludeDirectories, "-I");
+    BuildNodeArgList(graph, node, &compiler_config->Flags, NULL);
+}
+
+// Adds a compile node for each source of the configuration, wildcards are expanded here
+static void LowerCompileNodes(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    String      intermediate = BuildIntermediateDirectory(graph->BuildDirectory, graph->Arena);
+    const char *extension    = (graph->Compiler == Compiler_Bit_CL) ? "obj" : "o";
+
+    String_List sources;
+    StringListInit(&sources);
+    ForList(String_Array_List_Node, &compiler_config->Sources)
+    {
+        ForListNode(&compiler_config->Sources, MAX_STRING_NODE_DATA_COUNT)
+        {
+            Int64 str_count = it->Data[index].Count;
+            for (Int64 str_index = 0; str_index < str_count; ++str_index)
+                ExpandSourcePattern(&sources, it->Data[index].Values[str_index], graph->Arena);
         }
+    }
 
-        if (compiler == Compiler_Bit_CL)
+    // The options are the same for every source, they are built once and shared by the compile nodes
+    Build_Node options;
+    memset(&options, 0, sizeof(options));
+    StringListInit(&options.Argv);
+    BuildNodeCompilerOptions(graph, &options, compiler_config);
+
+    String pdb_arg = FmtStr(graph->Arena, "-Fd%s/", graph->BuildDirectory.Data);
+
+    // The profile is read by the compiler, except with CL where only the linker reads it
+    String profile = {0};
+    if (compiler_config->ProfilePhase == Profile_Phase_Use && graph->Compiler != Compiler_Bit_CL)
+        profile = ProfileDataPath(graph, compiler_config);
+
+    ForList(String_List_Node, &sources)
+    {
+        ForListNode(&sources, MAX_STRING_NODE_DATA_COUNT)
         {
-            // For CL, we output intermediate files to "BuildDirectory/int"
-            String intermediate;
-            if (build_dir.Data[build_dir.Length - 1] == '/')
-                intermediate = FmtStr(scratch, "%sint", build_dir.Data);
-            else
-                intermediate = FmtStr(scratch, "%s/int", build_dir.Data);
+            String      source = it->Data[index];
+            String      object = ObjectPathFromSource(intermediate, source, extension, graph->Arena);
+
+            Build_Node *node   = BuildGraphAddNode(graph, Build_Node_Compile);
+            BuildNodeArgStrings(graph, node, &options.Argv);
 
-            result = OsCheckIfPathExists(intermediate);
-            if (result == Path_Does_Not_Exist)
+            if (graph->Compiler == Compiler_Bit_CL)
             {
-                if (!OsCreateDirectoryRecursively(intermediate))
-                {
-                    LogError("Failed to create directory %s! Aborted.\n", intermediate.Data);
-                    return;
-                }
+                BuildNodeArg(graph, node, pdb_arg);
+                BuildNodeArg(graph, node, StringLiteral("-c"));
+                BuildNodeArg(graph, node, source);
+                BuildNodeArgPrefixed(graph, node, "-Fo", object);
             }
-            else if (result == Path_Exist_File)
+            else
             {
-                LogError("%s: Path exist but is a file! Aborted.\n", intermediate.Data);
-                return;
-            }
+                node->DepFile = StrConcatArena(object, StringLiteral(".d"), graph->Arena);
+                // -MD lists the system headers as well, a new libc or compiler changes the key of the cached objects
+                BuildNodeArg(graph, node, StringLiteral("-MD"));
+                BuildNodeArg(graph, node, StringLiteral("-MF"));
+                BuildNodeArg(graph, node, node->DepFile);
+                BuildNodeArg(graph, node, StringLiteral("-c"));
+                BuildNodeArg(graph, node, source);
+                BuildNodeArg(graph, node, StringLiteral("-o"));
+                BuildNodeArg(graph, node, object);
+            }
+
+            BuildNodeInput(graph, node, source);
+            if (profile.Length)
+                BuildNodeInput(graph, node, profile);
+            BuildNodeOutput(graph, node, object);
         }
+    }
+}
 
-        // Turn on Optimization if it is forced via command line
-        if (build_config->ForceOptimization)
+// Makes the node depend on every compile and resource node added so far and passes their outputs as arguments
+static void BuildNodeAddObjects(Build_Graph *graph, Build_Node *node)
+{
+    for (Build_Node *object = graph->First; object != node; object = object->Next)
+    {
+        if (object->Kind != Build_Node_Compile && object->Kind != Build_Node_Resource)
+            continue;
+        String output = BuildNodeFirstOutput(object);
+        BuildNodeAddDependency(graph, node, object);
+        BuildNodeArg(graph, node, output);
+        BuildNodeInput(graph, node, output);
+    }
+}
+
+static void LowerCompilerConfigCL(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    String build_dir = graph->BuildDirectory;
+    String build     = compiler_config->Build;
+
+#if PLATFORM_OS_WINDOWS == 1
+    if (compiler_config->ResourceFile.Length && compiler_config->Application != Application_Static_Library)
+    {
+        String      output = FmtStr(graph->Arena, "%s/%s.res", build_dir.Data, build.Data);
+        Build_Node *node   = BuildGraphAddNode(graph, Build_Node_Resource);
+        BuildNodeArg(graph, node, StringLiteral("rc"));
+        BuildNodeArg(graph, node, StringLiteral("-fo"));
+        BuildNodeArg(graph, node, output);
+        BuildNodeArg(graph, node, compiler_config->ResourceFile);
+        BuildNodeInput(graph, node, compiler_config->ResourceFile);
+        BuildNodeOutput(graph, node, output);
+    }
+#endif
+
+    LowerCompileNodes(graph, compiler_config);
+
+    Build_Node *node;
+
+    if (compiler_config->Application == Application_Static_Library)
+    {
+        String output = FmtStr(graph->Arena, "%s/%s.%s", build_dir.Data, build.Data, StaticLibraryExtension);
+        node          = BuildGraphAddNode(graph, Build_Node_Archive);
+        BuildNodeArg(graph, node, StringLiteral("lib"));
+        BuildNodeArg(graph, node, StringLiteral("-nologo"));
+        if (compiler_config->Lto != Lto_None || compiler_config->ProfilePhase != Profile_Phase_None)
+            BuildNodeArg(graph, node, StringLiteral("-LTCG"));
+        BuildNodeAddObjects(graph, node);
+        BuildNodeArgPrefixed(graph, node, "-out:", output);
+        BuildNodeOutput(graph, node, output);
+    }
+    else
+    {
+        const char *extension = compiler_config->Application == Application_Executable ? ExecutableExtension
+                                                                                        : DynamicLibraryExtension;
+        String      output    = FmtStr(graph->Arena, "%s/%s.%s", build_dir.Data, build.Data, extension);
+
+        node                  = BuildGraphAddNode(graph, Build_Node_Link);
+        BuildNodeArg(graph, node, StringLiteral("cl"));
+        BuildNodeArg(graph, node, StringLiteral("-nologo"));
+        if (CompilerConfigDebugSymbol(compiler_config))
+            BuildNodeArg(graph, node, StringLiteral("-Zi"));
+        BuildNodeAddObjects(graph, node);
+        BuildNodeArgList(graph, node, &compiler_config->Flags, NULL);
+
+        if (compiler_config->Application == Application_Dynamic_Library)
+            BuildNodeArg(graph, node, StringLiteral("-LD"));
+
+        BuildNodeArg(graph, node, StringLiteral("-link"));
+        BuildNodeArgFmt(graph, node, "-pdb:%s/%s.pdb", build_dir.Data, build.Data);
+        BuildNodeArgPrefixed(graph, node, "-out:", output);
+
+        if (compiler_config->Application == Application_Dynamic_Library)
+            BuildNodeArgFmt(graph, node, "-IMPLIB:%s/%s.%s", build_dir.Data, build.Data, StaticLibraryExtension);
+
+        if (compiler_config->Lto != Lto_None || compiler_config->ProfilePhase != Profile_Phase_None)
+            BuildNodeArg(graph, node, StringLiteral("-LTCG"));
+        if (compiler_config->ProfilePhase == Profile_Phase_Instrument)
         {
-            LogInfo("Optimization turned on forcefully\n");
-            compiler_config->Optimization = true;
+            BuildNodeArgPrefixed(graph, node, "-GENPROFILE:PGD=", ProfileDataPath(graph, compiler_config));
+        }
+        else if (compiler_config->ProfilePhase == Profile_Phase_Use)
+        {
+            String profile = ProfileDataPath(graph, compiler_config);
+            BuildNodeArgPrefixed(graph, node, "-USEPROFILE:PGD=", profile);
+            BuildNodeInput(graph, node, profile);
         }
 
-        switch (compiler)
+        BuildNodeArgList(graph, node, &compiler_config->LinkerFlags, NULL);
+        BuildNodeOutput(graph, node, output);
+    }
+
+    BuildNodeArgList(graph, node, &compiler_config->LibraryDirectories, "-LIBPATH:");
+    ForList(String_Array_List_Node, &compiler_config->Libraries)
+    {
+        ForListNode(&compiler_config->Libraries, MAX_STRING_NODE_DATA_COUNT)
         {
-        case Compiler_Bit_CL: {
-            OutFormatted(&out, "cl -nologo -EHsc -W3 ");
-            OutFormatted(&out, "%s ", compiler_config->Optimization ? "-O2" : "-Od");
+            Int64 str_count = it->Data[index].Count;
+            for (Int64 str_index = 0; str_index < str_count; ++str_index)
+                BuildNodeArgFmt(graph, node, "%s.%s", it->Data[index].Values[str_index].Data, StaticLibraryExtension);
+        }
+    }
 
-            if (compiler_config->DebugSymbol)
-            {
-                OutFormatted(&out, "-Zi ");
-            }
+    if (PLATFORM_OS_WINDOWS)
+    {
+        BuildNodeArgFmt(graph, node, "-SUBSYSTEM:%s",
+                        compiler_config->Subsystem == Subsystem_Console ? "CONSOLE" : "WINDOWS");
+    }
+}
 
-            ForList(String_Array_List_Node, &compiler_config->Defines)
-            {
-                ForListNode(&compiler_config->Defines, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-D%s ", it->Data[index].Values[str_index].Data);
-                }
-            }
+// Static libraries of GCC and CLANG are archives of the objects, libraries are resolved when linking the executable
+static void LowerArchiveNode(Build_Graph *graph, Compiler_Config *compiler_config, String archiver)
+{
+    String      output = FmtStr(graph->Arena, "%s/%s.%s", graph->BuildDirectory.Data, compiler_config->Build.Data,
+                                StaticLibraryExtension);
+    Build_Node *node   = BuildGraphAddNode(graph, Build_Node_Archive);
+    BuildNodeArg(graph, node, archiver);
+    BuildNodeArg(graph, node, StringLiteral("rcs"));
+    BuildNodeArg(graph, node, output);
+    BuildNodeAddObjects(graph, node);
+    BuildNodeOutput(graph, node, output);
+}
 
-            ForList(String_Array_List_Node, &compiler_config->IncludeDirectories)
-            {
-                ForListNode(&compiler_config->IncludeDirectories, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-I\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+static Build_Node *LowerLinkNode(Build_Graph *graph, Compiler_Config *compiler_config, String driver)
+{
+    const char *extension = compiler_config->Application == Application_Executable ? ExecutableExtension
+                                                                                    : DynamicLibraryExtension;
+    String      output    = FmtStr(graph->Arena, "%s/%s.%s", graph->BuildDirectory.Data, compiler_config->Build.Data,
+                                   extension);
+
+    Build_Node *node      = BuildGraphAddNode(graph, Build_Node_Link);
+    BuildNodeArg(graph, node, driver);
+    if (graph->Compiler == Compiler_Bit_CLANG && CompilerConfigDebugSymbol(compiler_config))
+    {
+        BuildNodeArg(graph, node, StringLiteral("-g"));
+        BuildNodeArg(graph, node, StringLiteral("-gcodeview"));
+    }
+    BuildNodeAddObjects(graph, node);
+    BuildNodeArgList(graph, node, &compiler_config->Flags, NULL);
 
-            ForList(String_Array_List_Node, &compiler_config->Sources)
-            {
-                ForListNode(&compiler_config->Sources, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    if (compiler_config->Application == Application_Dynamic_Library)
+        BuildNodeArg(graph, node, StringLiteral("--shared"));
+
+    // The code of the bitcode objects is generated when linking, with the jobs of the jobserver for GCC
+    if (compiler_config->Lto != Lto_None && graph->Compiler == Compiler_Bit_GCC)
+        BuildNodeArg(graph, node, StringLiteral("-flto=auto"));
+    else if (compiler_config->Lto != Lto_None)
+        BuildNodeArg(graph, node,
+                     compiler_config->Lto == Lto_Thin ? StringLiteral("-flto=thin") : StringLiteral("-flto"));
+    BuildNodeProfileOptions(graph, node, compiler_config);
 
+    BuildNodeArg(graph, node, StringLiteral("-o"));
+    BuildNodeArg(graph, node, output);
+
+    BuildNodeArgList(graph, node, &compiler_config->LinkerFlags, NULL);
+    BuildNodeArgList(graph, node, &compiler_config->LibraryDirectories, "-L");
+    BuildNodeArgList(graph, node, &compiler_config->Libraries, "-l");
+    BuildNodeOutput(graph, node, output);
+
+    return node;
+}
+
+static void LowerCompilerConfigCLANG(Build_Graph *graph, Compiler_Config *compiler_config,
+                                     const Compiler_Kind available_compilers)
+{
 #if PLATFORM_OS_WINDOWS == 1
-            if (compiler_config->ResourceFile.Length)
-            {
-                OutFormatted(&res, "rc -fo \"%s/%s.res\" \"%s\" ", build_dir.Data, build.Data,
-                             compiler_config->ResourceFile.Data);
-                OutFormatted(&out, "\"%s/%s.res\" ", build_dir.Data, build.Data);
-            }
+    if (compiler_config->ResourceFile.Length && compiler_config->Application != Application_Static_Library)
+    {
+        String output = FmtStr(graph->Arena, "%s/%s.res", graph->BuildDirectory.Data, compiler_config->Build.Data);
+        Build_Node *node = BuildGraphAddNode(graph, Build_Node_Resource);
+        BuildNodeArg(graph, node, StringLiteral("llvm-rc"));
+        BuildNodeArg(graph, node, StringLiteral("-FO"));
+        BuildNodeArg(graph, node, output);
+        BuildNodeArg(graph, node, compiler_config->ResourceFile);
+        BuildNodeInput(graph, node, compiler_config->ResourceFile);
+        BuildNodeOutput(graph, node, output);
+    }
 #endif
 
-            ForList(String_Array_List_Node, &compiler_config->Flags)
+    LowerCompileNodes(graph, compiler_config);
+
+    if (compiler_config->Application == Application_Static_Library)
+    {
+        // Archives of bitcode objects need the symbol table written by the LLVM archiver
+        LowerArchiveNode(graph, compiler_config,
+                         (PLATFORM_OS_WINDOWS || compiler_config->Lto != Lto_None) ? StringLiteral("llvm-ar")
+                                                                                   : StringLiteral("ar"));
+        return;
+    }
+
+    Build_Node *node =
+        LowerLinkNode(graph, compiler_config, compiler_config->Language ? StringLiteral("clang++") : StringLiteral("clang"));
+
+    if (PLATFORM_OS_WINDOWS)
+    {
+        if (available_compilers & Compiler_Bit_GCC)
+        {
+            BuildNodeArg(graph, node, StringLiteral("-fuse-ld=ld"));
+            BuildNodeArgFmt(graph, node, "-Wl,--subsystem,%s",
+                            compiler_config->Subsystem == Subsystem_Console ? "console" : "windows");
+        }
+        else
+        {
+            if (available_compilers & Compiler_Bit_CL)
+                BuildNodeArg(graph, node, StringLiteral("-fuse-ld=link"));
+            else
+                BuildNodeArg(graph, node, StringLiteral("-fuse-ld=lld"));
+            BuildNodeArg(graph, node, StringLiteral("-Xlinker"));
+            BuildNodeArgFmt(graph, node, "-subsystem:%s",
+                            compiler_config->Subsystem == Subsystem_Console ? "CONSOLE" : "WINDOWS");
+
+            if (compiler_config->Lto == Lto_Thin && !(available_compilers & Compiler_Bit_CL))
             {
-                ForListNode(&compiler_config->Flags, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
-                }
+                BuildNodeArg(graph, node, StringLiteral("-Xlinker"));
+                BuildNodeArgPrefixed(graph, node, "-lldltocache:", LtoCacheDirectory(graph));
             }
+        }
+    }
+    else if (compiler_config->Lto != Lto_None)
+    {
+        // The system linker only reads bitcode through a plugin that may not be installed
+        BuildNodeArg(graph, node, StringLiteral("-fuse-ld=lld"));
+        if (compiler_config->Lto == Lto_Thin)
+            BuildNodeArgPrefixed(graph, node, "-Wl,--thinlto-cache-dir=", LtoCacheDirectory(graph));
+    }
+}
 
-            OutFormatted(&out, "-Fd\"%s/\" ", build_dir.Data);
+static void LowerCompilerConfigGCC(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+#if PLATFORM_OS_WINDOWS == 1
+    if (compiler_config->ResourceFile.Length && compiler_config->Application != Application_Static_Library)
+    {
+        String output = FmtStr(graph->Arena, "%s/%s.o", graph->BuildDirectory.Data, compiler_config->Build.Data);
+        Build_Node *node = BuildGraphAddNode(graph, Build_Node_Resource);
+        BuildNodeArg(graph, node, StringLiteral("windres"));
+        BuildNodeArg(graph, node, StringLiteral("-i"));
+        BuildNodeArg(graph, node, compiler_config->ResourceFile);
+        BuildNodeArg(graph, node, output);
+        BuildNodeInput(graph, node, compiler_config->ResourceFile);
+        BuildNodeOutput(graph, node, output);
+    }
+#endif
 
-            if (compiler_config->Application != Application_Static_Library)
-            {
-                OutFormatted(&out, "-Fo\"%s/int/\" ", build_dir.Data);
+    LowerCompileNodes(graph, compiler_config);
 
-                if (compiler_config->Application == Application_Dynamic_Library)
-                    OutFormatted(&out, "-LD ");
+    if (compiler_config->Application == Application_Static_Library)
+    {
+        // The archive index of bitcode objects is written by the LTO plugin of gcc-ar
+        LowerArchiveNode(graph, compiler_config,
+                         compiler_config->Lto != Lto_None ? StringLiteral("gcc-ar") : StringLiteral("ar"));
+        return;
+    }
 
-                OutFormatted(&out, "-link ");
-                OutFormatted(&out, "-pdb:\"%s/%s.pdb\" ", build_dir.Data, build.Data);
+    Build_Node *node =
+        LowerLinkNode(graph, compiler_config, compiler_config->Language ? StringLiteral("g++") : StringLiteral("gcc"));
 
-                if (compiler_config->Application != Application_Static_Library)
-                    OutFormatted(&out, "-out:\"%s/%s.%s\" ", build_dir.Data, build.Data,
-                                 compiler_config->Application == Application_Executable ? ExecutableExtension
-                                                                                        : DynamicLibraryExtension);
+    if (PLATFORM_OS_WINDOWS)
+    {
+        BuildNodeArg(graph, node, StringLiteral("-w"));
+        BuildNodeArgFmt(graph, node, "-Wl,-subsystem,%s",
+                        compiler_config->Subsystem == Subsystem_Console ? "console" : "windows");
+    }
+}
 
-                if (compiler_config->Application == Application_Dynamic_Library)
-                    OutFormatted(&out, "-IMPLIB:\"%s/%s.%s\" ", build_dir.Data, build.Data, StaticLibraryExtension);
+// Lowers the configuration into the build graph of the given compiler, nothing is executed
+static void LowerCompilerConfig(Build_Graph *graph, Compiler_Config *compiler_config,
+                                const Compiler_Kind available_compilers, const Compiler_Kind compiler)
+{
+    String build_dir = compiler_config->BuildDirectory;
+    if (build_dir.Length > 1 && build_dir.Data[build_dir.Length - 1] == '/')
+        build_dir = FmtStr(compiler_config->Arena, "%.*s", (int)build_dir.Length - 1, build_dir.Data);
 
-                ForList(String_Array_List_Node, &compiler_config->LinkerFlags)
-                {
-                    ForListNode(&compiler_config->LinkerFlags, MAX_STRING_NODE_DATA_COUNT)
-                    {
-                        Int64 str_count = it->Data[index].Count;
-                        for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                            OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
-                    }
-                }
-            }
-            else
-            {
-                OutFormatted(&out, "-c ");
-                OutFormatted(&out, "-Fo\"%s/int/%s.obj\" ", build_dir.Data, build.Data);
+    BuildGraphInit(graph, compiler_config->Name, build_dir, compiler, compiler_config->Arena);
 
-                OutFormatted(&lib, "lib -nologo \"%s/int/%s.obj\" ", build_dir.Data, build.Data);
-                OutFormatted(&lib, "-out:\"%s/%s.%s\" ", build_dir.Data, build.Data, StaticLibraryExtension);
-            }
+    // Once collected by muda -pgo, the profile is used by every build of the configuration
+    if (compiler_config->ProfilePhase == Profile_Phase_None && compiler_config->Training.Length &&
+        OsCheckIfPathExists(ProfileDataPath(graph, compiler_config)) != Path_Does_Not_Exist)
+        compiler_config->ProfilePhase = Profile_Phase_Use;
 
-            Out_Stream *target = ((compiler_config->Application != Application_Static_Library) ? &out : &lib);
+    switch (compiler)
+    {
+    case Compiler_Bit_CL:
+        LowerCompilerConfigCL(graph, compiler_config);
+        break;
+    case Compiler_Bit_CLANG:
+        LowerCompilerConfigCLANG(graph, compiler_config, available_compilers);
+        break;
+    case Compiler_Bit_GCC:
+        LowerCompilerConfigGCC(graph, compiler_config);
+        break;
+    }
+}
 
-            ForList(String_Array_List_Node, &compiler_config->LibraryDirectories)
-            {
-                ForListNode(&compiler_config->LibraryDirectories, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "-LIBPATH:\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+// Every target keeps its build database in "BuildDirectory/<Build>.muda.db"
+static String BuildDbPath(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    return FmtStr(graph->Arena, "%s/%s.muda.db", graph->BuildDirectory.Data, compiler_config->Build.Data);
+}
 
-            ForList(String_Array_List_Node, &compiler_config->Libraries)
-            {
-                ForListNode(&compiler_config->Libraries, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "\"%s.%s\" ", it->Data[index].Values[str_index].Data,
-                                     StaticLibraryExtension);
-                }
-            }
+// The include scanner keeps the directives of the sources and headers in "BuildDirectory/<Build>.muda.inc"
+static String IncludeScannerPath(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    return FmtStr(graph->Arena, "%s/%s.muda.inc", graph->BuildDirectory.Data, compiler_config->Build.Data);
+}
 
-            if (PLATFORM_OS_WINDOWS)
-            {
-                OutFormatted(target, "-SUBSYSTEM:%s ",
-                             compiler_config->Subsystem == Subsystem_Console ? "CONSOLE" : "WINDOWS");
-            }
-        }
-        break;
+// GCC reads the BMI of the C++ modules from the mapper "BuildDirectory/<Build>.modules"
+static String ModuleMapperPath(Build_Graph *graph, Compiler_Config *compiler_config)
+{
+    return FmtStr(graph->Arena, "%s/%s.modules", graph->BuildDirectory.Data, compiler_config->Build.Data);
+}
 
-        case Compiler_Bit_CLANG: {
-            OutFormatted(&out, "%s -Wall ", compiler_config->Language ? "clang++" : "clang");
+// Adds one compile_commands.json entry for each compile node of the configuration, nothing is executed
+static void AddCompileDbEntries(Compile_Db *db, Compiler_Config *compiler_config,
+                                const Compiler_Kind available_compilers, const Compiler_Kind compiler)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
 
-            if (compiler_config->DebugSymbol)
-            {
-                OutFormatted(&out, "-g -gcodeview ");
-            }
+    Build_Graph      graph;
+    LowerCompilerConfig(&graph, compiler_config, available_compilers, compiler);
 
-            OutFormatted(&out, "%s ", compiler_config->Optimization ? "--optimize" : "--debug");
+    String directory = OsGetWorkingDirectory(db->Arena);
 
-            ForList(String_Array_List_Node, &compiler_config->Defines)
-            {
-                ForListNode(&compiler_config->Defines, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-D%s ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    for (Build_Node *node = graph.First; node; node = node->Next)
+    {
+        if (node->Kind != Build_Node_Compile)
+            continue;
+        CompileDbAdd(db, directory, BuildNodeFirstInput(node), BuildNodeCommandLine(node, scratch));
+    }
 
-            ForList(String_Array_List_Node, &compiler_config->IncludeDirectories)
-            {
-                ForListNode(&compiler_config->IncludeDirectories, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-I\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    EndTemporaryMemory(&temp);
+}
 
-            ForList(String_Array_List_Node, &compiler_config->Sources)
-            {
-                ForListNode(&compiler_config->Sources, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_config,
+                      const Compiler_Kind available_compilers, const Compiler_Kind compiler, const char *parent,
+                      bool is_root);
+void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, const Compiler_Kind available_compilers,
+                            const Compiler_Kind compiler, Compiler_Config *alternative_config, const char *parent,
+                            bool is_root);
 
-#if PLATFORM_OS_WINDOWS == 1
-            if (compiler_config->ResourceFile.Length)
-            {
-                OutFormatted(&res, "llvm-rc -FO \"%s/%s.res\" \"%s\" ", build_dir.Data, build.Data,
-                             compiler_config->ResourceFile.Data);
-                OutFormatted(&out, "\"%s/%s.res\" ", build_dir.Data, build.Data);
-            }
-#endif
+// Graphs kept by the daemon are found by the working directory, the name and the build directory of the configuration
+static Daemon_Graph *DaemonGraphFind(Daemon_Cache *cache, Compiler_Config *compiler_config)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
 
-            ForList(String_Array_List_Node, &compiler_config->Flags)
-            {
-                ForListNode(&compiler_config->Flags, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    String           name    = compiler_config->Name;
+    String           dir     = compiler_config->BuildDirectory;
+    Uint64           key     = StrHash(OsGetWorkingDirectory(scratch));
+    key                      = HashBytes(key, &name.Length, sizeof(name.Length));
+    key                      = HashBytes(key, name.Data, name.Length);
+    key                      = HashBytes(key, dir.Data, dir.Length);
 
-            if (compiler_config->Application != Application_Static_Library)
-            {
+    EndTemporaryMemory(&temp);
 
-                if (compiler_config->Application == Application_Dynamic_Library)
-                    OutFormatted(&out, "--shared ");
+    Uint64        time  = SourcePatternsTime(compiler_config);
+    Daemon_Graph *graph = DaemonCacheFindGraph(cache, key);
+    if (graph->SourcesTime != time)
+    {
+        graph->SourcesTime = time;
+        graph->Lowered     = false;
+    }
+    return graph;
+}
 
-                if (compiler_config->Application != Application_Static_Library)
-                {
-                    OutFormatted(&out, "-o \"%s/%s.%s\" ", build_dir.Data, build.Data,
-                                 compiler_config->Application == Application_Executable ? ExecutableExtension
-                                                                                        : DynamicLibraryExtension);
-                }
+// Lowers the configuration and executes the actions that are not up to date, false if one of them failed
+static bool BuildProject(Build_Graph *graph, Compiler_Config *compiler_config, Build_Config *build_config,
+                         const Compiler_Kind available_compilers, const Compiler_Kind compiler, String intermediate)
+{
+    Uint64        lower_start = OsGetMonotonicTime();
 
-                ForList(String_Array_List_Node, &compiler_config->LinkerFlags)
-                {
-                    ForListNode(&compiler_config->LinkerFlags, MAX_STRING_NODE_DATA_COUNT)
-                    {
-                        Int64 str_count = it->Data[index].Count;
-                        for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                            OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
-                    }
-                }
-            }
-            else
-            {
-                OutFormatted(&out, "-c ");
-                OutFormatted(&lib, "-o \"%s/%s.%s\" ", build_dir.Data, build.Data, StaticLibraryExtension);
-            }
+    // The daemon keeps the graph, the include scanner and the build database are loaded again as every build writes
+    // them. Graphs using a profile are not kept, the daemon does not check it.
+    Daemon_Graph *kept        = NULL;
+    Memory_Arena *arena       = compiler_config->Arena;
+    if (build_config->DaemonCache && !compiler_config->Training.Length)
+    {
+        kept  = DaemonGraphFind(build_config->DaemonCache, compiler_config);
+        arena = &build_config->DaemonCache->Build;
+        MemoryArenaReset(arena);
+    }
 
-            Out_Stream *target = ((compiler_config->Application != Application_Static_Library) ? &out : &lib);
+    if (kept && kept->Lowered)
+        *graph = kept->Graph;
+    else
+        LowerCompilerConfig(graph, compiler_config, available_compilers, compiler);
+
+    Uint64          scan_start = OsGetMonotonicTime();
+    Include_Scanner includes;
+    IncludeScannerLoad(&includes, IncludeScannerPath(graph, compiler_config), arena, build_config->SharedArena);
+    IncludeScannerRun(&includes, graph, build_config->ThreadPool);
+    IncludeScannerSave(&includes);
+    bool modules = false;
+    if (compiler_config->Language == Language_Cpp)
+        modules =
+            BuildGraphLowerModules(graph, &includes, intermediate, ModuleMapperPath(graph, compiler_config), true);
+    TraceAddEvent(build_config->Trace, "includes", compiler_config->Name, scan_start, OsGetMonotonicTime(), 0);
+
+    Build_Db db;
+    BuildDbLoad(&db, BuildDbPath(graph, compiler_config), arena);
+    Uint32 dirty_count = BuildGraphEvaluate(graph, &db, build_config->ForceRebuild);
+    TraceAddEvent(build_config->Trace, "lower", compiler_config->Name, lower_start, OsGetMonotonicTime(), 0);
+
+    // The options of the module units are added by every build, the graph is lowered again
+    if (kept)
+    {
+        kept->Graph   = *graph;
+        kept->Lowered = !modules;
+    }
 
-            ForList(String_Array_List_Node, &compiler_config->LibraryDirectories)
-            {
-                ForListNode(&compiler_config->LibraryDirectories, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "-L\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    if (!dirty_count)
+    {
+        LogInfo("Everything is up to date\n\n");
+        return true;
+    }
 
-            ForList(String_Array_List_Node, &compiler_config->Libraries)
-            {
-                ForListNode(&compiler_config->Libraries, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "\"-l%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+    bool succeeded = BuildGraphExecute(graph, &db, build_config);
+    if (succeeded)
+        LogInfo("Compilation succeeded\n\n");
+    else
+        LogError("Compilation failed\n\n");
+    return succeeded;
+}
 
-            if (PLATFORM_OS_WINDOWS)
-            {
-                if (available_compilers & Compiler_Bit_GCC)
-                {
-                    OutFormatted(target, "-fuse-ld=ld ");
-                    OutFormatted(target, "\"-Wl,--subsystem,%s\" ",
-                                 compiler_config->Subsystem == Subsystem_Console ? "console" : "windows");
-                }
-                else
-                {
-                    if (available_compilers & Compiler_Bit_CL)
-                        OutFormatted(target, "-fuse-ld=link ");
-                    else
-                        OutFormatted(target, "-fuse-ld=lld ");
-                    OutFormatted(target, "-Xlinker -subsystem:%s ",
-                                 compiler_config->Subsystem == Subsystem_Console ? "CONSOLE" : "WINDOWS");
-                }
-            }
+static Directory_Iteration ProfileClearIterator(const File_Info *info, void *user_context)
+{
+    String *pattern = (String *)user_context;
+    if (!(info->Atribute & File_Attribute_Directory) && StrMatchWildcard(*pattern, info->Name))
+        OsFileDelete(info->Path);
+    return Directory_Iteration_Continue;
+}
+
+// muda -pgo: the instrumented build is run by the Training command, the profiles it writes are merged and the
+// configuration is built again using them
+static bool BuildProjectProfileGuided(Build_Graph *graph, Compiler_Config *compiler_config, Build_Config *build_config,
+                                      const Compiler_Kind available_compilers, const Compiler_Kind compiler,
+                                      String intermediate)
+{
+    LogInfo("==> Building with instrumentation\n");
+    compiler_config->ProfilePhase = Profile_Phase_Instrument;
+
+    // GCC names the .gcda after the path of the object, which is not the same on the workers
+    struct Remote_Pool *remote    = build_config->Remote;
+    build_config->Remote          = NULL;
+    bool                succeeded = BuildProject(graph, compiler_config, build_config, available_compilers, compiler,
+                                                 intermediate);
+    build_config->Remote          = remote;
+    if (!succeeded)
+        return false;
+
+    // The counts of the previous trainings would be added to the new ones
+    String directory = ProfileDirectory(graph);
+    String pattern   = graph->Compiler == Compiler_Bit_GCC ? StringLiteral("*.gcda") : StringLiteral("*.profraw");
+    if (graph->Compiler == Compiler_Bit_CL)
+    {
+        directory = graph->BuildDirectory;
+        pattern   = FmtStr(graph->Arena, "%s!*.pgc", compiler_config->Build.Data);
+    }
+    if (OsCheckIfPathExists(directory) == Path_Exist_Directory)
+        OsIterateDirectory((const char *)directory.Data, ProfileClearIterator, &pattern);
+
+    LogInfo("==> Executing Training command\n");
+    LogFlush();
+    if (!OsExecuteCommandLine(compiler_config->Training))
+    {
+        LogError("Training execution failed. Aborted.\n\n");
+        return false;
+    }
+    LogInfo("Finished executing Training command\n");
+
+    if (graph->Compiler == Compiler_Bit_CLANG)
+    {
+        String merge = FmtStr(graph->Arena, "llvm-profdata merge -output=%s %s",
+                              ProfileDataPath(graph, compiler_config).Data, directory.Data);
+        LogFlush();
+        if (!OsExecuteCommandLine(merge))
+        {
+            LogError("Merging the profiles failed. Aborted.\n\n");
+            return false;
         }
-        break;
+    }
 
-        case Compiler_Bit_GCC: {
-            OutFormatted(&out, "%s -Wall ", compiler_config->Language ? "g++" : "gcc");
-            OutFormatted(&out, "%s ", compiler_config->Optimization ? "-O2" : "-O");
+    LogInfo("==> Building with the profile\n");
+    compiler_config->ProfilePhase = Profile_Phase_Use;
+    return BuildProject(graph, compiler_config, build_config, available_compilers, compiler, intermediate);
+}
 
-            ForList(String_Array_List_Node, &compiler_config->Defines)
-            {
-                ForListNode(&compiler_config->Defines, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-D%s ", it->Data[index].Values[str_index].Data);
-                }
-            }
+// Creates the directory if it does not exist, false if it can not be used
+static bool BuildDirectoryCreate(String path)
+{
+    Uint32 result = OsCheckIfPathExists(path);
+    if (result == Path_Does_Not_Exist)
+    {
+        if (!OsCreateDirectoryRecursively(path))
+        {
+            LogError("Failed to create directory %s! Aborted.\n", path.Data);
+            return false;
+        }
+    }
+    else if (result == Path_Exist_File)
+    {
+        LogError("%s: Path exist but is a file! Aborted.\n", path.Data);
+        return false;
+    }
+    return true;
+}
 
-            ForList(String_Array_List_Node, &compiler_config->IncludeDirectories)
+// Builds the configuration again for each of the TargetVariants, in "BuildDirectory/<TargetCPU>"
+static bool BuildTargetVariants(Compiler_Config *compiler_config, Build_Config *build_config,
+                                const Compiler_Kind available_compilers, const Compiler_Kind compiler)
+{
+    String build_dir = compiler_config->BuildDirectory;
+    if (build_dir.Length > 1 && build_dir.Data[build_dir.Length - 1] == '/')
+        build_dir.Length -= 1;
+
+    bool succeeded = true;
+    ForList(String_Array_List_Node, &compiler_config->TargetVariants)
+    {
+        ForListNode(&compiler_config->TargetVariants, MAX_STRING_NODE_DATA_COUNT)
+        {
+            Int64 str_count = it->Data[index].Count;
+            for (Int64 str_index = 0; str_index < str_count; ++str_index)
             {
-                ForListNode(&compiler_config->IncludeDirectories, MAX_STRING_NODE_DATA_COUNT)
+                String variant = it->Data[index].Values[str_index];
+                Uint32 cpu     = Target_Cpu_Default;
+                for (Uint32 id = Target_Cpu_Native; id < ArrayCount(TargetCpuKindId); ++id)
                 {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "-I\"%s\" ", it->Data[index].Values[str_index].Data);
+                    if (StrMatch(TargetCpuKindId[id], variant))
+                        cpu = id;
                 }
-            }
 
-            ForList(String_Array_List_Node, &compiler_config->Sources)
-            {
-                ForListNode(&compiler_config->Sources, MAX_STRING_NODE_DATA_COUNT)
+                if (cpu == Target_Cpu_Default)
                 {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "\"%s\" ", it->Data[index].Values[str_index].Data);
+                    LogError("Invalid value for Property \"TargetVariants\" : %s, skipped.\n", variant.Data);
+                    succeeded = false;
+                    continue;
                 }
-            }
 
-#if PLATFORM_OS_WINDOWS == 1
-            if (compiler_config->ResourceFile.Length)
-            {
-                OutFormatted(&res, "windres -i \"%s\" \"%s/%s.o\" ", compiler_config->ResourceFile.Data, build_dir.Data,
-                             build.Data);
-                OutFormatted(&out, "\"%s/%s.o\" ", build_dir.Data, build.Data);
-            }
-#endif
+                // The profile collected by muda -pgo is only for the objects of the main build
+                Compiler_Config config = *compiler_config;
+                config.TargetCpu       = cpu;
+                config.ProfilePhase    = Profile_Phase_None;
+                config.BuildDirectory  = FmtStr(compiler_config->Arena, "%.*s/%s", (int)build_dir.Length,
+                                                build_dir.Data, variant.Data);
 
-            ForList(String_Array_List_Node, &compiler_config->Flags)
-            {
-                ForListNode(&compiler_config->Flags, MAX_STRING_NODE_DATA_COUNT)
+                LogInfo("==> Building %s variant\n", variant.Data);
+                String intermediate = BuildIntermediateDirectory(config.BuildDirectory, compiler_config->Arena);
+                if (!BuildDirectoryCreate(config.BuildDirectory) || !BuildDirectoryCreate(intermediate))
                 {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
+                    succeeded = false;
+                    continue;
                 }
+
+                Build_Graph graph;
+                if (!BuildProject(&graph, &config, build_config, available_compilers, compiler, intermediate))
+                    succeeded = false;
             }
+        }
+    }
+    return succeeded;
+}
 
-            if (compiler_config->Application != Application_Static_Library)
-            {
+void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_config,
+                      const Compiler_Kind available_compilers, const Compiler_Kind compiler, const char *parent,
+                      bool is_root)
+{
+    Memory_Arena    *scratch       = ThreadScratchpad();
 
-                if (compiler_config->Application == Application_Dynamic_Library)
-                    OutFormatted(&out, "--shared ");
+    Temporary_Memory temp          = BeginTemporaryMemory(scratch);
 
-                if (compiler_config->Application != Application_Static_Library)
-                    OutFormatted(&out, "-o \"%s/%s.%s\" ", build_dir.Data, build.Data,
-                                 compiler_config->Application == Application_Executable ? ExecutableExtension
-                                                                                        : DynamicLibraryExtension);
+    if (build_config->GenerateCompileDb && compiler_config->Kind == Compile_Project)
+    {
+        if (build_config->ForceOptimization)
+            CompilerConfigForceOptimization(compiler_config);
+        AddCompileDbEntries(&build_config->CompileDb, compiler_config, available_compilers, compiler);
+        EndTemporaryMemory(&temp);
+        return;
+    }
 
-                ForList(String_Array_List_Node, &compiler_config->LinkerFlags)
-                {
-                    ForListNode(&compiler_config->LinkerFlags, MAX_STRING_NODE_DATA_COUNT)
-                    {
-                        Int64 str_count = it->Data[index].Count;
-                        for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                            OutFormatted(&out, "%s ", it->Data[index].Values[str_index].Data);
-                    }
-                }
-            }
-            else
-            {
-                OutFormatted(&out, "-c ");
-                OutFormatted(&lib, "-o \"%s/%s.%s\" ", build_dir.Data, build.Data, StaticLibraryExtension);
-            }
+    if (build_config->DryRun && compiler_config->Kind == Compile_Project)
+    {
+        if (build_config->ForceOptimization)
+            CompilerConfigForceOptimization(compiler_config);
 
-            Out_Stream *target = ((compiler_config->Application != Application_Static_Library) ? &out : &lib);
+        Build_Graph graph;
+        LowerCompilerConfig(&graph, compiler_config, available_compilers, compiler);
 
-            ForList(String_Array_List_Node, &compiler_config->LibraryDirectories)
-            {
-                ForListNode(&compiler_config->LibraryDirectories, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "-L\"%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+        Include_Scanner includes;
+        IncludeScannerLoad(&includes, IncludeScannerPath(&graph, compiler_config), compiler_config->Arena, NULL);
+        IncludeScannerRun(&includes, &graph, NULL);
+        if (compiler_config->Language == Language_Cpp)
+            BuildGraphLowerModules(&graph, &includes, BuildIntermediateDirectory(graph.BuildDirectory, scratch),
+                                   ModuleMapperPath(&graph, compiler_config), false);
 
-            ForList(String_Array_List_Node, &compiler_config->Libraries)
-            {
-                ForListNode(&compiler_config->Libraries, MAX_STRING_NODE_DATA_COUNT)
-                {
-                    Int64 str_count = it->Data[index].Count;
-                    for (Int64 str_index = 0; str_index < str_count; ++str_index)
-                        OutFormatted(target, "\"-l%s\" ", it->Data[index].Values[str_index].Data);
-                }
-            }
+        Build_Db db;
+        BuildDbLoad(&db, BuildDbPath(&graph, compiler_config), compiler_config->Arena);
+        BuildGraphEvaluate(&graph, &db, build_config->ForceRebuild);
+        BuildGraphPrint(&graph, build_config->ExplainDirty);
 
-            if (PLATFORM_OS_WINDOWS)
-            {
-                OutFormatted(target, "-w -Wl,-subsystem,%s ",
-                             compiler_config->Subsystem == Subsystem_Console ? "console" : "windows");
-            }
+        EndTemporaryMemory(&temp);
+        return;
+    }
+
+    bool             prebuild_pass = true;
+    if (compiler_config->Prebuild.Length && !build_config->GenerateCompileDb && !build_config->DryRun)
+    {
+        LogInfo("==> Executing Prebuild command\n");
+        LogFlush();
+        if (!OsExecuteCommandLine(compiler_config->Prebuild))
+        {
+            prebuild_pass        = false;
+            build_config->Failed = true;
+            LogError("Prebuild execution failed. Aborted.\n\n");
+            if (compiler_config->Kind != Compile_Project)
+                return;
         }
-        break;
+        else
+        {
+            LogInfo("Finished executing Prebuild command\n");
         }
+    }
 
-        String cmd_line                  = OutBuildStringSerial(&out, compiler_config->Arena);
+    bool              execute_postbuild = true;
 
-        execute_postbuild                = false;
+    Muda_Plugin_Event pevent;
+    memset(&pevent, 0, sizeof(pevent));
 
-        bool resource_compilation_passed = true;
-        if (res.Size)
-        {
-            LogInfo("Executing Resource compilation\n");
-            String resource_cmd_line = OutBuildStringSerial(&res, scratch);
+    if (compiler_config->Kind == Compile_Project)
+    {
+        String build_dir                 = compiler_config->BuildDirectory;
+        String build                     = compiler_config->Build;
 
-            if (build_config->DisplayCommandLine)
-            {
-                LogInfo("Resource Command Line: %s\n", resource_cmd_line.Data);
-            }
+        pevent.Data.Prebuild.MudaDirName = parent;
+        pevent.Data.Prebuild.Name        = compiler_config->Name.Data;
+        pevent.Data.Prebuild.Build       = build.Data;
+        pevent.Data.Prebuild.BuildDir    = build_dir.Data;
+        pevent.Data.Prebuild.Succeeded   = prebuild_pass;
+        pevent.Data.Prebuild.RootBuild   = is_root;
 
-            if (OsExecuteCommandLine(resource_cmd_line))
-            {
-                LogInfo("Resource Compilation succeeded\n");
-            }
-            else
-            {
-                LogInfo("Resource Compilation failed\n");
-                resource_compilation_passed = false;
-            }
-        }
+        if (compiler_config->Application == Application_Executable)
+            pevent.Data.Prebuild.BuildExtension = ExecutableExtension;
+        else if (compiler_config->Application == Application_Dynamic_Library)
+            pevent.Data.Prebuild.BuildExtension = DynamicLibraryExtension;
+        else
+            pevent.Data.Prebuild.BuildExtension = StaticLibraryExtension;
+
+        pevent.Kind = Muda_Plugin_Event_Kind_Prebuild;
+        PluginDispatch(build_config, &pevent);
+
+        if (!prebuild_pass)
+            return;
+
+        LogInfo("Beginning compilation\n");
 
-        if (resource_compilation_passed)
+        // Object files are written to "BuildDirectory/int"
+        String intermediate = BuildIntermediateDirectory(build_dir, scratch);
+        if (!BuildDirectoryCreate(build_dir) || !BuildDirectoryCreate(intermediate))
         {
-            if (build_config->DisplayCommandLine)
-            {
-                LogInfo("Compiler Command Line: %s\n", cmd_line.Data);
-            }
+            build_config->Failed = true;
+            return;
+        }
 
-            LogInfo("Executing compilation\n");
-            if (OsExecuteCommandLine(cmd_line))
-            {
-                LogInfo("Compilation succeeded\n\n");
-                if (lib.Size)
-                {
-                    if (build_config->DisplayCommandLine)
-                    {
-                        LogInfo("Linker Command Line: %s\n", cmd_line.Data);
-                    }
+        // Turn on Optimization if it is forced via command line
+        if (build_config->ForceOptimization)
+        {
+            LogInfo("Optimization turned on forcefully\n");
+            CompilerConfigForceOptimization(compiler_config);
+        }
 
-                    LogInfo("Creating static library\n");
-                    cmd_line = OutBuildStringSerial(&lib, compiler_config->Arena);
-                    if (OsExecuteCommandLine(cmd_line))
-                    {
-                        LogInfo("Library creation succeeded\n");
-                        execute_postbuild = true;
-                    }
-                    else
-                    {
-                        LogError("Library creation failed\n");
-                    }
-                }
-                else
-                {
-                    execute_postbuild = true;
-                }
-            }
-            else
-            {
-                LogError("Compilation failed\n\n");
-            }
+        Build_Graph graph;
+        if (build_config->ProfileGuided && compiler_config->Training.Length)
+        {
+            execute_postbuild = BuildProjectProfileGuided(&graph, compiler_config, build_config, available_compilers,
+                                                          compiler, intermediate);
+        }
+        else
+        {
+            if (build_config->ProfileGuided)
+                LogWarn("Training is not set, built without profile guided optimization\n");
+            execute_postbuild =
+                BuildProject(&graph, compiler_config, build_config, available_compilers, compiler, intermediate);
         }
+
+        if (execute_postbuild && !StringArrayListIsEmpty(&compiler_config->TargetVariants))
+            execute_postbuild = BuildTargetVariants(compiler_config, build_config, available_compilers, compiler);
+        build_config->Failed |= !execute_postbuild;
     }
     else
     {
@@ -1010,7 +1459,8 @@ void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_conf
             filtered_list = &compiler_config->ProjectDirectories;
         }
 
-        Memory_Arena *arena = compiler_config->Arena;
+        // The configurations kept by the daemon are allocated from the memory of the solution, it is not released
+        Memory_Arena *arena = build_config->DaemonCache ? scratch : compiler_config->Arena;
         ForList(String_Array_List_Node, filtered_list)
         {
             ForListNode(filtered_list, MAX_STRING_NODE_DATA_COUNT)
@@ -1050,12 +1500,15 @@ void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_conf
         compiler_config->Kind = Compile_Solution;
     }
 
-    if (execute_postbuild && compiler_config->Postbuild.Length)
+    if (execute_postbuild && compiler_config->Postbuild.Length && !build_config->GenerateCompileDb &&
+        !build_config->DryRun)
     {
         LogInfo("==> Executing Postbuild command\n");
+        LogFlush();
         if (!OsExecuteCommandLine(compiler_config->Postbuild))
         {
-            execute_postbuild = false;
+            execute_postbuild    = false;
+            build_config->Failed = true;
             LogError("Postbuild execution failed. \n\n");
         }
         else
@@ -1068,7 +1521,7 @@ void ExecuteMudaBuild(Compiler_Config *compiler_config, Build_Config *build_conf
     {
         pevent.Kind                    = Muda_Plugin_Event_Kind_Postbuild;
         pevent.Data.Prebuild.Succeeded = execute_postbuild;
-        build_config->PluginHook(&ThreadContext, &build_config->Interface, &pevent);
+        PluginDispatch(build_config, &pevent);
     }
 
     EndTemporaryMemory(&temp);
@@ -1080,6 +1533,8 @@ void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, con
 {
     Temporary_Memory      arena_temp = BeginTemporaryMemory(arena);
 
+    Compile_Db_Entry     *compdb_mark = build_config->CompileDb.Last;
+
     Compiler_Config_List *configs    = (Compiler_Config_List *)PushSize(arena, sizeof(Compiler_Config_List));
     CompilerConfigListInit(configs, arena);
 
@@ -1103,8 +1558,24 @@ void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, con
         }
     }
 
-    if (config_path.Length)
+    // The daemon parses a file again only once it is modified
+    Daemon_Cache         *cache = build_config->DaemonCache;
+    Compiler_Config_List *kept  = NULL;
+    if (cache && config_path.Length)
+        kept = DaemonCacheFindConfigs(cache, config_path);
+
+    if (kept)
+    {
+        configs = kept;
+    }
+    else if (config_path.Length)
     {
+        if (cache)
+        {
+            configs = PushType(&cache->Arena, Compiler_Config_List);
+            CompilerConfigListInit(configs, &cache->Arena);
+        }
+
         LogInfo("Found muda configuration file: \"%s\"\n", config_path.Data);
 
         File_Handle fp = OsFileOpen(config_path, File_Mode_Read);
@@ -1125,8 +1596,12 @@ void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, con
             {
                 buffer[size] = 0;
                 LogInfo("Parsing muda file\n");
+                Uint64 parse_start = OsGetMonotonicTime();
                 DeserializeMuda(build_config, configs, buffer, compiler, parent);
+                TraceAddEvent(build_config->Trace, "parse", config_path, parse_start, OsGetMonotonicTime(), 0);
                 LogInfo("Finished parsing muda file\n");
+                if (cache)
+                    DaemonCacheAddConfigs(cache, config_path, configs);
             }
             else if (size == 0)
             {
@@ -1190,129 +1665,495 @@ void SearchExecuteMudaBuild(Memory_Arena *arena, Build_Config *build_config, con
         }
     }
 
+    if (build_config->GenerateCompileDb)
+    {
+        // Solutions include the entries of all the projects built under it
+        Compile_Db_Entry *first = compdb_mark ? compdb_mark->Next : build_config->CompileDb.First;
+        if (first)
+        {
+            if (CompileDbWrite(first, StringLiteral("compile_commands.json")))
+                LogInfo("Generated compile_commands.json\n");
+            else
+                LogError("Could not write compile_commands.json\n");
+        }
+    }
+
     EndTemporaryMemory(&arena_temp);
 }
 
-int main(int argc, char *argv[])
+static void PrintMemoryStats()
 {
-    InitThreadContext(NullMemoryAllocator(), MegaBytes(512), (Log_Agent){.Procedure = LogProcedure},
-                      FatalErrorProcedure);
+    Uint32 count = MemoryArenaStatsCount();
 
-    OsSetupConsole();
+    OsConsoleWrite("\n%-24s %12s %12s %12s %12s %12s %10s\n", "Arena (KB)", "Reserved", "High water", "Committed",
+                   "Peak commit", "Allocations", "Temp depth");
+    for (Uint32 index = 0; index < count; ++index)
+    {
+        Memory_Arena_Stats *stats = MemoryArenaStatsGet(index);
+        OsConsoleWrite("%-24s %12.1f %12.1f %12.1f %12.1f %12llu %10u\n", stats->Name, (double)stats->Reserved / 1024.0,
+                       (double)stats->HighWater / 1024.0, (double)stats->Committed / 1024.0,
+                       (double)stats->PeakCommitted / 1024.0, (unsigned long long)stats->AllocationCount,
+                       stats->MaxTemporaryDepth);
+    }
 
-    Build_Config build_config;
-    BuildConfigInit(&build_config);
-    if (HandleCommandLineArguments(argc, argv, &build_config))
-        return 0;
+    OsConsoleWrite("\nAllocation sizes\n");
+    for (Uint32 index = 0; index < count; ++index)
+    {
+        Memory_Arena_Stats *stats = MemoryArenaStatsGet(index);
+        if (!stats->AllocationCount)
+            continue;
 
-    Compiler_Kind compiler = OsDetectCompiler();
-    if (compiler == 0)
+        OsConsoleWrite("%-24s", stats->Name);
+        for (Uint32 bucket = 0; bucket < MEMORY_ARENA_HISTOGRAM_BUCKETS; ++bucket)
+        {
+            if (!stats->Histogram[bucket])
+                continue;
+            if (bucket == MEMORY_ARENA_HISTOGRAM_BUCKETS - 1)
+                OsConsoleWrite(" >%llu: %llu", (unsigned long long)(8ull << (bucket - 1)),
+                               (unsigned long long)stats->Histogram[bucket]);
+            else
+                OsConsoleWrite(" <=%llu: %llu", (unsigned long long)(8ull << bucket),
+                               (unsigned long long)stats->Histogram[bucket]);
+        }
+        OsConsoleWrite("\n");
+    }
+    OsConsoleWrite("\n");
+
+    // Temporary memory that was never ended is only given back when an enclosing one ends
+    for (Uint32 index = 0; index < count; ++index)
     {
-        LogError("Failed to detect compiler! Installation of compiler is required...\n");
-        if (PLATFORM_OS_WINDOWS)
-            OsConsoleWrite("[Visual Studio - MSVC] https://visualstudio.microsoft.com/ \n");
-        OsConsoleWrite("[CLANG] https://releases.llvm.org/download.html \n");
-        OsConsoleWrite("[GCC] https://gcc.gnu.org/install/download.html \n");
-        return 1;
+        Memory_Arena_Stats *stats = MemoryArenaStatsGet(index);
+        if (stats->TemporaryDepth)
+            LogWarn("%u temporary memory blocks of %s were never ended\n", stats->TemporaryDepth, stats->Name);
     }
+}
 
-    if (build_config.DisableLogs)
-        ThreadContext.LogAgent.Procedure = LogProcedureDisabled;
+typedef struct Arena_Strategy
+{
+    const char *Name;
+    Uint32      Flags;
+    Ptrsize     CommitSize;
+} Arena_Strategy;
+
+static const Arena_Strategy ArenaBenchmarkStrategies[] = {
+    {"commit 64 MB chunks", 0, MEMORY_ALLOCATOR_COMMIT_SIZE},
+    {"commit 2 MB chunks", 0, MegaBytes(2)},
+    {"commit 64 KB chunks", 0, KiloBytes(64)},
+    {"eager commit", Memory_Arena_Commit_Eager, MEMORY_ALLOCATOR_COMMIT_SIZE},
+    {"eager commit, populate", Memory_Arena_Commit_Eager | Memory_Arena_Populate, MEMORY_ALLOCATOR_COMMIT_SIZE},
+    {"transparent huge pages", Memory_Arena_Huge_Pages, MegaBytes(2)},
+    {"transparent huge pages, populate", Memory_Arena_Huge_Pages | Memory_Arena_Populate, MegaBytes(2)},
+    {"huge tlb", Memory_Arena_Huge_TLB, MEMORY_ALLOCATOR_COMMIT_SIZE},
+};
+
+// Parses the muda file of the working directory and lowers its projects "iterations" times with every strategy
+// The arena is created inside the measurement, so the time spent committing and faulting in pages is included
+static void BenchmarkArenaStrategies(Memory_Arena *arena, Build_Config *build_config,
+                                     const Compiler_Kind available_compilers, const Compiler_Kind compiler)
+{
+    const String muda_file = StringLiteral("build.muda");
 
-    if (build_config.LogFilePath)
+    File_Handle  fp        = OsFileOpen(muda_file, File_Mode_Read);
+    if (!fp.PlatformFileHandle)
     {
-        File_Handle handle =
-            OsFileOpen(StringMake(build_config.LogFilePath, strlen(build_config.LogFilePath)), File_Mode_Write);
-        if (handle.PlatformFileHandle)
-        {
-            ThreadContext.LogAgent.Data = handle.PlatformFileHandle;
-            LogInfo("Logging to file: %s\n", build_config.LogFilePath);
-        }
-        else
-        {
-            LogError("Could not open file: \"%s\" for logging. Logging to file disabled.\n");
-        }
+        LogError("Could not open %s for the benchmark\n", muda_file.Data);
+        return;
     }
 
-    void *plugin = NULL;
-    if (build_config.EnablePlugins)
+    Ptrsize size = OsFileGetSize(fp);
+    Uint8  *file = PushSize(arena, size + 1);
+    bool    read = size && OsFileRead(fp, file, size);
+    OsFileClose(fp);
+    if (!read)
     {
-        plugin = OsLibraryLoad(MudaPluginPath);
-        if (plugin)
-        {
-            typedef void (*PluginVersionProc)(uint32_t * major, uint32_t * minor, uint32_t * patch);
-            PluginVersionProc check_version = (PluginVersionProc)OsGetProcedureAddress(plugin, "MudaAcceptVersion");
+        LogError("Could not read %s for the benchmark\n", muda_file.Data);
+        return;
+    }
 
-            if (check_version)
+    Uint32        iterations = build_config->BenchmarkIterations;
+    Log_Procedure log        = ThreadContext.LogAgent.Procedure;
+
+    LogFlush();
+    OsConsoleWrite("Benchmark: %u iterations of %s (%zu bytes) with %s\n\n", iterations, muda_file.Data, size,
+                   GetCompilerName(compiler));
+    OsConsoleWrite("%-34s %10s %12s %10s %12s\n", "Strategy", "Total ms", "us/iteration", "MB/s", "Page faults");
+
+    for (Uint32 strategy_index = 0; strategy_index < ArrayCount(ArenaBenchmarkStrategies); ++strategy_index)
+    {
+        const Arena_Strategy *strategy = &ArenaBenchmarkStrategies[strategy_index];
+
+        ThreadContext.LogAgent.Procedure = LogProcedureDisabled;
+
+        Uint64       faults = OsGetPageFaultCount();
+        Uint64       start  = OsGetMonotonicTime();
+
+        Memory_Arena bench  = MemoryArenaCreateEx(MegaBytes(128), strategy->Flags, strategy->CommitSize);
+        if (bench.Memory)
+        {
+            for (Uint32 iteration = 0; iteration < iterations; ++iteration)
             {
-                uint32_t major, minor, patch;
-                check_version(&major, &minor, &patch);
+                Temporary_Memory temp = BeginTemporaryMemory(&bench);
 
-                uint32_t supported_major   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_MAJOR;
-                uint32_t supported_minor   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_MINOR;
-                uint32_t supported_patch   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_PATCH;
+                Uint8           *data = PushSize(&bench, size + 1);
+                memcpy(data, file, size);
+                data[size]                    = 0;
 
-                uint32_t plugin_version    = MudaMakeVersion(major, minor, patch);
-                uint32_t supported_version = MudaMakeVersion(supported_major, supported_minor, supported_patch);
-                uint32_t current_version   = MUDA_CURRENT_VERSION;
+                Compiler_Config_List *configs = PushType(&bench, Compiler_Config_List);
+                CompilerConfigListInit(configs, &bench);
+                DeserializeMuda(build_config, configs, data, compiler, "benchmark");
 
-                if (plugin_version <= current_version && plugin_version >= supported_version)
+                ForList(Compiler_Config_Node, configs)
                 {
-                    build_config.PluginHook =
-                        (Muda_Event_Hook_Procedure)OsGetProcedureAddress(plugin, MudaPluginProcedureName);
-                    if (build_config.PluginHook)
+                    ForListNode(configs, ArrayCount(configs->Head.Config))
                     {
-                        Muda_Parsing_COMPILER forced_compiler = Muda_Parsing_COMPILER_ALL;
-                        if (build_config.ForceCompiler == Compiler_Bit_CL)
-                            forced_compiler = Muda_Parsing_COMPILER_CL;
-                        else if (build_config.ForceCompiler == Compiler_Bit_CLANG)
-                            forced_compiler = Muda_Parsing_COMPILER_CLANG;
-                        else if (build_config.ForceCompiler == Compiler_Bit_GCC)
-                            forced_compiler = Muda_Parsing_COMPILER_GCC;
-
-                        build_config.Interface.CommandLineConfig.Flags = 0;
-                        if (build_config.ForceCompiler)
-                            build_config.Interface.CommandLineConfig.Flags |= Command_Line_Flag_Force_Optimization;
-                        if (build_config.DisplayCommandLine)
-                            build_config.Interface.CommandLineConfig.Flags |= Command_Line_Flag_Display_Command_Line;
-                        if (build_config.DisableLogs)
-                            build_config.Interface.CommandLineConfig.Flags |= Command_Line_Flag_Disable_Logs;
-
-                        build_config.Interface.CommandLineConfig.ForceCompiler      = forced_compiler;
-                        build_config.Interface.CommandLineConfig.Configurations =
-                            (Muda_String *)build_config.Configurations;
-                        build_config.Interface.CommandLineConfig.ConfigurationCount = build_config.ConfigurationCount;
-                        build_config.Interface.CommandLineConfig.LogFilePath        = build_config.LogFilePath;
-
-                        Muda_Plugin_Event pevent;
-                        memset(&pevent, 0, sizeof(pevent));
-                        pevent.Kind = Muda_Plugin_Event_Kind_Detection;
-                        if (build_config.PluginHook(&ThreadContext, &build_config.Interface, &pevent) == 0)
-                        {
-                            LogInfo("Plugin detected. Name: %s\n", build_config.Interface.PluginName);
-                        }
-                        else
-                        {
-                            LogInfo("Loading of Plugin failed.\n");
-                            build_config.PluginHook = NullMudaEventHook;
-                        }
-                    }
-                    else
-                    {
-                        LogWarn("Plugin dectected by could not be loaded\n");
+                        Compiler_Config *config = &it->Config[index];
+                        if (config->Kind != Compile_Project)
+                            continue;
+                        PushDefaultCompilerConfig(config, false);
+                        Build_Graph graph;
+                        LowerCompilerConfig(&graph, config, available_compilers, compiler);
                     }
                 }
-                else
+
+                EndTemporaryMemory(&temp);
+            }
+        }
+
+        Uint64 elapsed                   = OsGetMonotonicTime() - start;
+        faults                           = OsGetPageFaultCount() - faults;
+
+        ThreadContext.LogAgent.Procedure = log;
+
+        if (!bench.Memory)
+        {
+            OsConsoleWrite("%-34s could not reserve memory\n", strategy->Name);
+            continue;
+        }
+
+        // Unsupported flags are cleared by the arena, huge tlb always adds eager commit
+        Uint32 requested = strategy->Flags;
+        if (requested & Memory_Arena_Huge_TLB)
+            requested |= Memory_Arena_Commit_Eager;
+
+        double seconds = (double)Maximum(elapsed, 1) / 1000000.0;
+        double mbps    = ((double)size * iterations / (1024.0 * 1024.0)) / seconds;
+        OsConsoleWrite("%-34s %10.3f %12.3f %10.2f %12llu%s\n", strategy->Name, (double)elapsed / 1000.0,
+                       (double)elapsed / iterations, mbps, (unsigned long long)faults,
+                       bench.Flags != requested ? " (not supported, normal pages used)" : "");
+
+        MemoryArenaDestroy(&bench);
+    }
+
+    OsConsoleWrite("\n");
+}
+
+//
+// Compilation worker
+// Started with -serve, compiles the preprocessed sources sent by the builds distributing their compilations.
+// Every connection carries a single compilation, handled by a worker thread in its own directory of .muda/serve.
+//
+
+typedef struct Remote_Connection
+{
+    Os_Socket             Socket;
+    String                Directory;
+    volatile Int32        Busy;
+    struct Remote_Server *Server;
+} Remote_Connection;
+
+typedef struct Remote_Server
+{
+    Remote_Connection *Connections;
+    Uint32             ConnectionCount;
+    Os_Semaphore       Available; // Signalled once for every connection that is closed
+} Remote_Server;
+
+static void RemoteServeConnection(void *data)
+{
+    Remote_Connection *connection = (Remote_Connection *)data;
+    Os_Socket          socket     = connection->Socket;
+
+    Memory_Arena      *scratch    = ThreadScratchpad();
+    Temporary_Memory   temp       = BeginTemporaryMemory(scratch);
+
+    String_List        args;
+    StringListInit(&args);
+
+    Uint32 magic = 0, version = 0, arg_count = 0;
+    bool   valid = RemoteReceiveUint32(socket, &magic) && magic == REMOTE_PROTOCOL_MAGIC &&
+                 RemoteReceiveUint32(socket, &version) && version == REMOTE_PROTOCOL_VERSION &&
+                 RemoteReceiveUint32(socket, &arg_count) && arg_count && arg_count <= REMOTE_MAX_ARGUMENTS;
+    for (Uint32 index = 0; valid && index < arg_count; ++index)
+    {
+        String arg;
+        valid = RemoteReceiveString(socket, &arg, scratch);
+        if (valid)
+            StringListAdd(&args, arg, scratch);
+    }
+
+    String name;
+    Uint64 source_size;
+    valid = valid && RemoteReceiveString(socket, &name, scratch) &&
+            (StrMatch(name, StringLiteral("source.i")) || StrMatch(name, StringLiteral("source.ii")));
+
+    String source = FmtStr(scratch, "%s/%s", connection->Directory.Data, valid ? (char *)name.Data : "source.i");
+    String object = FmtStr(scratch, "%s/source.o", connection->Directory.Data);
+    valid         = valid && RemoteReceiveUint64(socket, &source_size) && source_size <= REMOTE_MAX_SOURCE &&
+            RemoteReceiveFile(socket, source_size, source);
+
+    if (valid)
+    {
+        Out_Stream output;
+        OutCreate(&output, MemoryArenaAllocator(scratch));
+
+        Int32  exit_code = REMOTE_EXIT_NOT_RUN;
+        String compiler  = args.Head.Data[0];
+        String rejected  = compiler;
+        if (RemoteArgumentsAllowed(&args, &rejected))
+        {
+            // The arguments are given to the compiler as they are, without a shell interpreting them
+            char  **argv  = PushArray(scratch, char *, arg_count + 5);
+            Uint32  count = 0;
+            ForList(String_List_Node, &args)
+            {
+                ForListNode(&args, MAX_STRING_NODE_DATA_COUNT)
                 {
-                    LogWarn("Plugin dectected but not supported. Plugin version: %u.%u.%u. Min Supported version: "
-                            "%u.%u.%u. Current version: %u.%u.%u.",
-                            major, minor, patch, supported_major, supported_minor, supported_patch, MUDA_VERSION_MAJOR,
-                            MUDA_VERSION_MINOR, MUDA_VERSION_PATCH);
+                    argv[count++] = (char *)it->Data[index].Data;
                 }
             }
+            argv[count++] = "-c";
+            argv[count++] = (char *)source.Data;
+            argv[count++] = "-o";
+            argv[count++] = (char *)object.Data;
+            argv[count]   = NULL;
+
+            Os_Process_Usage usage;
+            OsExecuteProgramCapture(argv, BuildJobCaptureOutput, &output, &usage);
+            exit_code = usage.ExitCode;
+        }
+        else
+        {
+            exit_code = REMOTE_EXIT_REJECTED;
+            OutFormatted(&output, "The worker does not run %.*s\n", (int)rejected.Length, rejected.Data);
+        }
+
+        String text = OutBuildStringSerial(&output, scratch);
+        bool   sent = RemoteSendUint32(socket, REMOTE_PROTOCOL_MAGIC) && RemoteSendUint32(socket, (Uint32)exit_code) &&
+                    RemoteSendUint64(socket, text.Length) && OsSocketSend(socket, text.Data, text.Length);
+        if (exit_code == 0)
+            sent = sent && RemoteSendFile(socket, object);
+        else
+            sent = sent && RemoteSendUint64(socket, 0);
+
+        if (!sent)
+            LogWarn("Could not send the result of %.*s to the build\n", (int)compiler.Length, compiler.Data);
+    }
+
+    OsFileDelete(source);
+    OsFileDelete(object);
+    OsSocketClose(socket);
+    EndTemporaryMemory(&temp);
+
+    AtomicStore32(&connection->Busy, 0);
+    OsSemaphoreSignal(connection->Server->Available, 1);
+}
+
+// Serves until the process is killed, "jobs" compilations at a time
+static int RemoteServe(Memory_Arena *arena, Build_Config *build_config)
+{
+    String    address  = StringMake(build_config->ServeAddress, strlen(build_config->ServeAddress));
+    Os_Socket listener = OsSocketListen(address);
+    if (listener.PlatformHandle < 0)
+    {
+        LogError("Could not listen on %s\n", build_config->ServeAddress);
+        return 1;
+    }
+
+    Thread_Pool pool;
+    if (!ThreadPoolCreate(&pool, build_config->Jobs, arena))
+    {
+        LogError("Could not create worker threads\n");
+        OsSocketClose(listener);
+        return 1;
+    }
+
+    Remote_Server server;
+    server.ConnectionCount = pool.WorkerCount;
+    server.Connections     = PushArrayZero(arena, Remote_Connection, server.ConnectionCount);
+    server.Available       = OsSemaphoreCreate(server.ConnectionCount);
+    bool ready             = true;
+    for (Uint32 index = 0; ready && index < server.ConnectionCount; ++index)
+    {
+        Remote_Connection *connection = &server.Connections[index];
+        connection->Directory         = FmtStr(arena, ".muda/serve/%u", index);
+        connection->Server            = &server;
+        if (!OsCreateDirectoryRecursively(connection->Directory))
+        {
+            LogError("Could not create the directory %s\n", connection->Directory.Data);
+            ready = false;
+        }
+    }
+
+    if (!ready)
+    {
+        ThreadPoolDestroy(&pool);
+        OsSemaphoreDestroy(server.Available);
+        OsSocketClose(listener);
+        return 1;
+    }
+
+    LogInfo("Compiling for other machines on %s with %u jobs\n", build_config->ServeAddress, server.ConnectionCount);
+
+    for (;;)
+    {
+        Os_Socket socket = OsSocketAccept(listener);
+        if (socket.PlatformHandle < 0)
+            continue;
+
+        // A connection is only accepted by the worker once a thread is free, the build waits meanwhile
+        OsSemaphoreWait(server.Available);
+        Remote_Connection *connection = server.Connections;
+        while (AtomicLoad32(&connection->Busy))
+            connection += 1;
+        AtomicStore32(&connection->Busy, 1);
+        connection->Socket = socket;
+        ThreadPoolSubmit(&pool, RemoteServeConnection, connection);
+    }
+}
+
+//
+// Build daemon
+// Builds for the processes connecting to .muda/daemon.sock, one build at a time, until the process is killed
+// Every build gets its own copy of the configuration, the options sent by the client are applied to it
+//
+
+static int DaemonServe(Memory_Arena *arena, Build_Config *build_config, const Compiler_Kind available_compilers,
+                       const Compiler_Kind compiler)
+{
+    String    socket_path = StringLiteral(DAEMON_SOCKET_PATH);
+    Os_Socket running     = OsSocketConnectLocal(socket_path);
+    if (running.PlatformHandle >= 0)
+    {
+        OsSocketClose(running);
+        LogError("A daemon is already running in this directory\n");
+        return 1;
+    }
+
+    Os_Socket listener = {-1};
+    if (OsCreateDirectoryRecursively(FmtStr(arena, ".muda")))
+        listener = OsSocketListenLocal(socket_path);
+    if (listener.PlatformHandle < 0)
+    {
+        LogError("Could not listen on %s, the daemon is only supported on Linux\n", socket_path.Data);
+        return 1;
+    }
+
+    Uint64       environment = DaemonEnvironmentHash();
+    const char  *directory   = OsGetWorkingDirectoryName(arena);
+
+    Daemon_Cache cache;
+    DaemonCacheCreate(&cache);
+    build_config->DaemonCache = &cache;
+
+    LogInfo("Daemon listening on %s\n", socket_path.Data);
+
+    for (;;)
+    {
+        Os_Socket socket = OsSocketAccept(listener);
+        if (socket.PlatformHandle < 0)
+            continue;
+
+        Temporary_Memory temp  = BeginTemporaryMemory(arena);
+
+        Uint32           magic = 0, version = 0, arg_count = 0;
+        Uint64           hash  = 0;
+        bool valid = RemoteReceiveUint32(socket, &magic) && magic == DAEMON_PROTOCOL_MAGIC &&
+                     RemoteReceiveUint32(socket, &version) && version == DAEMON_PROTOCOL_VERSION &&
+                     RemoteReceiveUint64(socket, &hash) && RemoteReceiveUint32(socket, &arg_count) &&
+                     arg_count <= DAEMON_MAX_ARGUMENTS;
+
+        char **argv = PushArray(arena, char *, arg_count + 1);
+        argv[0]     = "muda";
+        for (Uint32 index = 0; valid && index < arg_count; ++index)
+        {
+            String arg;
+            valid = RemoteReceiveString(socket, &arg, arena);
+            if (valid)
+                argv[index + 1] = (char *)arg.Data;
+        }
+
+        // Tools and variables of another environment would give other fingerprints, the client builds by itself
+        Os_Console_Redirect console;
+        bool                accepted = valid && hash == environment && OsConsoleReceive(socket, &console);
+        if (valid && RemoteSendUint32(socket, DAEMON_PROTOCOL_MAGIC))
+            RemoteSendUint32(socket, accepted);
+
+        if (accepted)
+        {
+            Build_Config request = *build_config;
+            if (!HandleCommandLineArguments((int)arg_count + 1, argv, &request))
+            {
+                if (request.GenerateCompileDb)
+                    CompileDbInit(&request.CompileDb, arena);
+
+                // The tools may have been updated since the previous build
+                ToolIdentityCacheCount = 0;
+                DaemonCacheValidate(&cache, (int)arg_count, argv + 1);
+                SearchExecuteMudaBuild(arena, &request, available_compilers, compiler, NULL, directory, true);
+            }
+
+            LogFlush();
+            if (build_config->SharedArena)
+                SharedArenaReset(build_config->SharedArena);
+            OsConsoleRestore(&console);
+            RemoteSendUint32(socket, request.Failed);
         }
+
+        OsSocketClose(socket);
+        EndTemporaryMemory(&temp);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    InitThreadContext(NullMemoryAllocator(), MegaBytes(512), (Log_Agent){.Procedure = LogProcedure},
+                      FatalErrorProcedure);
+
+    OsSetupConsole();
+
+    Build_Config build_config;
+    BuildConfigInit(&build_config);
+    if (HandleCommandLineArguments(argc, argv, &build_config))
+        return 0;
+
+    // The daemon of the working directory builds if one is running, the rest of the setup is then not needed
+    int exit_code = 0;
+    if (DaemonRequestBuild(argc, argv, &exit_code))
+        return exit_code;
+
+    Compiler_Kind compiler = OsDetectCompiler();
+    if (compiler == 0)
+    {
+        LogError("Failed to detect compiler! Installation of compiler is required...\n");
+        if (PLATFORM_OS_WINDOWS)
+            OsConsoleWrite("[Visual Studio - MSVC] https://visualstudio.microsoft.com/ \n");
+        OsConsoleWrite("[CLANG] https://releases.llvm.org/download.html \n");
+        OsConsoleWrite("[GCC] https://gcc.gnu.org/install/download.html \n");
+        return 1;
     }
 
+    // Messages are written by the logger thread from here on, the worker threads get the same logging agent
+    Logger logger;
+    bool   async_log =
+        LoggerCreate(&logger, build_config.LogFilePath, build_config.LogJsonPath, build_config.DisableLogs);
+    if (async_log)
+        ThreadContext.LogAgent = LoggerAgent(&logger);
+    else if (build_config.DisableLogs)
+        ThreadContext.LogAgent.Procedure = LogProcedureDisabled;
+
+    if (async_log && logger.File.PlatformFileHandle)
+        LogInfo("Logging to file: %s\n", build_config.LogFilePath);
+
     Compiler_Kind available_compilers = compiler;
 
     if (build_config.ForceCompiler)
@@ -1347,27 +2188,121 @@ int main(int argc, char *argv[])
         LogInfo("Compiler GCC Detected.\n");
     }
 
+    if (build_config.PrintStats || build_config.TracePath)
+    {
+        MemoryStatsEnable();
+        ThreadScratchpadAttachStats("main");
+    }
+
+    Trace trace;
+    if (build_config.TracePath)
+    {
+        if (TraceCreate(&trace, build_config.TracePath))
+            build_config.Trace = &trace;
+        else
+            LogError("Could not reserve memory for the trace. Tracing disabled.\n");
+    }
+
+    Plugin_Host plugin_host;
+    if (build_config.EnablePlugins)
+        PluginHostCreate(&plugin_host, &build_config);
+
     Memory_Arena arena            = MemoryArenaCreate(MegaBytes(128));
+    if (MemoryStatsEnabled())
+        MemoryArenaAttachStats(&arena, "build");
+
+    Memory_Arena compdb_arena;
+    if (build_config.GenerateCompileDb)
+    {
+        compdb_arena = MemoryArenaCreate(MegaBytes(256));
+        if (MemoryStatsEnabled())
+            MemoryArenaAttachStats(&compdb_arena, "compdb");
+        CompileDbInit(&build_config.CompileDb, &compdb_arena);
+    }
 
-    const char  *current_dir_name = OsGetWorkingDirectoryName(&arena);
-    SearchExecuteMudaBuild(&arena, &build_config, available_compilers, compiler, NULL, current_dir_name, true);
+    // Worker threads are only needed when actions are executed, the shared arena holds the output of the actions
+    Thread_Pool  thread_pool;
+    Shared_Arena shared_arena;
+    Object_Cache object_cache;
+    Remote_Pool  remote_pool;
+    if (!build_config.GenerateCompileDb && !build_config.DryRun && !build_config.BenchmarkIterations &&
+        !build_config.ServeAddress)
+    {
+        if (ObjectCacheCreate(&object_cache, build_config.CachePath, build_config.Plugins, &arena))
+            build_config.Cache = &object_cache;
 
-    Muda_Plugin_Event pevent;
-    memset(&pevent, 0, sizeof(pevent));
-    pevent.Kind = Muda_Plugin_Event_Kind_Destroy;
-    build_config.PluginHook(&ThreadContext, &build_config.Interface, &pevent);
+        shared_arena = SharedArenaCreate(MegaBytes(256), SHARED_ARENA_MIN_CHUNK_SIZE);
+        if (shared_arena.Memory)
+            build_config.SharedArena = &shared_arena;
+
+        if (build_config.DistributePath && RemotePoolLoad(&remote_pool, build_config.DistributePath, &arena))
+        {
+            build_config.Remote = &remote_pool;
+            LogInfo("Distributing compilations to %u hosts with %u slots\n", remote_pool.HostCount,
+                    remote_pool.SlotCount);
+        }
+
+        // A worker thread waits for every compilation sent to a host, in addition to the local actions
+        Uint32 threads = build_config.Jobs + (build_config.Remote ? build_config.Remote->SlotCount : 0);
+        if (threads > 1)
+        {
+            if (ThreadPoolCreate(&thread_pool, threads, &arena))
+                build_config.ThreadPool = &thread_pool;
+            else
+                LogWarn("Could not create worker threads, actions are executed serially\n");
+        }
+
+        if (build_config.ThreadPool)
+            JobserverCreate(&build_config);
+    }
+
+    if (build_config.ServeAddress)
+    {
+        exit_code = RemoteServe(&arena, &build_config);
+    }
+    else if (build_config.Daemon)
+    {
+        exit_code = DaemonServe(&arena, &build_config, available_compilers, compiler);
+    }
+    else if (build_config.BenchmarkIterations)
+    {
+        BenchmarkArenaStrategies(&arena, &build_config, available_compilers, compiler);
+    }
+    else
+    {
+        const char *current_dir_name = OsGetWorkingDirectoryName(&arena);
+        SearchExecuteMudaBuild(&arena, &build_config, available_compilers, compiler, NULL, current_dir_name, true);
+        exit_code = build_config.Failed;
+    }
+
+    if (build_config.Plugins)
+        PluginHostDestroy(&plugin_host, &build_config);
 
-    if (ThreadContext.LogAgent.Data)
+    if (build_config.ThreadPool)
+        ThreadPoolDestroy(build_config.ThreadPool);
+    JobserverDestroy(&build_config);
+    if (build_config.SharedArena)
+        SharedArenaDestroy(build_config.SharedArena);
+
+    if (build_config.Trace)
     {
-        File_Handle handle;
-        handle.PlatformFileHandle = ThreadContext.LogAgent.Data;
-        OsFileClose(handle);
+        if (TraceWrite(build_config.Trace))
+            LogInfo("Trace written to %s\n", build_config.TracePath);
+        else
+            LogError("Could not write the trace to %s\n", build_config.TracePath);
+        TraceDestroy(build_config.Trace);
     }
 
-    if (plugin)
+    LogFlush();
+
+    if (build_config.PrintStats)
+        PrintMemoryStats();
+
+    if (async_log)
     {
-        OsLibraryFree(plugin);
+        LoggerDestroy(&logger);
+        ThreadContext.LogAgent = logger.Fallback;
     }
 
-    return 0;
+    return exit_code;
 }
@@ -0,0 +1,331 @@
+#pragma once
+
+#include "build_graph.h"
+#include "include_scanner.h"
+#include "lenstring.h"
+#include "logger.h"
+#include "os.h"
+
+//
+// C++20 modules
+// The module declarations and imports found by the include scanner make the compilation of every module unit depend
+// on the compilations of the interfaces it imports, compilations are reordered so that the interfaces come first and
+// still run in parallel wherever the imports allow it. Interface units write their binary module interface (BMI) to
+// "BuildDirectory/int/modules/<module>.<ext>", partitions to "<module>-<partition>.<ext>". The BMI is an output of
+// the compilation, rebuilt when it is missing, and an input of the importers, rebuilt when it is newer than them.
+//   GCC:   -fmodules-ts with a module mapper file listing the BMI of every module, "BuildDirectory/<Build>.modules"
+//   Clang: -fmodule-output for the interfaces, -fprebuilt-module-path for every unit
+//   CL:    -interface (-internalPartition for internal partitions) and -ifcOutput for the interfaces, -ifcSearchDir
+//          for every unit
+// Modules that are not declared by a source of the target (import std;) are left to the compiler. Header units
+// ("import <header>;") are tracked as includes, they are not compiled to BMIs.
+//
+
+typedef enum Module_Visit
+{
+    Module_Visit_None,
+    Module_Visit_Active,
+    Module_Visit_Done,
+} Module_Visit;
+
+typedef struct Module_Unit
+{
+    Build_Node        *Node;
+    Include_Directive *Declaration; // Module or partition whose interface is compiled from the unit, NULL otherwise
+    String             Interface;   // BMI written by the unit
+    Include_Directive *Directives;
+    Uint32             DirectiveCount;
+    bool               Imports; // The unit declares or imports a module
+} Module_Unit;
+
+typedef struct Module_Graph
+{
+    Module_Unit  *Units;   // Indexed by the id of the node
+    Module_Unit **Modules; // Hash table of the interfaces by module name
+    Uint32        ModuleTableSize;
+    Module_Visit *Visits;
+    Build_Node  **Order;
+    Uint32        OrderCount;
+} Module_Graph;
+
+INLINE_PROCEDURE Module_Unit **ModuleGraphSlot(Module_Graph *modules, String name)
+{
+    Uint32 slot = (Uint32)StrHash(name);
+    for (;; ++slot)
+    {
+        Module_Unit **entry = &modules->Modules[slot & (modules->ModuleTableSize - 1)];
+        if (*entry == NULL || StrMatch((*entry)->Declaration->Name, name))
+            return entry;
+    }
+}
+
+INLINE_PROCEDURE Module_Unit *ModuleGraphFind(Module_Graph *modules, String name)
+{
+    return *ModuleGraphSlot(modules, name);
+}
+
+// Partitions are named "<module>-<partition>", the convention of the prebuilt module path of Clang
+static String ModuleInterfacePath(String directory, String name, Compiler_Kind compiler, Memory_Arena *arena)
+{
+    const char *extension = (compiler == Compiler_Bit_CL) ? "ifc" : (compiler == Compiler_Bit_CLANG) ? "pcm" : "gcm";
+    String      path      = FmtStr(arena, "%s/%.*s.%s", directory.Data, (int)name.Length, name.Data, extension);
+    for (Int64 index = directory.Length + 1; index < path.Length; ++index)
+    {
+        if (path.Data[index] == ':')
+            path.Data[index] = '-';
+    }
+    return path;
+}
+
+// Dependencies come first in the order, imports closing a cycle are reported and not followed
+static void ModuleGraphVisit(Module_Graph *modules, Build_Graph *graph, Build_Node *node)
+{
+    modules->Visits[node->Id] = Module_Visit_Active;
+
+    for (Build_Node_Ref *dep = node->Deps; dep; dep = dep->Next)
+    {
+        if (modules->Visits[dep->Node->Id] == Module_Visit_None)
+            ModuleGraphVisit(modules, graph, dep->Node);
+    }
+
+    Module_Unit *unit = &modules->Units[node->Id];
+    for (Uint32 index = 0; unit->Imports && index < unit->DirectiveCount; ++index)
+    {
+        if (unit->Directives[index].Kind != Include_Directive_Import)
+            continue;
+
+        Module_Unit *imported = ModuleGraphFind(modules, unit->Directives[index].Name);
+        if (!imported || imported == unit)
+            continue;
+
+        Build_Node *dependency = imported->Node;
+        if (modules->Visits[dependency->Id] == Module_Visit_Active)
+        {
+            LogError("Module %s is imported by %s, which it depends on\n", imported->Declaration->Name.Data,
+                     BuildNodeFirstInput(node).Data);
+            continue;
+        }
+        if (modules->Visits[dependency->Id] == Module_Visit_None)
+            ModuleGraphVisit(modules, graph, dependency);
+
+        Build_Node_Ref *dep = node->Deps;
+        while (dep && dep->Node != dependency)
+            dep = dep->Next;
+        if (!dep)
+        {
+            BuildNodeAddDependency(graph, node, dependency);
+            BuildNodeInput(graph, node, imported->Interface);
+        }
+    }
+
+    modules->Visits[node->Id]             = Module_Visit_Done;
+    modules->Order[modules->OrderCount++] = node;
+}
+
+// Adds the arguments in front of the source of the compile node
+static void ModuleUnitInsertArguments(Build_Graph *graph, Build_Node *node, const String *args, Uint32 count)
+{
+    String      source   = BuildNodeFirstInput(node);
+    String_List previous = node->Argv;
+    StringListInit(&node->Argv);
+
+    bool inserted = false;
+    ForList(String_List_Node, &previous)
+    {
+        ForListNode(&previous, MAX_STRING_NODE_DATA_COUNT)
+        {
+            if (!inserted && StrMatch(it->Data[index], source))
+            {
+                for (Uint32 arg = 0; arg < count; ++arg)
+                    BuildNodeArg(graph, node, args[arg]);
+                inserted = true;
+            }
+            BuildNodeArg(graph, node, it->Data[index]);
+        }
+    }
+}
+
+// Writes the module mapper of GCC, only when the modules changed so that it is not rewritten on every build
+static void ModuleMapperWrite(String path, String content)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    bool             same    = false;
+    File_Handle      handle  = OsFileOpen(path, File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize size = OsFileGetSize(handle);
+        Uint8  *data = PushSize(scratch, size + 1);
+        same         = (size == (Ptrsize)content.Length) && OsFileRead(handle, data, size) &&
+               StrMatch(StringMake(data, size), content);
+        OsFileClose(handle);
+    }
+
+    if (!same)
+    {
+        handle = OsFileOpen(path, File_Mode_Write);
+        if (!handle.PlatformFileHandle || !OsFileWrite(handle, content))
+            LogError("Could not write the module mapper %s\n", path.Data);
+        if (handle.PlatformFileHandle)
+            OsFileClose(handle);
+    }
+
+    EndTemporaryMemory(&temp);
+}
+
+// Orders the compilations of the module units after the interfaces they import and adds the options of the compiler
+// for the BMIs. IncludeScannerRun must be called before. The BMI directory and the module mapper are only written
+// if "write" is set, nothing is changed for targets without module units. Returns false for those.
+static bool BuildGraphLowerModules(Build_Graph *graph, Include_Scanner *scanner, String intermediate,
+                                   String mapper_path, bool write)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Module_Graph     modules;
+    modules.Units           = PushArrayZero(scratch, Module_Unit, graph->NodeCount);
+    modules.ModuleTableSize = 64;
+    while (modules.ModuleTableSize < graph->NodeCount * 2)
+        modules.ModuleTableSize <<= 1;
+    modules.Modules    = PushArrayZero(scratch, Module_Unit *, modules.ModuleTableSize);
+    modules.Visits     = PushArrayZero(scratch, Module_Visit, graph->NodeCount);
+    modules.Order      = PushArray(scratch, Build_Node *, graph->NodeCount);
+    modules.OrderCount = 0;
+
+    Uint32 unit_count  = 0;
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        if (node->Kind != Build_Node_Compile)
+            continue;
+
+        String        path = IncludePathJoin(StringLiteral(""), BuildNodeFirstInput(node), scratch);
+        Include_File *file = *IncludeScannerSlot(scanner, path);
+        if (!file || file->State != Include_File_Ready)
+            continue;
+
+        Module_Unit *unit    = &modules.Units[node->Id];
+        unit->Node           = node;
+        unit->Directives     = file->Directives;
+        unit->DirectiveCount = file->DirectiveCount;
+        for (Uint32 index = 0; index < file->DirectiveCount; ++index)
+        {
+            Include_Directive *directive = &file->Directives[index];
+            if (directive->Kind == Include_Directive_Module || directive->Kind == Include_Directive_Partition)
+                unit->Declaration = directive;
+            unit->Imports |= (directive->Kind == Include_Directive_Import);
+        }
+        unit->Imports |= (unit->Declaration != NULL);
+        unit_count += unit->Imports;
+
+        if (!unit->Declaration)
+            continue;
+
+        Module_Unit **slot = ModuleGraphSlot(&modules, unit->Declaration->Name);
+        if (*slot)
+        {
+            LogError("Module %s is declared by both %s and %s\n", unit->Declaration->Name.Data,
+                     BuildNodeFirstInput((*slot)->Node).Data, BuildNodeFirstInput(node).Data);
+            unit->Declaration = NULL;
+            continue;
+        }
+        *slot = unit;
+    }
+
+    if (!unit_count)
+    {
+        EndTemporaryMemory(&temp);
+        return false;
+    }
+
+    String directory = FmtStr(graph->Arena, "%s/modules", intermediate.Data);
+    if (write && OsCheckIfPathExists(directory) == Path_Does_Not_Exist &&
+        !OsCreateDirectoryRecursively(FmtStr(scratch, "%s", directory.Data)))
+        LogError("Failed to create directory %s\n", directory.Data);
+
+    // Options of the compiler, the interfaces write their BMI before the importers are visited
+    Out_Stream mapper;
+    OutCreate(&mapper, MemoryArenaAllocator(scratch));
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        Module_Unit *unit = &modules.Units[node->Id];
+        if (!unit->Imports)
+            continue;
+
+        String args[6];
+        Uint32 count = 0;
+        String bmi   = StringLiteral("");
+        if (unit->Declaration)
+            bmi = ModuleInterfacePath(directory, unit->Declaration->Name, graph->Compiler, graph->Arena);
+        unit->Interface = bmi;
+
+        switch (graph->Compiler)
+        {
+        case Compiler_Bit_CL: {
+            args[count++] = StringLiteral("-ifcSearchDir");
+            args[count++] = directory;
+            if (unit->Declaration)
+            {
+                args[count++] = (unit->Declaration->Kind == Include_Directive_Partition)
+                                    ? StringLiteral("-internalPartition")
+                                    : StringLiteral("-interface");
+                args[count++] = StringLiteral("-ifcOutput");
+                args[count++] = bmi;
+            }
+        }
+        break;
+
+        case Compiler_Bit_CLANG: {
+            args[count++] = FmtStr(graph->Arena, "-fprebuilt-module-path=%s", directory.Data);
+            if (unit->Declaration)
+            {
+                args[count++] = FmtStr(graph->Arena, "-fmodule-output=%s", bmi.Data);
+                args[count++] = StringLiteral("-x");
+                args[count++] = StringLiteral("c++-module");
+            }
+        }
+        break;
+
+        case Compiler_Bit_GCC: {
+            args[count++] = StringLiteral("-fmodules-ts");
+            args[count++] = FmtStr(graph->Arena, "-fmodule-mapper=%s", mapper_path.Data);
+            args[count++] = StringLiteral("-x");
+            args[count++] = StringLiteral("c++");
+            if (unit->Declaration)
+            {
+                OutString(&mapper, unit->Declaration->Name);
+                OutBuffer(&mapper, " ", 1);
+                OutString(&mapper, bmi);
+                OutBuffer(&mapper, "\n", 1);
+            }
+        }
+        break;
+        }
+
+        ModuleUnitInsertArguments(graph, node, args, count);
+        if (unit->Declaration)
+            BuildNodeOutput(graph, node, bmi);
+    }
+
+    if (write && graph->Compiler == Compiler_Bit_GCC)
+        ModuleMapperWrite(mapper_path, OutBuildStringSerial(&mapper, scratch));
+
+    // Nodes are relinked in the order of the visit, dependencies are still added before their dependents
+    for (Build_Node *node = graph->First; node; node = node->Next)
+    {
+        if (modules.Visits[node->Id] == Module_Visit_None)
+            ModuleGraphVisit(&modules, graph, node);
+    }
+
+    graph->First = modules.Order[0];
+    for (Uint32 index = 0; index < modules.OrderCount; ++index)
+    {
+        Build_Node *node = modules.Order[index];
+        node->Id         = index;
+        node->Next       = (index + 1 < modules.OrderCount) ? modules.Order[index + 1] : NULL;
+    }
+    graph->Last = modules.Order[modules.OrderCount - 1];
+
+    EndTemporaryMemory(&temp);
+    return true;
+}
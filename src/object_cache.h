@@ -0,0 +1,207 @@
+#pragma once
+
+#include "lenstring.h"
+#include "os.h"
+#include "plugin_host.h"
+
+//
+// Object cache
+// Blobs are files stored by a 64 bit key, in layers: the cache providers of the plugins, in the order they are
+// loaded, then the local store given with -cache ("<dir>/ab/abcdef0123456789"). Layers are looked up in that order
+// and a blob found in a layer is copied to the layers before it. Blobs are stored in every layer that misses them.
+// Every procedure can be called by the worker threads at the same time.
+//
+
+typedef struct Object_Cache
+{
+    String                     LocalPath; // Absolute, empty without a local store
+    const Muda_Cache_Provider *Providers[MUDA_MAX_PLUGINS];
+    Uint32                     ProviderCount;
+} Object_Cache;
+
+INLINE_PROCEDURE Uint32 ObjectCacheLayerCount(Object_Cache *cache)
+{
+    return cache->ProviderCount + (cache->LocalPath.Length != 0);
+}
+
+// Files are read and written by chunks, blobs can be larger than the scratchpad of a worker thread
+#define OBJECT_CACHE_CHUNK_SIZE KiloBytes(256)
+
+// Copies through a temporary file renamed once complete, so that a reader never sees a partial file
+static bool ObjectCacheCopyFile(String from, String to)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    bool             result  = false;
+    File_Handle      input   = OsFileOpen(from, File_Mode_Read);
+    if (input.PlatformFileHandle)
+    {
+        String      temp_path = FmtStr(scratch, "%s.%llx%u.tmp", to.Data, (unsigned long long)OsGetMonotonicTime(),
+                                       ThreadContext.ThreadIndex);
+        File_Handle output    = OsFileOpen(temp_path, File_Mode_Write);
+        if (output.PlatformFileHandle)
+        {
+            Ptrsize remaining = OsFileGetSize(input);
+            Uint8  *chunk     = PushSize(scratch, OBJECT_CACHE_CHUNK_SIZE);
+            bool    copied    = true;
+            while (copied && remaining)
+            {
+                Ptrsize size = Minimum(remaining, OBJECT_CACHE_CHUNK_SIZE);
+                copied       = OsFileRead(input, chunk, size) && OsFileWrite(output, StringMake(chunk, size));
+                remaining -= size;
+            }
+            OsFileClose(output);
+
+            result = copied && OsFileRename(temp_path, to);
+            if (!result)
+                OsFileDelete(temp_path);
+        }
+        OsFileClose(input);
+    }
+
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
+INLINE_PROCEDURE String ObjectCacheLocalBlob(Object_Cache *cache, const char *key, Memory_Arena *arena)
+{
+    return FmtStr(arena, "%s/%.2s/%s", cache->LocalPath.Data, key, key);
+}
+
+static bool ObjectCacheLayerContains(Object_Cache *cache, Uint32 layer, const char *key)
+{
+    if (layer < cache->ProviderCount)
+        return cache->Providers[layer]->Contains(cache->Providers[layer]->Context, key) == 0;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    bool             result  = OsCheckIfPathExists(ObjectCacheLocalBlob(cache, key, scratch)) == Path_Exist_File;
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
+static bool ObjectCacheLayerGet(Object_Cache *cache, Uint32 layer, const char *key, String path)
+{
+    if (layer < cache->ProviderCount)
+        return cache->Providers[layer]->Get(cache->Providers[layer]->Context, key, (const char *)path.Data) == 0;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    bool             result  = ObjectCacheCopyFile(ObjectCacheLocalBlob(cache, key, scratch), path);
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
+static bool ObjectCacheLayerPut(Object_Cache *cache, Uint32 layer, const char *key, String path)
+{
+    if (layer < cache->ProviderCount)
+        return cache->Providers[layer]->Put(cache->Providers[layer]->Context, key, (const char *)path.Data) == 0;
+
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    String           blob    = ObjectCacheLocalBlob(cache, key, scratch);
+    bool             result  = OsCreateDirectoryRecursively(StringMake(blob.Data, blob.Length - 17)) &&
+                  ObjectCacheCopyFile(path, blob);
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
+// Writes the blob of "key" to the file "path", returns false if no layer has it
+static bool ObjectCacheGet(Object_Cache *cache, Uint64 key, String path)
+{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+    Uint32 count = ObjectCacheLayerCount(cache);
+    for (Uint32 layer = 0; layer < count; ++layer)
+    {
+        if (ObjectCacheLayerGet(cache, layer, name, path))
+        {
+            for (Uint32 above = 0; above < layer; ++above)
+                ObjectCacheLayerPut(cache, above, name, path);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ObjectCachePut(Object_Cache *cache, Uint64 key, String path)
+{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+    Uint32 count = ObjectCacheLayerCount(cache);
+    for (Uint32 layer = 0; layer < count; ++layer)
+    {
+        if (!ObjectCacheLayerContains(cache, layer, name))
+            ObjectCacheLayerPut(cache, layer, name, path);
+    }
+}
+
+// Hashes the content of the file into "hash", returns false if it could not be read
+static bool ObjectCacheHashFile(Uint64 *hash, String path)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    bool             result  = false;
+    File_Handle      handle  = OsFileOpen(path, File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize remaining = OsFileGetSize(handle);
+        Uint8  *chunk     = PushSize(scratch, OBJECT_CACHE_CHUNK_SIZE);
+        Uint64  value     = *hash;
+        result            = true;
+        while (result && remaining)
+        {
+            Ptrsize size = Minimum(remaining, OBJECT_CACHE_CHUNK_SIZE);
+            result       = OsFileRead(handle, chunk, size);
+            value        = HashBytes(value, chunk, size);
+            remaining -= size;
+        }
+        OsFileClose(handle);
+        if (result)
+            *hash = value;
+    }
+
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
+// Returns false if there is neither a local store nor a plugin providing a cache
+static bool ObjectCacheCreate(Object_Cache *cache, const char *local_path, Plugin_Host *plugins,
+                              Memory_Arena *arena)
+{
+    cache->LocalPath     = StringLiteral("");
+    cache->ProviderCount = 0;
+
+    bool replace_local   = false;
+    for (Uint32 index = 0; plugins && index < plugins->Count; ++index)
+    {
+        Plugin_Instance *plugin = &plugins->Plugins[index];
+        if (plugin->Version >= MudaMakeVersion(1, 11, 0) && plugin->Interface.CacheProvider)
+        {
+            cache->Providers[cache->ProviderCount++] = plugin->Interface.CacheProvider;
+            replace_local |= (plugin->Interface.CacheProvider->Flags & MUDA_CACHE_PROVIDER_REPLACE_LOCAL) != 0;
+            LogInfo("Object cache provided by %s\n", plugin->Interface.PluginName);
+        }
+    }
+
+    if (local_path && !replace_local)
+    {
+        // Projects are built from their own directory, the path is made absolute once
+        String path = StringMake(local_path, strlen(local_path));
+        if (path.Data[0] != '/' && !(path.Length > 1 && path.Data[1] == ':'))
+            path = FmtStr(arena, "%s/%s", OsGetWorkingDirectory(arena).Data, local_path);
+        else
+            path = StrDuplicateArena(path, arena);
+
+        if (OsCreateDirectoryRecursively(path))
+            cache->LocalPath = path;
+        else
+            LogWarn("Could not create the object cache directory %s\n", path.Data);
+    }
+
+    return ObjectCacheLayerCount(cache) != 0;
+}
@@ -55,6 +55,18 @@ typedef enum Compiler_Bit
 } Compiler_Bit;
 typedef Uint32 Compiler_Kind;
 
+INLINE_PROCEDURE const char *GetCompilerName(Compiler_Kind kind)
+{
+    if (kind == Compiler_Bit_CL)
+        return "CL";
+    else if (kind == Compiler_Bit_CLANG)
+        return "CLANG";
+    else if (kind == Compiler_Bit_GCC)
+        return "GCC";
+    Unreachable();
+    return "";
+}
+
 Compiler_Kind  OsDetectCompiler();
 
 enum
@@ -65,11 +77,34 @@ enum
 };
 
 bool   OsExecuteCommandLine(String cmdline);
+
+// Receives the output of a process as it is read from the pipe
+typedef void (*Os_Output_Procedure)(void *context, const Uint8 *data, Int64 size);
+
+typedef struct Os_Process_Usage
+{
+    Int32  ExitCode;   // -1 if the process could not be created or did not exit
+    Uint64 UserTime;   // microseconds
+    Uint64 SystemTime; // microseconds
+    Uint64 PeakMemory; // bytes of resident memory
+} Os_Process_Usage;
+
+// Executes the command line the same way as OsExecuteCommandLine, stdout and stderr are both passed to "output"
+// "usage" receives the exit code and the resources used by the process, it can be NULL
+bool   OsExecuteCommandLineCapture(String cmdline, Os_Output_Procedure output, void *context, Os_Process_Usage *usage);
+// Same as OsExecuteCommandLineCapture, but the arguments are passed as they are, no shell interprets them
+// "argv" ends with NULL, argv[0] is searched in the PATH
+bool   OsExecuteProgramCapture(char **argv, Os_Output_Procedure output, void *context, Os_Process_Usage *usage);
 Uint32 OsCheckIfPathExists(String path);
+Uint64 OsGetFileLastWriteTime(String path); // 0 if the file does not exist
+String OsFindExecutable(String program, Memory_Arena *arena); // searches PATH, empty if not found
 bool   OsCreateDirectoryRecursively(String path);
+bool   OsFileRename(String from, String to); // replaces "to" if it exists
+bool   OsFileDelete(String path);
 
 String OsGetUserConfigurationPath(String path);
 char  *OsGetWorkingDirectoryName(Memory_Arena *arena); // mallocs in linux!!
+String OsGetWorkingDirectory(Memory_Arena *arena);     // absolute path, separated by '/'
 
 typedef struct File_Handle
 {
@@ -87,6 +122,7 @@ File_Handle OsFileOpen(const String path, File_Mode mode);
 Ptrsize     OsFileGetSize(File_Handle handle);
 bool        OsFileRead(File_Handle handle, Uint8 *buffer, Ptrsize size);
 bool        OsFileWrite(File_Handle handle, String data);
+bool        OsFileWriteBuffers(File_Handle handle, const String *buffers, Uint32 count); // gather write
 bool        OsFileWriteFV(File_Handle handle, const char *fmt, va_list args);
 bool        OsFileWriteF(File_Handle handle, const char *fmt, ...);
 void        OsFileClose(File_Handle handle);
@@ -101,11 +137,88 @@ void       *OsGetErrorOutputHandle();
 
 void        OsConsoleOut(void *fp, const char *fmt, ...);
 void        OsConsoleOutV(void *fp, const char *fmt, va_list list);
+void        OsConsoleOutBuffer(void *fp, String buffer); // writes as is, without formatting
+bool        OsConsoleIsTerminal(void *fp);               // false when redirected to a file or a pipe
 void        OsConsoleWrite(const char *fmt, ...);
 void        OsConsoleWriteV(const char *fmt, va_list list);
 
 String      OsConsoleRead(char *buffer, Uint32 size);
 
+typedef void (*Os_Thread_Procedure)(void *arg);
+
+typedef struct Os_Thread
+{
+    void *PlatformHandle;
+} Os_Thread;
+
+typedef struct Os_Semaphore
+{
+    void *PlatformHandle;
+} Os_Semaphore;
+
+Uint64       OsGetMonotonicTime();  // microseconds
+Uint64       OsGetPageFaultCount(); // page faults of the process, minor faults on Linux
+
+Uint32       OsGetProcessorCount();
+
+typedef struct Os_System_Load
+{
+    Real32 LoadAverage;    // Runnable tasks averaged over the last minute, negative if not available
+    Real32 MemoryPressure; // Percentage of the last 10 seconds some task stalled on memory, negative if not available
+} Os_System_Load;
+
+Os_System_Load OsGetSystemLoad();
+Os_Thread    OsThreadCreate(Os_Thread_Procedure proc, void *arg);
+void         OsThreadJoin(Os_Thread thread);
+Os_Semaphore OsSemaphoreCreate(Uint32 initial_count);
+void         OsSemaphoreDestroy(Os_Semaphore semaphore);
+void         OsSemaphoreSignal(Os_Semaphore semaphore, Uint32 count);
+void         OsSemaphoreWait(Os_Semaphore semaphore);
+bool         OsSemaphoreWaitTimeout(Os_Semaphore semaphore, Uint32 milliseconds); // false if the time ran out
+
+// GNU make jobserver, the job slots of a build shared by the whole process tree
+// A token is taken for every job run beyond the first one and given back once the job completes
+// "auth" is the value of --jobserver-auth: "R,W" (pipe), "fifo:PATH" on Linux, a semaphore name on Windows
+typedef struct Os_Jobserver
+{
+    void *PlatformHandle; // NULL without a jobserver
+} Os_Jobserver;
+
+Os_Jobserver OsJobserverConnect(String auth);
+Os_Jobserver OsJobserverCreate(Uint32 tokens, char *auth, Uint32 auth_size); // "auth" receives the value to export
+bool         OsJobserverAcquire(Os_Jobserver jobserver);                     // does not block, false without a token
+void         OsJobserverRelease(Os_Jobserver jobserver);
+void         OsJobserverDestroy(Os_Jobserver jobserver);
+
+bool         OsSetEnvironmentVariable(const char *name, const char *value); // inherited by the child processes
+
+// TCP connections, addresses are "host:port", a listening address can be a port alone to accept on every interface
+typedef struct Os_Socket
+{
+    Int64 PlatformHandle; // -1 if not connected
+} Os_Socket;
+
+Os_Socket    OsSocketListen(String address);
+Os_Socket    OsSocketAccept(Os_Socket listener);
+Os_Socket    OsSocketConnect(String address, Uint32 timeout); // milliseconds
+bool         OsSocketSend(Os_Socket socket, const void *data, Ptrsize size);  // sends everything
+bool         OsSocketReceive(Os_Socket socket, void *data, Ptrsize size);     // false unless "size" bytes are received
+void         OsSocketClose(Os_Socket socket);
+
+// Local sockets bound to a path, only supported on Linux, -1 is returned elsewhere
+Os_Socket    OsSocketListenLocal(String path); // replaces a socket file left by a process that was killed
+Os_Socket    OsSocketConnectLocal(String path);
+
+// The console of a process can be handed over a local socket, so that another process writes to it
+typedef struct Os_Console_Redirect
+{
+    Int64 Saved[2]; // Standard output and error of the process before the redirection
+} Os_Console_Redirect;
+
+bool         OsConsoleSend(Os_Socket socket);
+bool         OsConsoleReceive(Os_Socket socket, Os_Console_Redirect *redirect); // redirects to the received console
+void         OsConsoleRestore(Os_Console_Redirect *redirect);
+
 void       *OsLibraryLoad(const char *path);
 void        OsLibraryFree(void *handle);
 void       *OsGetProcedureAddress(void *handle, const char *proc_name);
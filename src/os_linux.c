@@ -6,10 +6,25 @@
 #include <dirent.h>
 #include <dlfcn.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
 #include <features.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio_ext.h>
 #include <stdlib.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 void OsProcessExit(int code)
@@ -19,8 +34,10 @@ void OsProcessExit(int code)
 
 static bool GetInfo(File_Info *info, int dirfd, const String Path, const char *name, const int name_len)
 {
+    // The name is relative to the directory being iterated, the path is relative to the working directory
     struct statx stats;
-    statx(dirfd, (char *)Path.Data, 0x100, STATX_ALL, &stats);
+    if (statx(dirfd, name, AT_SYMLINK_NOFOLLOW, STATX_ALL, &stats) != 0)
+        memset(&stats, 0, sizeof(stats));
 
     info->CreationTime    = stats.stx_btime.tv_nsec;
     info->LastAccessTime  = stats.stx_atime.tv_nsec;
@@ -156,6 +173,80 @@ bool OsExecuteCommandLine(String cmdline)
     return !system((char *)cmdline.Data);
 }
 
+extern char **environ;
+
+// Runs "file", searched in the PATH if "search" is set
+static bool LinuxSpawnCapture(const char *file, char **argv, bool search, Os_Output_Procedure output, void *context,
+                              Os_Process_Usage *usage)
+{
+    Os_Process_Usage ignored;
+    if (!usage)
+        usage = &ignored;
+    memset(usage, 0, sizeof(*usage));
+    usage->ExitCode = -1;
+
+    // Close on exec, so that processes spawned at the same time by other threads do not keep the pipe open
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0)
+        return false;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDERR_FILENO);
+
+    pid_t pid;
+    int   spawned = search ? posix_spawnp(&pid, file, &actions, NULL, argv, environ)
+                           : posix_spawn(&pid, file, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fds[1]);
+
+    if (spawned != 0)
+    {
+        close(pipe_fds[0]);
+        return false;
+    }
+
+    Uint8 buffer[4096];
+    for (;;)
+    {
+        ssize_t read_size = read(pipe_fds[0], buffer, sizeof(buffer));
+        if (read_size > 0)
+            output(context, buffer, read_size);
+        else if (read_size == 0 || errno != EINTR)
+            break;
+    }
+    close(pipe_fds[0]);
+
+    int           status = 0;
+    struct rusage resources;
+    while (wait4(pid, &status, 0, &resources) < 0)
+    {
+        if (errno != EINTR)
+            return false;
+    }
+
+    usage->UserTime   = (Uint64)resources.ru_utime.tv_sec * 1000000 + (Uint64)resources.ru_utime.tv_usec;
+    usage->SystemTime = (Uint64)resources.ru_stime.tv_sec * 1000000 + (Uint64)resources.ru_stime.tv_usec;
+    usage->PeakMemory = (Uint64)resources.ru_maxrss * 1024;
+    if (WIFEXITED(status))
+        usage->ExitCode = WEXITSTATUS(status);
+
+    return usage->ExitCode == 0;
+}
+
+bool OsExecuteCommandLineCapture(String cmdline, Os_Output_Procedure output, void *context, Os_Process_Usage *usage)
+{
+    // Same as system(): the command line is run by /bin/sh -c
+    char *argv[] = {"sh", "-c", (char *)cmdline.Data, NULL};
+    return LinuxSpawnCapture("/bin/sh", argv, false, output, context, usage);
+}
+
+bool OsExecuteProgramCapture(char **argv, Os_Output_Procedure output, void *context, Os_Process_Usage *usage)
+{
+    return LinuxSpawnCapture(argv[0], argv, true, output, context, usage);
+}
+
 Uint32 OsCheckIfPathExists(String path)
 {
     struct stat tmp;
@@ -173,18 +264,49 @@ Uint32 OsCheckIfPathExists(String path)
     return Path_Does_Not_Exist;
 }
 
+Uint64 OsGetFileLastWriteTime(String path)
+{
+    struct stat tmp;
+    if (stat(path.Data, &tmp) == 0)
+        return (Uint64)tmp.st_mtim.tv_sec * 1000000000ull + (Uint64)tmp.st_mtim.tv_nsec;
+    return 0;
+}
+
+String OsFindExecutable(String program, Memory_Arena *arena)
+{
+    if (StrFindCharacter(program, '/', 0) >= 0)
+        return access(program.Data, X_OK) == 0 ? StrDuplicateArena(program, arena) : StringLiteral("");
+
+    const char *path = getenv("PATH");
+    while (path && *path)
+    {
+        const char *end = strchr(path, ':');
+        int         len = end ? (int)(end - path) : (int)strlen(path);
+
+        String candidate = FmtStr(arena, "%.*s/%s", len, path, program.Data);
+        if (len && access(candidate.Data, X_OK) == 0)
+            return candidate;
+
+        path = end ? end + 1 : NULL;
+    }
+
+    return StringLiteral("");
+}
+
 bool OsCreateDirectoryRecursively(String path)
 {
     const int len = path.Length;
     for (int i = 0; i < len + 1; i++)
     {
-        if (path.Data[i] == '/')
+        // The root of an absolute path always exists
+        if (path.Data[i] == '/' && i > 0)
         {
             path.Data[i]    = '\0';
             const char *dir = path.Data;
-            if (mkdir(dir, S_IRWXU) == -1 && errno != EEXIST)
+            bool        made = (mkdir(dir, S_IRWXU) == 0 || errno == EEXIST);
+            path.Data[i]     = '/';
+            if (!made)
                 return false;
-            path.Data[i] = '/';
         }
         else if (path.Data[i] == '\0')
         {
@@ -212,6 +334,18 @@ char *OsGetWorkingDirectoryName(Memory_Arena *arena)
     return result;
 }
 
+String OsGetWorkingDirectory(Memory_Arena *arena)
+{
+    char  *dirname = getcwd(NULL, 0);
+    size_t len     = strlen(dirname);
+    String result;
+    result.Data   = PushSize(arena, len + 1);
+    result.Length = len;
+    memcpy(result.Data, dirname, len + 1);
+    free(dirname);
+    return result;
+}
+
 File_Handle OsFileOpen(const String path, File_Mode mode)
 {
     File_Handle handle;
@@ -251,6 +385,52 @@ bool OsFileWrite(File_Handle handle, String data)
     return result;
 }
 
+bool OsFileWriteBuffers(File_Handle handle, const String *buffers, Uint32 count)
+{
+    FILE *fp = (FILE *)handle.PlatformFileHandle;
+    if (fflush(fp) != 0)
+        return false;
+
+    struct iovec vectors[64];
+    int          fd = fileno(fp);
+    while (count)
+    {
+        int batch = (int)Minimum(count, ArrayCount(vectors));
+        for (int index = 0; index < batch; ++index)
+        {
+            vectors[index].iov_base = buffers[index].Data;
+            vectors[index].iov_len  = (size_t)buffers[index].Length;
+        }
+
+        // Partial writes continue from the first buffer that was not completely written
+        int     first = 0;
+        while (first < batch)
+        {
+            ssize_t written = writev(fd, vectors + first, batch - first);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            while (first < batch && (size_t)written >= vectors[first].iov_len)
+            {
+                written -= vectors[first].iov_len;
+                first += 1;
+            }
+            if (first < batch)
+            {
+                vectors[first].iov_base = (Uint8 *)vectors[first].iov_base + written;
+                vectors[first].iov_len -= written;
+            }
+        }
+
+        buffers += batch;
+        count -= batch;
+    }
+    return true;
+}
+
 bool OsFileWriteFV(File_Handle handle, const char *fmt, va_list args)
 {
     bool result = (vfprintf(handle.PlatformFileHandle, fmt, args) >= 0);
@@ -271,6 +451,16 @@ void OsFileClose(File_Handle handle)
     fclose(handle.PlatformFileHandle);
 }
 
+bool OsFileRename(String from, String to)
+{
+    return rename((char *)from.Data, (char *)to.Data) == 0;
+}
+
+bool OsFileDelete(String path)
+{
+    return unlink((char *)path.Data) == 0;
+}
+
 void OsSetupConsole()
 {
     // we have nothing to do here :)
@@ -314,6 +504,17 @@ void OsConsoleOutV(void *fp, const char *fmt, va_list list)
     vfprintf((FILE *)fp, fmt, list);
 }
 
+void OsConsoleOutBuffer(void *fp, String buffer)
+{
+    fwrite(buffer.Data, 1, buffer.Length, (FILE *)fp);
+    fflush((FILE *)fp);
+}
+
+bool OsConsoleIsTerminal(void *fp)
+{
+    return isatty(fileno((FILE *)fp));
+}
+
 void OsConsoleWrite(const char *fmt, ...)
 {
     va_list args;
@@ -339,6 +540,570 @@ String OsConsoleRead(char *buffer, Uint32 size)
     return StringMake(buffer, len);
 }
 
+Uint64 OsGetMonotonicTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (Uint64)time.tv_sec * 1000000 + (Uint64)time.tv_nsec / 1000;
+}
+
+Uint64 OsGetPageFaultCount()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (Uint64)usage.ru_minflt;
+}
+
+Uint32 OsGetProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (Uint32)count : 1;
+}
+
+static bool LinuxReadProcFile(const char *path, char *buffer, Uint32 size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length <= 0)
+        return false;
+    buffer[length] = 0;
+    return true;
+}
+
+Os_System_Load OsGetSystemLoad()
+{
+    Os_System_Load load;
+    load.LoadAverage    = -1;
+    load.MemoryPressure = -1;
+
+    char buffer[256];
+    if (LinuxReadProcFile("/proc/loadavg", buffer, sizeof(buffer)))
+        load.LoadAverage = strtof(buffer, NULL);
+
+    // "some avg10=1.23 avg60=0.50 avg300=0.10 total=12345", only with kernels built with PSI
+    if (LinuxReadProcFile("/proc/pressure/memory", buffer, sizeof(buffer)) && strncmp(buffer, "some ", 5) == 0)
+    {
+        char *avg10 = strstr(buffer, "avg10=");
+        if (avg10)
+            load.MemoryPressure = strtof(avg10 + 6, NULL);
+    }
+
+    return load;
+}
+
+typedef struct Linux_Thread_Start
+{
+    Os_Thread_Procedure Procedure;
+    void               *Arg;
+} Linux_Thread_Start;
+
+static void *LinuxThreadEntry(void *arg)
+{
+    Linux_Thread_Start start = *(Linux_Thread_Start *)arg;
+    free(arg);
+    start.Procedure(start.Arg);
+    return NULL;
+}
+
+Os_Thread OsThreadCreate(Os_Thread_Procedure proc, void *arg)
+{
+    Os_Thread           thread = {NULL};
+
+    Linux_Thread_Start *start  = (Linux_Thread_Start *)malloc(sizeof(*start));
+    pthread_t          *handle = (pthread_t *)malloc(sizeof(*handle));
+    if (!start || !handle)
+    {
+        free(start);
+        free(handle);
+        return thread;
+    }
+
+    start->Procedure = proc;
+    start->Arg       = arg;
+
+    if (pthread_create(handle, NULL, LinuxThreadEntry, start) != 0)
+    {
+        free(start);
+        free(handle);
+        return thread;
+    }
+
+    thread.PlatformHandle = handle;
+    return thread;
+}
+
+void OsThreadJoin(Os_Thread thread)
+{
+    pthread_t *handle = (pthread_t *)thread.PlatformHandle;
+    pthread_join(*handle, NULL);
+    free(handle);
+}
+
+Os_Semaphore OsSemaphoreCreate(Uint32 initial_count)
+{
+    Os_Semaphore semaphore = {NULL};
+    sem_t       *handle    = (sem_t *)malloc(sizeof(*handle));
+    if (handle && sem_init(handle, 0, initial_count) == 0)
+        semaphore.PlatformHandle = handle;
+    else
+        free(handle);
+    return semaphore;
+}
+
+void OsSemaphoreDestroy(Os_Semaphore semaphore)
+{
+    sem_destroy((sem_t *)semaphore.PlatformHandle);
+    free(semaphore.PlatformHandle);
+}
+
+void OsSemaphoreSignal(Os_Semaphore semaphore, Uint32 count)
+{
+    for (Uint32 index = 0; index < count; ++index)
+        sem_post((sem_t *)semaphore.PlatformHandle);
+}
+
+void OsSemaphoreWait(Os_Semaphore semaphore)
+{
+    while (sem_wait((sem_t *)semaphore.PlatformHandle) != 0 && errno == EINTR)
+    {
+    }
+}
+
+bool OsSemaphoreWaitTimeout(Os_Semaphore semaphore, Uint32 milliseconds)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += milliseconds / 1000;
+    deadline.tv_nsec += (long)(milliseconds % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    for (;;)
+    {
+        if (sem_timedwait((sem_t *)semaphore.PlatformHandle, &deadline) == 0)
+            return true;
+        if (errno != EINTR)
+            return false;
+    }
+}
+
+typedef struct Linux_Jobserver
+{
+    int    Read;   // Opened by this process only, non blocking
+    int    Write;
+    int    Pipe[2]; // Created by this process and inherited by the child processes, -1 for a client
+    Uint32 TokenCount;
+    char   Tokens[256]; // Taken tokens, given back as they were read
+} Linux_Jobserver;
+
+// The descriptors of a pipe are shared with the other processes, reopening them through /proc gives a file description
+// of our own that can be made non blocking without changing the pipe for make
+static int LinuxReopenNonBlocking(int fd, int flags)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return open(path, flags | O_NONBLOCK | O_CLOEXEC);
+}
+
+Os_Jobserver OsJobserverConnect(String auth)
+{
+    Os_Jobserver     result    = {NULL};
+    Linux_Jobserver *jobserver = (Linux_Jobserver *)malloc(sizeof(*jobserver));
+    if (!jobserver)
+        return result;
+    memset(jobserver, 0, sizeof(*jobserver));
+    jobserver->Pipe[0] = -1;
+    jobserver->Pipe[1] = -1;
+
+    if (StrStartsWith(auth, StringLiteral("fifo:")))
+    {
+        // Both ends are opened at once, so that opening never blocks waiting for a writer
+        jobserver->Read  = open((char *)auth.Data + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        jobserver->Write = jobserver->Read;
+    }
+    else
+    {
+        int read_fd = -1, write_fd = -1;
+        if (sscanf((char *)auth.Data, "%d,%d", &read_fd, &write_fd) == 2 && read_fd >= 0 && write_fd >= 0 &&
+            fcntl(read_fd, F_GETFD) != -1 && fcntl(write_fd, F_GETFD) != -1)
+        {
+            jobserver->Read  = LinuxReopenNonBlocking(read_fd, O_RDONLY);
+            jobserver->Write = write_fd;
+        }
+        else
+        {
+            jobserver->Read = -1;
+        }
+    }
+
+    if (jobserver->Read < 0)
+    {
+        free(jobserver);
+        return result;
+    }
+
+    result.PlatformHandle = jobserver;
+    return result;
+}
+
+Os_Jobserver OsJobserverCreate(Uint32 tokens, char *auth, Uint32 auth_size)
+{
+    Os_Jobserver     result    = {NULL};
+    Linux_Jobserver *jobserver = (Linux_Jobserver *)malloc(sizeof(*jobserver));
+    if (!jobserver)
+        return result;
+    memset(jobserver, 0, sizeof(*jobserver));
+
+    // Not closed on exec, the child processes find the descriptors in MAKEFLAGS
+    if (pipe(jobserver->Pipe) != 0)
+    {
+        free(jobserver);
+        return result;
+    }
+
+    jobserver->Read  = LinuxReopenNonBlocking(jobserver->Pipe[0], O_RDONLY);
+    jobserver->Write = jobserver->Pipe[1];
+
+    bool written     = true;
+    for (Uint32 index = 0; written && index < tokens; ++index)
+        written = write(jobserver->Write, "+", 1) == 1;
+
+    if (jobserver->Read < 0 || !written)
+    {
+        if (jobserver->Read >= 0)
+            close(jobserver->Read);
+        close(jobserver->Pipe[0]);
+        close(jobserver->Pipe[1]);
+        free(jobserver);
+        return result;
+    }
+
+    snprintf(auth, auth_size, "%d,%d", jobserver->Pipe[0], jobserver->Pipe[1]);
+    result.PlatformHandle = jobserver;
+    return result;
+}
+
+bool OsJobserverAcquire(Os_Jobserver handle)
+{
+    Linux_Jobserver *jobserver = (Linux_Jobserver *)handle.PlatformHandle;
+    if (jobserver->TokenCount == ArrayCount(jobserver->Tokens))
+        return false;
+
+    char token;
+    if (read(jobserver->Read, &token, 1) != 1)
+        return false;
+    jobserver->Tokens[jobserver->TokenCount++] = token;
+    return true;
+}
+
+void OsJobserverRelease(Os_Jobserver handle)
+{
+    Linux_Jobserver *jobserver = (Linux_Jobserver *)handle.PlatformHandle;
+    if (jobserver->TokenCount == 0)
+        return;
+
+    char token = jobserver->Tokens[--jobserver->TokenCount];
+    while (write(jobserver->Write, &token, 1) < 0 && errno == EINTR)
+        ;
+}
+
+void OsJobserverDestroy(Os_Jobserver handle)
+{
+    Linux_Jobserver *jobserver = (Linux_Jobserver *)handle.PlatformHandle;
+    while (jobserver->TokenCount)
+        OsJobserverRelease(handle);
+
+    if (jobserver->Read != jobserver->Write)
+        close(jobserver->Read);
+    if (jobserver->Pipe[0] >= 0)
+    {
+        close(jobserver->Pipe[0]);
+        close(jobserver->Pipe[1]);
+    }
+    else if (jobserver->Read == jobserver->Write)
+    {
+        close(jobserver->Read);
+    }
+    free(jobserver);
+}
+
+bool OsSetEnvironmentVariable(const char *name, const char *value)
+{
+    return setenv(name, value, 1) == 0;
+}
+
+// Splits "host:port" or "port", returns false for the port alone
+static bool LinuxSplitAddress(String address, char *host, Uint32 host_size, char *port, Uint32 port_size)
+{
+    Int64 colon = StrReverseFindCharacter(address, ':', address.Length - 1);
+    if (colon < 0)
+    {
+        snprintf(port, port_size, "%.*s", (int)address.Length, address.Data);
+        return false;
+    }
+    snprintf(host, host_size, "%.*s", (int)colon, address.Data);
+    snprintf(port, port_size, "%.*s", (int)(address.Length - colon - 1), address.Data + colon + 1);
+    return true;
+}
+
+// The port alone is the loopback address, listening on every interface needs an explicit "0.0.0.0:port"
+static struct addrinfo *LinuxResolveAddress(String address)
+{
+    char host[256], port[32];
+    bool has_host = LinuxSplitAddress(address, host, sizeof(host), port, sizeof(port));
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *addresses = NULL;
+    if (getaddrinfo(has_host ? host : "127.0.0.1", port, &hints, &addresses) != 0)
+        return NULL;
+    return addresses;
+}
+
+Os_Socket OsSocketListen(String address)
+{
+    Os_Socket        result    = {-1};
+    struct addrinfo *addresses = LinuxResolveAddress(address);
+    for (struct addrinfo *it = addresses; it && result.PlatformHandle < 0; it = it->ai_next)
+    {
+        int fd = socket(it->ai_family, it->ai_socktype | SOCK_CLOEXEC, it->ai_protocol);
+        if (fd < 0)
+            continue;
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, it->ai_addr, it->ai_addrlen) == 0 && listen(fd, 64) == 0)
+            result.PlatformHandle = fd;
+        else
+            close(fd);
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+    return result;
+}
+
+Os_Socket OsSocketAccept(Os_Socket listener)
+{
+    Os_Socket result = {-1};
+    int       fd;
+    while ((fd = accept4((int)listener.PlatformHandle, NULL, NULL, SOCK_CLOEXEC)) < 0 && errno == EINTR)
+        ;
+    if (fd >= 0)
+    {
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        result.PlatformHandle = fd;
+    }
+    return result;
+}
+
+Os_Socket OsSocketConnect(String address, Uint32 timeout)
+{
+    Os_Socket        result    = {-1};
+    struct addrinfo *addresses = LinuxResolveAddress(address);
+    for (struct addrinfo *it = addresses; it && result.PlatformHandle < 0; it = it->ai_next)
+    {
+        int fd = socket(it->ai_family, it->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, it->ai_protocol);
+        if (fd < 0)
+            continue;
+
+        // Connected without blocking, so that a host that does not answer only costs the timeout
+        bool connected = connect(fd, it->ai_addr, it->ai_addrlen) == 0;
+        if (!connected && errno == EINPROGRESS)
+        {
+            struct pollfd poll_fd = {fd, POLLOUT, 0};
+            int           error   = 0;
+            socklen_t     length  = sizeof(error);
+            connected = poll(&poll_fd, 1, (int)timeout) == 1 &&
+                        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+        }
+
+        if (connected)
+        {
+            int no_delay = 1;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+            result.PlatformHandle = fd;
+        }
+        else
+        {
+            close(fd);
+        }
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+    return result;
+}
+
+bool OsSocketSend(Os_Socket socket, const void *data, Ptrsize size)
+{
+    const Uint8 *bytes = (const Uint8 *)data;
+    while (size)
+    {
+        ssize_t sent = send((int)socket.PlatformHandle, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (Ptrsize)sent;
+    }
+    return true;
+}
+
+bool OsSocketReceive(Os_Socket socket, void *data, Ptrsize size)
+{
+    Uint8 *bytes = (Uint8 *)data;
+    while (size)
+    {
+        ssize_t received = recv((int)socket.PlatformHandle, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= (Ptrsize)received;
+    }
+    return true;
+}
+
+void OsSocketClose(Os_Socket socket)
+{
+    if (socket.PlatformHandle >= 0)
+        close((int)socket.PlatformHandle);
+}
+
+static bool LinuxLocalAddress(String path, struct sockaddr_un *address)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (path.Length >= (Int64)sizeof(address->sun_path))
+        return false;
+    memcpy(address->sun_path, path.Data, path.Length);
+    return true;
+}
+
+Os_Socket OsSocketListenLocal(String path)
+{
+    Os_Socket          result = {-1};
+    struct sockaddr_un address;
+    if (!LinuxLocalAddress(path, &address))
+        return result;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return result;
+
+    unlink(address.sun_path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0 && listen(fd, 16) == 0)
+        result.PlatformHandle = fd;
+    else
+        close(fd);
+    return result;
+}
+
+Os_Socket OsSocketConnectLocal(String path)
+{
+    Os_Socket          result = {-1};
+    struct sockaddr_un address;
+    if (!LinuxLocalAddress(path, &address))
+        return result;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return result;
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+        result.PlatformHandle = fd;
+    else
+        close(fd);
+    return result;
+}
+
+// The standard output and error are sent as ancillary data of a single byte
+bool OsConsoleSend(Os_Socket socket)
+{
+    int  fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    char byte   = 0;
+    union {
+        struct cmsghdr header;
+        char           buffer[CMSG_SPACE(sizeof(fds))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec  io      = {&byte, 1};
+    struct msghdr message = {0};
+    message.msg_iov        = &io;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level     = SOL_SOCKET;
+    header->cmsg_type      = SCM_RIGHTS;
+    header->cmsg_len       = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    return sendmsg((int)socket.PlatformHandle, &message, MSG_NOSIGNAL) == 1;
+}
+
+bool OsConsoleReceive(Os_Socket socket, Os_Console_Redirect *redirect)
+{
+    int  fds[2] = {-1, -1};
+    char byte;
+    union {
+        struct cmsghdr header;
+        char           buffer[CMSG_SPACE(sizeof(fds))];
+    } control;
+
+    struct iovec  io      = {&byte, 1};
+    struct msghdr message = {0};
+    message.msg_iov        = &io;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    if (recvmsg((int)socket.PlatformHandle, &message, MSG_CMSG_CLOEXEC) != 1)
+        return false;
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds)))
+        return false;
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+    // The other process may close its console before we are done writing to it
+    signal(SIGPIPE, SIG_IGN);
+
+    fflush(stdout);
+    fflush(stderr);
+    redirect->Saved[0] = dup(STDOUT_FILENO);
+    redirect->Saved[1] = dup(STDERR_FILENO);
+    dup2(fds[0], STDOUT_FILENO);
+    dup2(fds[1], STDERR_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    return true;
+}
+
+void OsConsoleRestore(Os_Console_Redirect *redirect)
+{
+    fflush(stdout);
+    fflush(stderr);
+    dup2((int)redirect->Saved[0], STDOUT_FILENO);
+    dup2((int)redirect->Saved[1], STDERR_FILENO);
+    close((int)redirect->Saved[0]);
+    close((int)redirect->Saved[1]);
+}
+
 void *OsLibraryLoad(const char *path)
 {
     return dlopen(path, RTLD_LAZY);
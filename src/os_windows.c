@@ -2,13 +2,18 @@
 #include "os.h"
 
 #define WIN32_MEAN_AND_LEAN
+#include <winsock2.h> // Before any header including windows.h, which would include the old winsock.h
+#include <ws2tcpip.h>
 #include <UserEnv.h>
 #include <shlwapi.h>
 #include <windows.h>
+#include <psapi.h>
 
 #pragma comment(lib, "Shlwapi.lib")
 #pragma comment(lib, "Userenv.lib")
 #pragma comment(lib, "Advapi32.lib")
+#pragma comment(lib, "Psapi.lib")
+#pragma comment(lib, "Ws2_32.lib")
 
 static wchar_t *UnicodeToWideChar(const char *msg, int length)
 {
@@ -251,6 +256,142 @@ bool OsExecuteCommandLine(String cmdline)
     return exit_code == 0;
 }
 
+// Only one inheritable pipe exists at a time, otherwise processes created by other threads inherit it too
+// and the pipe is only closed once all of them exit
+static SRWLOCK CaptureLock = SRWLOCK_INIT;
+
+INLINE_PROCEDURE Uint64 OsFileTimeToMicroseconds(FILETIME time)
+{
+    ULARGE_INTEGER converter;
+    converter.HighPart = time.dwHighDateTime;
+    converter.LowPart  = time.dwLowDateTime;
+    return converter.QuadPart / 10;
+}
+
+bool OsExecuteCommandLineCapture(String cmdline, Os_Output_Procedure output, void *context, Os_Process_Usage *usage)
+{
+    Os_Process_Usage ignored;
+    if (!usage)
+        usage = &ignored;
+    memset(usage, 0, sizeof(*usage));
+    usage->ExitCode = -1;
+
+    wchar_t            *wcmdline = UnicodeToWideChar(cmdline.Data, (int)cmdline.Length);
+
+    SECURITY_ATTRIBUTES security = {sizeof(security), NULL, TRUE};
+    HANDLE              read_pipe, write_pipe;
+
+    STARTUPINFOW        start_up = {sizeof(start_up)};
+    PROCESS_INFORMATION process;
+    memset(&process, 0, sizeof(process));
+
+    AcquireSRWLockExclusive(&CaptureLock);
+    BOOL created = CreatePipe(&read_pipe, &write_pipe, &security, 0);
+    if (created)
+    {
+        SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+        start_up.dwFlags    = STARTF_USESTDHANDLES;
+        start_up.hStdInput  = GetStdHandle(STD_INPUT_HANDLE);
+        start_up.hStdOutput = write_pipe;
+        start_up.hStdError  = write_pipe;
+
+        created = CreateProcessW(NULL, wcmdline, NULL, NULL, TRUE, NORMAL_PRIORITY_CLASS, NULL, NULL, &start_up,
+                                 &process);
+        CloseHandle(write_pipe);
+        if (!created)
+            CloseHandle(read_pipe);
+    }
+    ReleaseSRWLockExclusive(&CaptureLock);
+
+    if (!created)
+        return false;
+
+    Uint8 buffer[4096];
+    DWORD read_size = 0;
+    while (ReadFile(read_pipe, buffer, sizeof(buffer), &read_size, NULL) && read_size)
+        output(context, buffer, read_size);
+    CloseHandle(read_pipe);
+
+    WaitForSingleObject(process.hProcess, INFINITE);
+
+    DWORD exit_code;
+    if (GetExitCodeProcess(process.hProcess, &exit_code))
+        usage->ExitCode = (Int32)exit_code;
+
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (GetProcessTimes(process.hProcess, &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+        usage->UserTime   = OsFileTimeToMicroseconds(user_time);
+        usage->SystemTime = OsFileTimeToMicroseconds(kernel_time);
+    }
+
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(process.hProcess, &counters, sizeof(counters)))
+        usage->PeakMemory = counters.PeakWorkingSetSize;
+
+    CloseHandle(process.hProcess);
+    CloseHandle(process.hThread);
+
+    return usage->ExitCode == 0;
+}
+
+// CreateProcess runs no shell, the arguments are quoted the way the C runtime splits the command line
+bool OsExecuteProgramCapture(char **argv, Os_Output_Procedure output, void *context, Os_Process_Usage *usage)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Ptrsize          size    = 1;
+    for (char **arg = argv; *arg; ++arg)
+        size += 2 * strlen(*arg) + 3;
+
+    char   *cmdline = PushSize(scratch, size);
+    Ptrsize length  = 0;
+    for (char **arg = argv; *arg; ++arg)
+    {
+        if (length)
+            cmdline[length++] = ' ';
+
+        const char *it = *arg;
+        if (*it && !strpbrk(it, " \t\"))
+        {
+            while (*it)
+                cmdline[length++] = *it++;
+            continue;
+        }
+
+        cmdline[length++] = '"';
+        for (;;)
+        {
+            Ptrsize backslashes = 0;
+            while (*it == '\\')
+            {
+                backslashes += 1;
+                it += 1;
+            }
+
+            // Backslashes are only escaped in front of a quote, including the closing one
+            if (!*it || *it == '"')
+                backslashes *= 2;
+            for (Ptrsize index = 0; index < backslashes; ++index)
+                cmdline[length++] = '\\';
+
+            if (!*it)
+                break;
+            if (*it == '"')
+                cmdline[length++] = '\\';
+            cmdline[length++] = *it++;
+        }
+        cmdline[length++] = '"';
+    }
+    cmdline[length] = 0;
+
+    bool result     = OsExecuteCommandLineCapture(StringMake(cmdline, length), output, context, usage);
+    EndTemporaryMemory(&temp);
+    return result;
+}
+
 Uint32 OsCheckIfPathExists(String path)
 {
     wchar_t *dir = UnicodeToWideChar(path.Data, (int)path.Length);
@@ -270,6 +411,37 @@ Uint32 OsCheckIfPathExists(String path)
     return Path_Does_Not_Exist;
 }
 
+Uint64 OsGetFileLastWriteTime(String path)
+{
+    wchar_t                  *wpath = UnicodeToWideChar(path.Data, (int)path.Length);
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wpath, GetFileExInfoStandard, &data))
+        return 0;
+
+    ULARGE_INTEGER converter;
+    converter.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    converter.LowPart  = data.ftLastWriteTime.dwLowDateTime;
+    return converter.QuadPart;
+}
+
+String OsFindExecutable(String program, Memory_Arena *arena)
+{
+    wchar_t *wprogram = UnicodeToWideChar(program.Data, (int)program.Length);
+
+    wchar_t  buffer[MAX_PATH + 1];
+    DWORD    length = SearchPathW(NULL, wprogram, L".exe", MAX_PATH + 1, buffer, NULL);
+    if (length == 0 || length > MAX_PATH)
+        return StringLiteral("");
+
+    String result;
+    int    len    = WideCharToMultiByte(CP_UTF8, 0, buffer, (int)length, NULL, 0, 0, 0);
+    result.Data   = PushSize(arena, len + 1);
+    result.Length = WideCharToMultiByte(CP_UTF8, 0, buffer, (int)length, result.Data, len + 1, 0, 0);
+    result.Data[result.Length] = 0;
+    return result;
+}
+
 bool OsCreateDirectoryRecursively(String path)
 {
     int      len = 0;
@@ -277,7 +449,9 @@ bool OsCreateDirectoryRecursively(String path)
 
     for (int i = 0; i < len + 1; i++)
     {
-        if (dir[i] == (Uint16)'/' || dir[i] == 0)
+        // Drives ("C:") and the root of an absolute path always exist
+        bool root = (i == 0) || (i == 2 && dir[1] == (Uint16)':');
+        if ((dir[i] == (Uint16)'/' || dir[i] == 0) && !root)
         {
             dir[i] = 0;
             if (!CreateDirectoryW(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
@@ -349,6 +523,34 @@ char *OsGetWorkingDirectoryName(Memory_Arena *arena)
     return working_dir;
 }
 
+String OsGetWorkingDirectory(Memory_Arena *arena)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    DWORD            length  = GetCurrentDirectoryW(0, NULL);
+    wchar_t         *buffer  = PushSize(scratch, (length + 1) * sizeof(wchar_t));
+    length                   = GetCurrentDirectoryW(length + 1, buffer);
+    buffer[length]           = 0;
+
+    String result;
+    int    len    = WideCharToMultiByte(CP_UTF8, 0, buffer, -1, NULL, 0, 0, 0);
+    result.Data   = PushSize(arena, len + 1);
+    len           = WideCharToMultiByte(CP_UTF8, 0, buffer, -1, result.Data, len + 1, 0, 0);
+    result.Length = len > 0 ? len - 1 : 0;
+    result.Data[result.Length] = 0;
+
+    for (Int64 index = 0; index < result.Length; ++index)
+    {
+        if (result.Data[index] == '\\')
+            result.Data[index] = '/';
+    }
+
+    EndTemporaryMemory(&temp);
+
+    return result;
+}
+
 File_Handle OsFileOpen(const String path, File_Mode mode)
 {
     wchar_t *wpath               = UnicodeToWideChar(path.Data, (int)path.Length);
@@ -439,6 +641,17 @@ bool OsFileWrite(File_Handle handle, String data)
     return result;
 }
 
+// WriteFileGather needs unbuffered, page aligned writes, so the buffers are written one after another
+bool OsFileWriteBuffers(File_Handle handle, const String *buffers, Uint32 count)
+{
+    for (Uint32 index = 0; index < count; ++index)
+    {
+        if (!OsFileWrite(handle, buffers[index]))
+            return false;
+    }
+    return true;
+}
+
 bool OsFileWriteFV(File_Handle handle, const char *fmt, va_list args)
 {
     Memory_Arena    *scratch = ThreadScratchpad();
@@ -467,6 +680,19 @@ void OsFileClose(File_Handle handle)
     CloseHandle(handle.PlatformFileHandle);
 }
 
+bool OsFileRename(String from, String to)
+{
+    wchar_t *wfrom = UnicodeToWideChar(from.Data, (int)from.Length);
+    wchar_t *wto   = UnicodeToWideChar(to.Data, (int)to.Length);
+    return MoveFileExW(wfrom, wto, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+bool OsFileDelete(String path)
+{
+    wchar_t *wpath = UnicodeToWideChar(path.Data, (int)path.Length);
+    return DeleteFileW(wpath) != 0;
+}
+
 void OsSetupConsole()
 {
     SetConsoleCP(CP_UTF8);
@@ -532,6 +758,23 @@ void OsConsoleOutV(void *fp, const char *fmt, va_list list)
     EndTemporaryMemory(&temp);
 }
 
+void OsConsoleOutBuffer(void *fp, String buffer)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+    int              len     = 0;
+    wchar_t         *wout    = UnicodeToWideCharLength((const char *)buffer.Data, (int)buffer.Length, &len);
+    DWORD            written = 0;
+    WriteConsoleW((HANDLE)fp, wout, (DWORD)len, &written, NULL);
+    EndTemporaryMemory(&temp);
+}
+
+bool OsConsoleIsTerminal(void *fp)
+{
+    DWORD mode;
+    return GetConsoleMode((HANDLE)fp, &mode) != 0;
+}
+
 void OsConsoleWrite(const char *fmt, ...)
 {
     va_list args;
@@ -573,6 +816,314 @@ String OsConsoleRead(char *buffer, Uint32 size)
     return StringMake(buffer, len);
 }
 
+Uint64 OsGetMonotonicTime()
+{
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (Uint64)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+           (Uint64)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+Uint64 OsGetPageFaultCount()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PageFaultCount;
+}
+
+Uint32 OsGetProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (Uint32)info.dwNumberOfProcessors : 1;
+}
+
+// Windows has neither a load average nor pressure stall information
+Os_System_Load OsGetSystemLoad()
+{
+    Os_System_Load load;
+    load.LoadAverage    = -1;
+    load.MemoryPressure = -1;
+    return load;
+}
+
+typedef struct Windows_Thread_Start
+{
+    Os_Thread_Procedure Procedure;
+    void               *Arg;
+} Windows_Thread_Start;
+
+static DWORD WINAPI WindowsThreadEntry(LPVOID arg)
+{
+    Windows_Thread_Start start = *(Windows_Thread_Start *)arg;
+    HeapFree(GetProcessHeap(), 0, arg);
+    start.Procedure(start.Arg);
+    return 0;
+}
+
+Os_Thread OsThreadCreate(Os_Thread_Procedure proc, void *arg)
+{
+    Os_Thread             thread = {NULL};
+
+    Windows_Thread_Start *start  = (Windows_Thread_Start *)HeapAlloc(GetProcessHeap(), 0, sizeof(*start));
+    if (!start)
+        return thread;
+
+    start->Procedure = proc;
+    start->Arg       = arg;
+
+    HANDLE handle    = CreateThread(NULL, 0, WindowsThreadEntry, start, 0, NULL);
+    if (!handle)
+    {
+        HeapFree(GetProcessHeap(), 0, start);
+        return thread;
+    }
+
+    thread.PlatformHandle = handle;
+    return thread;
+}
+
+void OsThreadJoin(Os_Thread thread)
+{
+    WaitForSingleObject((HANDLE)thread.PlatformHandle, INFINITE);
+    CloseHandle((HANDLE)thread.PlatformHandle);
+}
+
+Os_Semaphore OsSemaphoreCreate(Uint32 initial_count)
+{
+    Os_Semaphore semaphore;
+    semaphore.PlatformHandle = CreateSemaphoreW(NULL, (LONG)initial_count, MAXLONG, NULL);
+    return semaphore;
+}
+
+void OsSemaphoreDestroy(Os_Semaphore semaphore)
+{
+    CloseHandle((HANDLE)semaphore.PlatformHandle);
+}
+
+void OsSemaphoreSignal(Os_Semaphore semaphore, Uint32 count)
+{
+    ReleaseSemaphore((HANDLE)semaphore.PlatformHandle, (LONG)count, NULL);
+}
+
+void OsSemaphoreWait(Os_Semaphore semaphore)
+{
+    WaitForSingleObject((HANDLE)semaphore.PlatformHandle, INFINITE);
+}
+
+bool OsSemaphoreWaitTimeout(Os_Semaphore semaphore, Uint32 milliseconds)
+{
+    return WaitForSingleObject((HANDLE)semaphore.PlatformHandle, milliseconds) == WAIT_OBJECT_0;
+}
+
+// GNU make for Windows shares its job slots through a named semaphore, a token is a count of the semaphore
+Os_Jobserver OsJobserverConnect(String auth)
+{
+    Os_Jobserver result;
+    result.PlatformHandle = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, (char *)auth.Data);
+    return result;
+}
+
+Os_Jobserver OsJobserverCreate(Uint32 tokens, char *auth, Uint32 auth_size)
+{
+    Os_Jobserver result = {NULL};
+    snprintf(auth, auth_size, "muda_jobserver_%lu", (unsigned long)GetCurrentProcessId());
+    if (tokens)
+        result.PlatformHandle = CreateSemaphoreA(NULL, (LONG)tokens, (LONG)tokens, auth);
+    return result;
+}
+
+bool OsJobserverAcquire(Os_Jobserver jobserver)
+{
+    return WaitForSingleObject((HANDLE)jobserver.PlatformHandle, 0) == WAIT_OBJECT_0;
+}
+
+void OsJobserverRelease(Os_Jobserver jobserver)
+{
+    ReleaseSemaphore((HANDLE)jobserver.PlatformHandle, 1, NULL);
+}
+
+void OsJobserverDestroy(Os_Jobserver jobserver)
+{
+    CloseHandle((HANDLE)jobserver.PlatformHandle);
+}
+
+bool OsSetEnvironmentVariable(const char *name, const char *value)
+{
+    return SetEnvironmentVariableA(name, value) != 0;
+}
+
+// Winsock counts its initializations, every call is balanced by the cleanup done when the process exits
+static bool WindowsSocketStartup()
+{
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+
+// The port alone is the loopback address, listening on every interface needs an explicit "0.0.0.0:port"
+static struct addrinfo *WindowsResolveAddress(String address)
+{
+    char  host[256], port[32];
+    Int64 colon = StrReverseFindCharacter(address, ':', address.Length - 1);
+    if (colon >= 0)
+    {
+        snprintf(host, sizeof(host), "%.*s", (int)colon, address.Data);
+        snprintf(port, sizeof(port), "%.*s", (int)(address.Length - colon - 1), address.Data + colon + 1);
+    }
+    else
+    {
+        snprintf(port, sizeof(port), "%.*s", (int)address.Length, address.Data);
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *addresses = NULL;
+    if (!WindowsSocketStartup() || getaddrinfo(colon >= 0 ? host : "127.0.0.1", port, &hints, &addresses) != 0)
+        return NULL;
+    return addresses;
+}
+
+Os_Socket OsSocketListen(String address)
+{
+    Os_Socket        result    = {-1};
+    struct addrinfo *addresses = WindowsResolveAddress(address);
+    for (struct addrinfo *it = addresses; it && result.PlatformHandle < 0; it = it->ai_next)
+    {
+        SOCKET sock = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (bind(sock, it->ai_addr, (int)it->ai_addrlen) == 0 && listen(sock, 64) == 0)
+            result.PlatformHandle = (Int64)sock;
+        else
+            closesocket(sock);
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+    return result;
+}
+
+Os_Socket OsSocketAccept(Os_Socket listener)
+{
+    Os_Socket result = {-1};
+    SOCKET    sock   = accept((SOCKET)listener.PlatformHandle, NULL, NULL);
+    if (sock != INVALID_SOCKET)
+    {
+        BOOL no_delay = TRUE;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+        result.PlatformHandle = (Int64)sock;
+    }
+    return result;
+}
+
+Os_Socket OsSocketConnect(String address, Uint32 timeout)
+{
+    Os_Socket        result    = {-1};
+    struct addrinfo *addresses = WindowsResolveAddress(address);
+    for (struct addrinfo *it = addresses; it && result.PlatformHandle < 0; it = it->ai_next)
+    {
+        SOCKET sock = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+
+        // Connected without blocking, so that a host that does not answer only costs the timeout
+        u_long non_blocking = 1;
+        ioctlsocket(sock, FIONBIO, &non_blocking);
+        bool connected = connect(sock, it->ai_addr, (int)it->ai_addrlen) == 0;
+        if (!connected && WSAGetLastError() == WSAEWOULDBLOCK)
+        {
+            fd_set writable, failed;
+            FD_ZERO(&writable);
+            FD_ZERO(&failed);
+            FD_SET(sock, &writable);
+            FD_SET(sock, &failed);
+            struct timeval wait = {(long)(timeout / 1000), (long)(timeout % 1000) * 1000};
+            connected           = select(0, NULL, &writable, &failed, &wait) == 1 && FD_ISSET(sock, &writable);
+        }
+
+        if (connected)
+        {
+            BOOL no_delay = TRUE;
+            non_blocking  = 0;
+            ioctlsocket(sock, FIONBIO, &non_blocking);
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&no_delay, sizeof(no_delay));
+            result.PlatformHandle = (Int64)sock;
+        }
+        else
+        {
+            closesocket(sock);
+        }
+    }
+    if (addresses)
+        freeaddrinfo(addresses);
+    return result;
+}
+
+bool OsSocketSend(Os_Socket socket, const void *data, Ptrsize size)
+{
+    const char *bytes = (const char *)data;
+    while (size)
+    {
+        int sent = send((SOCKET)socket.PlatformHandle, bytes, (int)Minimum(size, MegaBytes(1)), 0);
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= (Ptrsize)sent;
+    }
+    return true;
+}
+
+bool OsSocketReceive(Os_Socket socket, void *data, Ptrsize size)
+{
+    char *bytes = (char *)data;
+    while (size)
+    {
+        int received = recv((SOCKET)socket.PlatformHandle, bytes, (int)Minimum(size, MegaBytes(1)), 0);
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= (Ptrsize)received;
+    }
+    return true;
+}
+
+void OsSocketClose(Os_Socket socket)
+{
+    if (socket.PlatformHandle >= 0)
+        closesocket((SOCKET)socket.PlatformHandle);
+}
+
+// The console handles of a process can not be handed over a socket, builds always run in their own process
+Os_Socket OsSocketListenLocal(String path)
+{
+    Os_Socket result = {-1};
+    return result;
+}
+
+Os_Socket OsSocketConnectLocal(String path)
+{
+    Os_Socket result = {-1};
+    return result;
+}
+
+bool OsConsoleSend(Os_Socket socket)
+{
+    return false;
+}
+
+bool OsConsoleReceive(Os_Socket socket, Os_Console_Redirect *redirect)
+{
+    return false;
+}
+
+void OsConsoleRestore(Os_Console_Redirect *redirect)
+{
+}
+
 void *OsLibraryLoad(const char *path)
 {
     return LoadLibraryA(path);
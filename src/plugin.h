@@ -177,7 +177,7 @@ typedef struct Temporary_Memory
 } Temporary_Memory;
 
 #define MUDA_PLUGIN_VERSION_MAJOR 1
-#define MUDA_PLUGIN_VERSION_MINOR 10
+#define MUDA_PLUGIN_VERSION_MINOR 11
 #define MUDA_PLUGIN_VERSION_PATCH 0
 
 #else
@@ -233,9 +233,13 @@ typedef enum Muda_Plugin_Event_Kind
     Muda_Plugin_Event_Kind_Parse,
     Muda_Plugin_Event_Kind_Prebuild,
     Muda_Plugin_Event_Kind_Postbuild,
-    Muda_Plugin_Event_Kind_Destroy
+    Muda_Plugin_Event_Kind_Destroy,
+    Muda_Plugin_Event_Kind_Actions, // Since 1.11, only sent to plugins that accept version 1.11 or later
 } Muda_Plugin_Event_Kind;
 
+// Bit of the event kind in Muda_Plugin_Interface::Subscriptions
+#define MudaEventBit(kind) (1u << (kind))
+
 typedef enum Command_Line_Flags
 {
     Command_Line_Flag_Force_Optimization = 0x1,
@@ -264,17 +268,77 @@ typedef struct Muda_Plugin_Config
                         // successful
 } Muda_Plugin_Config;
 
+typedef enum Muda_Plugin_Action_Event_Kind
+{
+    Muda_Plugin_Action_Event_Start,
+    Muda_Plugin_Action_Event_Finish,
+    Muda_Plugin_Action_Event_Cache_Hit,  // The outputs were restored from the cache, the action is not executed
+    Muda_Plugin_Action_Event_Cache_Miss, // The action is executed, its outputs are stored in the cache
+} Muda_Plugin_Action_Event_Kind;
+
+// ALERT: This must be synced with Build_Node_Kind
+typedef enum Muda_Plugin_Action_Kind
+{
+    Muda_Plugin_Action_Compile,
+    Muda_Plugin_Action_Archive,
+    Muda_Plugin_Action_Link,
+    Muda_Plugin_Action_Resource,
+    Muda_Plugin_Action_Custom,
+} Muda_Plugin_Action_Kind;
+
+// Times are in microseconds, "Time" is read from a monotonic clock
+// The fields below "ExitCode" are only set for Muda_Plugin_Action_Event_Finish
+typedef struct Muda_Plugin_Action_Event
+{
+    Muda_Plugin_Action_Event_Kind Kind;
+    Muda_Plugin_Action_Kind       Action;
+    const char                   *Input;  // First input of the action
+    const char                   *Output; // First output of the action
+    uint64_t                      Time;
+    uint32_t                      Thread; // 0 is the main thread
+
+    int32_t                       ExitCode; // -1 if the process could not be created or did not exit
+    uint64_t                      Duration;
+    uint64_t                      UserTime;
+    uint64_t                      SystemTime;
+    uint64_t                      PeakMemory; // Bytes of resident memory
+} Muda_Plugin_Action_Event;
+
+// Events of the actions are delivered in batches, in the order they happened, from the thread running the build
+// The batch and its strings are only valid during the call
+typedef struct Muda_Plugin_Action_Batch
+{
+    const char                     *Target;
+    const Muda_Plugin_Action_Event *Events;
+    uint32_t                        Count;
+} Muda_Plugin_Action_Batch;
+
 typedef struct Muda_Plugin_Event
 {
     Muda_Plugin_Event_Kind Kind;
 
     union {
-        Muda_Plugin_Config Prebuild;
-        Muda_Plugin_Config Postbuild;
-        Muda_Parser_Token  Parse;
+        Muda_Plugin_Config       Prebuild;
+        Muda_Plugin_Config       Postbuild;
+        Muda_Parser_Token        Parse;
+        Muda_Plugin_Action_Batch Actions;
     } Data;
 } Muda_Plugin_Event;
 
+// Since 1.11, a plugin stores the objects of the cache by setting Interface->CacheProvider during Detection
+// Blobs are files keyed by a hash (16 hexadecimal digits) of their content and of everything that produced them.
+// The procedures are called by the worker threads at the same time, and return 0 on success.
+typedef struct Muda_Cache_Provider
+{
+    int32_t (*Contains)(void *context, const char *key);
+    int32_t (*Get)(void *context, const char *key, const char *path); // Writes the blob to the file "path"
+    int32_t (*Put)(void *context, const char *key, const char *path); // Stores the content of the file "path"
+    void    *Context;
+    uint32_t Flags;
+} Muda_Cache_Provider;
+
+#define MUDA_CACHE_PROVIDER_REPLACE_LOCAL 0x1 // The local store given with -cache is not used
+
 typedef struct Muda_Plugin_Interface
 {
     struct Memory_Arena *(*GetThreadScratchpad)(struct Thread_Context *);
@@ -297,6 +361,9 @@ typedef struct Muda_Plugin_Interface
     {
         uint32_t Major, Minor, Patch;
     } Version;
+
+    uint32_t                   Subscriptions; // Since 1.11, event kinds sent to the plugin, all unless set in Detection
+    const Muda_Cache_Provider *CacheProvider; // Since 1.11, NULL unless the plugin stores the objects of the cache
 } Muda_Plugin_Interface;
 
 #define Muda_Event_Hook_Defn(name)                                                                                     \
@@ -324,9 +391,9 @@ typedef Muda_Event_Hook_Defn((*Muda_Event_Hook_Procedure));
 #define MudaError(fmt, ...) Interface->LogError(Thread, fmt, ##__VA_ARGS__)
 #define MudaFatalError(msg) Interface->FatalError(Thread, msg)
 #define MudaGetThreadScratch Interface->GetThreadScratchpad(Thread)
-#define MudaPushSize(sz) Interface->PushSize(sz)
-#define MudaPushType(type) Interface->PushSize(sizeof(sz))
-#define MudaPushSizeAligned(sz, align) Interface->PushSizeAligned(sz, align)
+#define MudaPushSize(arena, sz) Interface->PushSize(arena, sz)
+#define MudaPushType(arena, type) (type *)Interface->PushSize(arena, sizeof(type))
+#define MudaPushSizeAligned(arena, sz, align) Interface->PushSizeAligned(arena, sz, align)
 #define MudaBeginTemporaryMemory(arena) Interface->BeginTemporaryMemory(arena)
 #define MudaEndTemporaryMemory(temp) Interface->EndTemporaryMemory(temp)
 #define MudaSetUserContext(context) Interface->UserContext = context
@@ -334,5 +401,8 @@ typedef Muda_Event_Hook_Defn((*Muda_Event_Hook_Procedure));
 #define MudaGetEventKind() Event->Kind
 #define MudaGetPrebuildData() &Event->Data.Prebuild
 #define MudaGetPostbuildData() &Event->Data.Postbuild
+#define MudaGetActionBatch() &Event->Data.Actions
+#define MudaSubscribe(mask) Interface->Subscriptions = (mask)
+#define MudaSetCacheProvider(provider) Interface->CacheProvider = (provider)
 
 #endif
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "config.h"
+#include "lenstring.h"
+#include "os.h"
+#include "trace.h"
+
+//
+// Plugin host
+// Loads ".muda/muda.so" (".muda/muda.dll" on Windows) and every library of ".muda/plugins/", the version of every
+// plugin is negotiated on its own through MudaAcceptVersion.
+// While handling the Detection event, a plugin can restrict the events it receives with MudaSubscribe. The events are
+// dispatched through a table of the plugins subscribed to each kind, Detection and Destroy are always sent.
+// Calls to the plugins are added to the trace.
+//
+
+#define MUDA_MAX_PLUGINS 32
+#define MUDA_PLUGIN_EVENT_KIND_COUNT (Muda_Plugin_Event_Kind_Actions + 1)
+
+static const char *PluginEventKindName[MUDA_PLUGIN_EVENT_KIND_COUNT] = {"Detection", "Parse",   "Prebuild",
+                                                                         "Postbuild", "Destroy", "Actions"};
+
+typedef struct Plugin_Instance
+{
+    void                     *Library;
+    Muda_Event_Hook_Procedure Hook;
+    Muda_Plugin_Interface     Interface; // Every plugin has its own name and user context
+    Uint32                    Version;   // Version accepted by the plugin
+} Plugin_Instance;
+
+typedef struct Plugin_Host
+{
+    Plugin_Instance  Plugins[MUDA_MAX_PLUGINS];
+    Uint32           Count;
+    Plugin_Instance *Dispatch[MUDA_PLUGIN_EVENT_KIND_COUNT][MUDA_MAX_PLUGINS];
+    Uint32           DispatchCount[MUDA_PLUGIN_EVENT_KIND_COUNT];
+} Plugin_Host;
+
+static Int32 PluginCall(Build_Config *build_config, Plugin_Instance *plugin, Muda_Plugin_Event *event)
+{
+    if (!build_config->Trace)
+        return plugin->Hook(&ThreadContext, &plugin->Interface, event);
+
+    Uint64 start  = OsGetMonotonicTime();
+    Int32  result = plugin->Hook(&ThreadContext, &plugin->Interface, event);
+    Uint64 end    = OsGetMonotonicTime();
+
+    char   name[256];
+    int    length = snprintf(name, sizeof(name), "%s %s", plugin->Interface.PluginName, PluginEventKindName[event->Kind]);
+    TraceAddEvent(build_config->Trace, "plugin", StringMake(name, Minimum(length, (int)sizeof(name) - 1)), start, end,
+                  ThreadContext.ThreadIndex);
+    return result;
+}
+
+INLINE_PROCEDURE bool PluginSubscribed(Build_Config *build_config, Muda_Plugin_Event_Kind kind)
+{
+    return build_config->Plugins && build_config->Plugins->DispatchCount[kind] != 0;
+}
+
+// Returns 0 if a plugin handled the event (returned 0), non zero otherwise
+// A Parse event stops at the first plugin that consumes the property, the other events are sent to every subscriber
+static Int32 PluginDispatch(Build_Config *build_config, Muda_Plugin_Event *event)
+{
+    Plugin_Host *host = build_config->Plugins;
+    if (!host)
+        return -1;
+
+    Int32 result = -1;
+    for (Uint32 index = 0; index < host->DispatchCount[event->Kind]; ++index)
+    {
+        if (PluginCall(build_config, host->Dispatch[event->Kind][index], event) == 0)
+        {
+            result = 0;
+            if (event->Kind == Muda_Plugin_Event_Kind_Parse)
+                break;
+        }
+    }
+    return result;
+}
+
+static void PluginHostLoad(Plugin_Host *host, Build_Config *build_config, const char *path)
+{
+    if (host->Count == MUDA_MAX_PLUGINS)
+    {
+        LogWarn("Plugin %s ignored, at most %u plugins are loaded\n", path, MUDA_MAX_PLUGINS);
+        return;
+    }
+
+    void *library = OsLibraryLoad(path);
+    if (!library)
+        return;
+
+    typedef void (*PluginVersionProc)(uint32_t * major, uint32_t * minor, uint32_t * patch);
+    PluginVersionProc check_version = (PluginVersionProc)OsGetProcedureAddress(library, "MudaAcceptVersion");
+    if (!check_version)
+    {
+        OsLibraryFree(library);
+        return;
+    }
+
+    uint32_t major, minor, patch;
+    check_version(&major, &minor, &patch);
+
+    uint32_t supported_major   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_MAJOR;
+    uint32_t supported_minor   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_MINOR;
+    uint32_t supported_patch   = MUDA_PLUGIN_BACK_COMPATIBLE_VERSION_PATCH;
+
+    uint32_t plugin_version    = MudaMakeVersion(major, minor, patch);
+    uint32_t supported_version = MudaMakeVersion(supported_major, supported_minor, supported_patch);
+    uint32_t current_version   = MUDA_CURRENT_VERSION;
+
+    if (plugin_version > current_version || plugin_version < supported_version)
+    {
+        LogWarn("Plugin %s dectected but not supported. Plugin version: %u.%u.%u. Min Supported version: "
+                "%u.%u.%u. Current version: %u.%u.%u.\n",
+                path, major, minor, patch, supported_major, supported_minor, supported_patch, MUDA_VERSION_MAJOR,
+                MUDA_VERSION_MINOR, MUDA_VERSION_PATCH);
+        OsLibraryFree(library);
+        return;
+    }
+
+    Plugin_Instance *plugin = &host->Plugins[host->Count];
+    plugin->Library         = library;
+    plugin->Hook            = (Muda_Event_Hook_Procedure)OsGetProcedureAddress(library, MudaPluginProcedureName);
+    plugin->Interface       = build_config->Interface;
+    plugin->Version         = plugin_version;
+
+    if (!plugin->Hook)
+    {
+        LogWarn("Plugin %s dectected by could not be loaded\n", path);
+        OsLibraryFree(library);
+        return;
+    }
+
+    Muda_Plugin_Event pevent;
+    memset(&pevent, 0, sizeof(pevent));
+    pevent.Kind = Muda_Plugin_Event_Kind_Detection;
+    if (PluginCall(build_config, plugin, &pevent) != 0)
+    {
+        LogInfo("Loading of Plugin %s failed.\n", path);
+        OsLibraryFree(library);
+        return;
+    }
+
+    LogInfo("Plugin detected. Name: %s\n", plugin->Interface.PluginName);
+    host->Count += 1;
+
+    Uint32 subscriptions = plugin->Interface.Subscriptions;
+    subscriptions |= MudaEventBit(Muda_Plugin_Event_Kind_Detection) | MudaEventBit(Muda_Plugin_Event_Kind_Destroy);
+    if (plugin_version < MudaMakeVersion(1, 11, 0))
+        subscriptions &= ~MudaEventBit(Muda_Plugin_Event_Kind_Actions);
+
+    for (Uint32 kind = 0; kind < MUDA_PLUGIN_EVENT_KIND_COUNT; ++kind)
+    {
+        if (subscriptions & MudaEventBit(kind))
+            host->Dispatch[kind][host->DispatchCount[kind]++] = plugin;
+    }
+}
+
+typedef struct Plugin_Search
+{
+    String        Paths[MUDA_MAX_PLUGINS];
+    Uint32        Count;
+    Memory_Arena *Arena;
+} Plugin_Search;
+
+static Directory_Iteration PluginSearchIterator(const File_Info *info, void *context)
+{
+    Plugin_Search *search = (Plugin_Search *)context;
+    if (!(info->Atribute & File_Attribute_Directory) && search->Count < MUDA_MAX_PLUGINS &&
+        StrEndsWith(info->Name, StringMake(MudaPluginExtension, strlen(MudaPluginExtension))))
+    {
+        search->Paths[search->Count++] = StrDuplicateArena(info->Path, search->Arena);
+    }
+    return Directory_Iteration_Continue;
+}
+
+// Sets build_config->Plugins if at least one plugin is loaded
+// The plugins of ".muda/plugins/" are loaded in the order of their names
+static void PluginHostCreate(Plugin_Host *host, Build_Config *build_config)
+{
+    memset(host, 0, sizeof(*host));
+
+    Muda_Parsing_COMPILER forced_compiler = Muda_Parsing_COMPILER_ALL;
+    if (build_config->ForceCompiler == Compiler_Bit_CL)
+        forced_compiler = Muda_Parsing_COMPILER_CL;
+    else if (build_config->ForceCompiler == Compiler_Bit_CLANG)
+        forced_compiler = Muda_Parsing_COMPILER_CLANG;
+    else if (build_config->ForceCompiler == Compiler_Bit_GCC)
+        forced_compiler = Muda_Parsing_COMPILER_GCC;
+
+    Command_Line_Config *command_line = &build_config->Interface.CommandLineConfig;
+    command_line->Flags               = 0;
+    if (build_config->ForceCompiler)
+        command_line->Flags |= Command_Line_Flag_Force_Optimization;
+    if (build_config->DisplayCommandLine)
+        command_line->Flags |= Command_Line_Flag_Display_Command_Line;
+    if (build_config->DisableLogs)
+        command_line->Flags |= Command_Line_Flag_Disable_Logs;
+
+    command_line->ForceCompiler      = forced_compiler;
+    command_line->Configurations     = (Muda_String *)build_config->Configurations;
+    command_line->ConfigurationCount = build_config->ConfigurationCount;
+    command_line->LogFilePath        = build_config->LogFilePath;
+
+    if (OsCheckIfPathExists(StringMake(MudaPluginPath, strlen(MudaPluginPath))) == Path_Exist_File)
+        PluginHostLoad(host, build_config, MudaPluginPath);
+
+    if (OsCheckIfPathExists(StringMake(MudaPluginDirectory, strlen(MudaPluginDirectory))) == Path_Exist_Directory)
+    {
+        // The iteration uses the first scratchpad for every entry, the paths are kept in the second one
+        Memory_Arena    *dir_scratch = ThreadScratchpadI(1);
+        Temporary_Memory temp        = BeginTemporaryMemory(dir_scratch);
+
+        Plugin_Search    search;
+        search.Count = 0;
+        search.Arena = dir_scratch;
+        OsIterateDirectory(MudaPluginDirectory, PluginSearchIterator, &search);
+
+        for (Uint32 index = 1; index < search.Count; ++index)
+        {
+            String path = search.Paths[index];
+            Uint32 pos  = index;
+            for (; pos > 0 && StrCompare(search.Paths[pos - 1], path) > 0; --pos)
+                search.Paths[pos] = search.Paths[pos - 1];
+            search.Paths[pos] = path;
+        }
+
+        for (Uint32 index = 0; index < search.Count; ++index)
+            PluginHostLoad(host, build_config, (const char *)search.Paths[index].Data);
+
+        EndTemporaryMemory(&temp);
+    }
+
+    if (host->Count)
+        build_config->Plugins = host;
+}
+
+// Sends the Destroy event to every plugin before unloading them
+static void PluginHostDestroy(Plugin_Host *host, Build_Config *build_config)
+{
+    Muda_Plugin_Event pevent;
+    memset(&pevent, 0, sizeof(pevent));
+    pevent.Kind = Muda_Plugin_Event_Kind_Destroy;
+    PluginDispatch(build_config, &pevent);
+
+    for (Uint32 index = 0; index < host->Count; ++index)
+        OsLibraryFree(host->Plugins[index].Library);
+
+    build_config->Plugins = NULL;
+    host->Count           = 0;
+}
@@ -0,0 +1,491 @@
+#pragma once
+
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+
+#include <stdlib.h>
+
+//
+// Distributed compilation
+// Compilations can be run by workers started with "muda -serve <port>" on other machines. The source is preprocessed
+// locally, which also writes the dependency file, and sent to a worker along with the command line stripped of the
+// preprocessor options. The worker compiles it and sends back the exit code, the output of the compiler and the
+// object file. Only GCC and Clang compilations are distributed, the worker must have the same compiler version.
+// Hosts are listed in the file given with -distribute, one per line: "host:port [slots]", '#' starts a comment.
+// A host that can not be reached is not used again during the build, its compilations are run locally.
+// Workers only run the known compilers with the options of RemoteOptionAllowed, without a shell. The build does not
+// distribute the commands they would refuse, profile guided ones among them. Workers listen on the loopback address
+// unless given a host, there is no authentication: they must only be reachable from trusted machines.
+//
+// Messages, integers are little endian:
+//   request:  magic, version, argument count, arguments, source name, source size, source
+//   response: magic, exit code, output size, output, object size, object
+// Strings are sent as their 32 bit length followed by the bytes.
+//
+
+#define REMOTE_PROTOCOL_MAGIC 0x5244554du // "MUDR"
+#define REMOTE_PROTOCOL_VERSION 1
+#define REMOTE_MAX_HOSTS 64
+#define REMOTE_MAX_ARGUMENTS 4096
+#define REMOTE_MAX_STRING KiloBytes(64)
+#define REMOTE_MAX_SOURCE MegaBytes(512)
+#define REMOTE_CONNECT_TIMEOUT 2000 // Milliseconds
+#define REMOTE_EXIT_NOT_RUN -1      // Exit code sent when the worker could not run the compiler
+#define REMOTE_EXIT_REJECTED -2     // Exit code sent when the worker does not run the compiler or one of its options
+
+typedef struct Remote_Host
+{
+    String         Address;
+    Uint32         Slots;
+    Uint32         Running; // Only used by the thread executing the graph
+    volatile Int32 Down;    // Set by the worker thread that could not reach the host
+} Remote_Host;
+
+typedef struct Remote_Pool
+{
+    Remote_Host Hosts[REMOTE_MAX_HOSTS];
+    Uint32      HostCount;
+    Uint32      SlotCount;
+} Remote_Pool;
+
+typedef enum Remote_Result
+{
+    Remote_Result_Unavailable, // The host could not be reached or the transfer failed, the action has to run locally
+    Remote_Result_Rejected,    // The worker does not run this command, the action has to run locally
+    Remote_Result_Failed,      // The compiler failed on the worker
+    Remote_Result_Succeeded,
+} Remote_Result;
+
+// Returns false if the file could not be read or lists no host, the compilations are then executed locally
+static bool RemotePoolLoad(Remote_Pool *pool, const char *path, Memory_Arena *arena)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    File_Handle handle = OsFileOpen(StringMake(path, strlen(path)), File_Mode_Read);
+    if (!handle.PlatformFileHandle)
+    {
+        LogWarn("Could not read the host list %s, compilations are executed locally\n", path);
+        return false;
+    }
+
+    Ptrsize size = OsFileGetSize(handle);
+    Uint8  *data = PushSize(arena, size + 1);
+    bool    read = (size == 0) || OsFileRead(handle, data, size);
+    OsFileClose(handle);
+    if (!read)
+    {
+        LogWarn("Could not read the host list %s, compilations are executed locally\n", path);
+        return false;
+    }
+
+    String content = StringMake(data, size);
+    while (content.Length)
+    {
+        Int64  line_end = StrFindCharacter(content, '\n', 0);
+        String line     = StringMake(content.Data, line_end < 0 ? content.Length : line_end);
+        content         = StrRemovePrefix(content, line_end < 0 ? content.Length : line_end + 1);
+
+        Int64 comment   = StrFindCharacter(line, '#', 0);
+        if (comment >= 0)
+            line.Length = comment;
+        line = StrTrim(line);
+        if (!line.Length)
+            continue;
+
+        if (pool->HostCount == REMOTE_MAX_HOSTS)
+        {
+            LogWarn("Only %u hosts are used for distributed compilation\n", REMOTE_MAX_HOSTS);
+            break;
+        }
+
+        Int64  space   = Maximum(StrFindCharacter(line, ' ', 0), StrFindCharacter(line, '\t', 0));
+        String address = StrTrim(StringMake(line.Data, space < 0 ? line.Length : space));
+        Uint32 slots   = 1;
+        if (space >= 0)
+        {
+            String count = StrTrim(StrRemovePrefix(line, space + 1));
+            slots        = (Uint32)strtoul(StrDuplicateArena(count, arena).Data, NULL, 10);
+            if (slots == 0)
+            {
+                LogWarn("Invalid slot count for the host %.*s, 1 is used\n", (int)address.Length, address.Data);
+                slots = 1;
+            }
+        }
+
+        Remote_Host *host = &pool->Hosts[pool->HostCount++];
+        host->Address     = StrDuplicateArena(address, arena);
+        host->Slots       = slots;
+        pool->SlotCount += slots;
+    }
+
+    if (!pool->HostCount)
+    {
+        LogWarn("The host list %s lists no host, compilations are executed locally\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Returns the host with the most free slots, NULL if every host is busy or down
+static Remote_Host *RemotePoolAcquire(Remote_Pool *pool)
+{
+    Remote_Host *best = NULL;
+    for (Uint32 index = 0; index < pool->HostCount; ++index)
+    {
+        Remote_Host *host = &pool->Hosts[index];
+        if (AtomicLoad32(&host->Down) || host->Running == host->Slots)
+            continue;
+        if (!best || host->Slots - host->Running > best->Slots - best->Running)
+            best = host;
+    }
+    if (best)
+        best->Running += 1;
+    return best;
+}
+
+INLINE_PROCEDURE void RemotePoolRelease(Remote_Host *host)
+{
+    host->Running -= 1;
+}
+
+//
+// Commands run by the workers
+// Workers only run the known compilers with the code generation, warning, define and optimization options the build
+// gives for a preprocessed source. Every other option is refused: it could read files of the worker, load code, run
+// other programs or write other outputs. The build compiles the sources with refused commands locally.
+//
+
+static const String RemoteCompilers[] = {StringExpand("gcc"), StringExpand("g++"),   StringExpand("cc"),
+                                         StringExpand("c++"), StringExpand("clang"), StringExpand("clang++")};
+
+static const String RemoteAllowedFlags[] = {
+    StringExpand("-O"),
+    StringExpand("-w"),
+    StringExpand("-g"),
+    StringExpand("-g0"),
+    StringExpand("-g1"),
+    StringExpand("-g2"),
+    StringExpand("-g3"),
+    StringExpand("-ggdb"),
+    StringExpand("-gcodeview"),
+    StringExpand("-gline-tables-only"),
+    StringExpand("-ansi"),
+    StringExpand("-pedantic"),
+    StringExpand("-pedantic-errors"),
+    StringExpand("-pipe"),
+    StringExpand("-pthread"),
+    StringExpand("-fopenmp"),
+    StringExpand("-fPIC"),
+    StringExpand("-fpic"),
+    StringExpand("-fPIE"),
+    StringExpand("-fpie"),
+    StringExpand("-flto"),
+    StringExpand("-fexceptions"),
+    StringExpand("-frtti"),
+    StringExpand("-fcommon"),
+    StringExpand("-fwrapv"),
+    StringExpand("-fpermissive"),
+    StringExpand("-fshort-enums"),
+    StringExpand("-fsigned-char"),
+    StringExpand("-funsigned-char"),
+    StringExpand("-fms-extensions"),
+    StringExpand("-fcoroutines"),
+    StringExpand("-fchar8_t"),
+    StringExpand("-ffast-math"),
+    StringExpand("-funroll-loops"),
+    StringExpand("-fvectorize"),
+    StringExpand("-ftree-vectorize"),
+    StringExpand("-fstrict-aliasing"),
+    StringExpand("-fomit-frame-pointer"),
+    StringExpand("-ffunction-sections"),
+    StringExpand("-fdata-sections"),
+    StringExpand("-fstack-protector"),
+    StringExpand("-fstack-protector-strong"),
+    StringExpand("-fstack-protector-all"),
+    StringExpand("-fcolor-diagnostics"),
+    StringExpand("-m32"),
+    StringExpand("-m64"),
+    StringExpand("-marm"),
+    StringExpand("-mthumb"),
+};
+
+// Options given with their value: "-O2", "-DNAME=1", "-march=native"
+static const String RemoteAllowedPrefixes[] = {
+    StringExpand("-O"),
+    StringExpand("-D"),
+    StringExpand("-U"),
+    StringExpand("-std="),
+    StringExpand("-gdwarf"),
+    StringExpand("-fno-"),
+    StringExpand("-flto="),
+    StringExpand("-fvisibility="),
+    StringExpand("-fsanitize="),
+    StringExpand("-fdiagnostics-color"),
+    StringExpand("-fmax-errors="),
+    StringExpand("-ferror-limit="),
+    StringExpand("-ftemplate-depth="),
+    StringExpand("-fconstexpr-depth="),
+    StringExpand("-fconstexpr-steps="),
+    StringExpand("-ffp-contract="),
+    StringExpand("-march="),
+    StringExpand("-mtune="),
+    StringExpand("-mcpu="),
+    StringExpand("-mfpu="),
+    StringExpand("-mfloat-abi="),
+    StringExpand("-mabi="),
+    StringExpand("-mno-"),
+    StringExpand("-msse"),
+    StringExpand("-mavx"),
+    StringExpand("-mfma"),
+    StringExpand("-mbmi"),
+    StringExpand("-mpopcnt"),
+    StringExpand("-mlzcnt"),
+    StringExpand("-mf16c"),
+    StringExpand("-maes"),
+    StringExpand("-mpclmul"),
+};
+
+// Languages of a preprocessed source, given as the next argument of "-x"
+static const String RemoteAllowedLanguages[] = {StringExpand("c"), StringExpand("c++"), StringExpand("cpp-output"),
+                                                StringExpand("c++-cpp-output")};
+
+// Only the known compilers are run, found in the PATH of the worker and optionally suffixed by their version
+static bool RemoteCompilerAllowed(String compiler)
+{
+    for (Uint32 index = 0; index < ArrayCount(RemoteCompilers); ++index)
+    {
+        String name = RemoteCompilers[index];
+        if (StrMatch(compiler, name))
+            return true;
+        if (compiler.Length > name.Length + 1 && StrStartsWith(compiler, name) && compiler.Data[name.Length] == '-' &&
+            isdigit(compiler.Data[name.Length + 1]))
+        {
+            Int64 pos = name.Length + 1;
+            while (pos < compiler.Length && (isdigit(compiler.Data[pos]) || compiler.Data[pos] == '.'))
+                pos += 1;
+            if (pos == compiler.Length)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Warnings are allowed except the ones passing options to the assembler, the linker or the preprocessor ("-Wl,")
+static bool RemoteOptionAllowed(String arg)
+{
+    if (arg.Length > 2 && StrStartsWith(arg, StringLiteral("-W")))
+        return StrFindCharacter(arg, ',', 0) < 0;
+    for (Uint32 index = 0; index < ArrayCount(RemoteAllowedFlags); ++index)
+    {
+        if (StrMatch(arg, RemoteAllowedFlags[index]))
+            return true;
+    }
+    for (Uint32 index = 0; index < ArrayCount(RemoteAllowedPrefixes); ++index)
+    {
+        if (arg.Length > RemoteAllowedPrefixes[index].Length && StrStartsWith(arg, RemoteAllowedPrefixes[index]))
+            return true;
+    }
+    return false;
+}
+
+// "args" are the compiler followed by its options, without the source and the output
+// Returns false with the refused argument in "rejected"
+static bool RemoteArgumentsAllowed(String_List *args, String *rejected)
+{
+    String value    = {0}; // Option whose value is the next argument
+    bool   compiler = true;
+    ForList(String_List_Node, args)
+    {
+        ForListNode(args, MAX_STRING_NODE_DATA_COUNT)
+        {
+            String arg = it->Data[index];
+            *rejected  = arg;
+            if (compiler)
+            {
+                if (!RemoteCompilerAllowed(arg))
+                    return false;
+                compiler = false;
+            }
+            else if (value.Length)
+            {
+                bool allowed = StrMatch(value, StringLiteral("--param"));
+                for (Uint32 language = 0; !allowed && language < ArrayCount(RemoteAllowedLanguages); ++language)
+                    allowed = StrMatch(arg, RemoteAllowedLanguages[language]);
+                if (!allowed)
+                    return false;
+                value = StringLiteral("");
+            }
+            else if (StrMatch(arg, StringLiteral("-x")) || StrMatch(arg, StringLiteral("--param")))
+            {
+                value = arg;
+            }
+            else if (!RemoteOptionAllowed(arg))
+            {
+                return false;
+            }
+        }
+    }
+
+    // An option missing its value
+    return compiler == false && value.Length == 0;
+}
+
+INLINE_PROCEDURE bool RemoteSendUint32(Os_Socket socket, Uint32 value)
+{
+    Uint8 bytes[4] = {(Uint8)value, (Uint8)(value >> 8), (Uint8)(value >> 16), (Uint8)(value >> 24)};
+    return OsSocketSend(socket, bytes, sizeof(bytes));
+}
+
+INLINE_PROCEDURE bool RemoteSendUint64(Os_Socket socket, Uint64 value)
+{
+    return RemoteSendUint32(socket, (Uint32)value) && RemoteSendUint32(socket, (Uint32)(value >> 32));
+}
+
+INLINE_PROCEDURE bool RemoteSendString(Os_Socket socket, String str)
+{
+    return RemoteSendUint32(socket, (Uint32)str.Length) && OsSocketSend(socket, str.Data, str.Length);
+}
+
+INLINE_PROCEDURE bool RemoteReceiveUint32(Os_Socket socket, Uint32 *value)
+{
+    Uint8 bytes[4];
+    if (!OsSocketReceive(socket, bytes, sizeof(bytes)))
+        return false;
+    *value = (Uint32)bytes[0] | ((Uint32)bytes[1] << 8) | ((Uint32)bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+    return true;
+}
+
+INLINE_PROCEDURE bool RemoteReceiveUint64(Os_Socket socket, Uint64 *value)
+{
+    Uint32 low, high;
+    if (!RemoteReceiveUint32(socket, &low) || !RemoteReceiveUint32(socket, &high))
+        return false;
+    *value = (Uint64)low | ((Uint64)high << 32);
+    return true;
+}
+
+static bool RemoteReceiveString(Os_Socket socket, String *str, Memory_Arena *arena)
+{
+    Uint32 length;
+    if (!RemoteReceiveUint32(socket, &length) || length > REMOTE_MAX_STRING)
+        return false;
+    Uint8 *data = PushSize(arena, length + 1);
+    if (!OsSocketReceive(socket, data, length))
+        return false;
+    data[length] = 0;
+    *str         = StringMake(data, length);
+    return true;
+}
+
+// Files are sent as their size followed by the content, in chunks so that big files are never held in memory
+static bool RemoteSendFile(Os_Socket socket, String path)
+{
+    File_Handle handle = OsFileOpen(path, File_Mode_Read);
+    if (!handle.PlatformFileHandle)
+        return RemoteSendUint64(socket, 0);
+
+    Uint64 size   = OsFileGetSize(handle);
+    bool   result = RemoteSendUint64(socket, size);
+
+    Uint8  buffer[KiloBytes(64)];
+    while (result && size)
+    {
+        Ptrsize chunk = (Ptrsize)Minimum(size, sizeof(buffer));
+        result        = OsFileRead(handle, buffer, chunk) && OsSocketSend(socket, buffer, chunk);
+        size -= chunk;
+    }
+    OsFileClose(handle);
+    return result;
+}
+
+// The file is not written if "path" is empty, the content is then discarded
+static bool RemoteReceiveFile(Os_Socket socket, Uint64 size, String path)
+{
+    File_Handle handle = {NULL};
+    if (path.Length)
+    {
+        handle = OsFileOpen(path, File_Mode_Write);
+        if (!handle.PlatformFileHandle)
+            return false;
+    }
+
+    bool  result = true;
+    Uint8 buffer[KiloBytes(64)];
+    while (result && size)
+    {
+        Ptrsize chunk = (Ptrsize)Minimum(size, sizeof(buffer));
+        result        = OsSocketReceive(socket, buffer, chunk);
+        if (result && handle.PlatformFileHandle)
+            result = OsFileWrite(handle, StringMake(buffer, chunk));
+        size -= chunk;
+    }
+
+    if (handle.PlatformFileHandle)
+        OsFileClose(handle);
+    return result;
+}
+
+// Compiles the preprocessed "source" on the host, the arguments are the compiler and its options without the input
+// and output files. The output of the compiler is appended to "output" and its exit code written to "exit_code".
+static Remote_Result RemoteCompile(Remote_Host *host, String_List *args, String source, String name, String object,
+                                   Out_Stream *output, Int32 *exit_code)
+{
+    Os_Socket socket = OsSocketConnect(host->Address, REMOTE_CONNECT_TIMEOUT);
+    if (socket.PlatformHandle < 0)
+        return Remote_Result_Unavailable;
+
+    Uint32 arg_count = 0;
+    ForList(String_List_Node, args)
+    {
+        ForListNode(args, MAX_STRING_NODE_DATA_COUNT)
+        {
+            arg_count += 1;
+        }
+    }
+
+    bool sent = RemoteSendUint32(socket, REMOTE_PROTOCOL_MAGIC) && RemoteSendUint32(socket, REMOTE_PROTOCOL_VERSION) &&
+                RemoteSendUint32(socket, arg_count);
+    ForList(String_List_Node, args)
+    {
+        ForListNode(args, MAX_STRING_NODE_DATA_COUNT)
+        {
+            sent = sent && RemoteSendString(socket, it->Data[index]);
+        }
+    }
+    sent = sent && RemoteSendString(socket, name) && RemoteSendFile(socket, source);
+
+    // The output is appended in chunks, "output" may be allocated from the thread scratchpad
+    Remote_Result result   = Remote_Result_Unavailable;
+    Uint32        magic    = 0;
+    Uint32        code     = 0;
+    Uint64        output_size, object_size;
+    bool          received = sent && RemoteReceiveUint32(socket, &magic) && magic == REMOTE_PROTOCOL_MAGIC &&
+                             RemoteReceiveUint32(socket, &code) && RemoteReceiveUint64(socket, &output_size);
+
+    Uint8         buffer[KiloBytes(16)];
+    while (received && output_size)
+    {
+        Ptrsize chunk = (Ptrsize)Minimum(output_size, sizeof(buffer));
+        received      = OsSocketReceive(socket, buffer, chunk);
+        if (received)
+            OutBuffer(output, buffer, chunk);
+        output_size -= chunk;
+    }
+
+    if (received && RemoteReceiveUint64(socket, &object_size))
+    {
+        *exit_code = (Int32)code;
+        if (*exit_code == REMOTE_EXIT_NOT_RUN)
+            result = Remote_Result_Unavailable;
+        else if (*exit_code == REMOTE_EXIT_REJECTED)
+            result = Remote_Result_Rejected;
+        else if (*exit_code != 0)
+            result = Remote_Result_Failed;
+        else if (RemoteReceiveFile(socket, object_size, object))
+            result = Remote_Result_Succeeded;
+    }
+
+    OsSocketClose(socket);
+    return result;
+}
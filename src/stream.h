@@ -1,19 +1,26 @@
 #pragma once
 
+#include "lenstring.h"
+#include "os.h"
 #include "zBase.h"
 #include <stdio.h>
 #include <string.h>
 
+// The first bucket is stored in the stream, every following bucket is twice as large as the previous one
+// up to OSTREAM_MAX_BUCKET_SIZE. Buckets are never moved, they can be written out as they are (see OutWriteFile).
 #define OSTREAM_BUCKET_SIZE 16384
+#define OSTREAM_MAX_BUCKET_SIZE MegaBytes(1)
 
 struct Out_Stream_Bucket
 {
-    Uint8                     Data[OSTREAM_BUCKET_SIZE];
+    Uint8                    *Data;
     Int64                     Used;
+    Int64                     Capacity;
 
     struct Out_Stream_Bucket *Next;
 };
 
+// Head points into the stream itself, so streams must not be copied
 typedef struct Out_Stream
 {
     struct Out_Stream_Bucket  Head;
@@ -21,6 +28,8 @@ typedef struct Out_Stream
     Int64                     Size;
 
     Memory_Allocator          Allocator;
+
+    Uint8                     HeadData[OSTREAM_BUCKET_SIZE];
 } Out_Stream;
 
 INLINE_PROCEDURE void OutBuffer(Out_Stream *out, const void *ptr, Int64 size)
@@ -29,25 +38,28 @@ INLINE_PROCEDURE void OutBuffer(Out_Stream *out, const void *ptr, Int64 size)
 
     while (size > 0)
     {
-        if (out->Tail->Used == OSTREAM_BUCKET_SIZE)
+        if (out->Tail->Used == out->Tail->Capacity)
         {
             if (out->Tail->Next == NULL)
             {
-                out->Tail->Next =
-                    (struct Out_Stream_Bucket *)MemoryAllocate(sizeof(struct Out_Stream_Bucket), &out->Allocator);
-                out->Tail->Next = NULL;
-            }
-            else
-            {
-                out->Tail = out->Tail->Next;
+                Int64                     capacity = Minimum(out->Tail->Capacity * 2, OSTREAM_MAX_BUCKET_SIZE);
+                struct Out_Stream_Bucket *bucket   = (struct Out_Stream_Bucket *)MemoryAllocate(
+                    sizeof(struct Out_Stream_Bucket) + capacity, &out->Allocator);
+                bucket->Data     = (Uint8 *)(bucket + 1);
+                bucket->Capacity = capacity;
+                bucket->Next     = NULL;
+                out->Tail->Next  = bucket;
             }
 
+            out->Tail = out->Tail->Next;
+
             out->Tail->Used = 0;
         }
 
-        Int64 write = Minimum(size, OSTREAM_BUCKET_SIZE - out->Tail->Used);
+        Int64 write = Minimum(size, out->Tail->Capacity - out->Tail->Used);
         memcpy(out->Tail->Data + out->Tail->Used, data, write);
         size -= write;
+        data += write;
         out->Tail->Used += write;
         out->Size += write;
     }
@@ -58,26 +70,78 @@ INLINE_PROCEDURE void OutString(Out_Stream *out, String string)
     OutBuffer(out, string.Data, string.Length);
 }
 
-INLINE_PROCEDURE void OutFormatted(Out_Stream *out, const char *fmt, ...)
+INLINE_PROCEDURE void OutChar(Out_Stream *out, Uint8 ch)
 {
-    Memory_Arena    *scratch = ThreadScratchpad();
+    if (out->Tail->Used == out->Tail->Capacity)
+    {
+        OutBuffer(out, &ch, 1);
+        return;
+    }
+    out->Tail->Data[out->Tail->Used++] = ch;
+    out->Size += 1;
+}
 
-    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+// Flags such as "-I<path>" or "-D<define>" are written as two copies, without formatting
+INLINE_PROCEDURE void OutPrefixed(Out_Stream *out, String prefix, String value)
+{
+    OutBuffer(out, prefix.Data, prefix.Length);
+    OutBuffer(out, value.Data, value.Length);
+}
 
-    va_list          args0, args1;
+INLINE_PROCEDURE void OutUnsigned(Out_Stream *out, Uint64 value)
+{
+    Uint8  digits[20];
+    Uint8 *pos = digits + sizeof(digits);
+    do
+    {
+        *--pos = (Uint8)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    OutBuffer(out, pos, digits + sizeof(digits) - pos);
+}
+
+INLINE_PROCEDURE void OutInteger(Out_Stream *out, Int64 value)
+{
+    if (value < 0)
+    {
+        OutChar(out, '-');
+        OutUnsigned(out, (Uint64)0 - (Uint64)value);
+        return;
+    }
+    OutUnsigned(out, (Uint64)value);
+}
+
+// Formats straight into the free space of the last bucket, the format is only run a second time (through the
+// scratchpad) when the result does not fit
+INLINE_PROCEDURE void OutFormatted(Out_Stream *out, const char *fmt, ...)
+{
+    va_list args0, args1;
     va_start(args0, fmt);
     va_copy(args1, args0);
 
-    int   len = 1 + vsnprintf(NULL, 0, fmt, args1);
-    char *buf = (char *)PushSize(scratch, len);
-    vsnprintf(buf, len, fmt, args0);
+    struct Out_Stream_Bucket *tail      = out->Tail;
+    Int64                     available = tail->Capacity - tail->Used;
+    int                       len       = vsnprintf((char *)tail->Data + tail->Used, (size_t)available, fmt, args0);
 
-    va_end(args1);
-    va_end(args0);
+    if (len >= 0 && len < available)
+    {
+        tail->Used += len;
+        out->Size += len;
+    }
+    else if (len > 0)
+    {
+        Memory_Arena    *scratch = ThreadScratchpad();
+        Temporary_Memory temp    = BeginTemporaryMemory(scratch);
 
-    OutBuffer(out, buf, len - 1);
+        char            *buf     = (char *)PushSize(scratch, len + 1);
+        vsnprintf(buf, len + 1, fmt, args1);
+        OutBuffer(out, buf, len);
 
-    EndTemporaryMemory(&temp);
+        EndTemporaryMemory(&temp);
+    }
+
+    va_end(args1);
+    va_end(args0);
 }
 
 INLINE_PROCEDURE Int64 OutGetSize(Out_Stream *out)
@@ -152,11 +216,13 @@ INLINE_PROCEDURE void OutReset(Out_Stream *out)
 
 INLINE_PROCEDURE void OutCreate(Out_Stream *out, Memory_Allocator allocator)
 {
-    out->Allocator = allocator;
-    out->Size      = 0;
-    out->Head.Next = NULL;
-    out->Head.Used = 0;
-    out->Tail      = &out->Head;
+    out->Allocator     = allocator;
+    out->Size          = 0;
+    out->Head.Data     = out->HeadData;
+    out->Head.Capacity = OSTREAM_BUCKET_SIZE;
+    out->Head.Next     = NULL;
+    out->Head.Used     = 0;
+    out->Tail          = &out->Head;
 }
 
 INLINE_PROCEDURE void OutDestroy(Out_Stream *out)
@@ -168,3 +234,33 @@ INLINE_PROCEDURE void OutDestroy(Out_Stream *out)
         MemoryFree(buk, &out->Allocator);
     }
 }
+
+// Hash of the content, same as StrHash of the flattened stream
+INLINE_PROCEDURE Uint64 OutHash(Out_Stream *out)
+{
+    Uint64 hash = HASH_SEED;
+    for (struct Out_Stream_Bucket *buk = &out->Head; buk; buk = buk->Next)
+        hash = HashBytes(hash, buk->Data, buk->Used);
+    return hash;
+}
+
+// Writes the buckets to the file without flattening them into a single string
+INLINE_PROCEDURE bool OutWriteFile(Out_Stream *out, File_Handle handle)
+{
+    String buffers[32];
+    Uint32 count = 0;
+    for (struct Out_Stream_Bucket *buk = &out->Head; buk; buk = buk->Next)
+    {
+        if (buk->Used == 0)
+            continue;
+
+        buffers[count++] = StringMake(buk->Data, buk->Used);
+        if (count == ArrayCount(buffers))
+        {
+            if (!OsFileWriteBuffers(handle, buffers, count))
+                return false;
+            count = 0;
+        }
+    }
+    return count == 0 || OsFileWriteBuffers(handle, buffers, count);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "os.h"
+#include "zBase.h"
+
+//
+// Worker threads
+// Work is submitted by a single thread (the main thread) into a ring buffer and picked by the workers with an
+// atomic increment of the read position. Every worker gets its own thread context and scratchpads.
+//
+
+#define WORK_QUEUE_CAPACITY 1024
+#define WORKER_SCRATCHPAD_SIZE MegaBytes(64)
+
+typedef void (*Work_Procedure)(void *data);
+
+typedef struct Work_Item
+{
+    Work_Procedure Procedure;
+    void          *Data;
+} Work_Item;
+
+typedef struct Thread_Pool
+{
+    Work_Item             Items[WORK_QUEUE_CAPACITY];
+    volatile Int32        WritePos;
+    volatile Int32        ReadPos;
+    volatile Int32        Quit;
+    volatile Int32        Started;
+    Os_Semaphore          Available;
+
+    Os_Thread            *Workers;
+    Uint32                WorkerCount;
+
+    Log_Agent             LogAgent;
+    Fatal_Error_Procedure FatalError;
+} Thread_Pool;
+
+// Runs one queued item if there is any, returns false if the queue is empty
+static bool ThreadPoolRunNext(Thread_Pool *pool)
+{
+    Int32 read = AtomicLoad32(&pool->ReadPos);
+    if (read == AtomicLoad32(&pool->WritePos))
+        return false;
+
+    // The item is copied before claiming it, once claimed the producer may reuse the slot
+    Work_Item item = pool->Items[read & (WORK_QUEUE_CAPACITY - 1)];
+    if (AtomicCompareExchange32(&pool->ReadPos, read, read + 1))
+        item.Procedure(item.Data);
+    return true;
+}
+
+static void ThreadPoolWorker(void *arg)
+{
+    Thread_Pool *pool = (Thread_Pool *)arg;
+
+    InitThreadContext(NullMemoryAllocator(), WORKER_SCRATCHPAD_SIZE, pool->LogAgent, pool->FatalError);
+    ThreadContext.ThreadIndex = (Uint32)AtomicAdd32(&pool->Started, 1) + 1;
+
+    if (MemoryStatsEnabled())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "worker %u", ThreadContext.ThreadIndex);
+        ThreadScratchpadAttachStats(name);
+    }
+
+    while (!AtomicLoad32(&pool->Quit))
+    {
+        if (!ThreadPoolRunNext(pool))
+            OsSemaphoreWait(pool->Available);
+    }
+
+    FreeThreadContext();
+}
+
+// Logging agent of the calling thread is used by the workers
+static bool ThreadPoolCreate(Thread_Pool *pool, Uint32 worker_count, Memory_Arena *arena)
+{
+    pool->WritePos    = 0;
+    pool->ReadPos     = 0;
+    pool->Quit        = 0;
+    pool->Started     = 0;
+    pool->Available   = OsSemaphoreCreate(0);
+    pool->LogAgent    = ThreadContext.LogAgent;
+    pool->FatalError  = ThreadContext.FatalError;
+    pool->Workers     = PushArray(arena, Os_Thread, worker_count);
+    pool->WorkerCount = 0;
+
+    if (!pool->Available.PlatformHandle)
+        return false;
+
+    for (Uint32 index = 0; index < worker_count; ++index)
+    {
+        Os_Thread thread = OsThreadCreate(ThreadPoolWorker, pool);
+        if (!thread.PlatformHandle)
+            break;
+        pool->Workers[pool->WorkerCount++] = thread;
+    }
+
+    return pool->WorkerCount != 0;
+}
+
+static void ThreadPoolDestroy(Thread_Pool *pool)
+{
+    AtomicStore32(&pool->Quit, 1);
+    OsSemaphoreSignal(pool->Available, pool->WorkerCount);
+    for (Uint32 index = 0; index < pool->WorkerCount; ++index)
+        OsThreadJoin(pool->Workers[index]);
+    OsSemaphoreDestroy(pool->Available);
+    pool->WorkerCount = 0;
+}
+
+// Must only be called from the thread that created the pool
+static void ThreadPoolSubmit(Thread_Pool *pool, Work_Procedure proc, void *data)
+{
+    Int32 write = pool->WritePos;
+
+    // Queue is full, help the workers until there is space
+    while (write - AtomicLoad32(&pool->ReadPos) >= WORK_QUEUE_CAPACITY)
+        ThreadPoolRunNext(pool);
+
+    pool->Items[write & (WORK_QUEUE_CAPACITY - 1)].Procedure = proc;
+    pool->Items[write & (WORK_QUEUE_CAPACITY - 1)].Data      = data;
+    AtomicStore32(&pool->WritePos, write + 1);
+    OsSemaphoreSignal(pool->Available, 1);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "compile_db.h"
+#include "lenstring.h"
+#include "os.h"
+#include "stream.h"
+
+//
+// Build trace
+// Written in the Chrome trace event format (chrome://tracing, ui.perfetto.dev), timestamps are in microseconds.
+// Events are only added by the main thread, actions run by the workers are added by the executor once they complete.
+// The stats of the instrumented arenas are written as counters at the end of the trace.
+//
+
+typedef struct Trace_Event
+{
+    const char         *Category;
+    String              Name;
+    Uint64              Start;
+    Uint64              Duration;
+    Uint32              Thread;
+    struct Trace_Event *Next;
+} Trace_Event;
+
+typedef struct Trace
+{
+    String       Path;
+    Uint64       Origin;
+    Uint32       ThreadCount;
+    Trace_Event *First;
+    Trace_Event *Last;
+    Memory_Arena Arena;
+} Trace;
+
+static bool TraceCreate(Trace *trace, const char *path)
+{
+    trace->Arena       = MemoryArenaCreate(MegaBytes(64));
+    trace->Path        = StrDuplicateArena(StringMake(path, strlen(path)), &trace->Arena);
+    trace->Origin      = OsGetMonotonicTime();
+    trace->ThreadCount = 1;
+    trace->First       = NULL;
+    trace->Last        = NULL;
+    return trace->Arena.Memory != NULL;
+}
+
+static void TraceDestroy(Trace *trace)
+{
+    MemoryArenaDestroy(&trace->Arena);
+}
+
+// Does nothing if tracing is disabled (trace is NULL)
+static void TraceAddEvent(Trace *trace, const char *category, String name, Uint64 start, Uint64 end, Uint32 thread)
+{
+    if (!trace)
+        return;
+
+    Trace_Event *event = PushType(&trace->Arena, Trace_Event);
+    if (!event)
+        return;
+
+    event->Category    = category;
+    event->Name        = StrDuplicateArena(name, &trace->Arena);
+    event->Start       = start - trace->Origin;
+    event->Duration    = end - start;
+    event->Thread      = thread;
+    event->Next        = NULL;
+
+    if (trace->Last)
+        trace->Last->Next = event;
+    else
+        trace->First = event;
+    trace->Last        = event;
+    trace->ThreadCount = Maximum(trace->ThreadCount, thread + 1);
+}
+
+INLINE_PROCEDURE void OutTraceNumber(Out_Stream *out, const char *key, Uint64 value, bool comma)
+{
+    char number[64];
+    int  length = snprintf(number, sizeof(number), "\"%s\": %llu%s", key, (unsigned long long)value, comma ? ", " : "");
+    OutBuffer(out, number, length);
+}
+
+static bool TraceWrite(Trace *trace)
+{
+    Memory_Arena    *scratch = ThreadScratchpad();
+    Temporary_Memory temp    = BeginTemporaryMemory(scratch);
+
+    Out_Stream       out;
+    OutCreate(&out, MemoryArenaAllocator(scratch));
+
+    OutString(&out, StringLiteral("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"));
+
+    for (Uint32 thread = 0; thread < trace->ThreadCount; ++thread)
+    {
+        char name[128];
+        int  length = snprintf(name, sizeof(name),
+                               "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %u, "
+                               "\"args\": {\"name\": \"%s %u\"}},\n",
+                               thread, thread ? "worker" : "main", thread);
+        OutBuffer(&out, name, length);
+    }
+
+    for (Trace_Event *event = trace->First; event; event = event->Next)
+    {
+        OutString(&out, StringLiteral("{\"ph\": \"X\", \"pid\": 1, "));
+        OutTraceNumber(&out, "tid", event->Thread, true);
+        OutTraceNumber(&out, "ts", event->Start, true);
+        OutTraceNumber(&out, "dur", event->Duration, true);
+        OutString(&out, StringLiteral("\"cat\": "));
+        OutJsonString(&out, StringMake(event->Category, strlen(event->Category)));
+        OutString(&out, StringLiteral(", \"name\": "));
+        OutJsonString(&out, event->Name);
+        OutString(&out, StringLiteral("},\n"));
+    }
+
+    Uint64 end         = OsGetMonotonicTime() - trace->Origin;
+    Uint32 stats_count = MemoryArenaStatsCount();
+    for (Uint32 index = 0; index < stats_count; ++index)
+    {
+        Memory_Arena_Stats *stats = MemoryArenaStatsGet(index);
+        OutString(&out, StringLiteral("{\"ph\": \"C\", \"pid\": 1, \"tid\": 0, \"cat\": \"memory\", "));
+        OutTraceNumber(&out, "ts", end, true);
+        OutString(&out, StringLiteral("\"name\": "));
+        OutJsonString(&out, StringMake(stats->Name, strlen(stats->Name)));
+        OutString(&out, StringLiteral(", \"args\": {"));
+        OutTraceNumber(&out, "reserved", stats->Reserved, true);
+        OutTraceNumber(&out, "high_water", stats->HighWater, true);
+        OutTraceNumber(&out, "committed", stats->Committed, true);
+        OutTraceNumber(&out, "peak_committed", stats->PeakCommitted, true);
+        OutTraceNumber(&out, "allocations", stats->AllocationCount, true);
+        OutTraceNumber(&out, "allocated_bytes", stats->AllocatedBytes, true);
+        OutTraceNumber(&out, "max_temporary_depth", stats->MaxTemporaryDepth, true);
+        OutTraceNumber(&out, "unended_temporary", stats->TemporaryDepth, false);
+        OutString(&out, StringLiteral("}},\n"));
+    }
+
+    // Closing event, so that the list does not end with a comma
+    OutString(&out, StringLiteral("{\"ph\": \"i\", \"pid\": 1, \"tid\": 0, \"s\": \"g\", \"name\": \"end\", "));
+    OutTraceNumber(&out, "ts", end, false);
+    OutString(&out, StringLiteral("}\n]}\n"));
+
+    bool        result = false;
+    File_Handle handle = OsFileOpen(trace->Path, File_Mode_Write);
+    if (handle.PlatformFileHandle)
+    {
+        result = OutWriteFile(&out, handle);
+        OsFileClose(handle);
+    }
+
+    EndTemporaryMemory(&temp);
+
+    return result;
+}
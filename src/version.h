@@ -1,6 +1,6 @@
 #define MUDA_VERSION_MAJOR 1
-#define MUDA_VERSION_MINOR 10
-#define MUDA_VERSION_PATCH 1
+#define MUDA_VERSION_MINOR 11
+#define MUDA_VERSION_PATCH 0
 
 #define MUDA_BACKWARDS_COMPATIBLE_VERSION_MAJOR 1
 #define MUDA_BACKWARDS_COMPATIBLE_VERSION_MINOR 0
@@ -1,4 +1,5 @@
 #include "zBase.h"
+#include <stdio.h>
 #include <string.h>
 
 #if defined(__cplusplus)
@@ -18,16 +19,27 @@ extern "C"
         return ((location + (alignment - 1)) & ~(alignment - 1));
     }
 
-    Memory_Arena MemoryArenaCreate(Ptrsize max_size)
+    Memory_Arena MemoryArenaCreateEx(Ptrsize max_size, Uint32 flags, Ptrsize commit_size)
     {
+        if (flags & Memory_Arena_Huge_TLB)
+            flags |= Memory_Arena_Commit_Eager;
+
         Memory_Arena arena;
         arena.Reserved   = max_size;
-        arena.Memory     = VirtualMemoryAllocate(0, arena.Reserved);
-        arena.CommitPos  = 0;
+        arena.Flags      = flags;
+        arena.Memory     = VirtualMemoryAllocateEx(0, arena.Reserved, &arena.Flags);
+        arena.CommitSize = IsPower2(commit_size) ? commit_size : MEMORY_ALLOCATOR_COMMIT_SIZE;
+        arena.CommitPos  = (arena.Memory && (arena.Flags & Memory_Arena_Commit_Eager)) ? arena.Reserved : 0;
         arena.CurrentPos = 0;
+        arena.Stats      = NULL;
         return arena;
     }
 
+    Memory_Arena MemoryArenaCreate(Ptrsize max_size)
+    {
+        return MemoryArenaCreateEx(max_size, 0, MEMORY_ALLOCATOR_COMMIT_SIZE);
+    }
+
     void MemoryArenaDestroy(Memory_Arena *arena)
     {
         VirtualMemoryFree(arena->Memory, arena->Reserved);
@@ -43,6 +55,69 @@ extern "C"
         return arena->Reserved - arena->CurrentPos;
     }
 
+    static Memory_Arena_Stats MemoryArenaStatsTable[MEMORY_ARENA_MAX_STATS];
+    static volatile Int32     MemoryArenaStatsUsed;
+    static volatile Int32     MemoryStatsOn;
+
+    Memory_Arena_Stats       *MemoryArenaAttachStats(Memory_Arena *arena, const char *name)
+    {
+        Int32 index = AtomicAdd32(&MemoryArenaStatsUsed, 1);
+        if (index >= MEMORY_ARENA_MAX_STATS)
+        {
+            AtomicAdd32(&MemoryArenaStatsUsed, -1);
+            return NULL;
+        }
+
+        Memory_Arena_Stats *stats = &MemoryArenaStatsTable[index];
+        memset(stats, 0, sizeof(*stats));
+        snprintf(stats->Name, sizeof(stats->Name), "%s", name);
+        stats->Reserved      = arena->Reserved;
+        stats->HighWater     = arena->CurrentPos;
+        stats->Committed     = arena->CommitPos;
+        stats->PeakCommitted = arena->CommitPos;
+        arena->Stats         = stats;
+        return stats;
+    }
+
+    Uint32 MemoryArenaStatsCount()
+    {
+        return (Uint32)Minimum(AtomicLoad32(&MemoryArenaStatsUsed), MEMORY_ARENA_MAX_STATS);
+    }
+
+    Memory_Arena_Stats *MemoryArenaStatsGet(Uint32 index)
+    {
+        return &MemoryArenaStatsTable[index];
+    }
+
+    Uint32 MemoryArenaHistogramBucket(Ptrsize size)
+    {
+        Uint32 bucket = 0;
+        while (bucket < MEMORY_ARENA_HISTOGRAM_BUCKETS - 1 && size > ((Ptrsize)8 << bucket))
+            bucket += 1;
+        return bucket;
+    }
+
+    void MemoryStatsEnable()
+    {
+        AtomicStore32(&MemoryStatsOn, 1);
+    }
+
+    bool MemoryStatsEnabled()
+    {
+        return AtomicLoad32(&MemoryStatsOn) != 0;
+    }
+
+    static void MemoryArenaRecordPush(Memory_Arena *arena, Ptrsize size)
+    {
+        Memory_Arena_Stats *stats = arena->Stats;
+        stats->AllocationCount += 1;
+        stats->AllocatedBytes += size;
+        stats->Histogram[MemoryArenaHistogramBucket(size)] += 1;
+        stats->HighWater     = Maximum(stats->HighWater, arena->CurrentPos);
+        stats->Committed     = arena->CommitPos;
+        stats->PeakCommitted = Maximum(stats->PeakCommitted, arena->CommitPos);
+    }
+
     void *PushSize(Memory_Arena *arena, Ptrsize size)
     {
         void *ptr = 0;
@@ -52,19 +127,33 @@ extern "C"
             arena->CurrentPos += size;
             if (arena->CurrentPos > arena->CommitPos)
             {
-                Ptrsize CommitPos = AlignPower2Up(arena->CurrentPos, MEMORY_ALLOCATOR_COMMIT_SIZE - 1);
+                Ptrsize CommitPos = AlignPower2Up(arena->CurrentPos, arena->CommitSize);
                 CommitPos         = Minimum(CommitPos, arena->Reserved);
-                VirtualMemoryCommit(arena->Memory + arena->CommitPos, CommitPos - arena->CommitPos);
+                VirtualMemoryCommitEx(arena->Memory + arena->CommitPos, CommitPos - arena->CommitPos, arena->Flags);
                 arena->CommitPos = CommitPos;
             }
+            if (arena->Stats)
+                MemoryArenaRecordPush(arena, size);
         }
         return ptr;
     }
 
+    // Aligns the address rather than the position, so it holds even if the arena memory is not page aligned
     void *PushSizeAligned(Memory_Arena *arena, Ptrsize size, Uint32 alignment)
     {
-        Ptrsize alloc_size = AlignSize(arena->CurrentPos, alignment) - arena->CurrentPos + size;
-        return PushSize(arena, size);
+        Assert(IsPower2(alignment));
+        Ptrsize address = (Ptrsize)(arena->Memory + arena->CurrentPos);
+        Ptrsize padding = AlignPower2Up(address, (Ptrsize)alignment) - address;
+        Uint8  *ptr     = (Uint8 *)PushSize(arena, padding + size);
+        return ptr ? ptr + padding : NULL;
+    }
+
+    void *PushSizeEx(Memory_Arena *arena, Ptrsize size, Uint32 alignment, Uint32 flags)
+    {
+        void *ptr = (alignment > 1) ? PushSizeAligned(arena, size, alignment) : PushSize(arena, size);
+        if (ptr && (flags & Push_Flag_Zero))
+            memset(ptr, 0, size);
+        return ptr;
     }
 
     void SetAllocationPosition(Memory_Arena *arena, Ptrsize pos)
@@ -72,33 +161,115 @@ extern "C"
         if (pos < arena->CurrentPos)
         {
             arena->CurrentPos = pos;
-            Ptrsize CommitPos = AlignPower2Up(pos, MEMORY_ALLOCATOR_COMMIT_SIZE - 1);
+            Ptrsize CommitPos = AlignPower2Up(pos, arena->CommitSize);
             CommitPos         = Minimum(CommitPos, arena->Reserved);
 
-            if (CommitPos < arena->CommitPos)
+            if (CommitPos < arena->CommitPos && !(arena->Flags & Memory_Arena_Commit_Eager))
             {
                 VirtualMemoryDecommit(arena->Memory + CommitPos, arena->CommitPos - CommitPos);
                 arena->CommitPos = CommitPos;
+                if (arena->Stats)
+                    arena->Stats->Committed = CommitPos;
             }
         }
     }
 
+    // Shared across the arenas, an arena created at the address of a destroyed one does not match its chunks
+    static volatile Int64 SharedArenaGenerations;
+
+    static Uint64         SharedArenaNextGeneration(void)
+    {
+        return (Uint64)AtomicAdd64(&SharedArenaGenerations, 1) + 1;
+    }
+
+    Shared_Arena SharedArenaCreate(Ptrsize max_size, Ptrsize chunk_size)
+    {
+        Shared_Arena arena;
+        arena.ReservePos = 0;
+        arena.Reserved   = max_size;
+        arena.ChunkSize  = AlignPower2Up(Maximum(chunk_size, SHARED_ARENA_MIN_CHUNK_SIZE), SHARED_ARENA_MIN_CHUNK_SIZE);
+        arena.Generation = SharedArenaNextGeneration();
+        arena.Memory     = VirtualMemoryAllocate(0, arena.Reserved);
+        return arena;
+    }
+
+    void SharedArenaDestroy(Shared_Arena *arena)
+    {
+        VirtualMemoryFree(arena->Memory, arena->Reserved);
+        arena->Generation = SharedArenaNextGeneration();
+    }
+
+    void SharedArenaReset(Shared_Arena *arena)
+    {
+        Ptrsize used = Minimum((Ptrsize)arena->ReservePos, arena->Reserved);
+        if (used)
+            VirtualMemoryDecommit(arena->Memory, used);
+        arena->ReservePos = 0;
+        arena->Generation = SharedArenaNextGeneration();
+    }
+
+    void *SharedArenaPush(Shared_Arena *arena, Ptrsize size)
+    {
+        size                      = AlignPower2Up(size, sizeof(Ptrsize));
+
+        Shared_Arena_Chunk *chunk = &ThreadContext.SharedChunk;
+        if (chunk->Arena == arena && chunk->Generation == arena->Generation && chunk->Current + size <= chunk->End)
+        {
+            void *ptr = chunk->Current;
+            chunk->Current += size;
+            return ptr;
+        }
+
+        // Reservations are multiples of the minimum chunk size, so every chunk begins at a page boundary
+        // Allocations larger than a chunk get their own block and the current chunk of the thread is kept
+        Ptrsize reserve = Maximum(AlignPower2Up(size, SHARED_ARENA_MIN_CHUNK_SIZE), arena->ChunkSize);
+        Int64   pos     = AtomicAdd64(&arena->ReservePos, (Int64)reserve);
+        if ((Ptrsize)pos + reserve > arena->Reserved)
+            return NULL;
+
+        Uint8 *memory = arena->Memory + pos;
+        if (!VirtualMemoryCommit(memory, reserve))
+            return NULL;
+
+        if (reserve > arena->ChunkSize)
+            return memory;
+
+        chunk->Arena      = arena;
+        chunk->Generation = arena->Generation;
+        chunk->Current    = memory + size;
+        chunk->End        = memory + reserve;
+        return memory;
+    }
+
     Temporary_Memory BeginTemporaryMemory(Memory_Arena *arena)
     {
         Temporary_Memory mem;
         mem.Arena    = arena;
         mem.Position = arena->CurrentPos;
+        if (arena->Stats)
+        {
+            arena->Stats->TemporaryDepth += 1;
+            arena->Stats->MaxTemporaryDepth = Maximum(arena->Stats->MaxTemporaryDepth, arena->Stats->TemporaryDepth);
+        }
         return mem;
     }
 
+    static void TemporaryMemoryRecordEnd(Memory_Arena *arena)
+    {
+        if (arena->Stats && arena->Stats->TemporaryDepth)
+            arena->Stats->TemporaryDepth -= 1;
+    }
+
     void EndTemporaryMemory(Temporary_Memory *temp)
     {
         temp->Arena->CurrentPos = temp->Position;
+        TemporaryMemoryRecordEnd(temp->Arena);
     }
 
     void FreeTemporaryMemory(Temporary_Memory *temp)
     {
         SetAllocationPosition(temp->Arena, temp->Position);
+        TemporaryMemoryRecordEnd(temp->Arena);
     }
 
     static void *MemoryArenaAllocatorAllocate(Ptrsize size, void *context)
@@ -121,7 +292,8 @@ extern "C"
         }
 
         void *new_ptr = PushSizeAligned(arena, new_size, sizeof(Ptrsize));
-        memmove(ptr, new_ptr, previous_size);
+        if (new_ptr)
+            memmove(new_ptr, ptr, previous_size);
         return new_ptr;
     }
 
@@ -211,6 +383,16 @@ extern "C"
         return MemoryArenaAllocator(arena);
     }
 
+    void ThreadScratchpadAttachStats(const char *thread_name)
+    {
+        for (Uint32 index = 0; index < ArrayCount(ThreadContext.Scratchpad.Arena); ++index)
+        {
+            char name[48];
+            snprintf(name, sizeof(name), "%s scratchpad %u", thread_name, index);
+            MemoryArenaAttachStats(&ThreadContext.Scratchpad.Arena[index], name);
+        }
+    }
+
     void FatalError(const char *msg)
     {
         ThreadContext.FatalError(msg);
@@ -272,10 +454,23 @@ extern "C"
             memset(&ThreadContext.Scratchpad, 0, sizeof(ThreadContext.Scratchpad));
         }
 
+        memset(&ThreadContext.SharedChunk, 0, sizeof(ThreadContext.SharedChunk));
+        ThreadContext.ThreadIndex = 0;
+
         ThreadContext.LogAgent   = logger;
         ThreadContext.FatalError = fatal_error;
     }
 
+    void FreeThreadContext()
+    {
+        for (Uint32 index = 0; index < ArrayCount(ThreadContext.Scratchpad.Arena); ++index)
+        {
+            if (ThreadContext.Scratchpad.Arena[index].Memory)
+                MemoryArenaDestroy(&ThreadContext.Scratchpad.Arena[index]);
+        }
+        memset(&ThreadContext, 0, sizeof(ThreadContext));
+    }
+
     const char *GetPlatformName()
     {
 #if PLATFORM_OS_ANDRIOD == 1
@@ -295,18 +490,52 @@ extern "C"
 #endif
     }
 
+    // Writes to every page so that the page faults are taken now instead of on first use
+    static void VirtualMemoryTouch(void *ptr, Ptrsize size)
+    {
+        volatile Uint8 *memory = (volatile Uint8 *)ptr;
+        for (Ptrsize offset = 0; offset < size; offset += KiloBytes(4))
+            memory[offset] = 0;
+    }
+
+    void *VirtualMemoryAllocate(void *ptr, Ptrsize size)
+    {
+        Uint32 flags = 0;
+        return VirtualMemoryAllocateEx(ptr, size, &flags);
+    }
+
+    bool VirtualMemoryCommit(void *ptr, Ptrsize size)
+    {
+        return VirtualMemoryCommitEx(ptr, size, 0);
+    }
+
 #if PLATFORM_OS_WINDOWS == 1
 #define MICROSOFT_WINDOWS_WINBASE_H_DEFINE_INTERLOCKED_CPLUSPLUS_OVERLOADS 0
 #include <Windows.h>
 
-    void *VirtualMemoryAllocate(void *ptr, Ptrsize size)
+    // Large pages need the SeLockMemoryPrivilege, so huge page flags are not supported
+    // Memory is only reserved unless eager commit is requested, it is committed as the arena grows
+    void *VirtualMemoryAllocateEx(void *ptr, Ptrsize size, Uint32 *flags)
     {
-        return VirtualAlloc(ptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        *flags &= ~(Memory_Arena_Huge_Pages | Memory_Arena_Huge_TLB);
+
+        DWORD type = MEM_RESERVE;
+        if (*flags & Memory_Arena_Commit_Eager)
+            type |= MEM_COMMIT;
+
+        void *result = VirtualAlloc(ptr, size, type, (type & MEM_COMMIT) ? PAGE_READWRITE : PAGE_NOACCESS);
+        if (result && (*flags & Memory_Arena_Commit_Eager) && (*flags & Memory_Arena_Populate))
+            VirtualMemoryTouch(result, size);
+        return result;
     }
 
-    bool VirtualMemoryCommit(void *ptr, Ptrsize size)
+    bool VirtualMemoryCommitEx(void *ptr, Ptrsize size, Uint32 flags)
     {
-        return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+        if (VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) == NULL)
+            return false;
+        if (flags & Memory_Arena_Populate)
+            VirtualMemoryTouch(ptr, size);
+        return true;
     }
 
     bool VirtualMemoryDecommit(void *ptr, Ptrsize size)
@@ -324,17 +553,64 @@ extern "C"
 #if PLATFORM_OS_LINUX == 1
 #include <sys/mman.h>
 
-    void *VirtualMemoryAllocate(void *ptr, Ptrsize size)
+    static void VirtualMemoryPopulate(void *ptr, Ptrsize size)
+    {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+            return;
+#endif
+        VirtualMemoryTouch(ptr, size);
+    }
+
+    // MAP_HUGETLB needs pages reserved in /proc/sys/vm/nr_hugepages, without them normal pages are used
+    void *VirtualMemoryAllocateEx(void *ptr, Ptrsize size, Uint32 *flags)
     {
-        void *result = mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        int prot = PROT_NONE;
+        int map  = MAP_PRIVATE | MAP_ANONYMOUS;
+        if (*flags & Memory_Arena_Commit_Eager)
+        {
+            prot = PROT_READ | PROT_WRITE;
+            // Populating before madvise would fault in small pages
+            if ((*flags & Memory_Arena_Populate) && !(*flags & Memory_Arena_Huge_Pages))
+                map |= MAP_POPULATE;
+        }
+
+        void *result = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (*flags & Memory_Arena_Huge_TLB)
+            result = mmap(ptr, size, prot, map | MAP_HUGETLB, -1, 0);
+#endif
         if (result == MAP_FAILED)
-            return NULL;
+        {
+            *flags &= ~Memory_Arena_Huge_TLB;
+            result = mmap(ptr, size, prot, map, -1, 0);
+            if (result == MAP_FAILED)
+                return NULL;
+        }
+
+        if ((*flags & Memory_Arena_Huge_Pages) && !(*flags & Memory_Arena_Huge_TLB))
+        {
+#ifdef MADV_HUGEPAGE
+            if (madvise(result, size, MADV_HUGEPAGE) != 0)
+                *flags &= ~Memory_Arena_Huge_Pages;
+#else
+            *flags &= ~Memory_Arena_Huge_Pages;
+#endif
+        }
+
+        if ((*flags & Memory_Arena_Commit_Eager) && (*flags & Memory_Arena_Populate) && !(map & MAP_POPULATE))
+            VirtualMemoryPopulate(result, size);
+
         return result;
     }
 
-    bool VirtualMemoryCommit(void *ptr, Ptrsize size)
+    bool VirtualMemoryCommitEx(void *ptr, Ptrsize size, Uint32 flags)
     {
-        return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+        if (mprotect(ptr, size, PROT_READ | PROT_WRITE) != 0)
+            return false;
+        if (flags & Memory_Arena_Populate)
+            VirtualMemoryPopulate(ptr, size);
+        return true;
     }
 
     bool VirtualMemoryDecommit(void *ptr, Ptrsize size)
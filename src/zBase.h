@@ -34,6 +34,10 @@
 #define COMPILER_INTEL 0
 #endif
 
+#if COMPILER_MSVC == 1
+#include <intrin.h>
+#endif
+
 #if defined(__ANDROID__) || defined(__ANDROID_API__)
 #define OS_ANDROID 1
 #elif defined(__gnu_linux__) || defined(__linux__) || defined(linux) || defined(__linux)
@@ -247,26 +251,91 @@ extern "C"
     Uint8  *AlignPointer(Uint8 *location, Ptrsize alignment);
     Ptrsize AlignSize(Ptrsize location, Ptrsize alignment);
 
-    typedef struct Memory_Arena
+    //
+    // Arenas reserve their whole address space on creation and commit it in chunks of CommitSize as it is used.
+    // Flags that are not supported by the platform are cleared from Memory_Arena.Flags on creation.
+    //
+
+    typedef enum Memory_Arena_Flag_Bit
     {
-        Ptrsize CurrentPos;
-        Ptrsize CommitPos;
+        Memory_Arena_Commit_Eager = 0x1, // Commit the whole reservation on creation, pushes never commit
+        Memory_Arena_Huge_Pages   = 0x2, // Transparent huge pages (Linux MADV_HUGEPAGE)
+        Memory_Arena_Huge_TLB     = 0x4, // Explicit huge pages (Linux MAP_HUGETLB), implies eager commit
+        Memory_Arena_Populate     = 0x8, // Prefault memory when it is committed (Linux MAP_POPULATE)
+    } Memory_Arena_Flag_Bit;
+
+    //
+    // Instrumentation, only arenas with stats attached are measured.
+    // Stats live in a global table so that they outlive the arena and the thread that used it.
+    //
+
+#define MEMORY_ARENA_MAX_STATS 64
+#define MEMORY_ARENA_HISTOGRAM_BUCKETS 16
+
+    typedef struct Memory_Arena_Stats
+    {
+        char    Name[48];
         Ptrsize Reserved;
-        Uint8  *Memory;
+        Ptrsize HighWater; // Highest allocation position reached
+        Ptrsize Committed;
+        Ptrsize PeakCommitted;
+        Uint64  AllocationCount;
+        Uint64  AllocatedBytes;
+        Uint64  Histogram[MEMORY_ARENA_HISTOGRAM_BUCKETS]; // Allocations of at most 8 << index bytes, last has the rest
+        Uint32  TemporaryDepth; // Temporary memory begun and not yet ended
+        Uint32  MaxTemporaryDepth;
+    } Memory_Arena_Stats;
+
+    typedef struct Memory_Arena
+    {
+        Ptrsize             CurrentPos;
+        Ptrsize             CommitPos;
+        Ptrsize             Reserved;
+        Ptrsize             CommitSize;
+        Uint32              Flags;
+        Uint8              *Memory;
+        Memory_Arena_Stats *Stats; // NULL unless instrumented
     } Memory_Arena;
 
     Memory_Arena MemoryArenaCreate(Ptrsize max_size);
+    Memory_Arena MemoryArenaCreateEx(Ptrsize max_size, Uint32 flags, Ptrsize commit_size);
     void         MemoryArenaDestroy(Memory_Arena *arena);
     void         MemoryArenaReset(Memory_Arena *arena);
     Ptrsize      MemoryArenaSizeLeft(Memory_Arena *arena);
 
-    void        *PushSize(Memory_Arena *arena, Ptrsize size);
-    void        *PushSizeAligned(Memory_Arena *arena, Ptrsize size, Uint32 alignment);
-    void         SetAllocationPosition(Memory_Arena *arena, Ptrsize pos);
+    Memory_Arena_Stats *MemoryArenaAttachStats(Memory_Arena *arena, const char *name); // NULL if the table is full
+    Uint32              MemoryArenaStatsCount();
+    Memory_Arena_Stats *MemoryArenaStatsGet(Uint32 index);
+    Uint32              MemoryArenaHistogramBucket(Ptrsize size);
+    void                MemoryStatsEnable();
+    bool                MemoryStatsEnabled();
+
+    typedef enum Push_Flag_Bit
+    {
+        Push_Flag_Zero = 0x1, // Clear the memory, memory given back with temporary memory is not cleared otherwise
+    } Push_Flag_Bit;
+
+    void *PushSize(Memory_Arena *arena, Ptrsize size);
+    void *PushSizeAligned(Memory_Arena *arena, Ptrsize size, Uint32 alignment); // alignment must be a power of 2
+    void *PushSizeEx(Memory_Arena *arena, Ptrsize size, Uint32 alignment, Uint32 flags);
+    void  SetAllocationPosition(Memory_Arena *arena, Ptrsize pos);
+
+#if COMPILER_MSVC == 1
+#define AlignOf(type) __alignof(type)
+#else
+#define AlignOf(type) __alignof__(type)
+#endif
 
 #define PushType(arena, type) (type *)PushSize(arena, sizeof(type))
-#define PushArray(arena, type, count) (type *)PushSize(arena, sizeof(type) * count)
-#define PushArrayAligned(arena, type, count, alignment) (type *)PushSizeAligned(arena, sizeof(type) * count, alignment)
+#define PushArray(arena, type, count) (type *)PushSize(arena, sizeof(type) * (count))
+#define PushArrayAligned(arena, type, count, alignment)                                                               \
+    (type *)PushSizeAligned(arena, sizeof(type) * (count), alignment)
+
+// Typed pushes are aligned for the type
+#define PushTypeEx(arena, type, flags) (type *)PushSizeEx(arena, sizeof(type), AlignOf(type), flags)
+#define PushArrayEx(arena, type, count, flags) (type *)PushSizeEx(arena, sizeof(type) * (count), AlignOf(type), flags)
+#define PushTypeZero(arena, type) PushTypeEx(arena, type, Push_Flag_Zero)
+#define PushArrayZero(arena, type, count) PushArrayEx(arena, type, count, Push_Flag_Zero)
 
     typedef struct Temporary_Memory
     {
@@ -309,6 +378,103 @@ extern "C"
         void         *Data;
     } Log_Agent;
 
+    //
+    // Atomics, all of them are sequentially consistent. Add and Exchange return the previous value.
+    //
+
+#if COMPILER_MSVC == 1
+    INLINE_PROCEDURE Int32 AtomicLoad32(volatile Int32 *src)
+    {
+        return _InterlockedOr((volatile long *)src, 0);
+    }
+    INLINE_PROCEDURE void AtomicStore32(volatile Int32 *dst, Int32 value)
+    {
+        _InterlockedExchange((volatile long *)dst, value);
+    }
+    INLINE_PROCEDURE Int32 AtomicAdd32(volatile Int32 *dst, Int32 value)
+    {
+        return _InterlockedExchangeAdd((volatile long *)dst, value);
+    }
+    INLINE_PROCEDURE Int64 AtomicAdd64(volatile Int64 *dst, Int64 value)
+    {
+        return _InterlockedExchangeAdd64(dst, value);
+    }
+    INLINE_PROCEDURE bool AtomicCompareExchange32(volatile Int32 *dst, Int32 expected, Int32 desired)
+    {
+        return _InterlockedCompareExchange((volatile long *)dst, desired, expected) == expected;
+    }
+    INLINE_PROCEDURE bool AtomicCompareExchangePointer(void *volatile *dst, void *expected, void *desired)
+    {
+        return _InterlockedCompareExchangePointer(dst, desired, expected) == expected;
+    }
+    INLINE_PROCEDURE void *AtomicExchangePointer(void *volatile *dst, void *value)
+    {
+        return _InterlockedExchangePointer(dst, value);
+    }
+#else
+    INLINE_PROCEDURE Int32 AtomicLoad32(volatile Int32 *src)
+    {
+        return __atomic_load_n(src, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE void AtomicStore32(volatile Int32 *dst, Int32 value)
+    {
+        __atomic_store_n(dst, value, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE Int32 AtomicAdd32(volatile Int32 *dst, Int32 value)
+    {
+        return __atomic_fetch_add(dst, value, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE Int64 AtomicAdd64(volatile Int64 *dst, Int64 value)
+    {
+        return __atomic_fetch_add(dst, value, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE bool AtomicCompareExchange32(volatile Int32 *dst, Int32 expected, Int32 desired)
+    {
+        return __atomic_compare_exchange_n(dst, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE bool AtomicCompareExchangePointer(void *volatile *dst, void *expected, void *desired)
+    {
+        return __atomic_compare_exchange_n(dst, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+    INLINE_PROCEDURE void *AtomicExchangePointer(void *volatile *dst, void *value)
+    {
+        return __atomic_exchange_n(dst, value, __ATOMIC_SEQ_CST);
+    }
+#endif
+
+    //
+    // Arena shared between threads, for data that outlives the job that produced it.
+    // Threads reserve chunks with an atomic bump of the reserve position and then allocate from their own chunk
+    // without any synchronization. Memory is only released when the arena is destroyed.
+    //
+
+#define SHARED_ARENA_MIN_CHUNK_SIZE KiloBytes(64)
+
+    typedef struct Shared_Arena
+    {
+        volatile Int64 ReservePos;
+        Ptrsize        Reserved;
+        Ptrsize        ChunkSize;
+        Uint64         Generation; // Unique to the arena, replaced by a reset so chunks taken before are not used again
+        Uint8         *Memory;
+    } Shared_Arena;
+
+    typedef struct Shared_Arena_Chunk
+    {
+        Shared_Arena *Arena;
+        Uint64        Generation;
+        Uint8        *Current;
+        Uint8        *End;
+    } Shared_Arena_Chunk;
+
+    Shared_Arena SharedArenaCreate(Ptrsize max_size, Ptrsize chunk_size);
+    void         SharedArenaDestroy(Shared_Arena *arena);
+    void         SharedArenaReset(Shared_Arena *arena); // Only while no thread pushes to the arena
+    void        *SharedArenaPush(Shared_Arena *arena, Ptrsize size);
+
+#define SharedPushType(arena, type) (type *)SharedArenaPush(arena, sizeof(type))
+#define SharedPushArray(arena, type, count) (type *)SharedArenaPush(arena, sizeof(type) * (count))
+
     typedef struct Thread_Scratchpad
     {
         Memory_Arena Arena[2];
@@ -318,6 +484,8 @@ extern "C"
     {
         Memory_Allocator      Allocator;
         Thread_Scratchpad     Scratchpad;
+        Shared_Arena_Chunk    SharedChunk;
+        Uint32                ThreadIndex; // 0 for the main thread
         Log_Agent             LogAgent;
         Fatal_Error_Procedure FatalError;
     } Thread_Context;
@@ -341,6 +509,7 @@ extern "C"
     Memory_Arena    *ThreadUnusedScratchpad();
     void             ResetThreadScratchpad();
     Memory_Allocator ThreadScratchpadAllocator();
+    void             ThreadScratchpadAttachStats(const char *thread_name);
 
     void             FatalError(const char *msg);
 
@@ -353,6 +522,7 @@ extern "C"
 
     void             InitThreadContext(Memory_Allocator allocator, uint32_t scratchpad_size, Log_Agent logger,
                                        Fatal_Error_Procedure fatal_error);
+    void             FreeThreadContext();
 
     //
     //
@@ -365,7 +535,9 @@ extern "C"
     //
 
     void *VirtualMemoryAllocate(void *ptr, Ptrsize size);
+    void *VirtualMemoryAllocateEx(void *ptr, Ptrsize size, Uint32 *flags); // Memory_Arena_Flag_Bit, unsupported cleared
     bool  VirtualMemoryCommit(void *ptr, Ptrsize size);
+    bool  VirtualMemoryCommitEx(void *ptr, Ptrsize size, Uint32 flags);
     bool  VirtualMemoryDecommit(void *ptr, Ptrsize size);
     bool  VirtualMemoryFree(void *ptr, Ptrsize size);
 
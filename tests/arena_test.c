@@ -0,0 +1,134 @@
+//
+// Tests of the arena pushes, built and run by build.sh
+// Exits with 1 if one of the checks failed
+//
+
+#include "../src/zBase.c"
+
+#if PLATFORM_OS_WINDOWS == 1
+#include "../src/os_windows.c"
+#endif
+#if PLATFORM_OS_LINUX == 1
+#include "../src/os_linux.c"
+#endif
+
+static int FailedCount = 0;
+
+#define Check(x)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(x))                                                                                                      \
+        {                                                                                                              \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                                    \
+            FailedCount += 1;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+void AssertHandle(const char *reason, const char *file, int line, const char *proc)
+{
+    fprintf(stderr, "%s(%d): %s in %s\n", file, line, reason, proc);
+    exit(1);
+}
+
+static void TestPushSizeAligned(Memory_Arena *arena)
+{
+    static const Uint32 Alignments[] = {1, 8, 16, 64};
+
+    for (Uint32 index = 0; index < ArrayCount(Alignments); ++index)
+    {
+        Uint32 alignment = Alignments[index];
+
+        // A single byte leaves the position misaligned for every alignment above 1
+        Uint8 *byte      = (Uint8 *)PushSize(arena, 1);
+        Uint8 *ptr       = (Uint8 *)PushSizeAligned(arena, 24, alignment);
+
+        Check(ptr != NULL);
+        Check(((Ptrsize)ptr & (alignment - 1)) == 0);
+        Check(ptr > byte);
+        Check(arena->Memory + arena->CurrentPos == ptr + 24);
+
+        Uint64 *typed = PushTypeEx(arena, Uint64, 0);
+        Check(((Ptrsize)typed & (AlignOf(Uint64) - 1)) == 0);
+    }
+}
+
+static void TestPushFlagZero(Memory_Arena *arena)
+{
+    // Memory given back with temporary memory keeps its content
+    Temporary_Memory temp  = BeginTemporaryMemory(arena);
+    Uint8           *dirty = (Uint8 *)PushSizeAligned(arena, 256, 64);
+    memset(dirty, 0xCD, 256);
+    EndTemporaryMemory(&temp);
+
+    Uint8 *clear = (Uint8 *)PushSizeEx(arena, 256, 64, Push_Flag_Zero);
+    Check(clear == dirty);
+    for (Uint32 index = 0; index < 256; ++index)
+        Check(clear[index] == 0);
+
+    temp  = BeginTemporaryMemory(arena);
+    dirty = (Uint8 *)PushSize(arena, 64 * sizeof(Uint32));
+    memset(dirty, 0xCD, 64 * sizeof(Uint32));
+    EndTemporaryMemory(&temp);
+
+    Uint32 *array = PushArrayZero(arena, Uint32, 64);
+    for (Uint32 index = 0; index < 64; ++index)
+        Check(array[index] == 0);
+}
+
+static void TestReallocate(Memory_Arena *arena)
+{
+    Memory_Allocator allocator = MemoryArenaAllocator(arena);
+
+    Uint8           *ptr       = (Uint8 *)allocator.Allocate(16, allocator.Context);
+    for (Uint32 index = 0; index < 16; ++index)
+        ptr[index] = (Uint8)index;
+
+    // The block is not at the end of the arena anymore, growing it moves it
+    PushSize(arena, 8);
+
+    Uint8 *moved = (Uint8 *)allocator.Reallocate(ptr, 16, 64, allocator.Context);
+    Check(moved != NULL && moved != ptr);
+    Check(((Ptrsize)moved & (sizeof(Ptrsize) - 1)) == 0);
+    for (Uint32 index = 0; moved && index < 16; ++index)
+    {
+        Check(moved[index] == index);
+        Check(ptr[index] == index);
+    }
+
+    // The block at the end of the arena grows in place
+    Uint8 *grown = (Uint8 *)allocator.Reallocate(moved, 64, 128, allocator.Context);
+    Check(grown == moved);
+}
+
+static void TestSharedArenaRecreated(void)
+{
+    // The chunk of the thread points into the first arena, the second one is created at the same address
+    Shared_Arena shared = SharedArenaCreate(MegaBytes(4), 0);
+    Check(SharedPushArray(&shared, Uint8, 1 + 1) != NULL);
+    SharedArenaDestroy(&shared);
+
+    shared     = SharedArenaCreate(MegaBytes(4), 0);
+    Uint8 *ptr = SharedPushArray(&shared, Uint8, 1 + 1);
+    Check(ptr >= shared.Memory && ptr < shared.Memory + shared.Reserved);
+    Check(shared.ReservePos == (Int64)shared.ChunkSize);
+    SharedArenaDestroy(&shared);
+}
+
+int main(int argc, char *argv[])
+{
+    Memory_Arena arena = MemoryArenaCreate(MegaBytes(1));
+
+    TestPushSizeAligned(&arena);
+    TestPushFlagZero(&arena);
+    TestReallocate(&arena);
+    TestSharedArenaRecreated();
+
+    if (FailedCount)
+    {
+        fprintf(stderr, "arena_test: %d checks failed\n", FailedCount);
+        return 1;
+    }
+
+    printf("arena_test: passed\n");
+    return 0;
+}
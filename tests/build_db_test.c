@@ -0,0 +1,176 @@
+//
+// Tests of the build database reader, built and run by build.sh
+// Exits with 1 if one of the checks failed
+//
+
+#include "../src/zBase.c"
+
+#if PLATFORM_OS_WINDOWS == 1
+#include "../src/os_windows.c"
+#endif
+#if PLATFORM_OS_LINUX == 1
+#include "../src/os_linux.c"
+#endif
+
+#include "../src/build_db.h"
+
+#define TEST_PATH "build_db_test.muda.db"
+
+static int FailedCount = 0;
+
+#define Check(x)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(x))                                                                                                      \
+        {                                                                                                              \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                                    \
+            FailedCount += 1;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+void AssertHandle(const char *reason, const char *file, int line, const char *proc)
+{
+    fprintf(stderr, "%s(%d): %s in %s\n", file, line, reason, proc);
+    exit(1);
+}
+
+static void TestLogProcedure(void *agent, Log_Kind kind, const char *fmt, va_list list)
+{
+    vfprintf(stderr, fmt, list);
+}
+
+static void TestFatalError(const char *message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+static void WriteTestFile(const char *content, Ptrsize size)
+{
+    File_Handle handle = OsFileOpen(StringLiteral(TEST_PATH), File_Mode_Write);
+    if (handle.PlatformFileHandle)
+    {
+        OsFileWrite(handle, StringMake(content, size));
+        OsFileClose(handle);
+    }
+}
+
+typedef struct Load_Case
+{
+    const char *Content;
+    Uint32      Count;    // Records read
+    const char *Output;   // Output of the record looked up, NULL if no record is read
+    Uint64      Command;  // Command hash of that record
+    Uint64      Duration; // Duration of that record
+} Load_Case;
+
+#define RECORD(command, output) command "\t00000000000000b2\t00000000000000c3\t4\t1500\t4096\t" output
+
+static const Load_Case LoadCases[] = {
+    {"", 0, NULL, 0, 0},
+    {"\n\n\n", 0, NULL, 0, 0},
+    {RECORD("00000000000000a1", "bin/a.o") "\n", 1, "bin/a.o", 0xa1, 1500},
+    {RECORD("00000000000000a1", "bin/a.o"), 1, "bin/a.o", 0xa1, 1500},
+    {RECORD("00000000000000a1", "bin/a.o") "\r\n", 1, "bin/a.o", 0xa1, 1500},
+    {RECORD("00000000000000a1", "bin/a\tb.o") "\n", 1, "bin/a\tb.o", 0xa1, 1500},
+    {"00000000000000a1\t00000000000000b2\t00000000000000c3\t4\t1500\tbin/a.o\n", 0, NULL, 0, 0},
+    {"00000000000000a1\t00000000000000b2\t00000000000000c3\t9\t1500\t4096\tbin/a.o\n", 0, NULL, 0, 0},
+    {"00000000000000a1\t00000000000000b2\t00000000000000c3\tGCC\t1500\t4096\tbin/a.o\n", 0, NULL, 0, 0},
+    {"zz\t\t\t4\t\t\tbin/a.o\n", 1, "bin/a.o", 0, 0},
+    {"garbage\n" RECORD("00000000000000a1", "bin/a.o") "\n\t\t\t\n", 1, "bin/a.o", 0xa1, 1500},
+    {RECORD("00000000000000a1", "bin/a.o") "\n" RECORD("00000000000000a2", "bin/a.o") "\n", 1, "bin/a.o", 0xa2, 1500},
+    {RECORD("00000000000000a1", "bin/a.o") "\n" RECORD("00000000000000a2", "bin/b.o") "\n", 2, "bin/b.o", 0xa2, 1500},
+};
+
+static void TestLoad(Memory_Arena *arena)
+{
+    for (Uint32 index = 0; index < ArrayCount(LoadCases); ++index)
+    {
+        const Load_Case *test = &LoadCases[index];
+        Temporary_Memory temp = BeginTemporaryMemory(arena);
+
+        WriteTestFile(test->Content, strlen(test->Content));
+        Build_Db db;
+        BuildDbLoad(&db, StringLiteral(TEST_PATH), arena);
+        if (db.Count != test->Count)
+            fprintf(stderr, "case %u: %u records read\n", index, db.Count);
+        Check(db.Count == test->Count);
+
+        Uint32 listed = 0;
+        for (Build_Db_Record *record = db.First; record; record = record->Next)
+            listed += 1;
+        Check(listed == db.Count);
+
+        if (test->Output)
+        {
+            Build_Db_Record *record = BuildDbFind(&db, StringMake(test->Output, strlen(test->Output)));
+            Check(record != NULL);
+            if (record)
+            {
+                Check(record->Fingerprint.Command == test->Command);
+                Check(record->Duration == test->Duration);
+            }
+        }
+
+        EndTemporaryMemory(&temp);
+    }
+
+    // Bytes that are not text
+    Temporary_Memory temp     = BeginTemporaryMemory(arena);
+    const char       binary[] = "\0\t\0\t\xff\t4\t\0\t\t\n\t\t\t\t\t\t\t\t\t\t";
+    WriteTestFile(binary, sizeof(binary) - 1);
+    Build_Db db;
+    BuildDbLoad(&db, StringLiteral(TEST_PATH), arena);
+    Check(db.Count <= 1);
+    EndTemporaryMemory(&temp);
+
+    OsFileDelete(StringLiteral(TEST_PATH));
+}
+
+static void TestSaveLoad(Memory_Arena *arena)
+{
+    Build_Db db;
+    OsFileDelete(StringLiteral(TEST_PATH));
+    BuildDbLoad(&db, StringLiteral(TEST_PATH), arena);
+    Check(db.Count == 0);
+
+    // Enough records to grow the table
+    for (Uint32 index = 0; index < 100; ++index)
+    {
+        Build_Fingerprint fingerprint = {index, index * 2, index * 3};
+        BuildDbUpdate(&db, FmtStr(arena, "bin/%u.o", index), &fingerprint, Compiler_Bit_GCC, index, index * 10);
+    }
+    Check(BuildDbSave(&db));
+
+    Build_Db loaded;
+    BuildDbLoad(&loaded, StringLiteral(TEST_PATH), arena);
+    Check(loaded.Count == 100);
+    Check(!loaded.Changed);
+    for (Uint32 index = 0; index < 100; ++index)
+    {
+        Build_Db_Record *record = BuildDbFind(&loaded, FmtStr(arena, "bin/%u.o", index));
+        Check(record && record->Fingerprint.Tool == index * 2 && record->Memory == index * 10);
+    }
+
+    OsFileDelete(StringLiteral(TEST_PATH));
+}
+
+int main(int argc, char *argv[])
+{
+    InitThreadContext(NullMemoryAllocator(), MegaBytes(64), (Log_Agent){.Procedure = TestLogProcedure},
+                      TestFatalError);
+
+    Memory_Arena arena = MemoryArenaCreate(MegaBytes(16));
+
+    TestLoad(&arena);
+    TestSaveLoad(&arena);
+
+    if (FailedCount)
+    {
+        fprintf(stderr, "build_db_test: %d checks failed\n", FailedCount);
+        return 1;
+    }
+
+    printf("build_db_test: passed\n");
+    return 0;
+}
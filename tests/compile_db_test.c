@@ -0,0 +1,197 @@
+//
+// Tests of the compile_commands.json reader and merge, built and run by build.sh
+// Exits with 1 if one of the checks failed
+//
+
+#include "../src/zBase.c"
+
+#if PLATFORM_OS_WINDOWS == 1
+#include "../src/os_windows.c"
+#endif
+#if PLATFORM_OS_LINUX == 1
+#include "../src/os_linux.c"
+#endif
+
+#include "../src/compile_db.h"
+
+#define TEST_PATH "compile_db_test.json"
+
+static int FailedCount = 0;
+
+#define Check(x)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(x))                                                                                                      \
+        {                                                                                                              \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                                    \
+            FailedCount += 1;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+void AssertHandle(const char *reason, const char *file, int line, const char *proc)
+{
+    fprintf(stderr, "%s(%d): %s in %s\n", file, line, reason, proc);
+    exit(1);
+}
+
+static void TestLogProcedure(void *agent, Log_Kind kind, const char *fmt, va_list list)
+{
+    vfprintf(stderr, fmt, list);
+}
+
+static void TestFatalError(const char *message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+static String ReadTestFile(Memory_Arena *arena)
+{
+    String      content = StringLiteral("");
+    File_Handle handle  = OsFileOpen(StringLiteral(TEST_PATH), File_Mode_Read);
+    if (handle.PlatformFileHandle)
+    {
+        Ptrsize size = OsFileGetSize(handle);
+        Uint8  *data = PushSize(arena, size + 1);
+        if (OsFileRead(handle, data, size))
+            content = StringMake(data, size);
+        data[size] = 0;
+        OsFileClose(handle);
+    }
+    return content;
+}
+
+static void WriteTestFile(String content)
+{
+    File_Handle handle = OsFileOpen(StringLiteral(TEST_PATH), File_Mode_Write);
+    if (handle.PlatformFileHandle)
+    {
+        OsFileWrite(handle, content);
+        OsFileClose(handle);
+    }
+}
+
+static Uint32 EntryCount(Compile_Db_Entry *entry)
+{
+    Uint32 count = 0;
+    for (; entry; entry = entry->Next)
+        count += 1;
+    return count;
+}
+
+typedef struct Parse_Case
+{
+    const char *Json;
+    Uint32      Count; // Entries read
+    const char *File;  // File of the first entry, NULL if no entry is read
+} Parse_Case;
+
+static const Parse_Case ParseCases[] = {
+    {"", 0, NULL},
+    {"[]", 0, NULL},
+    {"{}", 0, NULL},
+    {"[{", 0, NULL},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\", \"command\": \"cc -c a.c\"}]", 1, "a.c"},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\", \"command\": \"cc -c a.c", 0, NULL},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\"}]", 0, NULL},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\", \"command\": 12}]", 0, NULL},
+    {"[{\"directory\": \"/w\", \"arguments\": [\"cc\", \"a.c\"], \"file\": \"a.c\", \"command\": \"cc a.c\"}]", 1,
+     "a.c"},
+    {"[{\"x\": {\"y\": [1, true, null, {\"z\": \"}\"}]}, \"directory\": \"/w\", \"file\": \"a.c\", "
+     "\"command\": \"cc\"}]",
+     1, "a.c"},
+    {"[{\"directory\": \"/w\", \"file\": \"a\\u0041\\\"\\u00e9.c\", \"command\": \"cc\"}]", 1, "aA\"\xc3\xa9.c"},
+    {"[{\"directory\": \"/w\", \"file\": \"a\\u00\", \"command\": \"cc\"}]", 0, NULL},
+    {"[{\"directory\": \"/w\", \"file\": \"a\\", 0, NULL},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\", \"command\": \"cc\"}, {\"directory\": \"/w\", \"file\": \"b.c\"", 1,
+     "a.c"},
+    {"[{\"directory\": \"/w\", \"file\": \"a.c\", \"command\": \"cc\"}, {\"directory\": \"/w\", \"file\": \"b.c\", "
+     "\"command\": \"cc\"}]",
+     2, "a.c"},
+};
+
+static void TestParse(Memory_Arena *arena)
+{
+    for (Uint32 index = 0; index < ArrayCount(ParseCases); ++index)
+    {
+        const Parse_Case *test    = &ParseCases[index];
+        Temporary_Memory  temp    = BeginTemporaryMemory(arena);
+
+        // Strings are decoded in place
+        String            json    = FmtStr(arena, "%s", test->Json);
+        Compile_Db_Entry *entries = CompileDbParse(json.Data, json.Length, arena);
+        if (EntryCount(entries) != test->Count)
+            fprintf(stderr, "case %u: %u entries read\n", index, EntryCount(entries));
+        Check(EntryCount(entries) == test->Count);
+        if (test->File && entries)
+            Check(StrMatch(entries->File, StringMake(test->File, strlen(test->File))));
+
+        EndTemporaryMemory(&temp);
+    }
+
+    // Nested values deeper than the stack could hold
+    Temporary_Memory temp   = BeginTemporaryMemory(arena);
+    Int64            depth  = 1000000;
+    Uint8           *nested = PushSize(arena, depth + 16);
+    memcpy(nested, "[{\"x\": ", 7);
+    memset(nested + 7, '[', depth);
+    Check(CompileDbParse(nested, depth + 7, arena) == NULL);
+    EndTemporaryMemory(&temp);
+}
+
+static void TestConfigurationsMerged(Memory_Arena *arena)
+{
+    // A debug and a release configuration compile the same sources
+    Compile_Db db;
+    CompileDbInit(&db, arena);
+    String directory = StringLiteral("/work");
+    CompileDbAdd(&db, directory, StringLiteral("a.c"), StringLiteral("gcc -O0 -c a.c"));
+    CompileDbAdd(&db, directory, StringLiteral("b.c"), StringLiteral("gcc -O0 -c b.c"));
+    CompileDbAdd(&db, directory, StringLiteral("a.c"), StringLiteral("gcc -O2 -c a.c"));
+    CompileDbAdd(&db, directory, StringLiteral("b.c"), StringLiteral("gcc -O2 -c b.c"));
+
+    OsFileDelete(StringLiteral(TEST_PATH));
+    Check(CompileDbWrite(db.First, StringLiteral(TEST_PATH)));
+
+    String            content = ReadTestFile(arena);
+    Compile_Db_Entry *entries = CompileDbParse(content.Data, content.Length, arena);
+    Check(EntryCount(entries) == 2);
+    for (Compile_Db_Entry *entry = entries; entry; entry = entry->Next)
+        Check(StrFind(entry->Command, StringLiteral("-O0"), 0) >= 0);
+
+    // The second run finds every command unchanged, the file keeps the text appended to it
+    String marked = FmtStr(arena, "%.*s\n\n", (int)content.Length, content.Data);
+    WriteTestFile(marked);
+    Check(CompileDbWrite(db.First, StringLiteral(TEST_PATH)));
+    Check(StrMatch(ReadTestFile(arena), marked));
+
+    // A changed command of the first configuration rewrites the file
+    db.First->Command = StringLiteral("gcc -O1 -c a.c");
+    Check(CompileDbWrite(db.First, StringLiteral(TEST_PATH)));
+    content = ReadTestFile(arena);
+    Check(!StrMatch(content, marked));
+    Check(StrFind(content, StringLiteral("gcc -O1 -c a.c"), 0) >= 0);
+    Check(EntryCount(CompileDbParse(content.Data, content.Length, arena)) == 2);
+
+    OsFileDelete(StringLiteral(TEST_PATH));
+}
+
+int main(int argc, char *argv[])
+{
+    InitThreadContext(NullMemoryAllocator(), MegaBytes(64), (Log_Agent){.Procedure = TestLogProcedure},
+                      TestFatalError);
+
+    Memory_Arena arena = MemoryArenaCreate(MegaBytes(16));
+
+    TestParse(&arena);
+    TestConfigurationsMerged(&arena);
+
+    if (FailedCount)
+    {
+        fprintf(stderr, "compile_db_test: %d checks failed\n", FailedCount);
+        return 1;
+    }
+
+    printf("compile_db_test: passed\n");
+    return 0;
+}
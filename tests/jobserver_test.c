@@ -0,0 +1,113 @@
+//
+// Tests of the MAKEFLAGS jobserver parser, built and run by build.sh
+// Exits with 1 if one of the checks failed
+//
+
+#include "../src/zBase.c"
+
+#if PLATFORM_OS_WINDOWS == 1
+#include "../src/os_windows.c"
+#endif
+#if PLATFORM_OS_LINUX == 1
+#include "../src/os_linux.c"
+#endif
+
+#include "../src/jobserver.h"
+
+static int FailedCount = 0;
+
+#define Check(x)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(x))                                                                                                      \
+        {                                                                                                              \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                                    \
+            FailedCount += 1;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+// AssertHandle is defined by config.h
+
+typedef struct Auth_Case
+{
+    const char *Makeflags;
+    const char *Auth; // Value found, empty if there is none
+} Auth_Case;
+
+static const Auth_Case AuthCases[] = {
+    {"", ""},
+    {" \t ", ""},
+    {"rs", ""},
+    {"-j8", ""},
+    {"--jobserver-auth=", ""},
+    {"--jobserver-auth=3,4", "3,4"},
+    {" -j8 --jobserver-auth=3,4", "3,4"},
+    {"rs -j8\t--jobserver-auth=3,4\t", "3,4"},
+    {"--jobserver-auth=fifo:/tmp/GMfifo1234", "fifo:/tmp/GMfifo1234"},
+    {"-j4 --jobserver-auth=3,4 -j8 --jobserver-auth=fifo:/tmp/f", "fifo:/tmp/f"},
+    {"--jobserver-fds=5,6", "5,6"},
+    {"--jobserver-fds=5,6 --jobserver-auth=3,4", "3,4"},
+    {"--jobserver-auth=3,4 --jobserver-fds=5,6", "3,4"},
+    {"--jobserver-auth", ""},
+    {"x--jobserver-auth=3,4", ""},
+    {"--jobserver-authx=3,4", ""},
+    {"-j8 -- FOO=--jobserver-auth=3,4", ""},
+    {"--jobserver-auth=3,4 -- FOO=bar --jobserver-auth=5,6", "3,4"},
+    {"-j8 --x=-- --jobserver-auth=3,4", "3,4"},
+};
+
+static void TestFindAuth(void)
+{
+    for (Uint32 index = 0; index < ArrayCount(AuthCases); ++index)
+    {
+        const Auth_Case *test = &AuthCases[index];
+        String           auth = JobserverFindAuth(StringMake(test->Makeflags, strlen(test->Makeflags)));
+        if (!StrMatch(auth, StringMake(test->Auth, strlen(test->Auth))))
+            fprintf(stderr, "case %u: found \"%.*s\"\n", index, (int)auth.Length, auth.Data);
+        Check(StrMatch(auth, StringMake(test->Auth, strlen(test->Auth))));
+    }
+}
+
+#if PLATFORM_OS_LINUX == 1
+static void TestConnect(void)
+{
+    int fds[2];
+    Check(pipe(fds) == 0);
+
+    char auth[32];
+    snprintf(auth, sizeof(auth), "%d,%d", fds[0], fds[1]);
+    Os_Jobserver jobserver = OsJobserverConnect(StringMake(auth, strlen(auth)));
+    Check(jobserver.PlatformHandle != NULL);
+    if (jobserver.PlatformHandle)
+        OsJobserverDestroy(jobserver);
+
+    static const char *refused[] = {"", "3", "abc", "-1,4", "1000000,1000001", "fifo:/nonexistent/fifo"};
+    for (Uint32 index = 0; index < ArrayCount(refused); ++index)
+    {
+        jobserver = OsJobserverConnect(StringMake(refused[index], strlen(refused[index])));
+        if (jobserver.PlatformHandle)
+            fprintf(stderr, "connected to \"%s\"\n", refused[index]);
+        Check(jobserver.PlatformHandle == NULL);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    TestFindAuth();
+#if PLATFORM_OS_LINUX == 1
+    TestConnect();
+#endif
+
+    if (FailedCount)
+    {
+        fprintf(stderr, "jobserver_test: %d checks failed\n", FailedCount);
+        return 1;
+    }
+
+    printf("jobserver_test: passed\n");
+    return 0;
+}
@@ -0,0 +1,126 @@
+//
+// Tests of the command lines accepted by the distributed compilation workers, built and run by build.sh
+// Exits with 1 if one of the checks failed
+//
+
+#include "../src/zBase.c"
+
+#if PLATFORM_OS_WINDOWS == 1
+#include "../src/os_windows.c"
+#endif
+#if PLATFORM_OS_LINUX == 1
+#include "../src/os_linux.c"
+#endif
+
+#include "../src/remote.h"
+
+static int FailedCount = 0;
+
+#define Check(x)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(x))                                                                                                      \
+        {                                                                                                              \
+            fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #x);                                    \
+            FailedCount += 1;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+void AssertHandle(const char *reason, const char *file, int line, const char *proc)
+{
+    fprintf(stderr, "%s(%d): %s in %s\n", file, line, reason, proc);
+    exit(1);
+}
+
+static void TestLogProcedure(void *agent, Log_Kind kind, const char *fmt, va_list list)
+{
+    vfprintf(stderr, fmt, list);
+}
+
+static void TestFatalError(const char *message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+typedef struct Arguments_Case
+{
+    const char *Args[8];  // Compiler followed by its options, ends with NULL
+    const char *Rejected; // Argument refused, NULL if the command is allowed
+} Arguments_Case;
+
+static const Arguments_Case ArgumentsCases[] = {
+    {{"gcc", NULL}, NULL},
+    {{"gcc", "-O2", "-Wall", "-Wextra", "-g", "-std=c11", NULL}, NULL},
+    {{"clang++", "-x", "c++-cpp-output", "-march=native", "-fno-exceptions", "-DNDEBUG", NULL}, NULL},
+    {{"gcc-12", "-x", "cpp-output", NULL}, NULL},
+    {{"clang-17.0.1", "--param", "max-inline-insns-single=200", NULL}, NULL},
+    {{"cc", "-fsanitize=address", "-fdiagnostics-color=always", "-Wformat=2", NULL}, NULL},
+    {{NULL}, ""},
+    {{"", NULL}, ""},
+    {{"/usr/bin/gcc", "-O2", NULL}, "/usr/bin/gcc"},
+    {{"sh", "-c", NULL}, "sh"},
+    {{"gcc-", NULL}, "gcc-"},
+    {{"gcc-.", NULL}, "gcc-."},
+    {{"gcc-12-evil", NULL}, "gcc-12-evil"},
+    {{"gccx", NULL}, "gccx"},
+    {{"gcc", "-O2", "", NULL}, ""},
+    {{"gcc", "-Wl,-rpath,/tmp", NULL}, "-Wl,-rpath,/tmp"},
+    {{"gcc", "-Wa,-adhln=/tmp/x", NULL}, "-Wa,-adhln=/tmp/x"},
+    {{"gcc", "-Xassembler", "x", NULL}, "-Xassembler"},
+    {{"gcc", "-fplugin=/tmp/x.so", NULL}, "-fplugin=/tmp/x.so"},
+    {{"gcc", "-fprofile-use", NULL}, "-fprofile-use"},
+    {{"gcc", "-fprofile-generate", NULL}, "-fprofile-generate"},
+    {{"gcc", "-fsanitize-ignorelist=/etc/passwd", NULL}, "-fsanitize-ignorelist=/etc/passwd"},
+    {{"gcc", "--sysroot=/", NULL}, "--sysroot=/"},
+    {{"gcc", "-B/tmp", NULL}, "-B/tmp"},
+    {{"gcc", "-specs=/tmp/x", NULL}, "-specs=/tmp/x"},
+    {{"gcc", "-o", "/etc/passwd", NULL}, "-o"},
+    {{"gcc", "@/tmp/options", NULL}, "@/tmp/options"},
+    {{"gcc", "-D", "NAME", NULL}, "-D"},
+    {{"gcc", "-march=", NULL}, "-march="},
+    {{"gcc", "-x", "assembler", NULL}, "assembler"},
+    {{"gcc", "-x", NULL}, "-x"},
+    {{"gcc", "--param", NULL}, "--param"},
+    {{"gcc", "-x", "c", "-x", NULL}, "-x"},
+};
+
+static void TestArgumentsAllowed(Memory_Arena *arena)
+{
+    for (Uint32 index = 0; index < ArrayCount(ArgumentsCases); ++index)
+    {
+        const Arguments_Case *test = &ArgumentsCases[index];
+
+        String_List args;
+        StringListInit(&args);
+        for (Uint32 arg = 0; test->Args[arg]; ++arg)
+            StringListAdd(&args, StringMake(test->Args[arg], strlen(test->Args[arg])), arena);
+
+        String rejected = StringLiteral("");
+        bool   allowed  = RemoteArgumentsAllowed(&args, &rejected);
+        if (allowed != (test->Rejected == NULL))
+            fprintf(stderr, "case %u: %s\n", index, allowed ? "allowed" : "rejected");
+        Check(allowed == (test->Rejected == NULL));
+        if (!allowed && test->Rejected)
+            Check(StrMatch(rejected, StringMake(test->Rejected, strlen(test->Rejected))));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    InitThreadContext(NullMemoryAllocator(), MegaBytes(64), (Log_Agent){.Procedure = TestLogProcedure},
+                      TestFatalError);
+
+    Memory_Arena arena = MemoryArenaCreate(MegaBytes(16));
+
+    TestArgumentsAllowed(&arena);
+
+    if (FailedCount)
+    {
+        fprintf(stderr, "remote_test: %d checks failed\n", FailedCount);
+        return 1;
+    }
+
+    printf("remote_test: passed\n");
+    return 0;
+}